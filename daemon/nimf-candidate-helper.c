@@ -0,0 +1,577 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 2; tab-width: 2 -*- */
+/*
+ * nimf-candidate-helper.c
+ * This file is part of Nimf.
+ *
+ * Copyright (C) 2017 Hodong Kim <cogniti@gmail.com>
+ *
+ * Nimf is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Nimf is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program;  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Draws the candidate window for NimfCandidate in nimf-daemon.  The daemon
+ * spawns this helper on first use with a socket on stdin and stdout, so
+ * rendering never delays key dispatch in the daemon.
+ */
+
+#include "config.h"
+#include "nimf-private.h"
+#include <gtk/gtk.h>
+#include <glib-unix.h>
+#include <string.h>
+#include <unistd.h>
+
+#define NIMF_CANDIDATE_CELL_PADDING 4
+
+enum
+{
+  INDEX_COLUMN,
+  MAIN_COLUMN,
+  EXTRA_COLUMN,
+  N_COLUMNS
+};
+
+typedef struct
+{
+  gchar       *text[N_COLUMNS];
+  PangoLayout *layouts[N_COLUMNS]; /* NULL until measured */
+} NimfCandidateRow;
+
+typedef struct
+{
+  GtkWidget            *window;
+  GtkWidget            *entry;
+  GtkWidget            *list;
+  GtkWidget            *scrollbar;
+  PangoFontDescription *font;
+  gint                  cell_height;
+  GArray               *rows;
+  gint                  n_rows;
+  gint                  n_drawn_rows;
+  gint                  selected;
+  gint                  column_widths[N_COLUMNS];
+  GByteArray           *input;
+} NimfCandidateHelper;
+
+static NimfCandidateHelper helper;
+
+static void
+nimf_candidate_helper_send (NimfCandidateHelperOp  op,
+                            gconstpointer          data,
+                            guint32                data_len)
+{
+  NimfCandidateHelperHeader header = { op, data_len };
+
+  if (write (STDOUT_FILENO, &header, sizeof (header)) != sizeof (header) ||
+      write (STDOUT_FILENO, data, data_len) != data_len)
+    gtk_main_quit ();
+}
+
+static void
+nimf_candidate_helper_queue_draw_row (gint index)
+{
+  if (index < 0)
+    return;
+
+  gtk_widget_queue_draw_area (helper.list, 0,
+                              index * helper.cell_height,
+                              gtk_widget_get_allocated_width (helper.list),
+                              helper.cell_height);
+}
+
+static void
+nimf_candidate_helper_select_row (gint index)
+{
+  if (index == helper.selected)
+    return;
+
+  nimf_candidate_helper_queue_draw_row (helper.selected);
+  nimf_candidate_helper_queue_draw_row (index);
+  helper.selected = index;
+}
+
+static gboolean
+on_list_button_press_event (GtkWidget      *widget,
+                            GdkEventButton *event,
+                            gpointer        user_data)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  gint32 index = event->y / helper.cell_height;
+
+  if (event->button != 1 || index < 0 || index >= helper.n_rows)
+    return FALSE;
+
+  nimf_candidate_helper_select_row (index);
+
+  /* like GtkTreeView::row-activated */
+  if (event->type == GDK_2BUTTON_PRESS)
+    nimf_candidate_helper_send (NIMF_CANDIDATE_HELPER_CLICKED,
+                                &index, sizeof (gint32));
+  return TRUE;
+}
+
+static gboolean
+on_list_draw (GtkWidget *widget,
+              cairo_t   *cr,
+              gpointer   user_data)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  GtkStyleContext *style_context;
+  GdkRectangle     clip;
+  gint             width;
+  gint             first, last;
+  gint             i, j;
+
+  style_context = gtk_widget_get_style_context (widget);
+  width = gtk_widget_get_allocated_width (widget);
+
+  gtk_render_background (style_context, cr, 0, 0, width,
+                         gtk_widget_get_allocated_height (widget));
+
+  if (!gdk_cairo_get_clip_rectangle (cr, &clip))
+    return TRUE;
+
+  /* fixed height rows: draw only the rows in the clip */
+  first = clip.y / helper.cell_height;
+  last  = MIN (helper.n_rows - 1,
+               (clip.y + clip.height - 1) / helper.cell_height);
+
+  for (i = first; i <= last; i++)
+  {
+    NimfCandidateRow *row = &g_array_index (helper.rows, NimfCandidateRow, i);
+    gint x = NIMF_CANDIDATE_CELL_PADDING;
+    gint y = i * helper.cell_height;
+
+    gtk_style_context_save (style_context);
+
+    if (i == helper.selected)
+    {
+      gtk_style_context_set_state (style_context, GTK_STATE_FLAG_SELECTED);
+      gtk_render_background (style_context, cr, 0, y,
+                             width, helper.cell_height);
+    }
+
+    for (j = 0; j < N_COLUMNS; j++)
+    {
+      gint height;
+
+      if (row->layouts[j])
+      {
+        pango_layout_get_pixel_size (row->layouts[j], NULL, &height);
+        gtk_render_layout (style_context, cr, x,
+                           y + (helper.cell_height - height) / 2,
+                           row->layouts[j]);
+      }
+
+      x += helper.column_widths[j] + 2 * NIMF_CANDIDATE_CELL_PADDING;
+    }
+
+    gtk_style_context_restore (style_context);
+  }
+
+  return TRUE;
+}
+
+/* measures the rows that changed and resizes the list if needed */
+static void
+nimf_candidate_helper_update_rows (gint page_size)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  gint widths[N_COLUMNS] = { 0 };
+  gint width = 0;
+  gint i, j;
+
+  for (i = 0; i < helper.n_rows; i++)
+  {
+    NimfCandidateRow *row = &g_array_index (helper.rows, NimfCandidateRow, i);
+
+    for (j = 0; j < N_COLUMNS; j++)
+    {
+      gint w;
+
+      if (row->text[j] == NULL)
+        continue;
+
+      if (row->layouts[j] == NULL)
+      {
+        row->layouts[j] = gtk_widget_create_pango_layout (helper.list,
+                                                          row->text[j]);
+        pango_layout_set_font_description (row->layouts[j], helper.font);
+      }
+
+      pango_layout_get_pixel_size (row->layouts[j], &w, NULL);
+      widths[j] = MAX (widths[j], w);
+    }
+  }
+
+  /* clear the rows that went away */
+  if (helper.n_drawn_rows > helper.n_rows)
+    gtk_widget_queue_draw_area (helper.list, 0,
+                                helper.n_rows * helper.cell_height,
+                                gtk_widget_get_allocated_width (helper.list),
+                                (helper.n_drawn_rows - helper.n_rows) *
+                                helper.cell_height);
+
+  helper.n_drawn_rows = helper.n_rows;
+
+  if (memcmp (widths, helper.column_widths, sizeof (widths)) != 0)
+  {
+    memcpy (helper.column_widths, widths, sizeof (widths));
+    gtk_widget_queue_draw (helper.list);
+  }
+
+  for (j = 0; j < N_COLUMNS; j++)
+    width += widths[j] + 2 * NIMF_CANDIDATE_CELL_PADDING;
+
+  gtk_widget_set_size_request (helper.list,
+                               MAX (width, (gint) (helper.cell_height * 10 / 1.6)),
+                               helper.cell_height * page_size);
+}
+
+static void
+nimf_candidate_helper_set_cell (gint         index,
+                                gint         column,
+                                const gchar *text)
+{
+  NimfCandidateRow *row = &g_array_index (helper.rows, NimfCandidateRow, index);
+
+  if (g_strcmp0 (row->text[column], text) == 0)
+    return;
+
+  g_free (row->text[column]);
+  row->text[column] = g_strdup (text);
+  g_clear_object (&row->layouts[column]);
+  nimf_candidate_helper_queue_draw_row (index);
+}
+
+static void
+nimf_candidate_helper_set_row (const gchar *data, guint32 data_len)
+{
+  const gint32 *values = (const gint32 *) data;
+  const gchar  *item1, *item2 = NULL;
+  gint          index = values[0];
+
+  if (data_len <= 2 * sizeof (gint32) || index < 0 || index > 1024)
+    return;
+
+  item1 = data + 2 * sizeof (gint32);
+
+  if (values[1])
+    item2 = item1 + strlen (item1) + 1;
+
+  if (index >= helper.rows->len)
+  {
+    gint i = helper.rows->len;
+
+    g_array_set_size (helper.rows, index + 1);
+
+    for (; i <= index; i++)
+      g_array_index (helper.rows, NimfCandidateRow, i).text[INDEX_COLUMN] =
+        g_strdup_printf ("%d", (i + 1) % 10);
+  }
+
+  nimf_candidate_helper_set_cell (index, MAIN_COLUMN,  item1);
+  nimf_candidate_helper_set_cell (index, EXTRA_COLUMN, item2);
+}
+
+static void
+nimf_candidate_helper_set_page_values (const gint32 *values)
+{
+  GtkRange *range = GTK_RANGE (helper.scrollbar);
+
+  gtk_range_set_range (range, 1.0, (gdouble) values[1] + 1.0);
+
+  if (values[0] != (gint) gtk_range_get_value (range))
+    gtk_range_set_value (range, (gdouble) values[0]);
+
+  helper.n_rows = CLAMP (values[3], 0, (gint) helper.rows->len);
+  nimf_candidate_helper_update_rows (values[2]);
+}
+
+static void
+nimf_candidate_helper_show (const gint32 *values)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  GtkRequisition  natural_size;
+  int             x, y, w, h;
+  int             screen_width, screen_height;
+
+  #if GTK_CHECK_VERSION (3, 22, 0)
+    GdkRectangle  geometry;
+    GdkDisplay   *display = gtk_widget_get_display (helper.window);
+    GdkWindow    *window  = gtk_widget_get_window  (helper.window);
+    GdkMonitor   *monitor = gdk_display_get_monitor_at_window (display, window);
+    gdk_monitor_get_geometry (monitor, &geometry);
+    screen_width  = geometry.width;
+    screen_height = geometry.height;
+  #else
+    screen_width  = gdk_screen_width ();
+    screen_height = gdk_screen_height ();
+  #endif
+
+  if (values[4])
+    gtk_widget_show (helper.entry);
+  else
+    gtk_widget_hide (helper.entry);
+
+  gtk_widget_show_all (helper.window);
+  gtk_widget_get_preferred_size (helper.window, NULL, &natural_size);
+  gtk_window_resize (GTK_WINDOW (helper.window),
+                     natural_size.width, natural_size.height);
+  gtk_window_get_size (GTK_WINDOW (helper.window), &w, &h);
+
+  x = values[0] - values[2];
+  y = values[1] + values[3];
+
+  if (x + w > screen_width)
+    x = screen_width - w;
+
+  if (y + h > screen_height)
+    y = values[1] - h;
+
+  gtk_window_move (GTK_WINDOW (helper.window), x, y);
+}
+
+static void
+nimf_candidate_helper_dispatch (NimfCandidateHelperOp  op,
+                                const gchar           *data,
+                                guint32                data_len)
+{
+  const gint32 *values = (const gint32 *) data;
+
+  switch (op)
+  {
+    case NIMF_CANDIDATE_HELPER_SET_ROW:
+      nimf_candidate_helper_set_row (data, data_len);
+      break;
+    case NIMF_CANDIDATE_HELPER_SET_AUXILIARY_TEXT:
+      if (data_len > sizeof (gint32))
+      {
+        gtk_entry_set_text (GTK_ENTRY (helper.entry), data + sizeof (gint32));
+        gtk_editable_set_position (GTK_EDITABLE (helper.entry), values[0]);
+      }
+      break;
+    case NIMF_CANDIDATE_HELPER_SET_PAGE_VALUES:
+      if (data_len >= 4 * sizeof (gint32))
+        nimf_candidate_helper_set_page_values (values);
+      break;
+    case NIMF_CANDIDATE_HELPER_SELECT:
+      if (data_len >= sizeof (gint32))
+        nimf_candidate_helper_select_row (values[0] < helper.n_rows ?
+                                          values[0] : -1);
+      break;
+    case NIMF_CANDIDATE_HELPER_SHOW:
+      if (data_len >= 5 * sizeof (gint32))
+        nimf_candidate_helper_show (values);
+      break;
+    case NIMF_CANDIDATE_HELPER_HIDE:
+      gtk_widget_hide (helper.window);
+      break;
+    default:
+      g_warning (G_STRLOC ": %s: Unknown op: %d", G_STRFUNC, op);
+      break;
+  }
+}
+
+static gboolean
+on_input (gint          fd,
+          GIOCondition  condition,
+          gpointer      user_data)
+{
+  NimfCandidateHelperHeader header;
+  guint8  buffer[4096];
+  gssize  n_read;
+  guint   offset = 0;
+
+  n_read = read (fd, buffer, sizeof (buffer));
+
+  /* nimf-daemon has gone */
+  if (n_read <= 0)
+  {
+    gtk_main_quit ();
+    return G_SOURCE_REMOVE;
+  }
+
+  g_byte_array_append (helper.input, buffer, n_read);
+
+  /* a burst of updates is applied before the next frame is drawn */
+  while (helper.input->len - offset >= sizeof (header))
+  {
+    memcpy (&header, helper.input->data + offset, sizeof (header));
+
+    if (helper.input->len - offset - sizeof (header) < header.data_len)
+      break;
+
+    /* NUL terminate the data for the string payloads */
+    gchar *data = g_malloc (header.data_len + 1);
+    memcpy (data, helper.input->data + offset + sizeof (header),
+            header.data_len);
+    data[header.data_len] = 0;
+
+    nimf_candidate_helper_dispatch (header.op, data, header.data_len);
+    g_free (data);
+
+    offset += sizeof (header) + header.data_len;
+  }
+
+  g_byte_array_remove_range (helper.input, 0, offset);
+
+  return G_SOURCE_CONTINUE;
+}
+
+static gboolean
+on_range_change_value (GtkRange      *range,
+                       GtkScrollType  scroll,
+                       gdouble        value,
+                       gpointer       user_data)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  GtkAdjustment *adjustment;
+  gdouble        lower, upper;
+
+  adjustment = gtk_range_get_adjustment (range);
+  lower = gtk_adjustment_get_lower (adjustment);
+  upper = gtk_adjustment_get_upper (adjustment);
+
+  if (value < lower)
+    value = lower;
+  if (value > upper - 1)
+    value = upper - 1;
+
+  nimf_candidate_helper_send (NIMF_CANDIDATE_HELPER_SCROLLED,
+                              &value, sizeof (gdouble));
+  return FALSE;
+}
+
+static gboolean
+on_entry_draw (GtkWidget *widget,
+               cairo_t   *cr,
+               gpointer   user_data)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  GtkStyleContext *style_context;
+  PangoContext    *pango_context;
+  PangoLayout     *layout;
+  const char      *text;
+  gint             cursor_index;
+  gint             x, y;
+
+  style_context = gtk_widget_get_style_context (widget);
+  pango_context = gtk_widget_get_pango_context (widget);
+  layout = gtk_entry_get_layout (GTK_ENTRY (widget));
+  text = pango_layout_get_text (layout);
+  gtk_entry_get_layout_offsets (GTK_ENTRY (widget), &x, &y);
+  cursor_index = g_utf8_offset_to_pointer (text, gtk_editable_get_position (GTK_EDITABLE (widget))) - text;
+  gtk_render_insertion_cursor (style_context, cr, x, y, layout, cursor_index,
+                               pango_context_get_base_dir (pango_context));
+  return FALSE;
+}
+
+static void
+nimf_candidate_helper_init ()
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  gint fixed_height = 32;
+
+  /* gtk entry */
+  helper.entry = gtk_entry_new ();
+  gtk_editable_set_editable (GTK_EDITABLE (helper.entry), FALSE);
+  gtk_widget_set_no_show_all (helper.entry, TRUE);
+  g_signal_connect_after (helper.entry, "draw",
+                          G_CALLBACK (on_entry_draw), NULL);
+  /* candidate list */
+  helper.rows = g_array_new (FALSE, TRUE, sizeof (NimfCandidateRow));
+  helper.selected = -1;
+  helper.font = pango_font_description_from_string ("Sans 14");
+  helper.cell_height = fixed_height + 2;
+  helper.list = gtk_drawing_area_new ();
+  gtk_style_context_add_class (gtk_widget_get_style_context (helper.list),
+                               GTK_STYLE_CLASS_VIEW);
+  gtk_widget_add_events (helper.list, GDK_BUTTON_PRESS_MASK);
+  gtk_widget_set_size_request (helper.list,
+                               (gint) (helper.cell_height * 10 / 1.6),
+                               helper.cell_height * 10);
+  g_signal_connect (helper.list, "draw",
+                    G_CALLBACK (on_list_draw), NULL);
+  g_signal_connect (helper.list, "button-press-event",
+                    G_CALLBACK (on_list_button_press_event), NULL);
+  /* scrollbar */
+  GtkAdjustment *adjustment = gtk_adjustment_new (1.0, 1.0, 2.0, 1.0, 1.0, 1.0);
+  helper.scrollbar = gtk_scrollbar_new (GTK_ORIENTATION_VERTICAL, adjustment);
+  gtk_range_set_slider_size_fixed (GTK_RANGE (helper.scrollbar), FALSE);
+  g_signal_connect (helper.scrollbar, "change-value",
+                    G_CALLBACK (on_range_change_value), NULL);
+  GtkCssProvider  *provider;
+  GtkStyleContext *style_context;
+  provider = gtk_css_provider_new ();
+  gtk_css_provider_load_from_data (GTK_CSS_PROVIDER (provider),
+                       ".scrollbar {"
+                       "  -GtkScrollbar-has-backward-stepper: true;"
+                       "  -GtkScrollbar-has-forward-stepper:  true;"
+                       "  -GtkScrollbar-has-secondary-forward-stepper:  true;"
+                       "}" , -1, NULL);
+  style_context = gtk_widget_get_style_context (helper.scrollbar);
+  gtk_style_context_add_provider (style_context,
+                                  GTK_STYLE_PROVIDER (provider),
+                                  GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
+  g_object_unref (provider);
+
+  /* gtk box */
+  GtkWidget *vbox = gtk_box_new (GTK_ORIENTATION_VERTICAL, 0);
+  GtkWidget *hbox = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 0);
+
+  gtk_box_pack_start (GTK_BOX (vbox), helper.entry, TRUE, TRUE, 0);
+  gtk_box_pack_start (GTK_BOX (vbox), hbox, TRUE, TRUE, 0);
+
+  gtk_box_pack_start (GTK_BOX (hbox), helper.list,      TRUE,  TRUE, 0);
+  gtk_box_pack_end   (GTK_BOX (hbox), helper.scrollbar, FALSE, TRUE, 0);
+
+  /* gtk window */
+  helper.window = gtk_window_new (GTK_WINDOW_POPUP);
+  gtk_window_set_type_hint (GTK_WINDOW (helper.window),
+                            GDK_WINDOW_TYPE_HINT_POPUP_MENU);
+  gtk_container_set_border_width (GTK_CONTAINER (helper.window), 1);
+  gtk_container_add (GTK_CONTAINER (helper.window), vbox);
+
+  helper.input = g_byte_array_new ();
+}
+
+int
+main (int argc, char **argv)
+{
+  gtk_init (&argc, &argv);
+
+  if (isatty (STDIN_FILENO))
+  {
+    g_printerr ("%s is started by nimf-daemon\n", g_get_prgname ());
+    return EXIT_FAILURE;
+  }
+
+  nimf_candidate_helper_init ();
+  g_unix_fd_add (STDIN_FILENO, G_IO_IN | G_IO_HUP | G_IO_ERR, on_input, NULL);
+
+  gtk_main ();
+
+  gtk_widget_destroy (helper.window);
+  g_byte_array_free (helper.input, TRUE);
+
+  return EXIT_SUCCESS;
+}
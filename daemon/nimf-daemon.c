@@ -25,12 +25,28 @@
 #include <glib-unix.h>
 #include <syslog.h>
 #include "nimf-private.h"
+#include "nimf-span.h"
+#include "nimf-trace.h"
 #include <glib/gi18n.h>
 #include <unistd.h>
 #include <libaudit.h>
 
 gboolean syslog_initialized = FALSE;
 
+static gboolean
+on_sigusr1 (gpointer user_data)
+{
+  GError *error = NULL;
+
+  if (!nimf_span_dump (&error))
+  {
+    g_warning ("%s", error->message);
+    g_clear_error (&error);
+  }
+
+  return G_SOURCE_CONTINUE;
+}
+
 int
 main (int argc, char **argv)
 {
@@ -45,12 +61,14 @@ main (int argc, char **argv)
   gboolean is_no_daemon = FALSE;
   gboolean is_debug     = FALSE;
   gboolean is_version   = FALSE;
+  gchar   *trace_file   = NULL;
 
   GOptionContext *context;
   GOptionEntry    entries[] = {
     {"no-daemon", 0, 0, G_OPTION_ARG_NONE, &is_no_daemon, N_("Do not daemonize"), NULL},
     {"debug", 0, 0, G_OPTION_ARG_NONE, &is_debug, N_("Log debugging message"), NULL},
     {"version", 0, 0, G_OPTION_ARG_NONE, &is_version, N_("Version"), NULL},
+    {"trace", 0, 0, G_OPTION_ARG_FILENAME, &trace_file, N_("Record keystroke trace to FILE"), N_("FILE")},
     {NULL}
   };
 
@@ -83,6 +101,20 @@ main (int argc, char **argv)
     exit (EXIT_SUCCESS);
   }
 
+  /* before daemon (), which changes the working directory */
+  if (trace_file)
+  {
+    if (!nimf_trace_start (trace_file, &error))
+    {
+      g_warning ("%s", error->message);
+      g_clear_error (&error);
+    }
+
+    g_free (trace_file);
+  }
+
+  nimf_span_is_enabled (); /* resolves a relative NIMF_SPAN_DIR */
+
   if (is_no_daemon == FALSE)
   {
     openlog (g_get_prgname (), LOG_PID | LOG_PERROR, LOG_DAEMON);
@@ -119,13 +151,20 @@ main (int argc, char **argv)
   g_unix_signal_add (SIGINT,  (GSourceFunc) g_main_loop_quit, loop);
   g_unix_signal_add (SIGTERM, (GSourceFunc) g_main_loop_quit, loop);
 
+  if (nimf_span_is_enabled ())
+    g_unix_signal_add (SIGUSR1, on_sigusr1, NULL);
+
   g_main_loop_run (loop);
 
   g_main_loop_unref (loop);
   g_object_unref (server);
+  nimf_trace_stop ();
 
   if (syslog_initialized)
+  {
+    nimf_log_flush ();
     closelog ();
+  }
 
   return EXIT_SUCCESS;
 }
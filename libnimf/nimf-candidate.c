@@ -19,21 +19,62 @@
  * along with this program;  If not, see <http://www.gnu.org/licenses/>.
  */
 
+
 #include "nimf-candidate.h"
-#include <gtk/gtk.h>
+#include "nimf-private.h"
+#include <glib-unix.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
 
 static NimfCandidate *nimf_candidate_default = NULL;
 
+typedef struct
+{
+  gchar *text;
+  gchar *extra;
+} NimfCandidateRow;
+
+/*
+ * The candidate window is drawn by nimf-candidate-helper, spawned on
+ * first show.  NimfCandidate keeps the page and the selection here, so
+ * engines never wait for the helper; updates are queued on a
+ * non-blocking socket and only changed rows are sent.
+ *
+ * An engine either appends the rows of a page itself and pages through
+ * the candidate_page_up/down vfuncs, or sets a source with the total
+ * number of items, in which case paging is done here and only the items
+ * of the shown page are fetched.
+ */
 struct _NimfCandidate
 {
   GObject parent_instance;
 
   NimfServiceIM *target;
-  GtkWidget     *window;
-  GtkWidget     *entry;
-  GtkWidget     *treeview;
-  GtkWidget     *scrollbar;
-  gint           cell_height;
+  GArray        *rows;
+  gint           n_rows;
+  gint           selected;
+  gchar         *auxiliary_text;
+  gint           auxiliary_cursor_pos;
+  gint           page_index;
+  gint           n_pages;
+  gint           page_size;
+  gboolean       is_visible;
+  /* source */
+  NimfCandidateFillFunc fill_func;
+  gpointer       fill_data;
+  gint           n_items;
+  NimfCandidateItem *items;
+  gint           n_allocated_items;
+  /* helper */
+  GPid           pid;
+  gint           fd;
+  guint          child_watch_id;
+  guint          input_source_id;
+  guint          output_source_id;
+  GByteArray    *input;
+  GByteArray    *output;
 };
 
 struct _NimfCandidateClass
@@ -41,21 +82,222 @@ struct _NimfCandidateClass
   GObjectClass parent_class;
 };
 
-enum
+G_DEFINE_TYPE (NimfCandidate, nimf_candidate, G_TYPE_OBJECT);
+
+static void nimf_candidate_stop_helper (NimfCandidate *candidate);
+
+static gboolean
+nimf_candidate_flush (NimfCandidate *candidate)
 {
-  INDEX_COLUMN,
-  MAIN_COLUMN,
-  EXTRA_COLUMN,
-  N_COLUMNS
-};
+  gssize n_written;
 
-G_DEFINE_TYPE (NimfCandidate, nimf_candidate, G_TYPE_OBJECT);
+  while (candidate->output->len > 0)
+  {
+    n_written = send (candidate->fd, candidate->output->data,
+                      candidate->output->len, MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (n_written < 0)
+    {
+      if (errno == EINTR)
+        continue;
+
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        return FALSE;
+
+      g_warning (G_STRLOC ": %s: %s", G_STRFUNC, g_strerror (errno));
+      nimf_candidate_stop_helper (candidate);
+      return TRUE;
+    }
+
+    g_byte_array_remove_range (candidate->output, 0, n_written);
+  }
+
+  return TRUE;
+}
+
+static gboolean
+on_helper_writable (gint           fd,
+                    GIOCondition   condition,
+                    NimfCandidate *candidate)
+{
+  if (nimf_candidate_flush (candidate))
+  {
+    candidate->output_source_id = 0;
+    return G_SOURCE_REMOVE;
+  }
+
+  return G_SOURCE_CONTINUE;
+}
 
 static void
-on_tree_view_row_activated (GtkTreeView       *tree_view,
-                            GtkTreePath       *path,
-                            GtkTreeViewColumn *column,
-                            NimfCandidate     *candidate)
+nimf_candidate_send (NimfCandidate          *candidate,
+                     NimfCandidateHelperOp   op,
+                     gconstpointer           data,
+                     guint32                 data_len)
+{
+  NimfCandidateHelperHeader header = { op, data_len };
+
+  if (candidate->pid == 0)
+    return;
+
+  g_byte_array_append (candidate->output, (const guint8 *) &header,
+                       sizeof (header));
+  g_byte_array_append (candidate->output, data, data_len);
+
+  if (candidate->output_source_id)
+    return;
+
+  if (!nimf_candidate_flush (candidate))
+    candidate->output_source_id =
+      g_unix_fd_add (candidate->fd, G_IO_OUT,
+                     (GUnixFDSourceFunc) on_helper_writable, candidate);
+}
+
+static void
+nimf_candidate_send_row (NimfCandidate *candidate,
+                         gint           index)
+{
+  NimfCandidateRow *row = &g_array_index (candidate->rows,
+                                          NimfCandidateRow, index);
+  GByteArray *data = g_byte_array_new ();
+  gint32      values[2] = { index, row->extra != NULL };
+
+  g_byte_array_append (data, (const guint8 *) values, sizeof (values));
+  g_byte_array_append (data, (const guint8 *) row->text,
+                       strlen (row->text) + 1);
+
+  if (row->extra)
+    g_byte_array_append (data, (const guint8 *) row->extra,
+                         strlen (row->extra) + 1);
+
+  nimf_candidate_send (candidate, NIMF_CANDIDATE_HELPER_SET_ROW,
+                       data->data, data->len);
+  g_byte_array_free (data, TRUE);
+}
+
+static void
+nimf_candidate_send_auxiliary_text (NimfCandidate *candidate)
+{
+  GByteArray *data = g_byte_array_new ();
+  gint32      cursor_pos = candidate->auxiliary_cursor_pos;
+
+  g_byte_array_append (data, (const guint8 *) &cursor_pos, sizeof (gint32));
+  g_byte_array_append (data, (const guint8 *) candidate->auxiliary_text,
+                       strlen (candidate->auxiliary_text) + 1);
+  nimf_candidate_send (candidate, NIMF_CANDIDATE_HELPER_SET_AUXILIARY_TEXT,
+                       data->data, data->len);
+  g_byte_array_free (data, TRUE);
+}
+
+static void
+nimf_candidate_send_page_values (NimfCandidate *candidate)
+{
+  gint32 values[4] = { candidate->page_index, candidate->n_pages,
+                       candidate->page_size,  candidate->n_rows };
+
+  nimf_candidate_send (candidate, NIMF_CANDIDATE_HELPER_SET_PAGE_VALUES,
+                       values, sizeof (values));
+}
+
+static void
+nimf_candidate_send_selection (NimfCandidate *candidate)
+{
+  gint32 index = candidate->selected;
+
+  nimf_candidate_send (candidate, NIMF_CANDIDATE_HELPER_SELECT,
+                       &index, sizeof (gint32));
+}
+
+static void
+nimf_candidate_select_row (NimfCandidate *candidate,
+                           gint           index)
+{
+  if (index == candidate->selected)
+    return;
+
+  candidate->selected = index;
+  nimf_candidate_send_selection (candidate);
+}
+
+static gint
+nimf_candidate_get_page_offset (NimfCandidate *candidate)
+{
+  if (candidate->fill_func == NULL)
+    return 0;
+
+  return (candidate->page_index - 1) * candidate->page_size;
+}
+
+static NimfCandidateRow *
+nimf_candidate_get_next_row (NimfCandidate *candidate)
+{
+  if (candidate->n_rows == candidate->rows->len)
+    g_array_set_size (candidate->rows, candidate->n_rows + 1);
+
+  return &g_array_index (candidate->rows, NimfCandidateRow, candidate->n_rows);
+}
+
+/* takes the strings of the item; an unchanged row is not sent again */
+static void
+nimf_candidate_take_item (NimfCandidate     *candidate,
+                          NimfCandidateItem *item)
+{
+  NimfCandidateRow *row = nimf_candidate_get_next_row (candidate);
+
+  if (item->text == NULL)
+    item->text = g_strdup ("");
+
+  if (g_strcmp0 (row->text,  item->text)  != 0 ||
+      g_strcmp0 (row->extra, item->extra) != 0)
+  {
+    g_free (row->text);
+    g_free (row->extra);
+    row->text  = item->text;
+    row->extra = item->extra;
+    nimf_candidate_send_row (candidate, candidate->n_rows);
+  }
+  else
+  {
+    g_free (item->text);
+    g_free (item->extra);
+  }
+
+  item->text  = NULL;
+  item->extra = NULL;
+  candidate->n_rows++;
+}
+
+static void
+nimf_candidate_load_page (NimfCandidate *candidate,
+                          gint           page_index)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  gint offset = (page_index - 1) * candidate->page_size;
+  gint n_items;
+  gint i;
+
+  n_items = CLAMP (candidate->n_items - offset, 0, candidate->page_size);
+  candidate->n_rows     = 0;
+  candidate->page_index = page_index;
+
+  if (n_items > 0)
+  {
+    memset (candidate->items, 0, n_items * sizeof (NimfCandidateItem));
+    candidate->fill_func (candidate->fill_data, offset, n_items,
+                          candidate->items);
+  }
+
+  for (i = 0; i < n_items; i++)
+    nimf_candidate_take_item (candidate, &candidate->items[i]);
+
+  nimf_candidate_send_page_values (candidate);
+}
+
+static void
+nimf_candidate_dispatch (NimfCandidate          *candidate,
+                         NimfCandidateHelperOp   op,
+                         const gchar            *data,
+                         guint32                 data_len)
 {
   g_debug (G_STRLOC ": %s", G_STRFUNC);
 
@@ -66,71 +308,205 @@ on_tree_view_row_activated (GtkTreeView       *tree_view,
 
   engine_class = NIMF_ENGINE_GET_CLASS (candidate->target->engine);
 
-  gchar *text = nimf_candidate_get_selected_text (candidate);
-  gint *indices = gtk_tree_path_get_indices (path);
+  switch (op)
+  {
+    case NIMF_CANDIDATE_HELPER_CLICKED:
+      if (data_len == sizeof (gint32))
+      {
+        gint   index = *(const gint32 *) data;
+        gchar *text;
+
+        if (index < 0 || index >= candidate->n_rows)
+          break;
+
+        candidate->selected = index;
+        text = nimf_candidate_get_selected_text (candidate);
+
+        if (engine_class->candidate_clicked)
+          engine_class->candidate_clicked (candidate->target->engine,
+                                           candidate->target, text,
+                                           nimf_candidate_get_selected_index (candidate));
+        g_free (text);
+      }
+      break;
+    case NIMF_CANDIDATE_HELPER_SCROLLED:
+      if (data_len != sizeof (gdouble))
+        break;
+
+      if (candidate->fill_func)
+      {
+        gint page_index = CLAMP ((gint) *(const gdouble *) data,
+                                 1, candidate->n_pages);
+
+        if (page_index != candidate->page_index)
+        {
+          nimf_candidate_load_page (candidate, page_index);
+          nimf_candidate_select_first_item_in_page (candidate);
+        }
+      }
+      else if (engine_class->candidate_scrolled)
+      {
+        engine_class->candidate_scrolled (candidate->target->engine,
+                                          candidate->target,
+                                          *(const gdouble *) data);
+      }
+      break;
+    default:
+      g_warning (G_STRLOC ": %s: Unknown op: %d", G_STRFUNC, op);
+      break;
+  }
+}
+
+static gboolean
+on_helper_readable (gint           fd,
+                    GIOCondition   condition,
+                    NimfCandidate *candidate)
+{
+  NimfCandidateHelperHeader header;
+  guint8 buffer[256];
+  gssize n_read;
 
-  if (engine_class->candidate_clicked)
-    engine_class->candidate_clicked (candidate->target->engine,
-                                     candidate->target, text, indices[0]);
-  g_free (text);
+  n_read = recv (fd, buffer, sizeof (buffer), MSG_DONTWAIT);
+
+  if (n_read < 0 && (errno == EAGAIN || errno == EINTR))
+    return G_SOURCE_CONTINUE;
+
+  if (n_read <= 0)
+  {
+    candidate->input_source_id = 0;
+    nimf_candidate_stop_helper (candidate);
+    return G_SOURCE_REMOVE;
+  }
+
+  g_byte_array_append (candidate->input, buffer, n_read);
+
+  while (candidate->input->len >= sizeof (header))
+  {
+    gchar *data;
+
+    memcpy (&header, candidate->input->data, sizeof (header));
+
+    if (candidate->input->len - sizeof (header) < header.data_len)
+      break;
+
+    data = g_memdup (candidate->input->data + sizeof (header), header.data_len);
+    g_byte_array_remove_range (candidate->input, 0,
+                               sizeof (header) + header.data_len);
+    nimf_candidate_dispatch (candidate, header.op, data, header.data_len);
+    g_free (data);
+
+    /* the engine may have hidden the window and the helper gone */
+    if (candidate->pid == 0)
+      return G_SOURCE_REMOVE;
+  }
+
+  return G_SOURCE_CONTINUE;
 }
 
-gboolean
-on_range_change_value (GtkRange      *range,
-                       GtkScrollType  scroll,
-                       gdouble        value,
-                       NimfCandidate *candidate)
+static void
+on_helper_exited (GPid           pid,
+                  gint           status,
+                  NimfCandidate *candidate)
 {
   g_debug (G_STRLOC ": %s", G_STRFUNC);
 
-  g_return_val_if_fail (candidate->target &&
-                        NIMF_IS_ENGINE (candidate->target->engine), FALSE);
+  g_spawn_close_pid (pid);
 
-  NimfEngineClass *engine_class;
-  GtkAdjustment   *adjustment;
-  gdouble          lower, upper;
+  if (candidate->pid == pid)
+  {
+    candidate->child_watch_id = 0;
+    nimf_candidate_stop_helper (candidate);
+  }
+}
+
+static void
+nimf_candidate_stop_helper (NimfCandidate *candidate)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
 
-  adjustment = gtk_range_get_adjustment (range);
-  lower = gtk_adjustment_get_lower (adjustment);
-  upper = gtk_adjustment_get_upper (adjustment);
+  if (candidate->pid == 0)
+    return;
 
-  if (value < lower)
-    value = lower;
-  if (value > upper - 1)
-    value = upper - 1;
+  if (candidate->child_watch_id)
+    g_source_remove (candidate->child_watch_id);
 
-  engine_class = NIMF_ENGINE_GET_CLASS (candidate->target->engine);
+  if (candidate->input_source_id)
+    g_source_remove (candidate->input_source_id);
 
-  if (engine_class->candidate_scrolled)
-    engine_class->candidate_scrolled (candidate->target->engine,
-                                      candidate->target, value);
-  return FALSE;
+  if (candidate->output_source_id)
+    g_source_remove (candidate->output_source_id);
+
+  /* the helper exits when it reads EOF */
+  close (candidate->fd);
+
+  candidate->pid              = 0;
+  candidate->fd               = -1;
+  candidate->child_watch_id   = 0;
+  candidate->input_source_id  = 0;
+  candidate->output_source_id = 0;
+  candidate->is_visible       = FALSE;
+  g_byte_array_set_size (candidate->input,  0);
+  g_byte_array_set_size (candidate->output, 0);
 }
 
+static void
+nimf_candidate_helper_setup (gpointer user_data)
+{
+  gint fd = GPOINTER_TO_INT (user_data);
+
+  dup2 (fd, STDIN_FILENO);
+  dup2 (fd, STDOUT_FILENO);
+}
 
 static gboolean
-on_entry_draw (GtkWidget *widget,
-               cairo_t   *cr,
-               gpointer   user_data)
+nimf_candidate_start_helper (NimfCandidate *candidate)
 {
   g_debug (G_STRLOC ": %s", G_STRFUNC);
 
-  GtkStyleContext *style_context;
-  PangoContext    *pango_context;
-  PangoLayout     *layout;
-  const char      *text;
-  gint             cursor_index;
-  gint             x, y;
+  gchar  *argv[] = { NIMF_CANDIDATE_HELPER, NULL };
+  GError *error  = NULL;
+  gint    fds[2];
+  guint   i;
+
+  if (candidate->pid)
+    return TRUE;
 
-  style_context = gtk_widget_get_style_context (widget);
-  pango_context = gtk_widget_get_pango_context (widget);
-  layout = gtk_entry_get_layout (GTK_ENTRY (widget));
-  text = pango_layout_get_text (layout);
-  gtk_entry_get_layout_offsets (GTK_ENTRY (widget), &x, &y);
-  cursor_index = g_utf8_offset_to_pointer (text, gtk_editable_get_position (GTK_EDITABLE (widget))) - text;
-  gtk_render_insertion_cursor (style_context, cr, x, y, layout, cursor_index,
-                               pango_context_get_base_dir (pango_context));
-  return FALSE;
+  if (socketpair (AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) != 0)
+  {
+    g_warning (G_STRLOC ": %s: %s", G_STRFUNC, g_strerror (errno));
+    return FALSE;
+  }
+
+  /* dup2 () in the child clears close-on-exec on the copies */
+  if (!g_spawn_async (NULL, argv, NULL, G_SPAWN_DO_NOT_REAP_CHILD,
+                      nimf_candidate_helper_setup, GINT_TO_POINTER (fds[1]),
+                      &candidate->pid, &error))
+  {
+    g_warning (G_STRLOC ": %s: %s", G_STRFUNC, error->message);
+    g_clear_error (&error);
+    close (fds[0]);
+    close (fds[1]);
+    return FALSE;
+  }
+
+  close (fds[1]);
+  candidate->fd = fds[0];
+  candidate->child_watch_id =
+    g_child_watch_add (candidate->pid, (GChildWatchFunc) on_helper_exited,
+                       candidate);
+  candidate->input_source_id =
+    g_unix_fd_add (candidate->fd, G_IO_IN | G_IO_HUP | G_IO_ERR,
+                   (GUnixFDSourceFunc) on_helper_readable, candidate);
+
+  /* replay the current state; a restarted helper starts from scratch */
+  for (i = 0; i < candidate->rows->len; i++)
+    nimf_candidate_send_row (candidate, i);
+
+  nimf_candidate_send_auxiliary_text (candidate);
+  nimf_candidate_send_page_values    (candidate);
+  nimf_candidate_send_selection      (candidate);
+
+  return TRUE;
 }
 
 static void
@@ -138,90 +514,17 @@ nimf_candidate_init (NimfCandidate *candidate)
 {
   g_debug (G_STRLOC ": %s", G_STRFUNC);
 
-  GtkCellRenderer   *renderer;
-  GtkTreeViewColumn *column[N_COLUMNS];
-  GtkListStore      *store;
-  gint               fixed_height = 32;
-  gint               horizontal_space;
-
-  gtk_init (NULL, NULL);
   nimf_candidate_default = candidate;
 
-  /* gtk entry */
-  candidate->entry = gtk_entry_new ();
-  gtk_editable_set_editable (GTK_EDITABLE (candidate->entry), FALSE);
-  gtk_widget_set_no_show_all (candidate->entry, TRUE);
-  g_signal_connect_after (candidate->entry, "draw",
-                          G_CALLBACK (on_entry_draw), NULL);
-  /* gtk tree view */
-  store = gtk_list_store_new (N_COLUMNS, G_TYPE_INT, G_TYPE_STRING, G_TYPE_STRING);
-  candidate->treeview = gtk_tree_view_new_with_model (GTK_TREE_MODEL (store));
-  g_object_unref (store);
-  gtk_tree_view_set_headers_visible (GTK_TREE_VIEW (candidate->treeview), FALSE);
-  gtk_widget_style_get (candidate->treeview, "horizontal-separator",
-                        &horizontal_space, NULL);
-  candidate->cell_height = fixed_height + horizontal_space / 2;
-  gtk_widget_set_size_request (candidate->treeview,
-                               (gint) (candidate->cell_height * 10 / 1.6),
-                               candidate->cell_height * 10);
-  g_signal_connect (candidate->treeview, "row-activated",
-                    (GCallback) on_tree_view_row_activated, candidate);
-  /* column */
-  renderer = gtk_cell_renderer_text_new ();
-  g_object_set (renderer, "height", fixed_height, "font", "Sans 14", NULL);
-
-  column[INDEX_COLUMN] = gtk_tree_view_column_new_with_attributes ("Index",
-                                        renderer, "text", INDEX_COLUMN, NULL);
-  column[MAIN_COLUMN]  = gtk_tree_view_column_new_with_attributes ("Main",
-                                        renderer, "text", MAIN_COLUMN, NULL);
-  column[EXTRA_COLUMN] = gtk_tree_view_column_new_with_attributes ("Extra",
-                                        renderer, "text", EXTRA_COLUMN, NULL);
-  gtk_tree_view_column_set_sizing (column[INDEX_COLUMN], GTK_TREE_VIEW_COLUMN_AUTOSIZE);
-  gtk_tree_view_column_set_sizing (column[MAIN_COLUMN],  GTK_TREE_VIEW_COLUMN_AUTOSIZE);
-  gtk_tree_view_column_set_sizing (column[EXTRA_COLUMN], GTK_TREE_VIEW_COLUMN_AUTOSIZE);
-  gtk_tree_view_append_column (GTK_TREE_VIEW (candidate->treeview),
-                               column[INDEX_COLUMN]);
-  gtk_tree_view_append_column (GTK_TREE_VIEW (candidate->treeview),
-                               column[MAIN_COLUMN]);
-  gtk_tree_view_append_column (GTK_TREE_VIEW (candidate->treeview),
-                               column[EXTRA_COLUMN]);
-  /* scrollbar */
-  GtkAdjustment *adjustment = gtk_adjustment_new (1.0, 1.0, 2.0, 1.0, 1.0, 1.0);
-  candidate->scrollbar = gtk_scrollbar_new (GTK_ORIENTATION_VERTICAL, adjustment);
-  gtk_range_set_slider_size_fixed (GTK_RANGE (candidate->scrollbar), FALSE);
-  g_signal_connect (candidate->scrollbar, "change-value",
-                    G_CALLBACK (on_range_change_value), candidate);
-  GtkCssProvider  *provider;
-  GtkStyleContext *style_context;
-  provider = gtk_css_provider_new ();
-  gtk_css_provider_load_from_data (GTK_CSS_PROVIDER (provider),
-                       ".scrollbar {"
-                       "  -GtkScrollbar-has-backward-stepper: true;"
-                       "  -GtkScrollbar-has-forward-stepper:  true;"
-                       "  -GtkScrollbar-has-secondary-forward-stepper:  true;"
-                       "}" , -1, NULL);
-  style_context = gtk_widget_get_style_context (candidate->scrollbar);
-  gtk_style_context_add_provider (style_context,
-                                  GTK_STYLE_PROVIDER (provider),
-                                  GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
-  g_object_unref (provider);
-
-  /* gtk box */
-  GtkWidget *vbox = gtk_box_new (GTK_ORIENTATION_VERTICAL, 0);
-  GtkWidget *hbox = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 0);
-
-  gtk_box_pack_start (GTK_BOX (vbox), candidate->entry, TRUE, TRUE, 0);
-  gtk_box_pack_start (GTK_BOX (vbox), hbox, TRUE, TRUE, 0);
-
-  gtk_box_pack_start (GTK_BOX (hbox), candidate->treeview,  TRUE,  TRUE, 0);
-  gtk_box_pack_end   (GTK_BOX (hbox), candidate->scrollbar, FALSE, TRUE, 0);
-
-  /* gtk window */
-  candidate->window = gtk_window_new (GTK_WINDOW_POPUP);
-  gtk_window_set_type_hint (GTK_WINDOW (candidate->window),
-                            GDK_WINDOW_TYPE_HINT_POPUP_MENU);
-  gtk_container_set_border_width (GTK_CONTAINER (candidate->window), 1);
-  gtk_container_add (GTK_CONTAINER (candidate->window), vbox);
+  candidate->rows           = g_array_new (FALSE, TRUE, sizeof (NimfCandidateRow));
+  candidate->selected       = -1;
+  candidate->auxiliary_text = g_strdup ("");
+  candidate->page_index     = 1;
+  candidate->n_pages        = 1;
+  candidate->page_size      = 10;
+  candidate->fd             = -1;
+  candidate->input          = g_byte_array_new ();
+  candidate->output         = g_byte_array_new ();
 }
 
 static void
@@ -229,7 +532,28 @@ nimf_candidate_finalize (GObject *object)
 {
   g_debug (G_STRLOC ": %s", G_STRFUNC);
 
-  gtk_widget_destroy (NIMF_CANDIDATE (object)->window);
+  NimfCandidate *candidate = NIMF_CANDIDATE (object);
+  guint          i;
+
+  nimf_candidate_stop_helper (candidate);
+
+  for (i = 0; i < candidate->rows->len; i++)
+  {
+    NimfCandidateRow *row = &g_array_index (candidate->rows,
+                                            NimfCandidateRow, i);
+    g_free (row->text);
+    g_free (row->extra);
+  }
+
+  g_array_free (candidate->rows, TRUE);
+  g_free (candidate->items);
+  g_free (candidate->auxiliary_text);
+  g_byte_array_free (candidate->input,  TRUE);
+  g_byte_array_free (candidate->output, TRUE);
+
+  if (nimf_candidate_default == candidate)
+    nimf_candidate_default = NULL;
+
   G_OBJECT_CLASS (nimf_candidate_parent_class)->finalize (object);
 }
 
@@ -243,16 +567,21 @@ nimf_candidate_class_init (NimfCandidateClass *class)
   object_class->finalize = nimf_candidate_finalize;
 }
 
+/* the rows are reused by the following nimf_candidate_append () calls and
+ * sent in nimf_candidate_set_page_values () */
 void nimf_candidate_clear (NimfCandidate *candidate,
                            NimfServiceIM *target)
 {
   g_debug (G_STRLOC ": %s", G_STRFUNC);
 
-  GtkTreeModel *model;
-
-  model = gtk_tree_view_get_model (GTK_TREE_VIEW (candidate->treeview));
-  gtk_list_store_clear (GTK_LIST_STORE (model));
-  nimf_candidate_set_page_values (candidate, target, 1, 1, 5);
+  candidate->target     = target;
+  candidate->n_rows     = 0;
+  candidate->page_index = 1;
+  candidate->n_pages    = 1;
+  candidate->fill_func  = NULL;
+  candidate->fill_data  = NULL;
+  candidate->n_items    = 0;
+  nimf_candidate_select_row (candidate, -1);
 }
 
 void nimf_candidate_append (NimfCandidate *candidate,
@@ -261,21 +590,19 @@ void nimf_candidate_append (NimfCandidate *candidate,
 {
   g_debug (G_STRLOC ": %s", G_STRFUNC);
 
-  GtkTreeModel  *model;
-  GtkTreeIter    iter;
-  gint           n_row;
+  NimfCandidateRow *row = nimf_candidate_get_next_row (candidate);
 
-  model = gtk_tree_view_get_model (GTK_TREE_VIEW (candidate->treeview));
-  n_row = gtk_tree_model_iter_n_children (GTK_TREE_MODEL (model), NULL);
-
-  gtk_list_store_append (GTK_LIST_STORE (model), &iter);
-  gtk_list_store_set    (GTK_LIST_STORE (model), &iter,
-                         INDEX_COLUMN, (n_row + 1) % 10,
-                         MAIN_COLUMN, item1, -1);
+  if (g_strcmp0 (row->text,  item1) != 0 ||
+      g_strcmp0 (row->extra, item2) != 0)
+  {
+    g_free (row->text);
+    g_free (row->extra);
+    row->text  = g_strdup (item1 ? item1 : "");
+    row->extra = g_strdup (item2);
+    nimf_candidate_send_row (candidate, candidate->n_rows);
+  }
 
-  if (item2)
-    gtk_list_store_set (GTK_LIST_STORE (model), &iter,
-                        EXTRA_COLUMN, item2, -1);
+  candidate->n_rows++;
 }
 
 void nimf_candidate_set_auxiliary_text (NimfCandidate *candidate,
@@ -284,8 +611,14 @@ void nimf_candidate_set_auxiliary_text (NimfCandidate *candidate,
 {
   g_debug (G_STRLOC ": %s", G_STRFUNC);
 
-  gtk_entry_set_text (GTK_ENTRY (candidate->entry), text);
-  gtk_editable_set_position (GTK_EDITABLE (candidate->entry), cursor_pos);
+  if (candidate->auxiliary_cursor_pos == cursor_pos &&
+      g_strcmp0 (candidate->auxiliary_text, text) == 0)
+    return;
+
+  g_free (candidate->auxiliary_text);
+  candidate->auxiliary_text       = g_strdup (text ? text : "");
+  candidate->auxiliary_cursor_pos = cursor_pos;
+  nimf_candidate_send_auxiliary_text (candidate);
 }
 
 void nimf_candidate_set_page_values (NimfCandidate *candidate,
@@ -296,17 +629,11 @@ void nimf_candidate_set_page_values (NimfCandidate *candidate,
 {
   g_debug (G_STRLOC ": %s", G_STRFUNC);
 
-  GtkRange *range = GTK_RANGE (candidate->scrollbar);
-
-  candidate->target = target;
-  gtk_range_set_range (range, 1.0, (gdouble) n_pages + 1.0);
-
-  if (page_index != (gint) gtk_range_get_value (range))
-    gtk_range_set_value (range, (gdouble) page_index);
-
-  gtk_widget_set_size_request (candidate->treeview,
-                               (gint) (candidate->cell_height *  10 / 1.6),
-                               candidate->cell_height * page_size);
+  candidate->target     = target;
+  candidate->page_index = page_index;
+  candidate->n_pages    = n_pages;
+  candidate->page_size  = page_size;
+  nimf_candidate_send_page_values (candidate);
 }
 
 void nimf_candidate_show_window (NimfCandidate *candidate,
@@ -315,60 +642,40 @@ void nimf_candidate_show_window (NimfCandidate *candidate,
 {
   g_debug (G_STRLOC ": %s", G_STRFUNC);
 
-  GtkRequisition  natural_size;
-  int             x, y, w, h;
-  int             screen_width, screen_height;
-
-  #if GTK_CHECK_VERSION (3, 22, 0)
-    GdkRectangle  geometry;
-    GdkDisplay   *display = gtk_widget_get_display (candidate->window);
-    GdkWindow    *window  = gtk_widget_get_window  (candidate->window);
-    GdkMonitor   *monitor = gdk_display_get_monitor_at_window (display, window);
-    gdk_monitor_get_geometry (monitor, &geometry);
-    screen_width  = geometry.width;
-    screen_height = geometry.height;
-  #else
-    screen_width  = gdk_screen_width ();
-    screen_height = gdk_screen_height ();
-  #endif
+  gint32 values[5] = { target->cursor_area.x,
+                       target->cursor_area.y,
+                       target->cursor_area.width,
+                       target->cursor_area.height,
+                       show_entry };
 
   candidate->target = target;
 
-  if (show_entry)
-    gtk_widget_show (candidate->entry);
-  else
-    gtk_widget_hide (candidate->entry);
-
-  gtk_widget_show_all (candidate->window);
-  gtk_widget_get_preferred_size (candidate->window, NULL, &natural_size);
-  gtk_window_resize (GTK_WINDOW (candidate->window),
-                     natural_size.width, natural_size.height);
-  gtk_window_get_size (GTK_WINDOW (candidate->window), &w, &h);
-
-  x = target->cursor_area.x - target->cursor_area.width;
-  y = target->cursor_area.y + target->cursor_area.height;
-
-  if (x + w > screen_width)
-    x = screen_width - w;
-
-  if (y + h > screen_height)
-    y = target->cursor_area.y - h;
+  if (!nimf_candidate_start_helper (candidate))
+    return;
 
-  gtk_window_move (GTK_WINDOW (candidate->window), x, y);
+  /* in case the page was cleared without new page values */
+  nimf_candidate_send_page_values (candidate);
+  nimf_candidate_send (candidate, NIMF_CANDIDATE_HELPER_SHOW,
+                       values, sizeof (values));
+  candidate->is_visible = TRUE;
 }
 
 void nimf_candidate_hide_window (NimfCandidate *candidate)
 {
   g_debug (G_STRLOC ": %s", G_STRFUNC);
 
-  gtk_widget_hide (candidate->window);
+  if (!candidate->is_visible)
+    return;
+
+  nimf_candidate_send (candidate, NIMF_CANDIDATE_HELPER_HIDE, NULL, 0);
+  candidate->is_visible = FALSE;
 }
 
 gboolean nimf_candidate_is_window_visible (NimfCandidate *candidate)
 {
   g_debug (G_STRLOC ": %s", G_STRFUNC);
 
-  return gtk_widget_is_visible (candidate->window);
+  return candidate->is_visible;
 }
 
 void
@@ -376,17 +683,8 @@ nimf_candidate_select_last_item_in_page (NimfCandidate *candidate)
 {
   g_debug (G_STRLOC ": %s", G_STRFUNC);
 
-  GtkTreeModel     *model;
-  GtkTreeSelection *selection;
-  GtkTreeIter       iter;
-
-  model = gtk_tree_view_get_model (GTK_TREE_VIEW (candidate->treeview));
-  selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (candidate->treeview));
-  gint n_row = gtk_tree_model_iter_n_children (GTK_TREE_MODEL (model), NULL);
-
-  if (gtk_tree_model_iter_nth_child (GTK_TREE_MODEL (model),
-                                     &iter, NULL, MAX (0, n_row - 1)))
-    gtk_tree_selection_select_iter (selection, &iter);
+  if (candidate->n_rows > 0)
+    nimf_candidate_select_row (candidate, candidate->n_rows - 1);
 }
 
 void
@@ -395,15 +693,8 @@ nimf_candidate_select_item_by_index_in_page (NimfCandidate *candidate,
 {
   g_debug (G_STRLOC ": %s", G_STRFUNC);
 
-  GtkTreeModel     *model;
-  GtkTreeSelection *selection;
-  GtkTreeIter       iter;
-
-  model = gtk_tree_view_get_model (GTK_TREE_VIEW (candidate->treeview));
-  selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (candidate->treeview));
-
-  if (gtk_tree_model_iter_nth_child (GTK_TREE_MODEL (model), &iter, NULL, index))
-    gtk_tree_selection_select_iter (selection, &iter);
+  if (index >= 0 && index < candidate->n_rows)
+    nimf_candidate_select_row (candidate, index);
 }
 
 void
@@ -411,22 +702,19 @@ nimf_candidate_select_previous_item (NimfCandidate *candidate)
 {
   g_debug (G_STRLOC ": %s", G_STRFUNC);
 
-  GtkTreeModel     *model;
-  GtkTreeSelection *selection;
-  GtkTreeIter       iter;
-
-  model = gtk_tree_view_get_model (GTK_TREE_VIEW (candidate->treeview));
-  selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (candidate->treeview));
-
-  if (gtk_tree_selection_get_selected (selection, &model, &iter) == FALSE)
+  if (candidate->selected < 0)
   {
     nimf_candidate_select_last_item_in_page (candidate);
     return;
   }
 
-  if (gtk_tree_model_iter_previous (model, &iter))
+  if (candidate->selected > 0)
+  {
+    nimf_candidate_select_row (candidate, candidate->selected - 1);
+  }
+  else if (candidate->fill_func)
   {
-    gtk_tree_selection_select_iter (selection, &iter);
+    nimf_candidate_page_up (candidate);
   }
   else
   {
@@ -447,15 +735,8 @@ nimf_candidate_select_first_item_in_page (NimfCandidate *candidate)
 {
   g_debug (G_STRLOC ": %s", G_STRFUNC);
 
-  GtkTreeModel     *model;
-  GtkTreeSelection *selection;
-  GtkTreeIter       iter;
-
-  model = gtk_tree_view_get_model (GTK_TREE_VIEW (candidate->treeview));
-  selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (candidate->treeview));
-
-  if (gtk_tree_model_get_iter_first (model, &iter))
-    gtk_tree_selection_select_iter (selection, &iter);
+  if (candidate->n_rows > 0)
+    nimf_candidate_select_row (candidate, 0);
 }
 
 void
@@ -463,22 +744,19 @@ nimf_candidate_select_next_item (NimfCandidate *candidate)
 {
   g_debug (G_STRLOC ": %s", G_STRFUNC);
 
-  GtkTreeModel     *model;
-  GtkTreeSelection *selection;
-  GtkTreeIter       iter;
-
-  model = gtk_tree_view_get_model (GTK_TREE_VIEW (candidate->treeview));
-  selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (candidate->treeview));
-
-  if (gtk_tree_selection_get_selected (selection, &model, &iter) == FALSE)
+  if (candidate->selected < 0)
   {
     nimf_candidate_select_first_item_in_page (candidate);
     return;
   }
 
-  if (gtk_tree_model_iter_next (model, &iter))
+  if (candidate->selected < candidate->n_rows - 1)
   {
-    gtk_tree_selection_select_iter (selection, &iter);
+    nimf_candidate_select_row (candidate, candidate->selected + 1);
+  }
+  else if (candidate->fill_func)
+  {
+    nimf_candidate_page_down (candidate);
   }
   else
   {
@@ -512,40 +790,129 @@ gchar *nimf_candidate_get_selected_text (NimfCandidate *candidate)
 {
   g_debug (G_STRLOC ": %s", G_STRFUNC);
 
-  GtkTreeIter   iter;
-  GtkTreeModel *model;
-  gchar        *text = NULL;
+  if (candidate->selected < 0 || candidate->selected >= candidate->n_rows)
+    return NULL;
 
-  GtkTreeSelection *selection;
-  selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (candidate->treeview));
+  return g_strdup (g_array_index (candidate->rows, NimfCandidateRow,
+                                  candidate->selected).text);
+}
 
-  if (gtk_tree_selection_get_selected (selection, &model, &iter))
-    gtk_tree_model_get (model, &iter, MAIN_COLUMN, &text, -1);
+/* with a source, the index is the index of the item in the source */
+gint nimf_candidate_get_selected_index (NimfCandidate *candidate)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
 
-  return text;
+  return nimf_candidate_get_item_index (candidate, candidate->selected);
 }
 
-gint nimf_candidate_get_selected_index (NimfCandidate *candidate)
+void
+nimf_candidate_set_source (NimfCandidate         *candidate,
+                           NimfServiceIM         *target,
+                           gint                   n_items,
+                           gint                   page_size,
+                           NimfCandidateFillFunc  fill_func,
+                           gpointer               user_data)
 {
   g_debug (G_STRLOC ": %s", G_STRFUNC);
 
-  GtkTreeIter       iter;
-  GtkTreeModel     *model;
-  GtkTreeSelection *selection;
-  gint              index = -1;
+  g_return_if_fail (page_size > 0 && fill_func != NULL);
 
-  selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (candidate->treeview));
+  candidate->target    = target;
+  candidate->fill_func = fill_func;
+  candidate->fill_data = user_data;
+  candidate->n_items   = MAX (n_items, 0);
+  candidate->page_size = page_size;
+  candidate->n_pages   = MAX (1, (candidate->n_items + page_size - 1) / page_size);
 
-  if (gtk_tree_selection_get_selected (selection, &model, &iter))
+  if (candidate->n_allocated_items < page_size)
   {
-    GtkTreePath *path = gtk_tree_model_get_path (model, &iter);
-    gint *indices = gtk_tree_path_get_indices (path);
+    g_free (candidate->items);
+    candidate->items = g_new0 (NimfCandidateItem, page_size);
+    candidate->n_allocated_items = page_size;
+  }
+
+  nimf_candidate_load_page (candidate, 1);
+  nimf_candidate_select_row (candidate, candidate->n_rows > 0 ? 0 : -1);
+}
+
+/* returns the index in the source of the item shown at @index_in_page,
+ * or -1 if there is no such row */
+gint
+nimf_candidate_get_item_index (NimfCandidate *candidate,
+                               gint           index_in_page)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  if (index_in_page < 0 || index_in_page >= candidate->n_rows)
+    return -1;
+
+  return nimf_candidate_get_page_offset (candidate) + index_in_page;
+}
+
+gboolean
+nimf_candidate_page_up (NimfCandidate *candidate)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  if (candidate->fill_func == NULL)
+    return FALSE;
+
+  if (candidate->page_index <= 1)
+  {
+    nimf_candidate_select_first_item_in_page (candidate);
+    return FALSE;
+  }
+
+  nimf_candidate_load_page (candidate, candidate->page_index - 1);
+  nimf_candidate_select_last_item_in_page (candidate);
+
+  return TRUE;
+}
+
+gboolean
+nimf_candidate_page_down (NimfCandidate *candidate)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
 
-    if (indices)
-      index = indices[0];
+  if (candidate->fill_func == NULL)
+    return FALSE;
 
-    gtk_tree_path_free (path);
+  if (candidate->page_index >= candidate->n_pages)
+  {
+    nimf_candidate_select_last_item_in_page (candidate);
+    return FALSE;
   }
 
-  return index;
+  nimf_candidate_load_page (candidate, candidate->page_index + 1);
+  nimf_candidate_select_first_item_in_page (candidate);
+
+  return TRUE;
+}
+
+void
+nimf_candidate_page_home (NimfCandidate *candidate)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  if (candidate->fill_func == NULL)
+    return;
+
+  if (candidate->page_index > 1)
+    nimf_candidate_load_page (candidate, 1);
+
+  nimf_candidate_select_first_item_in_page (candidate);
+}
+
+void
+nimf_candidate_page_end (NimfCandidate *candidate)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  if (candidate->fill_func == NULL)
+    return;
+
+  if (candidate->page_index < candidate->n_pages)
+    nimf_candidate_load_page (candidate, candidate->n_pages);
+
+  nimf_candidate_select_last_item_in_page (candidate);
 }
@@ -42,6 +42,23 @@ typedef struct _NimfServiceIM NimfServiceIM;
 
 typedef struct _NimfCandidate       NimfCandidate;
 typedef struct _NimfCandidateClass  NimfCandidateClass;
+typedef struct _NimfCandidateItem   NimfCandidateItem;
+
+struct _NimfCandidateItem
+{
+  gchar *text;
+  gchar *extra;
+};
+
+/*
+ * Fills @n_items items from @offset into @items, a zeroed buffer owned by
+ * the candidate, with newly allocated strings the candidate takes over.
+ * Only the items of the shown page are fetched.
+ */
+typedef void (* NimfCandidateFillFunc) (gpointer           user_data,
+                                        gint               offset,
+                                        gint               n_items,
+                                        NimfCandidateItem *items);
 
 GType          nimf_candidate_get_type (void) G_GNUC_CONST;
 
@@ -73,6 +90,19 @@ void           nimf_candidate_select_first_item_in_page (NimfCandidate *candidat
 void           nimf_candidate_select_last_item_in_page  (NimfCandidate *candidate);
 gchar         *nimf_candidate_get_selected_text     (NimfCandidate  *candidate);
 gint           nimf_candidate_get_selected_index    (NimfCandidate  *candidate);
+/* source */
+void           nimf_candidate_set_source            (NimfCandidate        *candidate,
+                                                     NimfServiceIM        *target,
+                                                     gint                  n_items,
+                                                     gint                  page_size,
+                                                     NimfCandidateFillFunc fill_func,
+                                                     gpointer              user_data);
+gint           nimf_candidate_get_item_index        (NimfCandidate  *candidate,
+                                                     gint            index_in_page);
+gboolean       nimf_candidate_page_up               (NimfCandidate  *candidate);
+gboolean       nimf_candidate_page_down             (NimfCandidate  *candidate);
+void           nimf_candidate_page_home             (NimfCandidate  *candidate);
+void           nimf_candidate_page_end              (NimfCandidate  *candidate);
 
 G_END_DECLS
 
@@ -23,6 +23,7 @@
 #include "nimf-im.h"
 #include "nimf-marshalers.h"
 #include "nimf-enum-types.h"
+#include "nimf-span.h"
 #include <gio/gunixsocketaddress.h>
 #include <string.h>
 #include <unistd.h>
@@ -84,6 +85,14 @@ on_incoming_message (GSocket      *socket,
   client = g_hash_table_lookup (nimf_client_table,
                                 GUINT_TO_POINTER (message->header->icid));
 
+  NimfMessageType type = message->header->type;
+  NimfSpan        span = { 0 };
+
+  /* context signals, including the reply */
+  if (type >= NIMF_MESSAGE_PREEDIT_START &&
+      type <= NIMF_MESSAGE_DELETE_SURROUNDING)
+    nimf_span_begin (&span);
+
   switch (message->header->type)
   {
     /* signals */
@@ -160,12 +169,17 @@ on_incoming_message (GSocket      *socket,
     case NIMF_MESSAGE_GET_SURROUNDING_REPLY:
     case NIMF_MESSAGE_SET_CURSOR_LOCATION_REPLY:
     case NIMF_MESSAGE_SET_USE_PREEDIT_REPLY:
+    case NIMF_MESSAGE_GET_ENGINE_ID_REPLY:
+    case NIMF_MESSAGE_SET_ENGINE_BY_ID_REPLY:
       break;
     default:
       g_warning (G_STRLOC ": %s: Unknown message type: %d", G_STRFUNC, message->header->type);
       break;
   }
 
+  if (G_UNLIKELY (span.begin))
+    nimf_span_end (&span, nimf_message_get_name_by_type (type), client->id);
+
   return G_SOURCE_CONTINUE;
 }
 
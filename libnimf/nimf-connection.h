@@ -59,6 +59,13 @@ struct _NimfConnection
   GSource           *source;
   GSocketConnection *socket_connection;
   GHashTable        *ims;
+  /* metrics */
+  gint               pid;
+  guint64            n_messages;
+  guint64            n_filter_events;
+  gint64             filter_event_time;
+  guint64            n_round_trips;
+  guint64            n_slow_replies;
 };
 
 struct _NimfConnectionClass
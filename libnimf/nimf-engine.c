@@ -184,6 +184,25 @@ nimf_engine_set_cursor_location (NimfEngine          *engine,
     class->set_cursor_location (engine, area);
 }
 
+/*
+ * Services use this to keep key releases on the client side when the
+ * engine ignores them anyway.
+ */
+gboolean
+nimf_engine_wants_key_release (NimfEngine *engine)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  g_return_val_if_fail (NIMF_IS_ENGINE (engine), FALSE);
+
+  NimfEngineClass *class = NIMF_ENGINE_GET_CLASS (engine);
+
+  if (class->wants_key_release)
+    return class->wants_key_release (engine);
+
+  return FALSE;
+}
+
 void
 nimf_engine_emit_preedit_start (NimfEngine    *engine,
                                 NimfServiceIM *im)
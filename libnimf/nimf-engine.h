@@ -93,6 +93,8 @@ struct _NimfEngineClass
   /* info */
   const gchar * (* get_id)        (NimfEngine          *engine);
   const gchar * (* get_icon_name) (NimfEngine          *engine);
+  /* TRUE if filter_event () may consume key releases */
+  gboolean (* wants_key_release)  (NimfEngine          *engine);
 };
 
 GType    nimf_engine_get_type                  (void) G_GNUC_CONST;
@@ -115,6 +117,7 @@ gboolean nimf_engine_get_surrounding           (NimfEngine          *engine,
                                                 gint                *cursor_index);
 void     nimf_engine_set_cursor_location       (NimfEngine          *engine,
                                                 const NimfRectangle *area);
+gboolean nimf_engine_wants_key_release         (NimfEngine          *engine);
 /* signals */
 void     nimf_engine_emit_preedit_start        (NimfEngine       *engine,
                                                 NimfServiceIM    *im);
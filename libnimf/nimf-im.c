@@ -27,6 +27,7 @@
 #include <gio/gunixsocketaddress.h>
 #include "nimf-message.h"
 #include "nimf-private.h"
+#include "nimf-span.h"
 #include <string.h>
 
 enum {
@@ -279,16 +280,92 @@ gboolean nimf_im_filter_event (NimfIM *im, NimfEvent *event)
     return FALSE;
   }
 
-  nimf_send_message (socket, client->id, NIMF_MESSAGE_FILTER_EVENT,
-                     event, sizeof (NimfEvent), NULL);
+  NimfSpan span;
+  gboolean retval = FALSE;
+
+  nimf_span_begin (&span);
+
+  if (G_UNLIKELY (span.begin))
+  {
+    /* the daemon picks up the correlation ID following the event */
+    gchar   data[sizeof (NimfEvent) + sizeof (guint64)];
+    guint64 id = nimf_span_new_correlation_id ();
+
+    memcpy (data, event, sizeof (NimfEvent));
+    memcpy (data + sizeof (NimfEvent), &id, sizeof (guint64));
+    nimf_send_message (socket, client->id, NIMF_MESSAGE_FILTER_EVENT,
+                       data, sizeof (data), NULL);
+  }
+  else
+  {
+    nimf_send_message (socket, client->id, NIMF_MESSAGE_FILTER_EVENT,
+                       event, sizeof (NimfEvent), NULL);
+  }
+
   nimf_result_iteration_until (nimf_client_result, nimf_client_socket_context,
                                client->id, NIMF_MESSAGE_FILTER_EVENT_REPLY);
 
   if (nimf_client_result->reply &&
       *(gboolean *) (nimf_client_result->reply->data))
-    return TRUE;
+    retval = TRUE;
+
+  nimf_span_end (&span, "client FILTER_EVENT", client->id);
+
+  return retval;
+}
+
+/* returns the id of the engine im uses, to be freed with g_free () */
+gchar *nimf_im_get_engine_id (NimfIM *im)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  g_return_val_if_fail (NIMF_IS_IM (im), NULL);
+
+  NimfClient *client = NIMF_CLIENT (im);
+
+  GSocket *socket = g_socket_connection_get_socket (nimf_client_connection);
+  if (!socket || g_socket_is_closed (socket))
+  {
+    g_warning ("socket is closed");
+    return NULL;
+  }
+
+  nimf_send_message (socket, client->id, NIMF_MESSAGE_GET_ENGINE_ID,
+                     NULL, 0, NULL);
+  nimf_result_iteration_until (nimf_client_result, nimf_client_socket_context,
+                               client->id, NIMF_MESSAGE_GET_ENGINE_ID_REPLY);
+
+  if (nimf_client_result->reply == NULL ||
+      nimf_client_result->reply->header->data_len == 0 ||
+      nimf_client_result->reply->data[0] == '\0')
+    return NULL;
+
+  return g_strndup (nimf_client_result->reply->data,
+                    nimf_client_result->reply->header->data_len);
+}
+
+/* an engine id the daemon doesn't have is ignored */
+void nimf_im_set_engine_by_id (NimfIM      *im,
+                               const gchar *engine_id)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  g_return_if_fail (NIMF_IS_IM (im));
+  g_return_if_fail (engine_id != NULL);
+
+  NimfClient *client = NIMF_CLIENT (im);
 
-  return FALSE;
+  GSocket *socket = g_socket_connection_get_socket (nimf_client_connection);
+  if (!socket || g_socket_is_closed (socket))
+  {
+    g_warning ("socket is closed");
+    return;
+  }
+
+  nimf_send_message (socket, client->id, NIMF_MESSAGE_SET_ENGINE_BY_ID,
+                     (gchar *) engine_id, strlen (engine_id) + 1, NULL);
+  nimf_result_iteration_until (nimf_client_result, nimf_client_socket_context,
+                               client->id, NIMF_MESSAGE_SET_ENGINE_BY_ID_REPLY);
 }
 
 NimfIM *
@@ -95,6 +95,9 @@ void      nimf_im_set_surrounding         (NimfIM              *im,
                                            const char          *text,
                                            gint                 len,
                                            gint                 cursor_index);
+gchar    *nimf_im_get_engine_id           (NimfIM              *im);
+void      nimf_im_set_engine_by_id        (NimfIM              *im,
+                                           const gchar         *engine_id);
 
 G_END_DECLS
 
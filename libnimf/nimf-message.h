@@ -71,6 +71,14 @@ typedef enum
   NIMF_MESSAGE_RETRIEVE_SURROUNDING_REPLY,
   NIMF_MESSAGE_DELETE_SURROUNDING,
   NIMF_MESSAGE_DELETE_SURROUNDING_REPLY,
+  /* daemon */
+  NIMF_MESSAGE_GET_STATS,
+  NIMF_MESSAGE_GET_STATS_REPLY,
+  /* im methods, added at the end to keep the numbers above */
+  NIMF_MESSAGE_GET_ENGINE_ID,
+  NIMF_MESSAGE_GET_ENGINE_ID_REPLY,
+  NIMF_MESSAGE_SET_ENGINE_BY_ID,
+  NIMF_MESSAGE_SET_ENGINE_BY_ID_REPLY,
 } NimfMessageType;
 
 struct _NimfMessageHeader
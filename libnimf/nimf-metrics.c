@@ -0,0 +1,146 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 2; tab-width: 2 -*- */
+/*
+ * nimf-metrics.c
+ * This file is part of Nimf.
+ *
+ * Copyright (C) 2017 Hodong Kim <cogniti@gmail.com>
+ *
+ * Nimf is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Nimf is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program;  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "nimf-metrics.h"
+#include <unistd.h>
+#include <stdio.h>
+
+static void
+nimf_engine_metrics_free (NimfEngineMetrics *engine_metrics)
+{
+  g_slice_free (NimfEngineMetrics, engine_metrics);
+}
+
+NimfMetrics *
+nimf_metrics_new ()
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  NimfMetrics *metrics = g_slice_new0 (NimfMetrics);
+
+  metrics->start_time = g_get_monotonic_time ();
+  metrics->engines = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                            (GDestroyNotify) nimf_engine_metrics_free);
+  return metrics;
+}
+
+void
+nimf_metrics_free (NimfMetrics *metrics)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  g_return_if_fail (metrics != NULL);
+
+  g_hash_table_unref (metrics->engines);
+  g_slice_free (NimfMetrics, metrics);
+}
+
+NimfEngineMetrics *
+nimf_metrics_get_engine (NimfMetrics *metrics, const gchar *engine_id)
+{
+  NimfEngineMetrics *engine_metrics;
+
+  engine_metrics = g_hash_table_lookup (metrics->engines, engine_id);
+
+  if (G_UNLIKELY (engine_metrics == NULL))
+  {
+    engine_metrics = g_slice_new0 (NimfEngineMetrics);
+    g_hash_table_insert (metrics->engines, g_strdup (engine_id),
+                         engine_metrics);
+  }
+
+  return engine_metrics;
+}
+
+void
+nimf_metrics_add_round_trips (NimfMetrics *metrics, guint n_round_trips)
+{
+  metrics->round_trips_per_key[MIN (n_round_trips,
+                                    NIMF_METRICS_MAX_ROUND_TRIPS)]++;
+}
+
+void
+nimf_histogram_add (NimfHistogram *histogram, gint64 usec)
+{
+  gint i = 0;
+
+  if (usec < 0)
+    usec = 0;
+
+  histogram->count++;
+  histogram->total += usec;
+
+  if (usec > histogram->max)
+    histogram->max = usec;
+
+  while (usec > 0 && i < NIMF_METRICS_N_BUCKETS - 1)
+  {
+    usec >>= 1;
+    i++;
+  }
+
+  histogram->buckets[i]++;
+}
+
+void
+nimf_histogram_append_to_string (NimfHistogram *histogram,
+                                 const gchar   *prefix,
+                                 GString       *string)
+{
+  gint i;
+
+  g_string_append_printf (string,
+                          "%s-count=%"G_GUINT64_FORMAT"\n"
+                          "%s-total=%"G_GINT64_FORMAT"\n"
+                          "%s-max=%"G_GINT64_FORMAT"\n"
+                          "%s-buckets=",
+                          prefix, histogram->count,
+                          prefix, histogram->total,
+                          prefix, histogram->max,
+                          prefix);
+
+  for (i = 0; i < NIMF_METRICS_N_BUCKETS; i++)
+    g_string_append_printf (string, "%"G_GUINT64_FORMAT";",
+                            histogram->buckets[i]);
+
+  g_string_append_c (string, '\n');
+}
+
+/* in kB, or -1 */
+glong
+nimf_metrics_get_rss ()
+{
+  FILE  *file;
+  glong  size, resident;
+  glong  retval = -1;
+
+  file = fopen ("/proc/self/statm", "r");
+
+  if (file == NULL)
+    return -1;
+
+  if (fscanf (file, "%ld %ld", &size, &resident) == 2)
+    retval = resident * (sysconf (_SC_PAGESIZE) / 1024);
+
+  fclose (file);
+
+  return retval;
+}
@@ -0,0 +1,87 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 2; tab-width: 2 -*- */
+/*
+ * nimf-metrics.h
+ * This file is part of Nimf.
+ *
+ * Copyright (C) 2017 Hodong Kim <cogniti@gmail.com>
+ *
+ * Nimf is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Nimf is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program;  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __NIMF_METRICS_H__
+#define __NIMF_METRICS_H__
+
+#if !defined (__NIMF_H_INSIDE__) && !defined (NIMF_COMPILATION)
+#error "Only <nimf.h> can be included directly."
+#endif
+
+#include <glib.h>
+#include "nimf-message.h"
+
+G_BEGIN_DECLS
+
+#define NIMF_METRICS_N_MESSAGE_TYPES      (NIMF_MESSAGE_SET_ENGINE_BY_ID_REPLY + 1)
+/* bucket i counts samples in [2^(i-1), 2^i) microseconds */
+#define NIMF_METRICS_N_BUCKETS            16
+#define NIMF_METRICS_MAX_ROUND_TRIPS      8
+/* a reply from a client slower than this is counted as a slow reply */
+#define NIMF_METRICS_SLOW_REPLY_THRESHOLD (100 * G_TIME_SPAN_MILLISECOND)
+
+typedef struct _NimfHistogram     NimfHistogram;
+typedef struct _NimfEngineMetrics NimfEngineMetrics;
+typedef struct _NimfMetrics       NimfMetrics;
+
+struct _NimfHistogram
+{
+  guint64 count;
+  gint64  total; /* microseconds */
+  gint64  max;
+  guint64 buckets[NIMF_METRICS_N_BUCKETS];
+};
+
+struct _NimfEngineMetrics
+{
+  NimfHistogram filter_event;
+  glong         rss_kb;         /* RSS growth while the engine was loaded */
+  guint         n_sessions;     /* for engines that keep per-context sessions */
+  glong         session_rss_kb; /* RSS growth of the last session created */
+  gint64        session_time;   /* microseconds to create it */
+};
+
+struct _NimfMetrics
+{
+  gint64        start_time;
+  NimfHistogram messages[NIMF_METRICS_N_MESSAGE_TYPES];
+  NimfHistogram round_trip;
+  guint64       round_trips_per_key[NIMF_METRICS_MAX_ROUND_TRIPS + 1];
+  guint64       n_slow_replies;
+  GHashTable   *engines;
+};
+
+NimfMetrics       *nimf_metrics_new             (void);
+void               nimf_metrics_free            (NimfMetrics   *metrics);
+NimfEngineMetrics *nimf_metrics_get_engine      (NimfMetrics   *metrics,
+                                                 const gchar   *engine_id);
+void               nimf_metrics_add_round_trips (NimfMetrics   *metrics,
+                                                 guint          n_round_trips);
+void               nimf_histogram_add           (NimfHistogram *histogram,
+                                                 gint64         usec);
+void               nimf_histogram_append_to_string (NimfHistogram *histogram,
+                                                    const gchar   *prefix,
+                                                    GString       *string);
+glong              nimf_metrics_get_rss         (void);
+
+G_END_DECLS
+
+#endif /* __NIMF_METRICS_H__ */
@@ -21,6 +21,36 @@
 
 #include "nimf-private.h"
 #include <syslog.h>
+#include <unistd.h>
+
+/* must be a power of two */
+#define NIMF_LOG_RING_SIZE      512
+#define NIMF_LOG_MESSAGE_MAX    512
+#define NIMF_LOG_FLUSH_INTERVAL (100 * G_TIME_SPAN_MILLISECOND)
+#define NIMF_LOG_DROP_INTERVAL  G_TIME_SPAN_SECOND
+
+typedef struct
+{
+  guint sequence;
+  gint  priority;
+  gchar text[NIMF_LOG_MESSAGE_MAX];
+} NimfLogRecord;
+
+/*
+ * Bounded multi-producer, single-consumer ring: a producer claims a slot
+ * by advancing nimf_log_enqueue_pos and publishes it through the slot's
+ * sequence number, so logging never blocks on /dev/log; the nimf-log
+ * thread writes the records to syslog in batches.
+ */
+static NimfLogRecord  nimf_log_ring[NIMF_LOG_RING_SIZE];
+static guint          nimf_log_enqueue_pos = 0;
+static guint          nimf_log_dequeue_pos = 0;
+static guint          nimf_log_n_dropped   = 0;
+static gint           nimf_log_pid         = 0;
+static gboolean       nimf_log_is_running  = FALSE;
+static GThread       *nimf_log_thread      = NULL;
+static GMutex         nimf_log_mutex;
+static GCond          nimf_log_cond;
 
 void
 nimf_send_message (GSocket         *socket,
@@ -163,6 +193,156 @@ NimfMessage *nimf_recv_message (GSocket *socket)
   return message;
 }
 
+static void
+nimf_log_drain ()
+{
+  static gint64 last_drop_report = 0;
+  NimfLogRecord *record;
+  guint          n_dropped;
+
+  while (TRUE)
+  {
+    record = &nimf_log_ring[nimf_log_dequeue_pos & (NIMF_LOG_RING_SIZE - 1)];
+
+    if (g_atomic_int_get (&record->sequence) != nimf_log_dequeue_pos + 1)
+      break;
+
+    syslog (record->priority, "%s", record->text);
+    g_atomic_int_set (&record->sequence,
+                      nimf_log_dequeue_pos + NIMF_LOG_RING_SIZE);
+    g_atomic_int_inc (&nimf_log_dequeue_pos);
+  }
+
+  n_dropped = g_atomic_int_get (&nimf_log_n_dropped);
+
+  if (G_UNLIKELY (n_dropped > 0) &&
+      g_get_monotonic_time () - last_drop_report >= NIMF_LOG_DROP_INTERVAL)
+  {
+    g_atomic_int_add (&nimf_log_n_dropped, -(gint) n_dropped);
+    last_drop_report = g_get_monotonic_time ();
+    syslog (LOG_WARNING, "%u log messages dropped", n_dropped);
+  }
+}
+
+static gpointer
+nimf_log_thread_func (gpointer data)
+{
+  g_mutex_lock (&nimf_log_mutex);
+
+  while (nimf_log_is_running)
+  {
+    g_mutex_unlock (&nimf_log_mutex);
+    nimf_log_drain ();
+    g_mutex_lock (&nimf_log_mutex);
+
+    if (nimf_log_is_running)
+      g_cond_wait_until (&nimf_log_cond, &nimf_log_mutex,
+                         g_get_monotonic_time () + NIMF_LOG_FLUSH_INTERVAL);
+  }
+
+  g_mutex_unlock (&nimf_log_mutex);
+  nimf_log_drain ();
+
+  return NULL;
+}
+
+/* returns FALSE once nimf_log_flush () has stopped the thread */
+static gboolean
+nimf_log_ensure_thread ()
+{
+  gint     pid = getpid ();
+  gboolean retval;
+
+  if (G_LIKELY (g_atomic_int_get (&nimf_log_pid) == pid))
+    return g_atomic_int_get (&nimf_log_is_running);
+
+  g_mutex_lock (&nimf_log_mutex);
+
+  /* threads don't survive fork (), e.g. daemon () */
+  if (nimf_log_pid != pid)
+  {
+    if (nimf_log_pid == 0)
+    {
+      gint i;
+
+      for (i = 0; i < NIMF_LOG_RING_SIZE; i++)
+        nimf_log_ring[i].sequence = i;
+    }
+
+    nimf_log_is_running = TRUE;
+    nimf_log_thread = g_thread_new ("nimf-log", nimf_log_thread_func, NULL);
+    g_atomic_int_set (&nimf_log_pid, pid);
+  }
+
+  retval = nimf_log_is_running;
+  g_mutex_unlock (&nimf_log_mutex);
+
+  return retval;
+}
+
+static void
+nimf_log_push (gint         priority,
+               const gchar *log_domain,
+               const gchar *prefix,
+               const gchar *message)
+{
+  NimfLogRecord *record;
+  guint          pos;
+
+  pos = g_atomic_int_get (&nimf_log_enqueue_pos);
+
+  while (TRUE)
+  {
+    gint diff;
+
+    record = &nimf_log_ring[pos & (NIMF_LOG_RING_SIZE - 1)];
+    diff   = (gint) (g_atomic_int_get (&record->sequence) - pos);
+
+    if (diff == 0)
+    {
+      if (g_atomic_int_compare_and_exchange ((gint *) &nimf_log_enqueue_pos,
+                                             pos, pos + 1))
+        break;
+    }
+    else if (diff < 0)
+    {
+      /* full; nimf_log_drain () reports the count */
+      g_atomic_int_inc (&nimf_log_n_dropped);
+      g_cond_signal (&nimf_log_cond);
+      return;
+    }
+
+    pos = g_atomic_int_get (&nimf_log_enqueue_pos);
+  }
+
+  record->priority = priority;
+  g_snprintf (record->text, NIMF_LOG_MESSAGE_MAX, "%s-%s: %s",
+              log_domain, prefix, message);
+  g_atomic_int_set (&record->sequence, pos + 1);
+
+  if (pos - g_atomic_int_get (&nimf_log_dequeue_pos) >= NIMF_LOG_RING_SIZE / 2)
+    g_cond_signal (&nimf_log_cond);
+}
+
+/* writes out pending messages; later messages are logged synchronously */
+void
+nimf_log_flush ()
+{
+  GThread *thread;
+
+  g_mutex_lock (&nimf_log_mutex);
+
+  thread = nimf_log_pid == getpid () ? nimf_log_thread : NULL;
+  nimf_log_thread = NULL;
+  g_atomic_int_set (&nimf_log_is_running, FALSE);
+  g_cond_signal (&nimf_log_cond);
+
+  g_mutex_unlock (&nimf_log_mutex);
+
+  if (thread)
+    g_thread_join (thread);
+}
+
 void nimf_log_default_handler (const gchar    *log_domain,
                                GLogLevelFlags  log_level,
                                const gchar    *message,
@@ -206,7 +386,17 @@ void nimf_log_default_handler (const gchar    *log_domain,
   if (priority == LOG_DEBUG && (debug == NULL || *debug == FALSE))
     return;
 
-  syslog (priority, "%s-%s: %s", log_domain, prefix, message ? message : "(NULL) message");
+  if (message == NULL)
+    message = "(NULL) message";
+
+  /* the process aborts right after a fatal message */
+  if (G_UNLIKELY (log_level & G_LOG_FLAG_FATAL) || !nimf_log_ensure_thread ())
+  {
+    syslog (priority, "%s-%s: %s", log_domain, prefix, message);
+    return;
+  }
+
+  nimf_log_push (priority, log_domain, prefix, message);
 }
 
 void
@@ -43,6 +43,33 @@ struct _NimfEnginePrivate
   gint        surrounding_cursor_index;
 };
 
+/*
+ * nimf-candidate-helper draws the candidate window out of process.
+ * Messages are a NimfCandidateHelperHeader followed by data_len bytes;
+ * integers are gint32 in host byte order, strings are NUL terminated.
+ */
+typedef enum
+{
+  /* to the helper */
+  NIMF_CANDIDATE_HELPER_SET_ROW,            /* index, has_extra, main, extra */
+  NIMF_CANDIDATE_HELPER_SET_AUXILIARY_TEXT, /* cursor_pos, text */
+  NIMF_CANDIDATE_HELPER_SET_PAGE_VALUES,    /* page_index, n_pages, page_size, n_rows */
+  NIMF_CANDIDATE_HELPER_SELECT,             /* index */
+  NIMF_CANDIDATE_HELPER_SHOW,               /* x, y, width, height, show_entry */
+  NIMF_CANDIDATE_HELPER_HIDE,
+  /* from the helper */
+  NIMF_CANDIDATE_HELPER_CLICKED,            /* index */
+  NIMF_CANDIDATE_HELPER_SCROLLED            /* page as gdouble */
+} NimfCandidateHelperOp;
+
+typedef struct _NimfCandidateHelperHeader NimfCandidateHelperHeader;
+
+struct _NimfCandidateHelperHeader
+{
+  guint32 op;
+  guint32 data_len;
+};
+
 typedef struct _NimfResult NimfResult;
 
 struct _NimfResult
@@ -62,6 +89,7 @@ void         nimf_log_default_handler    (const gchar     *log_domain,
                                           GLogLevelFlags   log_level,
                                           const gchar     *message,
                                           gboolean        *debug);
+void         nimf_log_flush              (void);
 void         nimf_result_iteration_until (NimfResult      *result,
                                           GMainContext    *main_context,
                                           guint16          icid,
@@ -0,0 +1,540 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 2; tab-width: 2 -*- */
+/*
+ * nimf-romaji.c
+ * This file is part of Nimf.
+ *
+ * Copyright (C) 2017 Hodong Kim <cogniti@gmail.com>
+ *
+ * Nimf is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Nimf is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program;  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "nimf-romaji.h"
+#include <string.h>
+
+typedef struct
+{
+  const gchar *romaji;
+  const gchar *kana;
+  guint16      romaji_len;
+  guint16      kana_len;
+} NimfRomajiEntry;
+
+#define NIMF_ROMAJI_ENTRY(romaji, kana) \
+  { romaji, kana, sizeof (romaji) - 1, sizeof (kana) - 1 }
+
+/* sorted by romaji in byte order; a romaji that only leads to longer ones
+ * needs no entry, nimf_romaji_match () finds them by prefix */
+static const NimfRomajiEntry nimf_romaji_table[] = {
+  NIMF_ROMAJI_ENTRY (",",     "、"),
+  NIMF_ROMAJI_ENTRY (".",     "。"),
+  NIMF_ROMAJI_ENTRY ("a",     "あ"),
+  NIMF_ROMAJI_ENTRY ("ba",    "ば"),
+  NIMF_ROMAJI_ENTRY ("be",    "べ"),
+  NIMF_ROMAJI_ENTRY ("bi",    "び"),
+  NIMF_ROMAJI_ENTRY ("bo",    "ぼ"),
+  NIMF_ROMAJI_ENTRY ("bu",    "ぶ"),
+  NIMF_ROMAJI_ENTRY ("bya",   "びゃ"),
+  NIMF_ROMAJI_ENTRY ("bye",   "びぇ"),
+  NIMF_ROMAJI_ENTRY ("byi",   "びぃ"),
+  NIMF_ROMAJI_ENTRY ("byo",   "びょ"),
+  NIMF_ROMAJI_ENTRY ("byu",   "びゅ"),
+  NIMF_ROMAJI_ENTRY ("ca",    "か"),
+  NIMF_ROMAJI_ENTRY ("ce",    "せ"),
+  NIMF_ROMAJI_ENTRY ("cha",   "ちゃ"),
+  NIMF_ROMAJI_ENTRY ("che",   "ちぇ"),
+  NIMF_ROMAJI_ENTRY ("chi",   "ち"),
+  NIMF_ROMAJI_ENTRY ("cho",   "ちょ"),
+  NIMF_ROMAJI_ENTRY ("chu",   "ちゅ"),
+  NIMF_ROMAJI_ENTRY ("ci",    "し"),
+  NIMF_ROMAJI_ENTRY ("co",    "こ"),
+  NIMF_ROMAJI_ENTRY ("cu",    "く"),
+  NIMF_ROMAJI_ENTRY ("cya",   "ちゃ"),
+  NIMF_ROMAJI_ENTRY ("cye",   "ちぇ"),
+  NIMF_ROMAJI_ENTRY ("cyi",   "ちぃ"),
+  NIMF_ROMAJI_ENTRY ("cyo",   "ちょ"),
+  NIMF_ROMAJI_ENTRY ("cyu",   "ちゅ"),
+  NIMF_ROMAJI_ENTRY ("da",    "だ"),
+  NIMF_ROMAJI_ENTRY ("de",    "で"),
+  NIMF_ROMAJI_ENTRY ("dha",   "でゃ"),
+  NIMF_ROMAJI_ENTRY ("dhe",   "でぇ"),
+  NIMF_ROMAJI_ENTRY ("dhi",   "でぃ"),
+  NIMF_ROMAJI_ENTRY ("dho",   "でょ"),
+  NIMF_ROMAJI_ENTRY ("dhu",   "でゅ"),
+  NIMF_ROMAJI_ENTRY ("di",    "ぢ"),
+  NIMF_ROMAJI_ENTRY ("do",    "ど"),
+  NIMF_ROMAJI_ENTRY ("du",    "づ"),
+  NIMF_ROMAJI_ENTRY ("dwa",   "どぁ"),
+  NIMF_ROMAJI_ENTRY ("dwe",   "どぇ"),
+  NIMF_ROMAJI_ENTRY ("dwi",   "どぃ"),
+  NIMF_ROMAJI_ENTRY ("dwo",   "どぉ"),
+  NIMF_ROMAJI_ENTRY ("dwu",   "どぅ"),
+  NIMF_ROMAJI_ENTRY ("dya",   "ぢゃ"),
+  NIMF_ROMAJI_ENTRY ("dye",   "ぢぇ"),
+  NIMF_ROMAJI_ENTRY ("dyi",   "ぢぃ"),
+  NIMF_ROMAJI_ENTRY ("dyo",   "ぢょ"),
+  NIMF_ROMAJI_ENTRY ("dyu",   "ぢゅ"),
+  NIMF_ROMAJI_ENTRY ("e",     "え"),
+  NIMF_ROMAJI_ENTRY ("fa",    "ふぁ"),
+  NIMF_ROMAJI_ENTRY ("fe",    "ふぇ"),
+  NIMF_ROMAJI_ENTRY ("fi",    "ふぃ"),
+  NIMF_ROMAJI_ENTRY ("fo",    "ふぉ"),
+  NIMF_ROMAJI_ENTRY ("fu",    "ふ"),
+  NIMF_ROMAJI_ENTRY ("fwa",   "ふぁ"),
+  NIMF_ROMAJI_ENTRY ("fwe",   "ふぇ"),
+  NIMF_ROMAJI_ENTRY ("fwi",   "ふぃ"),
+  NIMF_ROMAJI_ENTRY ("fwo",   "ふぉ"),
+  NIMF_ROMAJI_ENTRY ("fwu",   "ふう"),
+  NIMF_ROMAJI_ENTRY ("fya",   "ふゃ"),
+  NIMF_ROMAJI_ENTRY ("fye",   "ふぇ"),
+  NIMF_ROMAJI_ENTRY ("fyi",   "ふぃ"),
+  NIMF_ROMAJI_ENTRY ("fyo",   "ふょ"),
+  NIMF_ROMAJI_ENTRY ("fyu",   "ふゅ"),
+  NIMF_ROMAJI_ENTRY ("ga",    "が"),
+  NIMF_ROMAJI_ENTRY ("ge",    "げ"),
+  NIMF_ROMAJI_ENTRY ("gi",    "ぎ"),
+  NIMF_ROMAJI_ENTRY ("go",    "ご"),
+  NIMF_ROMAJI_ENTRY ("gu",    "ぐ"),
+  NIMF_ROMAJI_ENTRY ("gwa",   "ぐぁ"),
+  NIMF_ROMAJI_ENTRY ("gwe",   "ぐえ"),
+  NIMF_ROMAJI_ENTRY ("gwi",   "ぐぃ"),
+  NIMF_ROMAJI_ENTRY ("gwo",   "ぐぉ"),
+  NIMF_ROMAJI_ENTRY ("gwu",   "ぐぅ"),
+  NIMF_ROMAJI_ENTRY ("gya",   "ぎゃ"),
+  NIMF_ROMAJI_ENTRY ("gye",   "ぎぇ"),
+  NIMF_ROMAJI_ENTRY ("gyi",   "ぎぃ"),
+  NIMF_ROMAJI_ENTRY ("gyo",   "ぎょ"),
+  NIMF_ROMAJI_ENTRY ("gyu",   "ぎゅ"),
+  NIMF_ROMAJI_ENTRY ("ha",    "は"),
+  NIMF_ROMAJI_ENTRY ("he",    "へ"),
+  NIMF_ROMAJI_ENTRY ("hi",    "ひ"),
+  NIMF_ROMAJI_ENTRY ("ho",    "ほ"),
+  NIMF_ROMAJI_ENTRY ("hu",    "ふ"),
+  NIMF_ROMAJI_ENTRY ("hya",   "ひゃ"),
+  NIMF_ROMAJI_ENTRY ("hye",   "ひぇ"),
+  NIMF_ROMAJI_ENTRY ("hyi",   "ひぃ"),
+  NIMF_ROMAJI_ENTRY ("hyo",   "ひょ"),
+  NIMF_ROMAJI_ENTRY ("hyu",   "ひゅ"),
+  NIMF_ROMAJI_ENTRY ("i",     "い"),
+  NIMF_ROMAJI_ENTRY ("ja",    "じゃ"),
+  NIMF_ROMAJI_ENTRY ("je",    "じぇ"),
+  NIMF_ROMAJI_ENTRY ("ji",    "じ"),
+  NIMF_ROMAJI_ENTRY ("jo",    "じょ"),
+  NIMF_ROMAJI_ENTRY ("ju",    "じゅ"),
+  NIMF_ROMAJI_ENTRY ("jya",   "じゃ"),
+  NIMF_ROMAJI_ENTRY ("jye",   "じぇ"),
+  NIMF_ROMAJI_ENTRY ("jyi",   "じぃ"),
+  NIMF_ROMAJI_ENTRY ("jyo",   "じょ"),
+  NIMF_ROMAJI_ENTRY ("jyu",   "じゅ"),
+  NIMF_ROMAJI_ENTRY ("ka",    "か"),
+  NIMF_ROMAJI_ENTRY ("ke",    "け"),
+  NIMF_ROMAJI_ENTRY ("ki",    "き"),
+  NIMF_ROMAJI_ENTRY ("ko",    "こ"),
+  NIMF_ROMAJI_ENTRY ("ku",    "く"),
+  NIMF_ROMAJI_ENTRY ("kwa",   "くぁ"),
+  NIMF_ROMAJI_ENTRY ("kya",   "きゃ"),
+  NIMF_ROMAJI_ENTRY ("kye",   "きぇ"),
+  NIMF_ROMAJI_ENTRY ("kyi",   "きぃ"),
+  NIMF_ROMAJI_ENTRY ("kyo",   "きょ"),
+  NIMF_ROMAJI_ENTRY ("kyu",   "きゅ"),
+  NIMF_ROMAJI_ENTRY ("la",    "ぁ"),
+  NIMF_ROMAJI_ENTRY ("le",    "ぇ"),
+  NIMF_ROMAJI_ENTRY ("li",    "ぃ"),
+  NIMF_ROMAJI_ENTRY ("lka",   "ヵ"),
+  NIMF_ROMAJI_ENTRY ("lke",   "ヶ"),
+  NIMF_ROMAJI_ENTRY ("lo",    "ぉ"),
+  NIMF_ROMAJI_ENTRY ("ltsu",  "っ"),
+  NIMF_ROMAJI_ENTRY ("ltu",   "っ"),
+  NIMF_ROMAJI_ENTRY ("lu",    "ぅ"),
+  NIMF_ROMAJI_ENTRY ("lwa",   "ゎ"),
+  NIMF_ROMAJI_ENTRY ("lya",   "ゃ"),
+  NIMF_ROMAJI_ENTRY ("lye",   "ぇ"),
+  NIMF_ROMAJI_ENTRY ("lyi",   "ぃ"),
+  NIMF_ROMAJI_ENTRY ("lyo",   "ょ"),
+  NIMF_ROMAJI_ENTRY ("lyu",   "ゅ"),
+  NIMF_ROMAJI_ENTRY ("ma",    "ま"),
+  NIMF_ROMAJI_ENTRY ("me",    "め"),
+  NIMF_ROMAJI_ENTRY ("mi",    "み"),
+  NIMF_ROMAJI_ENTRY ("mo",    "も"),
+  NIMF_ROMAJI_ENTRY ("mu",    "む"),
+  NIMF_ROMAJI_ENTRY ("mya",   "みゃ"),
+  NIMF_ROMAJI_ENTRY ("mye",   "みぇ"),
+  NIMF_ROMAJI_ENTRY ("myi",   "みぃ"),
+  NIMF_ROMAJI_ENTRY ("myo",   "みょ"),
+  NIMF_ROMAJI_ENTRY ("myu",   "みゅ"),
+  NIMF_ROMAJI_ENTRY ("na",    "な"),
+  NIMF_ROMAJI_ENTRY ("ne",    "ね"),
+  NIMF_ROMAJI_ENTRY ("ni",    "に"),
+  NIMF_ROMAJI_ENTRY ("nn",    "ん"),
+  NIMF_ROMAJI_ENTRY ("no",    "の"),
+  NIMF_ROMAJI_ENTRY ("nu",    "ぬ"),
+  NIMF_ROMAJI_ENTRY ("nya",   "にゃ"),
+  NIMF_ROMAJI_ENTRY ("nye",   "にぇ"),
+  NIMF_ROMAJI_ENTRY ("nyi",   "にぃ"),
+  NIMF_ROMAJI_ENTRY ("nyo",   "にょ"),
+  NIMF_ROMAJI_ENTRY ("nyu",   "にゅ"),
+  NIMF_ROMAJI_ENTRY ("o",     "お"),
+  NIMF_ROMAJI_ENTRY ("pa",    "ぱ"),
+  NIMF_ROMAJI_ENTRY ("pe",    "ぺ"),
+  NIMF_ROMAJI_ENTRY ("pi",    "ぴ"),
+  NIMF_ROMAJI_ENTRY ("po",    "ぽ"),
+  NIMF_ROMAJI_ENTRY ("pu",    "ぷ"),
+  NIMF_ROMAJI_ENTRY ("pya",   "ぴゃ"),
+  NIMF_ROMAJI_ENTRY ("pye",   "ぴぇ"),
+  NIMF_ROMAJI_ENTRY ("pyi",   "ぴぃ"),
+  NIMF_ROMAJI_ENTRY ("pyo",   "ぴょ"),
+  NIMF_ROMAJI_ENTRY ("pyu",   "ぴゅ"),
+  NIMF_ROMAJI_ENTRY ("qa",    "くぁ"),
+  NIMF_ROMAJI_ENTRY ("qe",    "くぇ"),
+  NIMF_ROMAJI_ENTRY ("qi",    "くぃ"),
+  NIMF_ROMAJI_ENTRY ("qo",    "くぉ"),
+  NIMF_ROMAJI_ENTRY ("qu",    "く"),
+  NIMF_ROMAJI_ENTRY ("qwa",   "くぁ"),
+  NIMF_ROMAJI_ENTRY ("qwe",   "くぇ"),
+  NIMF_ROMAJI_ENTRY ("qwi",   "くぃ"),
+  NIMF_ROMAJI_ENTRY ("qwo",   "くぉ"),
+  NIMF_ROMAJI_ENTRY ("qwu",   "くぅ"),
+  NIMF_ROMAJI_ENTRY ("qya",   "くゃ"),
+  NIMF_ROMAJI_ENTRY ("qye",   "くぇ"),
+  NIMF_ROMAJI_ENTRY ("qyi",   "くぃ"),
+  NIMF_ROMAJI_ENTRY ("qyo",   "くょ"),
+  NIMF_ROMAJI_ENTRY ("qyu",   "くゅ"),
+  NIMF_ROMAJI_ENTRY ("ra",    "ら"),
+  NIMF_ROMAJI_ENTRY ("re",    "れ"),
+  NIMF_ROMAJI_ENTRY ("ri",    "り"),
+  NIMF_ROMAJI_ENTRY ("ro",    "ろ"),
+  NIMF_ROMAJI_ENTRY ("ru",    "る"),
+  NIMF_ROMAJI_ENTRY ("rya",   "りゃ"),
+  NIMF_ROMAJI_ENTRY ("rye",   "りぇ"),
+  NIMF_ROMAJI_ENTRY ("ryi",   "りぃ"),
+  NIMF_ROMAJI_ENTRY ("ryo",   "りょ"),
+  NIMF_ROMAJI_ENTRY ("ryu",   "りゅ"),
+  NIMF_ROMAJI_ENTRY ("sa",    "さ"),
+  NIMF_ROMAJI_ENTRY ("se",    "せ"),
+  NIMF_ROMAJI_ENTRY ("sha",   "しゃ"),
+  NIMF_ROMAJI_ENTRY ("she",   "しぇ"),
+  NIMF_ROMAJI_ENTRY ("shi",   "し"),
+  NIMF_ROMAJI_ENTRY ("sho",   "しょ"),
+  NIMF_ROMAJI_ENTRY ("shu",   "しゅ"),
+  NIMF_ROMAJI_ENTRY ("si",    "し"),
+  NIMF_ROMAJI_ENTRY ("so",    "そ"),
+  NIMF_ROMAJI_ENTRY ("su",    "す"),
+  NIMF_ROMAJI_ENTRY ("swa",   "すぁ"),
+  NIMF_ROMAJI_ENTRY ("swe",   "すぇ"),
+  NIMF_ROMAJI_ENTRY ("swi",   "すぃ"),
+  NIMF_ROMAJI_ENTRY ("swo",   "すぉ"),
+  NIMF_ROMAJI_ENTRY ("swu",   "すぅ"),
+  NIMF_ROMAJI_ENTRY ("sya",   "しゃ"),
+  NIMF_ROMAJI_ENTRY ("sye",   "しぇ"),
+  NIMF_ROMAJI_ENTRY ("syi",   "しぃ"),
+  NIMF_ROMAJI_ENTRY ("syo",   "しょ"),
+  NIMF_ROMAJI_ENTRY ("syu",   "しゅ"),
+  NIMF_ROMAJI_ENTRY ("ta",    "た"),
+  NIMF_ROMAJI_ENTRY ("te",    "て"),
+  NIMF_ROMAJI_ENTRY ("tha",   "てゃ"),
+  NIMF_ROMAJI_ENTRY ("the",   "てぇ"),
+  NIMF_ROMAJI_ENTRY ("thi",   "てぃ"),
+  NIMF_ROMAJI_ENTRY ("tho",   "てょ"),
+  NIMF_ROMAJI_ENTRY ("thu",   "てゅ"),
+  NIMF_ROMAJI_ENTRY ("ti",    "ち"),
+  NIMF_ROMAJI_ENTRY ("to",    "と"),
+  NIMF_ROMAJI_ENTRY ("tsa",   "つぁ"),
+  NIMF_ROMAJI_ENTRY ("tse",   "つぇ"),
+  NIMF_ROMAJI_ENTRY ("tsi",   "つぃ"),
+  NIMF_ROMAJI_ENTRY ("tso",   "つぉ"),
+  NIMF_ROMAJI_ENTRY ("tsu",   "つ"),
+  NIMF_ROMAJI_ENTRY ("tu",    "つ"),
+  NIMF_ROMAJI_ENTRY ("twa",   "とぁ"),
+  NIMF_ROMAJI_ENTRY ("twe",   "とぇ"),
+  NIMF_ROMAJI_ENTRY ("twi",   "とぃ"),
+  NIMF_ROMAJI_ENTRY ("two",   "とぉ"),
+  NIMF_ROMAJI_ENTRY ("twu",   "とぅ"),
+  NIMF_ROMAJI_ENTRY ("tya",   "ちゃ"),
+  NIMF_ROMAJI_ENTRY ("tye",   "ちぇ"),
+  NIMF_ROMAJI_ENTRY ("tyi",   "ちぃ"),
+  NIMF_ROMAJI_ENTRY ("tyo",   "ちょ"),
+  NIMF_ROMAJI_ENTRY ("tyu",   "ちゅ"),
+  NIMF_ROMAJI_ENTRY ("u",     "う"),
+  NIMF_ROMAJI_ENTRY ("va",    "ヴぁ"),
+  NIMF_ROMAJI_ENTRY ("ve",    "ヴぇ"),
+  NIMF_ROMAJI_ENTRY ("vi",    "ヴぃ"),
+  NIMF_ROMAJI_ENTRY ("vo",    "ヴぉ"),
+  NIMF_ROMAJI_ENTRY ("vu",    "ヴ"),
+  NIMF_ROMAJI_ENTRY ("vya",   "ヴゃ"),
+  NIMF_ROMAJI_ENTRY ("vye",   "ヴぇ"),
+  NIMF_ROMAJI_ENTRY ("vyi",   "ヴぃ"),
+  NIMF_ROMAJI_ENTRY ("vyo",   "ヴょ"),
+  NIMF_ROMAJI_ENTRY ("vyu",   "ヴゅ"),
+  NIMF_ROMAJI_ENTRY ("wa",    "わ"),
+  NIMF_ROMAJI_ENTRY ("we",    "うぇ"),
+  NIMF_ROMAJI_ENTRY ("wha",   "うぁ"),
+  NIMF_ROMAJI_ENTRY ("whe",   "うぇ"),
+  NIMF_ROMAJI_ENTRY ("whi",   "うぃ"),
+  NIMF_ROMAJI_ENTRY ("who",   "うぉ"),
+  NIMF_ROMAJI_ENTRY ("whu",   "う"),
+  NIMF_ROMAJI_ENTRY ("wi",    "うぃ"),
+  NIMF_ROMAJI_ENTRY ("wo",    "を"),
+  NIMF_ROMAJI_ENTRY ("wu",    "う"),
+  NIMF_ROMAJI_ENTRY ("wye",   "ゑ"),
+  NIMF_ROMAJI_ENTRY ("wyi",   "ゐ"),
+  NIMF_ROMAJI_ENTRY ("xa",    "ぁ"),
+  NIMF_ROMAJI_ENTRY ("xe",    "ぇ"),
+  NIMF_ROMAJI_ENTRY ("xi",    "ぃ"),
+  NIMF_ROMAJI_ENTRY ("xka",   "ヵ"),
+  NIMF_ROMAJI_ENTRY ("xke",   "ヶ"),
+  NIMF_ROMAJI_ENTRY ("xn",    "ん"),
+  NIMF_ROMAJI_ENTRY ("xo",    "ぉ"),
+  NIMF_ROMAJI_ENTRY ("xtsu",  "っ"),
+  NIMF_ROMAJI_ENTRY ("xtu",   "っ"),
+  NIMF_ROMAJI_ENTRY ("xu",    "ぅ"),
+  NIMF_ROMAJI_ENTRY ("xwa",   "ゎ"),
+  NIMF_ROMAJI_ENTRY ("xya",   "ゃ"),
+  NIMF_ROMAJI_ENTRY ("xye",   "ぇ"),
+  NIMF_ROMAJI_ENTRY ("xyi",   "ぃ"),
+  NIMF_ROMAJI_ENTRY ("xyo",   "ょ"),
+  NIMF_ROMAJI_ENTRY ("xyu",   "ゅ"),
+  NIMF_ROMAJI_ENTRY ("ya",    "や"),
+  NIMF_ROMAJI_ENTRY ("ye",    "いぇ"),
+  NIMF_ROMAJI_ENTRY ("yi",    "い"),
+  NIMF_ROMAJI_ENTRY ("yo",    "よ"),
+  NIMF_ROMAJI_ENTRY ("yu",    "ゆ"),
+  NIMF_ROMAJI_ENTRY ("za",    "ざ"),
+  NIMF_ROMAJI_ENTRY ("ze",    "ぜ"),
+  NIMF_ROMAJI_ENTRY ("zi",    "じ"),
+  NIMF_ROMAJI_ENTRY ("zo",    "ぞ"),
+  NIMF_ROMAJI_ENTRY ("zu",    "ず"),
+  NIMF_ROMAJI_ENTRY ("zya",   "じゃ"),
+  NIMF_ROMAJI_ENTRY ("zye",   "じぇ"),
+  NIMF_ROMAJI_ENTRY ("zyi",   "じぃ"),
+  NIMF_ROMAJI_ENTRY ("zyo",   "じょ"),
+  NIMF_ROMAJI_ENTRY ("zyu",   "じゅ"),
+};
+
+struct _NimfRomaji
+{
+  /* user overrides, pointing into the mapped file */
+  GMappedFile *file;
+  GArray      *entries;
+};
+
+static gint
+nimf_romaji_compare (const gchar *a,
+                     gsize        a_len,
+                     const gchar *b,
+                     gsize        b_len)
+{
+  gint retval = memcmp (a, b, MIN (a_len, b_len));
+
+  if (retval)
+    return retval;
+
+  return a_len < b_len ? -1 : a_len > b_len;
+}
+
+static gint
+nimf_romaji_entry_compare (const NimfRomajiEntry *a,
+                           const NimfRomajiEntry *b)
+{
+  return nimf_romaji_compare (a->romaji, a->romaji_len,
+                              b->romaji, b->romaji_len);
+}
+
+static NimfRomajiMatch
+nimf_romaji_table_match (const NimfRomajiEntry  *entries,
+                         guint                   n_entries,
+                         const gchar            *input,
+                         gsize                   len,
+                         const NimfRomajiEntry **entry)
+{
+  guint low  = 0;
+  guint high = n_entries;
+
+  /* the first entry not less than the input */
+  while (low < high)
+  {
+    guint mid = low + (high - low) / 2;
+
+    if (nimf_romaji_compare (entries[mid].romaji, entries[mid].romaji_len,
+                             input, len) < 0)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+
+  *entry = NULL;
+
+  if (low < n_entries && entries[low].romaji_len == len &&
+      memcmp (entries[low].romaji, input, len) == 0)
+    *entry = &entries[low++];
+
+  if (low < n_entries && entries[low].romaji_len > len &&
+      memcmp (entries[low].romaji, input, len) == 0)
+    return NIMF_ROMAJI_PARTIAL_MATCH;
+
+  return *entry ? NIMF_ROMAJI_MATCH : NIMF_ROMAJI_NO_MATCH;
+}
+
+/*
+ * One step of longest-match conversion: @input is the romaji typed since
+ * the last kana.  NIMF_ROMAJI_PARTIAL_MATCH means more input may complete
+ * a longer romaji; @kana is still set if @input itself is one.  Nothing is
+ * allocated; @kana points into the table and is not nul-terminated.
+ */
+NimfRomajiMatch
+nimf_romaji_match (NimfRomaji   *romaji,
+                   const gchar  *input,
+                   gsize         len,
+                   const gchar **kana,
+                   gsize        *kana_len)
+{
+  const NimfRomajiEntry *entry = NULL;
+  const NimfRomajiEntry *user_entry = NULL;
+  NimfRomajiMatch        match;
+  NimfRomajiMatch        user_match = NIMF_ROMAJI_NO_MATCH;
+
+  match = nimf_romaji_table_match (nimf_romaji_table,
+                                   G_N_ELEMENTS (nimf_romaji_table),
+                                   input, len, &entry);
+  if (romaji->entries)
+    user_match = nimf_romaji_table_match ((const NimfRomajiEntry *) romaji->entries->data,
+                                          romaji->entries->len,
+                                          input, len, &user_entry);
+  if (user_entry)
+    entry = user_entry;
+
+  *kana     = entry ? entry->kana : NULL;
+  *kana_len = entry ? entry->kana_len : 0;
+
+  if (match == NIMF_ROMAJI_PARTIAL_MATCH ||
+      user_match == NIMF_ROMAJI_PARTIAL_MATCH)
+    return NIMF_ROMAJI_PARTIAL_MATCH;
+
+  return entry ? NIMF_ROMAJI_MATCH : NIMF_ROMAJI_NO_MATCH;
+}
+
+/* lines are "romaji kana", separated by spaces or tabs; '#' starts a
+ * comment line.  The strings are used in place. */
+static void
+nimf_romaji_load_overrides (NimfRomaji  *romaji,
+                            const gchar *path)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  const gchar *p;
+  const gchar *end;
+  GError      *error = NULL;
+  guint        i, j;
+
+  romaji->file = g_mapped_file_new (path, FALSE, &error);
+
+  if (romaji->file == NULL)
+  {
+    if (!g_error_matches (error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+      g_warning (G_STRLOC ": %s: %s", G_STRFUNC, error->message);
+
+    g_clear_error (&error);
+    return;
+  }
+
+  romaji->entries = g_array_new (FALSE, FALSE, sizeof (NimfRomajiEntry));
+  p = g_mapped_file_get_contents (romaji->file);
+
+  if (p == NULL)
+    return;
+
+  end = p + g_mapped_file_get_length (romaji->file);
+
+  while (p < end)
+  {
+    const gchar    *eol = memchr (p, '\n', end - p);
+    const gchar    *q;
+    NimfRomajiEntry entry;
+
+    if (eol == NULL)
+      eol = end;
+
+    if (*p == '#')
+    {
+      p = eol + 1;
+      continue;
+    }
+
+    q = p;
+
+    while (q < eol && *q != ' ' && *q != '\t')
+      q++;
+
+    entry.romaji     = p;
+    entry.romaji_len = MIN (q - p, G_MAXUINT16);
+
+    while (q < eol && (*q == ' ' || *q == '\t'))
+      q++;
+
+    entry.kana = q;
+
+    while (q < eol && *q != ' ' && *q != '\t' && *q != '\r')
+      q++;
+
+    entry.kana_len = MIN (q - entry.kana, G_MAXUINT16);
+
+    if (entry.romaji_len > 0 && entry.kana_len > 0)
+      g_array_append_val (romaji->entries, entry);
+
+    p = eol + 1;
+  }
+
+  /* stable, so the last of the same romaji wins */
+  g_array_sort (romaji->entries, (GCompareFunc) nimf_romaji_entry_compare);
+
+  for (i = 0, j = 0; i < romaji->entries->len; i++)
+  {
+    NimfRomajiEntry *entry = &g_array_index (romaji->entries,
+                                             NimfRomajiEntry, i);
+
+    if (j > 0 && nimf_romaji_entry_compare (entry,
+                   &g_array_index (romaji->entries, NimfRomajiEntry, j - 1)) == 0)
+      j--;
+
+    g_array_index (romaji->entries, NimfRomajiEntry, j++) = *entry;
+  }
+
+  g_array_set_size (romaji->entries, j);
+}
+
+/* @override_path may be NULL or name a file that doesn't exist */
+NimfRomaji *
+nimf_romaji_new (const gchar *override_path)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  NimfRomaji *romaji = g_slice_new0 (NimfRomaji);
+
+  if (override_path)
+    nimf_romaji_load_overrides (romaji, override_path);
+
+  return romaji;
+}
+
+void
+nimf_romaji_free (NimfRomaji *romaji)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  if (romaji->entries)
+    g_array_free (romaji->entries, TRUE);
+
+  if (romaji->file)
+    g_mapped_file_unref (romaji->file);
+
+  g_slice_free (NimfRomaji, romaji);
+}
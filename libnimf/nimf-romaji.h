@@ -0,0 +1,52 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 2; tab-width: 2 -*- */
+/*
+ * nimf-romaji.h
+ * This file is part of Nimf.
+ *
+ * Copyright (C) 2017 Hodong Kim <cogniti@gmail.com>
+ *
+ * Nimf is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Nimf is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program;  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __NIMF_ROMAJI_H__
+#define __NIMF_ROMAJI_H__
+
+#if !defined (__NIMF_H_INSIDE__) && !defined (NIMF_COMPILATION)
+#error "Only <nimf.h> can be included directly."
+#endif
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef enum
+{
+  NIMF_ROMAJI_NO_MATCH,
+  NIMF_ROMAJI_PARTIAL_MATCH, /* a longer romaji starts with the input */
+  NIMF_ROMAJI_MATCH
+} NimfRomajiMatch;
+
+typedef struct _NimfRomaji NimfRomaji;
+
+NimfRomaji     *nimf_romaji_new   (const gchar *override_path);
+void            nimf_romaji_free  (NimfRomaji  *romaji);
+NimfRomajiMatch nimf_romaji_match (NimfRomaji  *romaji,
+                                   const gchar *input,
+                                   gsize        len,
+                                   const gchar **kana,
+                                   gsize       *kana_len);
+
+G_END_DECLS
+
+#endif /* __NIMF_ROMAJI_H__ */
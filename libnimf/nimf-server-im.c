@@ -20,10 +20,40 @@
  */
 
 #include "nimf-server-im.h"
+#include "nimf-span.h"
 #include <string.h>
 
 G_DEFINE_TYPE (NimfServerIM, nimf_server_im, NIMF_TYPE_SERVICE_IM);
 
+static void
+nimf_server_im_wait_reply (NimfServiceIM   *im,
+                           NimfMessageType  type)
+{
+  NimfConnection *connection = NIMF_SERVER_IM (im)->connection;
+  NimfMetrics    *metrics    = im->server->metrics;
+  gint64          elapsed;
+  NimfSpan        span;
+
+  nimf_span_begin (&span);
+  elapsed = g_get_monotonic_time ();
+  nimf_result_iteration_until (connection->result, NULL, im->icid, type);
+  elapsed = g_get_monotonic_time () - elapsed;
+
+  if (G_UNLIKELY (span.begin))
+    nimf_span_end (&span, nimf_message_get_name_by_type (type), im->icid);
+
+  nimf_histogram_add (&metrics->round_trip, elapsed);
+  connection->n_round_trips++;
+
+  if (G_UNLIKELY (elapsed > NIMF_METRICS_SLOW_REPLY_THRESHOLD))
+  {
+    metrics->n_slow_replies++;
+    connection->n_slow_replies++;
+    g_debug (G_STRLOC ": %s: %s took %"G_GINT64_FORMAT" us", G_STRFUNC,
+             nimf_message_get_name_by_type (type), elapsed);
+  }
+}
+
 void
 nimf_server_im_emit_commit (NimfServiceIM *im,
                             const gchar   *text)
@@ -35,8 +65,7 @@ nimf_server_im_emit_commit (NimfServiceIM *im,
   nimf_send_message (server_im->connection->socket, im->icid,
                      NIMF_MESSAGE_COMMIT,
                      (gchar *) text, strlen (text) + 1, NULL);
-  nimf_result_iteration_until (server_im->connection->result, NULL, im->icid,
-                               NIMF_MESSAGE_COMMIT_REPLY);
+  nimf_server_im_wait_reply (im, NIMF_MESSAGE_COMMIT_REPLY);
 }
 
 void nimf_server_im_emit_preedit_start (NimfServiceIM *im)
@@ -51,8 +80,7 @@ void nimf_server_im_emit_preedit_start (NimfServiceIM *im)
 
   nimf_send_message (server_im->connection->socket, im->icid,
                      NIMF_MESSAGE_PREEDIT_START, NULL, 0, NULL);
-  nimf_result_iteration_until (server_im->connection->result, NULL, im->icid,
-                               NIMF_MESSAGE_PREEDIT_START_REPLY);
+  nimf_server_im_wait_reply (im, NIMF_MESSAGE_PREEDIT_START_REPLY);
   im->preedit_state = NIMF_PREEDIT_STATE_START;
 }
 
@@ -90,8 +118,7 @@ nimf_server_im_emit_preedit_changed (NimfServiceIM    *im,
   nimf_send_message (server_im->connection->socket, im->icid,
                      NIMF_MESSAGE_PREEDIT_CHANGED,
                      data, data_len, g_free);
-  nimf_result_iteration_until (server_im->connection->result, NULL, im->icid,
-                               NIMF_MESSAGE_PREEDIT_CHANGED_REPLY);
+  nimf_server_im_wait_reply (im, NIMF_MESSAGE_PREEDIT_CHANGED_REPLY);
 }
 
 void nimf_server_im_emit_preedit_end (NimfServiceIM *im)
@@ -106,8 +133,7 @@ void nimf_server_im_emit_preedit_end (NimfServiceIM *im)
 
   nimf_send_message (server_im->connection->socket, im->icid,
                      NIMF_MESSAGE_PREEDIT_END, NULL, 0, NULL);
-  nimf_result_iteration_until (server_im->connection->result, NULL, im->icid,
-                               NIMF_MESSAGE_PREEDIT_END_REPLY);
+  nimf_server_im_wait_reply (im, NIMF_MESSAGE_PREEDIT_END_REPLY);
   im->preedit_state = NIMF_PREEDIT_STATE_END;
 }
 
@@ -120,8 +146,7 @@ nimf_server_im_emit_retrieve_surrounding (NimfServiceIM *im)
 
   nimf_send_message (server_im->connection->socket, im->icid,
                      NIMF_MESSAGE_RETRIEVE_SURROUNDING, NULL, 0, NULL);
-  nimf_result_iteration_until (server_im->connection->result, NULL, im->icid,
-                               NIMF_MESSAGE_RETRIEVE_SURROUNDING_REPLY);
+  nimf_server_im_wait_reply (im, NIMF_MESSAGE_RETRIEVE_SURROUNDING_REPLY);
 
   if (server_im->connection->result->reply == NULL)
     return FALSE;
@@ -145,8 +170,7 @@ nimf_server_im_emit_delete_surrounding (NimfServiceIM *im,
   nimf_send_message (server_im->connection->socket, im->icid,
                      NIMF_MESSAGE_DELETE_SURROUNDING,
                      data, 2 * sizeof (gint), g_free);
-  nimf_result_iteration_until (server_im->connection->result, NULL, im->icid,
-                               NIMF_MESSAGE_DELETE_SURROUNDING_REPLY);
+  nimf_server_im_wait_reply (im, NIMF_MESSAGE_DELETE_SURROUNDING_REPLY);
 
   if (server_im->connection->result->reply == NULL)
     return FALSE;
@@ -30,6 +30,7 @@
 #include "nimf-types.h"
 #include "nimf-service-im.h"
 #include "nimf-server-im.h"
+#include "nimf-span.h"
 #include <gio/gunixsocketaddress.h>
 #include <string.h>
 
@@ -46,6 +47,113 @@ enum {
 
 static guint nimf_server_signals[LAST_SIGNAL] = { 0 };
 
+static gchar *
+nimf_server_get_stats (NimfServer *server, guint16 *len)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  NimfMetrics    *metrics = server->metrics;
+  GString        *string;
+  GHashTableIter  iter;
+  gpointer        key;
+  gpointer        value;
+  gint            i;
+
+  string = g_string_sized_new (4096);
+
+  g_string_append_printf (string,
+                          "[server]\n"
+                          "uptime=%"G_GINT64_FORMAT"\n"
+                          "rss=%ld\n"
+                          "connections=%u\n"
+                          "slow-replies=%"G_GUINT64_FORMAT"\n"
+                          "round-trips-per-key=",
+                          g_get_monotonic_time () - metrics->start_time,
+                          nimf_metrics_get_rss (),
+                          g_hash_table_size (server->connections),
+                          metrics->n_slow_replies);
+
+  for (i = 0; i <= NIMF_METRICS_MAX_ROUND_TRIPS; i++)
+    g_string_append_printf (string, "%"G_GUINT64_FORMAT";",
+                            metrics->round_trips_per_key[i]);
+
+  g_string_append_c (string, '\n');
+  nimf_histogram_append_to_string (&metrics->round_trip, "round-trip", string);
+
+  for (i = 0; i < NIMF_METRICS_N_MESSAGE_TYPES; i++)
+  {
+    if (metrics->messages[i].count == 0)
+      continue;
+
+    g_string_append_printf (string, "\n[message %s]\n",
+                            nimf_message_get_name_by_type (i));
+    nimf_histogram_append_to_string (&metrics->messages[i], "service-time",
+                                     string);
+  }
+
+  g_hash_table_iter_init (&iter, metrics->engines);
+
+  while (g_hash_table_iter_next (&iter, &key, &value))
+  {
+    NimfEngineMetrics *engine_metrics = value;
+
+    g_string_append_printf (string,
+                            "\n[engine %s]\n"
+                            "rss=%ld\n"
+                            "sessions=%u\n"
+                            "session-rss=%ld\n"
+                            "session-time=%"G_GINT64_FORMAT"\n",
+                            (gchar *) key,
+                            engine_metrics->rss_kb,
+                            engine_metrics->n_sessions,
+                            engine_metrics->session_rss_kb,
+                            engine_metrics->session_time);
+    nimf_histogram_append_to_string (&engine_metrics->filter_event,
+                                     "filter-event", string);
+  }
+
+  g_hash_table_iter_init (&iter, server->connections);
+
+  /* the reply size is limited to G_MAXUINT16 */
+  while (g_hash_table_iter_next (&iter, NULL, &value) &&
+         string->len < G_MAXUINT16 - 512)
+  {
+    NimfConnection *connection = value;
+
+    g_string_append_printf (string,
+                            "\n[connection %d]\n"
+                            "pid=%d\n"
+                            "contexts=%u\n"
+                            "messages=%"G_GUINT64_FORMAT"\n"
+                            "filter-events=%"G_GUINT64_FORMAT"\n"
+                            "filter-event-time=%"G_GINT64_FORMAT"\n"
+                            "round-trips=%"G_GUINT64_FORMAT"\n"
+                            "slow-replies=%"G_GUINT64_FORMAT"\n",
+                            connection->id,
+                            connection->pid,
+                            g_hash_table_size (connection->ims),
+                            connection->n_messages,
+                            connection->n_filter_events,
+                            connection->filter_event_time,
+                            connection->n_round_trips,
+                            connection->n_slow_replies);
+  }
+
+  /* cut at the end of a line, so the reply stays a NUL terminated key file */
+  if (string->len + 1 > G_MAXUINT16)
+  {
+    gchar *newline;
+
+    g_string_truncate (string, G_MAXUINT16 - 1);
+    newline = strrchr (string->str, '\n');
+    g_string_truncate (string, newline ? newline - string->str + 1 : 0);
+  }
+
+  *len = string->len + 1;
+
+  return g_string_free (string, FALSE);
+}
+
 static gboolean
 on_incoming_message_nimf (GSocket        *socket,
                           GIOCondition    condition,
@@ -64,9 +172,13 @@ on_incoming_message_nimf (GSocket        *socket,
 
     g_socket_close (socket, NULL);
 
-    GList *l;
-    for (l = connection->server->instances; l != NULL; l = l->next)
-      nimf_engine_reset (l->data, NULL);
+    /* nimf-top and the like never create a context */
+    if (g_hash_table_size (connection->ims) > 0)
+    {
+      GList *l;
+      for (l = connection->server->instances; l != NULL; l = l->next)
+        nimf_engine_reset (l->data, NULL);
+    }
 
     connection->result->reply = NULL;
     g_hash_table_remove (connection->server->connections,
@@ -84,8 +196,15 @@ on_incoming_message_nimf (GSocket        *socket,
     return G_SOURCE_CONTINUE;
   }
 
-  NimfServerIM *im;
-  guint16       icid = message->header->icid;
+  NimfServerIM   *im;
+  guint16         icid  = message->header->icid;
+  NimfMessageType type  = message->header->type;
+  gint64          begin = g_get_monotonic_time ();
+  NimfSpan        span;
+  guint64         saved_id = 0;
+
+  nimf_span_begin (&span);
+  connection->n_messages++;
 
   im = g_hash_table_lookup (connection->ims, GUINT_TO_POINTER (icid));
 
@@ -105,11 +224,42 @@ on_incoming_message_nimf (GSocket        *socket,
                          NULL, 0, NULL);
       break;
     case NIMF_MESSAGE_FILTER_EVENT:
-      nimf_message_ref (message);
-      retval = nimf_service_im_filter_event (NIMF_SERVICE_IM (im), (NimfEvent *) message->data);
-      nimf_message_unref (message);
-      nimf_send_message (socket, icid, NIMF_MESSAGE_FILTER_EVENT_REPLY,
-                         &retval, sizeof (gboolean), NULL);
+      {
+        NimfMetrics *metrics = connection->server->metrics;
+        NimfEngine  *engine  = NIMF_SERVICE_IM (im)->engine;
+        gint64       elapsed = g_get_monotonic_time ();
+        /* other connections are served while this waits for replies */
+        guint64      n_round_trips = connection->n_round_trips;
+
+        if (G_UNLIKELY (span.begin))
+        {
+          guint64 id = 0;
+
+          /* older clients don't append the correlation ID */
+          if (message->header->data_len >= sizeof (NimfEvent) + sizeof (guint64))
+            memcpy (&id, message->data + sizeof (NimfEvent), sizeof (guint64));
+
+          saved_id = nimf_span_get_correlation_id ();
+          nimf_span_set_correlation_id (id);
+        }
+
+        nimf_message_ref (message);
+        retval = nimf_service_im_filter_event (NIMF_SERVICE_IM (im), (NimfEvent *) message->data);
+        nimf_message_unref (message);
+        elapsed = g_get_monotonic_time () - elapsed;
+
+        if (engine)
+          nimf_histogram_add (&nimf_metrics_get_engine (metrics,
+                                nimf_engine_get_id (engine))->filter_event,
+                              elapsed);
+        nimf_metrics_add_round_trips (metrics, connection->n_round_trips -
+                                               n_round_trips);
+        connection->n_filter_events++;
+        connection->filter_event_time += elapsed;
+
+        nimf_send_message (socket, icid, NIMF_MESSAGE_FILTER_EVENT_REPLY,
+                           &retval, sizeof (gboolean), NULL);
+      }
       break;
     case NIMF_MESSAGE_RESET:
       nimf_service_im_reset (NIMF_SERVICE_IM (im));
@@ -174,16 +324,63 @@ on_incoming_message_nimf (GSocket        *socket,
       nimf_send_message (socket, icid, NIMF_MESSAGE_SET_USE_PREEDIT_REPLY,
                          NULL, 0, NULL);
       break;
+    case NIMF_MESSAGE_GET_ENGINE_ID:
+      {
+        NimfEngine  *engine    = NIMF_SERVICE_IM (im)->engine;
+        const gchar *engine_id = engine ? nimf_engine_get_id (engine) : "";
+
+        nimf_send_message (socket, icid, NIMF_MESSAGE_GET_ENGINE_ID_REPLY,
+                           (gchar *) engine_id, strlen (engine_id) + 1, NULL);
+      }
+      break;
+    case NIMF_MESSAGE_SET_ENGINE_BY_ID:
+      nimf_message_ref (message);
+
+      /* the engine may have been turned off since the client asked */
+      if (message->header->data_len > 0 &&
+          message->data[message->header->data_len - 1] == '\0' &&
+          nimf_server_get_instance (connection->server, message->data))
+        nimf_service_im_set_engine_by_id (NIMF_SERVICE_IM (im),
+                                          message->data);
+
+      nimf_message_unref (message);
+      nimf_send_message (socket, icid, NIMF_MESSAGE_SET_ENGINE_BY_ID_REPLY,
+                         NULL, 0, NULL);
+      break;
+    case NIMF_MESSAGE_GET_STATS:
+      {
+        gchar   *data;
+        guint16  data_len;
+
+        data = nimf_server_get_stats (connection->server, &data_len);
+        nimf_send_message (socket, icid, NIMF_MESSAGE_GET_STATS_REPLY,
+                           data, data_len, g_free);
+      }
+      break;
     case NIMF_MESSAGE_PREEDIT_START_REPLY:
     case NIMF_MESSAGE_PREEDIT_CHANGED_REPLY:
     case NIMF_MESSAGE_PREEDIT_END_REPLY:
     case NIMF_MESSAGE_COMMIT_REPLY:
     case NIMF_MESSAGE_RETRIEVE_SURROUNDING_REPLY:
     case NIMF_MESSAGE_DELETE_SURROUNDING_REPLY:
-      break;
+      /* replies are accounted for in the round trips */
+      return G_SOURCE_CONTINUE;
     default:
       g_warning ("Unknown message type: %d", message->header->type);
-      break;
+      return G_SOURCE_CONTINUE;
+  }
+
+  /* message may have been released by a nested iteration */
+  nimf_histogram_add (&connection->server->metrics->messages[type],
+                      g_get_monotonic_time () - begin);
+
+  if (G_UNLIKELY (span.begin))
+  {
+    nimf_span_end (&span, nimf_message_get_name_by_type (type), icid);
+
+    /* a nested iteration may have served another client's key */
+    if (type == NIMF_MESSAGE_FILTER_EVENT)
+      nimf_span_set_correlation_id (saved_id);
   }
 
   return G_SOURCE_CONTINUE;
@@ -221,6 +418,15 @@ on_new_connection (GSocketService    *service,
   connection->socket = g_socket_connection_get_socket (socket_connection);
   nimf_server_add_connection (server, connection);
 
+  GCredentials *credentials;
+  credentials = g_socket_get_credentials (connection->socket, NULL);
+
+  if (credentials)
+  {
+    connection->pid = g_credentials_get_unix_pid (credentials, NULL);
+    g_object_unref (credentials);
+  }
+
   connection->source = g_socket_create_source (connection->socket, G_IO_IN, NULL);
   connection->socket_connection = g_object_ref (socket_connection);
   g_source_set_can_recurse (connection->source, TRUE);
@@ -503,6 +709,7 @@ nimf_server_load_engines (NimfServer *server)
         NimfModule *module;
         NimfEngine *engine;
         gchar      *path;
+        glong       rss_kb = nimf_metrics_get_rss ();
 
         path = g_module_build_path (NIMF_MODULE_DIR, engine_id);
         module = nimf_module_new (path);
@@ -524,6 +731,9 @@ nimf_server_load_engines (NimfServer *server)
         server->instances = g_list_prepend (server->instances, engine);
         g_type_module_unuse (G_TYPE_MODULE (module));
 
+        nimf_metrics_get_engine (server->metrics, engine_id)->rss_kb =
+          nimf_metrics_get_rss () - rss_kb;
+
         if (g_settings_schema_has_key (schema, "trigger-keys"))
         {
           NimfKey **trigger_keys;
@@ -572,6 +782,7 @@ nimf_server_init (NimfServer *server)
   g_signal_connect (server->settings, "changed::use-singleton",
                     G_CALLBACK (on_use_singleton), server);
 
+  server->metrics   = nimf_metrics_new ();
   server->candidate = nimf_candidate_new ();
   server->modules   = g_hash_table_new_full (g_str_hash, g_str_equal,
                                              g_free, NULL);
@@ -643,6 +854,7 @@ nimf_server_finalize (GObject *object)
   g_hash_table_unref (server->trigger_keys);
   nimf_key_freev (server->hotkeys);
   g_free (server->address);
+  nimf_metrics_free (server->metrics);
 
   g_main_context_unref (server->main_context);
 
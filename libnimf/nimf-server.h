@@ -31,6 +31,7 @@
 #include "nimf-types.h"
 #include "nimf-candidate.h"
 #include "nimf-engine.h"
+#include "nimf-metrics.h"
 
 G_BEGIN_DECLS
 
@@ -71,6 +72,7 @@ struct _NimfServer
   GHashTable      *trigger_gsettings;
   GHashTable      *trigger_keys;
   gboolean         use_singleton;
+  NimfMetrics     *metrics;
 };
 
 struct _NimfServerClass
@@ -20,7 +20,11 @@
  */
 
 #include "nimf-service-im.h"
+#include "nimf-connection.h"
 #include "nimf-module.h"
+#include "nimf-server-im.h"
+#include "nimf-span.h"
+#include "nimf-trace.h"
 #include <string.h>
 #include <xkbcommon/xkbcommon-compose.h>
 
@@ -32,6 +36,20 @@ enum
   PROP_SERVICE_IM_SERVER
 };
 
+/* icids are numbered per connection for nimf clients, and per service for
+ * the others, so the trace needs both to tell input contexts apart */
+static guint32
+nimf_service_im_trace_source (NimfServiceIM *im)
+{
+  if (G_LIKELY (!nimf_trace_is_active ()))
+    return 0;
+
+  if (NIMF_IS_SERVER_IM (im))
+    return nimf_connection_get_id (NIMF_SERVER_IM (im)->connection);
+
+  return G_MAXUINT16 + g_quark_from_static_string (G_OBJECT_TYPE_NAME (im));
+}
+
 void nimf_service_im_emit_preedit_start (NimfServiceIM *im)
 {
   g_debug (G_STRLOC ": %s", G_STRFUNC);
@@ -39,6 +57,9 @@ void nimf_service_im_emit_preedit_start (NimfServiceIM *im)
   if (G_UNLIKELY (!im))
     return;
 
+  nimf_trace_record (nimf_service_im_trace_source (im), im->icid,
+                     NIMF_TRACE_RECORD_PREEDIT_START, NULL, 0);
+
   NimfServiceIMClass *class = NIMF_SERVICE_IM_GET_CLASS (im);
 
   if (class->emit_preedit_start)
@@ -56,6 +77,9 @@ nimf_service_im_emit_preedit_changed (NimfServiceIM    *im,
   if (G_UNLIKELY (!im))
     return;
 
+  nimf_trace_record_preedit_changed (nimf_service_im_trace_source (im),
+                                     im->icid, preedit_string, cursor_pos);
+
   g_free (im->preedit_string);
   nimf_preedit_attr_freev (im->preedit_attrs);
 
@@ -77,6 +101,9 @@ nimf_service_im_emit_preedit_end (NimfServiceIM *im)
   if (G_UNLIKELY (!im))
     return;
 
+  nimf_trace_record (nimf_service_im_trace_source (im), im->icid,
+                     NIMF_TRACE_RECORD_PREEDIT_END, NULL, 0);
+
   NimfServiceIMClass *class = NIMF_SERVICE_IM_GET_CLASS (im);
 
   if (class->emit_preedit_end)
@@ -92,6 +119,9 @@ nimf_service_im_emit_commit (NimfServiceIM *im,
   if (G_UNLIKELY (!im))
     return;
 
+  nimf_trace_record_string (nimf_service_im_trace_source (im), im->icid,
+                            NIMF_TRACE_RECORD_COMMIT, text);
+
   NimfServiceIMClass *class = NIMF_SERVICE_IM_GET_CLASS (im);
 
   if (class->emit_commit)
@@ -124,6 +154,9 @@ nimf_service_im_emit_delete_surrounding (NimfServiceIM *im,
   if (G_UNLIKELY (!im))
     return FALSE;
 
+  nimf_trace_record_delete_surrounding (nimf_service_im_trace_source (im),
+                                        im->icid, offset, n_chars);
+
   NimfServiceIMClass *class = NIMF_SERVICE_IM_GET_CLASS (im);
 
   if (class->emit_delete_surrounding)
@@ -141,6 +174,9 @@ nimf_service_im_emit_engine_changed (NimfServiceIM *im,
   if (G_UNLIKELY (!im))
     return;
 
+  nimf_trace_record_string (nimf_service_im_trace_source (im), im->icid,
+                            NIMF_TRACE_RECORD_ENGINE_CHANGED, name);
+
   g_signal_emit_by_name (im->server, "engine-changed", name);
 }
 
@@ -153,6 +189,9 @@ void nimf_service_im_focus_in (NimfServiceIM *im)
   if (G_UNLIKELY (im->engine == NULL))
     return;
 
+  nimf_trace_record_string (nimf_service_im_trace_source (im), im->icid,
+                            NIMF_TRACE_RECORD_FOCUS_IN,
+                            nimf_engine_get_id (im->engine));
   nimf_engine_focus_in (im->engine, im);
   nimf_service_im_emit_engine_changed (im,
                                        nimf_engine_get_icon_name (im->engine));
@@ -167,6 +206,8 @@ void nimf_service_im_focus_out (NimfServiceIM *im)
   if (G_UNLIKELY (im->engine == NULL))
     return;
 
+  nimf_trace_record (nimf_service_im_trace_source (im), im->icid,
+                     NIMF_TRACE_RECORD_FOCUS_OUT, NULL, 0);
   nimf_engine_focus_out (im->engine, im);
   nimf_service_im_emit_engine_changed (im, "nimf-indicator");
 }
@@ -284,20 +325,26 @@ static gboolean nimf_service_im_filter_compose (NimfServiceIM *im,
   return TRUE;
 }
 
-gboolean nimf_service_im_filter_event (NimfServiceIM *im,
-                                       NimfEvent     *event)
+static void
+nimf_service_im_reset_real (NimfServiceIM *im)
 {
-  g_debug (G_STRLOC ": %s", G_STRFUNC);
-
-  g_return_val_if_fail (im != NULL, FALSE);
+  if (G_LIKELY (im->engine))
+    nimf_engine_reset (im->engine, im);
 
-  if (G_UNLIKELY (im->engine == NULL))
-    return FALSE;
+  xkb_compose_state_reset (im->xkb_compose_state);
+}
 
+static gboolean
+nimf_service_im_filter_event_real (NimfServiceIM *im,
+                                   NimfEvent     *event)
+{
   GHashTableIter iter;
   gpointer       trigger_keys;
   gpointer       engine_id;
+  NimfSpan       span;
+  gboolean       retval;
 
+  nimf_span_begin (&span);
   g_hash_table_iter_init (&iter, im->server->trigger_keys);
 
   while (g_hash_table_iter_next (&iter, &trigger_keys, &engine_id))
@@ -306,7 +353,7 @@ gboolean nimf_service_im_filter_event (NimfServiceIM *im,
     {
       if (event->key.type == NIMF_EVENT_KEY_PRESS)
       {
-        nimf_service_im_reset (im);
+        nimf_service_im_reset_real (im);
 
         if (g_strcmp0 (nimf_engine_get_id (im->engine), engine_id) != 0)
         {
@@ -329,6 +376,8 @@ gboolean nimf_service_im_filter_event (NimfServiceIM *im,
                                              nimf_engine_get_icon_name (im->engine));
       }
 
+      nimf_span_end (&span, "trigger dispatch", im->icid);
+
       return TRUE;
     }
   }
@@ -337,7 +386,7 @@ gboolean nimf_service_im_filter_event (NimfServiceIM *im,
   {
     if (event->key.type == NIMF_EVENT_KEY_PRESS)
     {
-      nimf_service_im_reset (im);
+      nimf_service_im_reset_real (im);
 
       if (im->server->use_singleton)
         im->engine = nimf_server_get_next_instance (im->server, im->engine);
@@ -348,15 +397,46 @@ gboolean nimf_service_im_filter_event (NimfServiceIM *im,
                                            nimf_engine_get_icon_name (im->engine));
     }
 
+    nimf_span_end (&span, "trigger dispatch", im->icid);
+
     return TRUE;
   }
 
-  if (nimf_engine_filter_event (im->engine, im, event))
+  nimf_span_end (&span, "trigger dispatch", im->icid);
+  nimf_span_begin (&span);
+
+  retval = nimf_engine_filter_event (im->engine, im, event);
+
+  if (G_UNLIKELY (span.begin))
+    nimf_span_end (&span, g_intern_string (nimf_engine_get_id (im->engine)),
+                   im->icid);
+
+  if (retval)
     return TRUE;
   else
     return nimf_service_im_filter_compose (im, event);
 }
 
+gboolean nimf_service_im_filter_event (NimfServiceIM *im,
+                                       NimfEvent     *event)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  g_return_val_if_fail (im != NULL, FALSE);
+
+  if (G_UNLIKELY (im->engine == NULL))
+    return FALSE;
+
+  gboolean retval;
+
+  nimf_trace_record_event (nimf_service_im_trace_source (im), im->icid, event);
+  retval = nimf_service_im_filter_event_real (im, event);
+  nimf_trace_record_int (nimf_service_im_trace_source (im), im->icid,
+                         NIMF_TRACE_RECORD_FILTER_EVENT_RESULT, retval);
+
+  return retval;
+}
+
 void
 nimf_service_im_set_surrounding (NimfServiceIM *im,
                                  const char    *text,
@@ -370,6 +450,8 @@ nimf_service_im_set_surrounding (NimfServiceIM *im,
   if (G_UNLIKELY (im->engine == NULL))
     return;
 
+  nimf_trace_record_surrounding (nimf_service_im_trace_source (im), im->icid,
+                                 text, len, cursor_index);
   nimf_engine_set_surrounding (im->engine, text, len, cursor_index);
 }
 
@@ -396,6 +478,9 @@ nimf_service_im_set_use_preedit (NimfServiceIM *im,
 
   g_return_if_fail (im != NULL);
 
+  nimf_trace_record_int (nimf_service_im_trace_source (im), im->icid,
+                         NIMF_TRACE_RECORD_SET_USE_PREEDIT, use_preedit);
+
   if (im->use_preedit == TRUE && use_preedit == FALSE)
   {
     im->use_preedit = FALSE;
@@ -433,6 +518,9 @@ nimf_service_im_set_cursor_location (NimfServiceIM       *im,
   if (G_UNLIKELY (im->engine == NULL))
     return;
 
+  nimf_trace_record (nimf_service_im_trace_source (im), im->icid,
+                     NIMF_TRACE_RECORD_SET_CURSOR_LOCATION, area,
+                     sizeof (NimfRectangle));
   im->cursor_area = *area;
   nimf_engine_set_cursor_location (im->engine, area);
 }
@@ -443,10 +531,9 @@ void nimf_service_im_reset (NimfServiceIM *im)
 
   g_return_if_fail (im != NULL);
 
-  if (G_LIKELY (im->engine))
-    nimf_engine_reset (im->engine, im);
-
-  xkb_compose_state_reset (im->xkb_compose_state);
+  nimf_trace_record (nimf_service_im_trace_source (im), im->icid,
+                     NIMF_TRACE_RECORD_RESET, NULL, 0);
+  nimf_service_im_reset_real (im);
 }
 
 void
@@ -464,6 +551,8 @@ nimf_service_im_set_engine_by_id (NimfServiceIM *im,
 
   g_return_if_fail (engine != NULL);
 
+  nimf_trace_record_string (nimf_service_im_trace_source (im), im->icid,
+                            NIMF_TRACE_RECORD_SET_ENGINE, engine_id);
   im->engine = engine;
   nimf_service_im_emit_engine_changed (im,
                                        nimf_engine_get_icon_name (im->engine));
@@ -549,6 +638,9 @@ nimf_service_im_finalize (GObject *object)
 
   NimfServiceIM *im = NIMF_SERVICE_IM (object);
 
+  nimf_trace_record (nimf_service_im_trace_source (im), im->icid,
+                     NIMF_TRACE_RECORD_DESTROY, NULL, 0);
+
   if (im->engines)
     g_list_free_full (im->engines, g_object_unref);
 
@@ -0,0 +1,254 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 2; tab-width: 2 -*- */
+/*
+ * nimf-span.c
+ * This file is part of Nimf.
+ *
+ * Copyright (C) 2017 Hodong Kim <cogniti@gmail.com>
+ *
+ * Nimf is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Nimf is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program;  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "nimf-span.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+typedef struct
+{
+  const gchar *name;
+  guint64      id;
+  gint64       begin;
+  gint64       end;
+  guint16      icid;
+} NimfSpanRecord;
+
+/*
+ * Only the owner thread writes to a ring, so recording a span takes no
+ * lock; n_records is published atomically for nimf_span_dump ().
+ */
+typedef struct
+{
+  NimfSpanRecord records[NIMF_SPAN_RING_SIZE];
+  guint          n_records;
+  gint           tid;
+  guint64        correlation_id;
+} NimfSpanRing;
+
+static gchar    *nimf_span_dir = NULL;
+static GSList   *nimf_span_rings = NULL;
+static GMutex    nimf_span_rings_mutex;
+static GPrivate  nimf_span_ring_key; /* rings outlive their threads */
+static guint     nimf_span_next_id = 0;
+
+static void
+nimf_span_dump_at_exit ()
+{
+  GError *error = NULL;
+
+  if (!nimf_span_dump (&error))
+  {
+    g_warning (G_STRLOC ": %s: %s", G_STRFUNC, error->message);
+    g_clear_error (&error);
+  }
+}
+
+gboolean
+nimf_span_is_enabled ()
+{
+  static gsize initialized = 0;
+
+  if (g_once_init_enter (&initialized))
+  {
+    const gchar *dir = g_getenv ("NIMF_SPAN_DIR");
+
+    if (dir && dir[0])
+    {
+      /* nimf-daemon changes the working directory when it daemonizes */
+      if (g_path_is_absolute (dir))
+      {
+        nimf_span_dir = g_strdup (dir);
+      }
+      else
+      {
+        gchar *cwd = g_get_current_dir ();
+        nimf_span_dir = g_build_filename (cwd, dir, NULL);
+        g_free (cwd);
+      }
+
+      atexit (nimf_span_dump_at_exit);
+    }
+
+    g_once_init_leave (&initialized, 1);
+  }
+
+  return nimf_span_dir != NULL;
+}
+
+static NimfSpanRing *
+nimf_span_get_ring ()
+{
+  NimfSpanRing *ring = g_private_get (&nimf_span_ring_key);
+
+  if (G_UNLIKELY (ring == NULL))
+  {
+    ring = g_new0 (NimfSpanRing, 1);
+    ring->tid = syscall (SYS_gettid);
+    g_private_set (&nimf_span_ring_key, ring);
+
+    g_mutex_lock (&nimf_span_rings_mutex);
+    nimf_span_rings = g_slist_prepend (nimf_span_rings, ring);
+    g_mutex_unlock (&nimf_span_rings_mutex);
+  }
+
+  return ring;
+}
+
+void
+nimf_span_begin (NimfSpan *span)
+{
+  span->begin = nimf_span_is_enabled () ? g_get_monotonic_time () : 0;
+}
+
+/* name must be a static or interned string */
+void
+nimf_span_end (NimfSpan    *span,
+               const gchar *name,
+               guint16      icid)
+{
+  if (G_LIKELY (span->begin == 0))
+    return;
+
+  NimfSpanRing   *ring = nimf_span_get_ring ();
+  NimfSpanRecord *record;
+  guint           n    = ring->n_records;
+
+  record         = &ring->records[n % NIMF_SPAN_RING_SIZE];
+  record->name   = name;
+  record->id     = ring->correlation_id;
+  record->begin  = span->begin;
+  record->end    = g_get_monotonic_time ();
+  record->icid   = icid;
+
+  g_atomic_int_set (&ring->n_records, n + 1);
+}
+
+/* unique across processes, so spans of the client and the daemon match */
+guint64
+nimf_span_new_correlation_id ()
+{
+  guint64 id;
+
+  if (!nimf_span_is_enabled ())
+    return 0;
+
+  id = ((guint64) getpid () << 32) |
+       (guint32) (g_atomic_int_add (&nimf_span_next_id, 1) + 1);
+  nimf_span_set_correlation_id (id);
+
+  return id;
+}
+
+guint64
+nimf_span_get_correlation_id ()
+{
+  if (!nimf_span_is_enabled ())
+    return 0;
+
+  return nimf_span_get_ring ()->correlation_id;
+}
+
+void
+nimf_span_set_correlation_id (guint64 id)
+{
+  if (!nimf_span_is_enabled ())
+    return;
+
+  nimf_span_get_ring ()->correlation_id = id;
+}
+
+static void
+nimf_span_append_json_string (GString *json, const gchar *str)
+{
+  g_string_append_c (json, '"');
+
+  for (; str && *str; str++)
+  {
+    if (*str == '"' || *str == '\\')
+      g_string_append_printf (json, "\\%c", *str);
+    else if ((guchar) *str < 0x20)
+      g_string_append_printf (json, "\\u%04x", (guchar) *str);
+    else
+      g_string_append_c (json, *str);
+  }
+
+  g_string_append_c (json, '"');
+}
+
+gboolean
+nimf_span_dump (GError **error)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  GString  *json;
+  GSList   *l;
+  gchar    *path;
+  gint      pid = getpid ();
+  gboolean  retval;
+
+  if (!nimf_span_is_enabled ())
+    return TRUE;
+
+  json = g_string_new ("{\"traceEvents\":[\n");
+  g_string_append_printf (json, "{\"name\":\"process_name\",\"ph\":\"M\","
+                                "\"pid\":%d,\"args\":{\"name\":", pid);
+  nimf_span_append_json_string (json, g_get_prgname ());
+  g_string_append (json, "}}");
+
+  g_mutex_lock (&nimf_span_rings_mutex);
+
+  for (l = nimf_span_rings; l != NULL; l = l->next)
+  {
+    NimfSpanRing *ring = l->data;
+    guint         n    = g_atomic_int_get (&ring->n_records);
+    guint         i    = n > NIMF_SPAN_RING_SIZE ? n - NIMF_SPAN_RING_SIZE : 0;
+
+    for (; i < n; i++)
+    {
+      NimfSpanRecord *record = &ring->records[i % NIMF_SPAN_RING_SIZE];
+
+      g_string_append (json, ",\n{\"name\":");
+      nimf_span_append_json_string (json, record->name);
+      g_string_append_printf (json,
+        ",\"cat\":\"nimf\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,"
+        "\"ts\":%"G_GINT64_FORMAT",\"dur\":%"G_GINT64_FORMAT","
+        "\"args\":{\"id\":\"%016"G_GINT64_MODIFIER"x\",\"icid\":%u}}",
+        pid, ring->tid, record->begin, record->end - record->begin,
+        record->id, record->icid);
+    }
+  }
+
+  g_mutex_unlock (&nimf_span_rings_mutex);
+
+  g_string_append (json, "\n]}\n");
+
+  path = g_strdup_printf ("%s/nimf-spans-%d.json", nimf_span_dir, pid);
+  retval = g_file_set_contents (path, json->str, json->len, error);
+
+  g_free (path);
+  g_string_free (json, TRUE);
+
+  return retval;
+}
@@ -0,0 +1,68 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 2; tab-width: 2 -*- */
+/*
+ * nimf-span.h
+ * This file is part of Nimf.
+ *
+ * Copyright (C) 2017 Hodong Kim <cogniti@gmail.com>
+ *
+ * Nimf is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Nimf is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program;  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef __NIMF_SPAN_H__
+#define __NIMF_SPAN_H__
+
+#if !defined (__NIMF_H_INSIDE__) && !defined (NIMF_COMPILATION)
+#error "Only <nimf.h> can be included directly."
+#endif
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Latency spans.  Set NIMF_SPAN_DIR to a directory to enable them; every
+ * process using libnimf then writes nimf-spans-<pid>.json there at exit
+ * (nimf-daemon also on SIGUSR1) in the Chrome trace event format.  Time
+ * stamps are CLOCK_MONOTONIC, so the files of the client and the daemon
+ * can be merged into one timeline:
+ *
+ *   jq -s '{traceEvents: map(.traceEvents) | add}' nimf-spans-*.json
+ *
+ * A key press is followed across processes by the correlation ID that
+ * the client appends to NIMF_MESSAGE_FILTER_EVENT.
+ */
+
+#define NIMF_SPAN_RING_SIZE 4096
+
+typedef struct _NimfSpan NimfSpan;
+
+struct _NimfSpan
+{
+  gint64 begin; /* 0 if spans are disabled */
+};
+
+gboolean nimf_span_is_enabled         (void);
+void     nimf_span_begin              (NimfSpan    *span);
+void     nimf_span_end                (NimfSpan    *span,
+                                       const gchar *name,
+                                       guint16      icid);
+guint64  nimf_span_new_correlation_id (void);
+guint64  nimf_span_get_correlation_id (void);
+void     nimf_span_set_correlation_id (guint64      id);
+gboolean nimf_span_dump               (GError     **error);
+
+G_END_DECLS
+
+#endif /* __NIMF_SPAN_H__ */
@@ -0,0 +1,398 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 2; tab-width: 2 -*- */
+/*
+ * nimf-trace.c
+ * This file is part of Nimf.
+ *
+ * Copyright (C) 2017 Hodong Kim <cogniti@gmail.com>
+ *
+ * Nimf is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Nimf is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program;  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "nimf-trace.h"
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+static FILE   *nimf_trace_file       = NULL;
+static gint64  nimf_trace_start_time = 0;
+static gint64  nimf_trace_flush_time = 0;
+static GMutex  nimf_trace_mutex;
+
+gboolean
+nimf_trace_start (const gchar *path, GError **error)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  g_return_val_if_fail (path != NULL, FALSE);
+
+  NimfTraceFileHeader header = { NIMF_TRACE_MAGIC };
+  FILE *file;
+
+  file = g_fopen (path, "wb");
+
+  if (file == NULL)
+  {
+    gint saved_errno = errno;
+
+    g_set_error (error, G_IO_ERROR, g_io_error_from_errno (saved_errno),
+                 "Can't open %s: %s", path, g_strerror (saved_errno));
+    return FALSE;
+  }
+
+  header.version    = NIMF_TRACE_VERSION;
+  header.byte_order = G_BYTE_ORDER;
+  header.start_time = g_get_real_time ();
+
+  if (fwrite (&header, sizeof (NimfTraceFileHeader), 1, file) != 1)
+  {
+    g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                 "Can't write trace header to %s", path);
+    fclose (file);
+    return FALSE;
+  }
+
+  g_mutex_lock (&nimf_trace_mutex);
+
+  if (nimf_trace_file)
+    fclose (nimf_trace_file);
+
+  nimf_trace_file       = file;
+  nimf_trace_start_time = g_get_monotonic_time ();
+  nimf_trace_flush_time = nimf_trace_start_time;
+
+  g_mutex_unlock (&nimf_trace_mutex);
+
+  return TRUE;
+}
+
+void
+nimf_trace_stop ()
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  g_mutex_lock (&nimf_trace_mutex);
+
+  if (nimf_trace_file)
+  {
+    fclose (nimf_trace_file);
+    nimf_trace_file = NULL;
+  }
+
+  g_mutex_unlock (&nimf_trace_mutex);
+}
+
+gboolean
+nimf_trace_is_active ()
+{
+  return nimf_trace_file != NULL;
+}
+
+static void
+nimf_trace_write (guint32              source,
+                  guint16              icid,
+                  NimfTraceRecordType  type,
+                  gconstpointer        data1,
+                  gsize                data1_len,
+                  gconstpointer        data2,
+                  gsize                data2_len)
+{
+  NimfTraceRecordHeader header = { 0 };
+  gint64                now;
+
+  g_mutex_lock (&nimf_trace_mutex);
+
+  if (G_UNLIKELY (nimf_trace_file == NULL))
+  {
+    g_mutex_unlock (&nimf_trace_mutex);
+    return;
+  }
+
+  now = g_get_monotonic_time ();
+
+  header.type      = type;
+  header.icid      = icid;
+  header.data_len  = data1_len + data2_len;
+  header.source    = source;
+  header.timestamp = now - nimf_trace_start_time;
+
+  if (fwrite (&header, sizeof (NimfTraceRecordHeader), 1, nimf_trace_file) != 1 ||
+      (data1_len > 0 && fwrite (data1, data1_len, 1, nimf_trace_file) != 1) ||
+      (data2_len > 0 && fwrite (data2, data2_len, 1, nimf_trace_file) != 1))
+  {
+    g_warning (G_STRLOC ": %s: Can't write trace record, tracing stopped",
+               G_STRFUNC);
+    fclose (nimf_trace_file);
+    nimf_trace_file = NULL;
+  }
+  else if (type < NIMF_TRACE_RECORD_ENGINE_CHANGED ||
+           now - nimf_trace_flush_time >= G_USEC_PER_SEC)
+  {
+    /* Inputs are what a crash report needs; don't leave them in stdio.
+     * Output records between inputs are flushed with the next input. */
+    fflush (nimf_trace_file);
+    nimf_trace_flush_time = now;
+  }
+
+  g_mutex_unlock (&nimf_trace_mutex);
+}
+
+void
+nimf_trace_record (guint32              source,
+                   guint16              icid,
+                   NimfTraceRecordType  type,
+                   gconstpointer        data,
+                   gsize                data_len)
+{
+  if (G_LIKELY (nimf_trace_file == NULL))
+    return;
+
+  nimf_trace_write (source, icid, type, data, data_len, NULL, 0);
+}
+
+void
+nimf_trace_record_string (guint32              source,
+                          guint16              icid,
+                          NimfTraceRecordType  type,
+                          const gchar         *str)
+{
+  if (G_LIKELY (nimf_trace_file == NULL))
+    return;
+
+  if (str == NULL)
+    str = "";
+
+  nimf_trace_write (source, icid, type, str, strlen (str) + 1, NULL, 0);
+}
+
+void
+nimf_trace_record_int (guint32              source,
+                       guint16              icid,
+                       NimfTraceRecordType  type,
+                       gint                 value)
+{
+  if (G_LIKELY (nimf_trace_file == NULL))
+    return;
+
+  gint32 data = value;
+
+  nimf_trace_write (source, icid, type, &data, sizeof (gint32), NULL, 0);
+}
+
+void
+nimf_trace_record_event (guint32 source, guint16 icid, NimfEvent *event)
+{
+  if (G_LIKELY (nimf_trace_file == NULL))
+    return;
+
+  NimfTraceKey key;
+
+  key.type             = event->key.type;
+  key.state            = event->key.state;
+  key.keyval           = event->key.keyval;
+  key.hardware_keycode = event->key.hardware_keycode;
+
+  nimf_trace_write (source, icid, NIMF_TRACE_RECORD_FILTER_EVENT,
+                    &key, sizeof (NimfTraceKey), NULL, 0);
+}
+
+void
+nimf_trace_record_surrounding (guint32      source,
+                               guint16      icid,
+                               const gchar *text,
+                               gint         len,
+                               gint         cursor_index)
+{
+  if (G_LIKELY (nimf_trace_file == NULL))
+    return;
+
+  gint32  data = cursor_index;
+  gchar  *str;
+
+  if (text == NULL)
+    str = g_strdup ("");
+  else if (len < 0)
+    str = g_strdup (text);
+  else
+    str = g_strndup (text, len);
+
+  nimf_trace_write (source, icid, NIMF_TRACE_RECORD_SET_SURROUNDING,
+                    &data, sizeof (gint32), str, strlen (str) + 1);
+  g_free (str);
+}
+
+void
+nimf_trace_record_preedit_changed (guint32      source,
+                                   guint16      icid,
+                                   const gchar *preedit_string,
+                                   gint         cursor_pos)
+{
+  if (G_LIKELY (nimf_trace_file == NULL))
+    return;
+
+  gint32 data = cursor_pos;
+
+  if (preedit_string == NULL)
+    preedit_string = "";
+
+  nimf_trace_write (source, icid, NIMF_TRACE_RECORD_PREEDIT_CHANGED,
+                    &data, sizeof (gint32),
+                    preedit_string, strlen (preedit_string) + 1);
+}
+
+void
+nimf_trace_record_delete_surrounding (guint32 source,
+                                      guint16 icid,
+                                      gint    offset,
+                                      gint    n_chars)
+{
+  if (G_LIKELY (nimf_trace_file == NULL))
+    return;
+
+  gint32 data[2] = { offset, n_chars };
+
+  nimf_trace_write (source, icid, NIMF_TRACE_RECORD_DELETE_SURROUNDING,
+                    data, sizeof (data), NULL, 0);
+}
+
+GPtrArray *
+nimf_trace_load (const gchar *path, GError **error)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  g_return_val_if_fail (path != NULL, NULL);
+
+  GPtrArray           *records;
+  NimfTraceFileHeader  header;
+  gchar               *contents;
+  gsize                length;
+  gsize                offset;
+
+  if (!g_file_get_contents (path, &contents, &length, error))
+    return NULL;
+
+  if (length < sizeof (NimfTraceFileHeader))
+  {
+    g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                 "%s: too short to be a trace file", path);
+    g_free (contents);
+    return NULL;
+  }
+
+  memcpy (&header, contents, sizeof (NimfTraceFileHeader));
+
+  if (memcmp (header.magic, NIMF_TRACE_MAGIC, sizeof (NIMF_TRACE_MAGIC)) != 0 ||
+      header.version    != NIMF_TRACE_VERSION ||
+      header.byte_order != G_BYTE_ORDER)
+  {
+    g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                 "%s: not a trace file or unsupported version", path);
+    g_free (contents);
+    return NULL;
+  }
+
+  records = g_ptr_array_new_with_free_func ((GDestroyNotify) nimf_trace_record_free);
+  offset  = sizeof (NimfTraceFileHeader);
+
+  while (offset + sizeof (NimfTraceRecordHeader) <= length)
+  {
+    NimfTraceRecord *record = g_slice_new0 (NimfTraceRecord);
+
+    memcpy (&record->header, contents + offset, sizeof (NimfTraceRecordHeader));
+    offset += sizeof (NimfTraceRecordHeader);
+
+    if (record->header.data_len > length - offset)
+    {
+      /* the daemon was killed while writing the last record */
+      g_warning (G_STRLOC ": %s: %s: truncated record, ignored",
+                 G_STRFUNC, path);
+      g_slice_free (NimfTraceRecord, record);
+      break;
+    }
+
+    /* always NUL terminate, so string payloads can be used directly */
+    record->data = g_malloc0 (record->header.data_len + 1);
+    memcpy (record->data, contents + offset, record->header.data_len);
+    offset += record->header.data_len;
+
+    g_ptr_array_add (records, record);
+  }
+
+  g_free (contents);
+
+  return records;
+}
+
+void
+nimf_trace_record_free (NimfTraceRecord *record)
+{
+  g_return_if_fail (record != NULL);
+
+  g_free (record->data);
+  g_slice_free (NimfTraceRecord, record);
+}
+
+gboolean
+nimf_trace_record_is_output (const NimfTraceRecord *record)
+{
+  return record->header.type >= NIMF_TRACE_RECORD_ENGINE_CHANGED;
+}
+
+NimfEvent *
+nimf_trace_record_get_event (const NimfTraceRecord *record)
+{
+  g_return_val_if_fail (record->header.type == NIMF_TRACE_RECORD_FILTER_EVENT,
+                        NULL);
+  g_return_val_if_fail (record->header.data_len == sizeof (NimfTraceKey),
+                        NULL);
+
+  const NimfTraceKey *key = (const NimfTraceKey *) record->data;
+  NimfEvent *event;
+
+  event = nimf_event_new (key->type);
+  event->key.state            = key->state;
+  event->key.keyval           = key->keyval;
+  event->key.hardware_keycode = key->hardware_keycode;
+
+  return event;
+}
+
+const gchar *
+nimf_trace_record_type_get_name (NimfTraceRecordType type)
+{
+  switch (type)
+  {
+    case NIMF_TRACE_RECORD_FILTER_EVENT:        return "filter-event";
+    case NIMF_TRACE_RECORD_FILTER_EVENT_RESULT: return "filter-event-result";
+    case NIMF_TRACE_RECORD_FOCUS_IN:            return "focus-in";
+    case NIMF_TRACE_RECORD_FOCUS_OUT:           return "focus-out";
+    case NIMF_TRACE_RECORD_RESET:               return "reset";
+    case NIMF_TRACE_RECORD_SET_SURROUNDING:     return "set-surrounding";
+    case NIMF_TRACE_RECORD_SET_CURSOR_LOCATION: return "set-cursor-location";
+    case NIMF_TRACE_RECORD_SET_USE_PREEDIT:     return "set-use-preedit";
+    case NIMF_TRACE_RECORD_SET_ENGINE:          return "set-engine";
+    case NIMF_TRACE_RECORD_DESTROY:             return "destroy";
+    case NIMF_TRACE_RECORD_ENGINE_CHANGED:      return "engine-changed";
+    case NIMF_TRACE_RECORD_PREEDIT_START:       return "preedit-start";
+    case NIMF_TRACE_RECORD_PREEDIT_CHANGED:     return "preedit-changed";
+    case NIMF_TRACE_RECORD_PREEDIT_END:         return "preedit-end";
+    case NIMF_TRACE_RECORD_COMMIT:              return "commit";
+    case NIMF_TRACE_RECORD_DELETE_SURROUNDING:  return "delete-surrounding";
+    default:
+      break;
+  }
+
+  return "unknown";
+}
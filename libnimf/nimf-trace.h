@@ -0,0 +1,162 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 2; tab-width: 2 -*- */
+/*
+ * nimf-trace.h
+ * This file is part of Nimf.
+ *
+ * Copyright (C) 2017 Hodong Kim <cogniti@gmail.com>
+ *
+ * Nimf is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Nimf is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program;  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __NIMF_TRACE_H__
+#define __NIMF_TRACE_H__
+
+#if !defined (__NIMF_H_INSIDE__) && !defined (NIMF_COMPILATION)
+#error "Only <nimf.h> can be included directly."
+#endif
+
+#include <glib.h>
+#include "nimf-events.h"
+#include "nimf-types.h"
+
+G_BEGIN_DECLS
+
+#define NIMF_TRACE_MAGIC   "NIMFTRC"
+#define NIMF_TRACE_VERSION 2
+
+/*
+ * A trace file starts with a NimfTraceFileHeader, followed by records.
+ * Each record is a NimfTraceRecordHeader followed by data_len bytes.
+ * Integers are stored in host byte order; byte_order tells which one.
+ *
+ * icids are only unique within their source, so a record names both.
+ * The source is the connection id (1 to G_MAXUINT16) for nimf clients;
+ * services that number their own input contexts, like XIM and Wayland,
+ * get a source above G_MAXUINT16.
+ *
+ *   FILTER_EVENT         NimfTraceKey
+ *   FILTER_EVENT_RESULT  gint32 retval
+ *   FOCUS_IN             engine id, NUL terminated
+ *   SET_SURROUNDING      gint32 cursor_index, text, NUL terminated
+ *   SET_CURSOR_LOCATION  NimfRectangle
+ *   SET_USE_PREEDIT      gint32 use_preedit
+ *   SET_ENGINE           engine id, NUL terminated
+ *   ENGINE_CHANGED       icon name, NUL terminated
+ *   PREEDIT_CHANGED      gint32 cursor_pos, string, NUL terminated
+ *   COMMIT               text, NUL terminated
+ *   DELETE_SURROUNDING   gint32 offset, gint32 n_chars
+ *
+ * Other records have no data.
+ */
+typedef enum
+{
+  NIMF_TRACE_RECORD_NONE = 0,
+  /* input */
+  NIMF_TRACE_RECORD_FILTER_EVENT,
+  NIMF_TRACE_RECORD_FILTER_EVENT_RESULT,
+  NIMF_TRACE_RECORD_FOCUS_IN,
+  NIMF_TRACE_RECORD_FOCUS_OUT,
+  NIMF_TRACE_RECORD_RESET,
+  NIMF_TRACE_RECORD_SET_SURROUNDING,
+  NIMF_TRACE_RECORD_SET_CURSOR_LOCATION,
+  NIMF_TRACE_RECORD_SET_USE_PREEDIT,
+  NIMF_TRACE_RECORD_SET_ENGINE,
+  NIMF_TRACE_RECORD_DESTROY,
+  /* output */
+  NIMF_TRACE_RECORD_ENGINE_CHANGED,
+  NIMF_TRACE_RECORD_PREEDIT_START,
+  NIMF_TRACE_RECORD_PREEDIT_CHANGED,
+  NIMF_TRACE_RECORD_PREEDIT_END,
+  NIMF_TRACE_RECORD_COMMIT,
+  NIMF_TRACE_RECORD_DELETE_SURROUNDING
+} NimfTraceRecordType;
+
+typedef struct
+{
+  gchar   magic[8];
+  guint32 version;
+  guint32 byte_order;
+  gint64  start_time; /* wall clock, microseconds */
+} NimfTraceFileHeader;
+
+typedef struct
+{
+  guint8  type;
+  guint8  reserved;
+  guint16 icid;
+  guint32 data_len;
+  guint32 source;
+  guint32 reserved2;
+  gint64  timestamp; /* microseconds since the trace was started */
+} NimfTraceRecordHeader;
+
+typedef struct
+{
+  gint32  type;
+  guint32 state;
+  guint32 keyval;
+  guint32 hardware_keycode;
+} NimfTraceKey;
+
+typedef struct
+{
+  NimfTraceRecordHeader header;
+  gchar                *data;
+} NimfTraceRecord;
+
+/* recorder */
+gboolean   nimf_trace_start          (const gchar         *path,
+                                      GError             **error);
+void       nimf_trace_stop           (void);
+gboolean   nimf_trace_is_active      (void);
+void       nimf_trace_record         (guint32              source,
+                                      guint16              icid,
+                                      NimfTraceRecordType  type,
+                                      gconstpointer        data,
+                                      gsize                data_len);
+void       nimf_trace_record_string  (guint32              source,
+                                      guint16              icid,
+                                      NimfTraceRecordType  type,
+                                      const gchar         *str);
+void       nimf_trace_record_int     (guint32              source,
+                                      guint16              icid,
+                                      NimfTraceRecordType  type,
+                                      gint                 value);
+void       nimf_trace_record_event   (guint32              source,
+                                      guint16              icid,
+                                      NimfEvent           *event);
+void       nimf_trace_record_surrounding     (guint32      source,
+                                              guint16      icid,
+                                              const gchar *text,
+                                              gint         len,
+                                              gint         cursor_index);
+void       nimf_trace_record_preedit_changed (guint32      source,
+                                              guint16      icid,
+                                              const gchar *preedit_string,
+                                              gint         cursor_pos);
+void       nimf_trace_record_delete_surrounding (guint32   source,
+                                                 guint16   icid,
+                                                 gint      offset,
+                                                 gint      n_chars);
+/* reader */
+GPtrArray   *nimf_trace_load         (const gchar         *path,
+                                      GError             **error);
+void         nimf_trace_record_free  (NimfTraceRecord     *record);
+gboolean     nimf_trace_record_is_output (const NimfTraceRecord *record);
+NimfEvent   *nimf_trace_record_get_event (const NimfTraceRecord *record);
+const gchar *nimf_trace_record_type_get_name (NimfTraceRecordType type);
+
+G_END_DECLS
+
+#endif /* __NIMF_TRACE_H__ */
@@ -30,9 +30,12 @@
 #include "nimf-events.h"
 #include "nimf-im.h"
 #include "nimf-key-syms.h"
+#include "nimf-romaji.h"
 #include "nimf-server.h"
 #include "nimf-service.h"
 #include "nimf-service-im.h"
+#include "nimf-span.h"
+#include "nimf-trace.h"
 #include "nimf-types.h"
 
 #undef __NIMF_H_INSIDE__
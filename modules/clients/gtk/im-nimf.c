@@ -30,6 +30,8 @@
 #endif
 
 
+#define NIMF_GTK_IM_CONTEXT_IDLE_TIMEOUT 60 /* seconds out of focus */
+
 #define NIMF_GTK_TYPE_IM_CONTEXT  (nimf_gtk_im_context_get_type ())
 #define NIMF_GTK_IM_CONTEXT(obj)  (G_TYPE_CHECK_INSTANCE_CAST ((obj), NIMF_GTK_TYPE_IM_CONTEXT, NimfGtkIMContext))
 
@@ -40,7 +42,7 @@ struct _NimfGtkIMContext
 {
   GtkIMContext  parent_instance;
 
-  NimfIM       *im;
+  NimfIM       *im; /* NULL until focused or fed a key */
   GtkIMContext *simple;
   GdkWindow    *client_window;
   GSettings    *settings;
@@ -49,6 +51,12 @@ struct _NimfGtkIMContext
   gboolean      always_use_preedit;
   gboolean      has_focus;
   gboolean      has_event_filter;
+  /* handed to im when it is created */
+  gboolean      use_preedit;
+  GdkRectangle  cursor_area;
+  gboolean      has_cursor_area;
+  gchar        *engine_id; /* of im when it was dropped */
+  guint         idle_timeout_id;
 };
 
 struct _NimfGtkIMContextClass
@@ -58,6 +66,9 @@ struct _NimfGtkIMContextClass
 
 G_DEFINE_DYNAMIC_TYPE (NimfGtkIMContext, nimf_gtk_im_context, GTK_TYPE_IM_CONTEXT);
 
+static NimfIM  *nimf_gtk_im_context_get_im (NimfGtkIMContext *context);
+static gboolean on_idle_timeout            (NimfGtkIMContext *context);
+
 static NimfEvent *
 translate_gdk_event_key (GdkEventKey *event)
 {
@@ -122,14 +133,21 @@ nimf_gtk_im_context_filter_keypress (GtkIMContext *context,
 {
   g_debug (G_STRLOC ": %s", G_STRFUNC);
 
+  NimfGtkIMContext *nimf_context = NIMF_GTK_IM_CONTEXT (context);
   gboolean   retval;
-  NimfEvent *nimf_event = translate_gdk_event_key (event);
+  NimfSpan   span;
+  NimfEvent *nimf_event;
 
-  retval = nimf_im_filter_event (NIMF_GTK_IM_CONTEXT (context)->im, nimf_event);
+  nimf_span_begin (&span);
+  nimf_event = translate_gdk_event_key (event);
+  retval = nimf_im_filter_event (nimf_gtk_im_context_get_im (nimf_context),
+                                 nimf_event);
   nimf_event_free (nimf_event);
 
   if (retval == FALSE)
-    return gtk_im_context_filter_keypress (NIMF_GTK_IM_CONTEXT (context)->simple, event);
+    retval = gtk_im_context_filter_keypress (nimf_context->simple, event);
+
+  nimf_span_end (&span, "gtk filter_keypress", 0);
 
   return retval;
 }
@@ -139,7 +157,9 @@ nimf_gtk_im_context_reset (GtkIMContext *context)
 {
   g_debug (G_STRLOC ": %s", G_STRFUNC);
 
-  nimf_im_reset (NIMF_GTK_IM_CONTEXT (context)->im);
+  if (NIMF_GTK_IM_CONTEXT (context)->im)
+    nimf_im_reset (NIMF_GTK_IM_CONTEXT (context)->im);
+
   gtk_im_context_reset (NIMF_GTK_IM_CONTEXT (context)->simple);
 }
 
@@ -162,13 +182,18 @@ on_gdk_x_event (XEvent           *xevent,
     case KeyRelease:
       if (context->is_hook_gdk_event_key)
       {
+        NimfSpan span;
+
+        nimf_span_begin (&span);
         NimfEvent *nimf_event = translate_xkey_event (xevent);
-        retval = nimf_im_filter_event (context->im, nimf_event);
+        retval = nimf_im_filter_event (nimf_gtk_im_context_get_im (context),
+                                       nimf_event);
         nimf_event_free (nimf_event);
+        nimf_span_end (&span, "gtk x event", 0);
       }
       break;
     case ButtonPress:
-      if (context->is_reset_on_gdk_button_press_event)
+      if (context->is_reset_on_gdk_button_press_event && context->im)
         nimf_im_reset (context->im);
       break;
     default:
@@ -207,11 +232,23 @@ nimf_gtk_im_context_get_preedit_string (GtkIMContext   *context,
 {
   g_debug (G_STRLOC ": %s", G_STRFUNC);
 
+  NimfGtkIMContext *nimf_context = NIMF_GTK_IM_CONTEXT (context);
   NimfPreeditAttr **preedit_attrs;
   gchar *preedit_str;
 
-  nimf_im_get_preedit_string (NIMF_GTK_IM_CONTEXT (context)->im,
-                              &preedit_str, &preedit_attrs, cursor_pos);
+  if (nimf_context->im)
+  {
+    nimf_im_get_preedit_string (nimf_context->im,
+                                &preedit_str, &preedit_attrs, cursor_pos);
+  }
+  else
+  {
+    preedit_str   = g_strdup ("");
+    preedit_attrs = g_malloc0_n (1, sizeof (NimfPreeditAttr *));
+
+    if (cursor_pos)
+      *cursor_pos = 0;
+  }
 
   if (str)
     *str = preedit_str;
@@ -263,8 +300,15 @@ nimf_gtk_im_context_focus_in (GtkIMContext *context)
   g_debug (G_STRLOC ": %s", G_STRFUNC);
 
   NimfGtkIMContext *a_context = NIMF_GTK_IM_CONTEXT (context);
+
+  if (a_context->idle_timeout_id)
+  {
+    g_source_remove (a_context->idle_timeout_id);
+    a_context->idle_timeout_id = 0;
+  }
+
   a_context->has_focus = TRUE;
-  nimf_im_focus_in (a_context->im);
+  nimf_im_focus_in (nimf_gtk_im_context_get_im (a_context));
 }
 
 static void
@@ -273,7 +317,17 @@ nimf_gtk_im_context_focus_out (GtkIMContext *context)
   g_debug (G_STRLOC ": %s", G_STRFUNC);
 
   NimfGtkIMContext *a_context = NIMF_GTK_IM_CONTEXT (context);
-  nimf_im_focus_out (a_context->im);
+
+  if (a_context->im)
+  {
+    nimf_im_focus_out (a_context->im);
+
+    if (a_context->idle_timeout_id == 0)
+      a_context->idle_timeout_id =
+        g_timeout_add_seconds (NIMF_GTK_IM_CONTEXT_IDLE_TIMEOUT,
+                               (GSourceFunc) on_idle_timeout, a_context);
+  }
+
   a_context->has_focus = FALSE;
 }
 
@@ -294,8 +348,12 @@ nimf_gtk_im_context_set_cursor_location (GtkIMContext *context,
                                 &root_area.x,
                                 &root_area.y);
 
-  nimf_im_set_cursor_location (NIMF_GTK_IM_CONTEXT (context)->im,
-                               (const NimfRectangle *) &root_area);
+  nimf_context->cursor_area     = root_area;
+  nimf_context->has_cursor_area = TRUE;
+
+  if (nimf_context->im)
+    nimf_im_set_cursor_location (nimf_context->im,
+                                 (const NimfRectangle *) &root_area);
 }
 
 static void
@@ -304,10 +362,17 @@ nimf_gtk_im_context_set_use_preedit (GtkIMContext *context,
 {
   g_debug (G_STRLOC ": %s", G_STRFUNC);
 
-  if (NIMF_GTK_IM_CONTEXT (context)->always_use_preedit == TRUE)
-    nimf_im_set_use_preedit (NIMF_GTK_IM_CONTEXT (context)->im, TRUE);
+  NimfGtkIMContext *nimf_context = NIMF_GTK_IM_CONTEXT (context);
+
+  nimf_context->use_preedit = use_preedit;
+
+  if (nimf_context->im == NULL)
+    return;
+
+  if (nimf_context->always_use_preedit == TRUE)
+    nimf_im_set_use_preedit (nimf_context->im, TRUE);
   else
-    nimf_im_set_use_preedit (NIMF_GTK_IM_CONTEXT (context)->im, use_preedit);
+    nimf_im_set_use_preedit (nimf_context->im, use_preedit);
 }
 
 static gboolean
@@ -317,6 +382,9 @@ nimf_gtk_im_context_get_surrounding (GtkIMContext  *context,
 {
   g_debug (G_STRLOC ": %s", G_STRFUNC);
 
+  if (NIMF_GTK_IM_CONTEXT (context)->im == NULL)
+    return FALSE;
+
   return nimf_im_get_surrounding (NIMF_GTK_IM_CONTEXT (context)->im,
                                   text, cursor_index);
 }
@@ -329,8 +397,9 @@ nimf_gtk_im_context_set_surrounding (GtkIMContext *context,
 {
   g_debug (G_STRLOC ": %s", G_STRFUNC);
 
-  nimf_im_set_surrounding (NIMF_GTK_IM_CONTEXT (context)->im,
-                           text, len, cursor_index);
+  if (NIMF_GTK_IM_CONTEXT (context)->im)
+    nimf_im_set_surrounding (NIMF_GTK_IM_CONTEXT (context)->im,
+                             text, len, cursor_index);
 }
 
 GtkIMContext *
@@ -348,7 +417,11 @@ on_commit (NimfIM           *im,
 {
   g_debug (G_STRLOC ": %s", G_STRFUNC);
 
+  NimfSpan span;
+
+  nimf_span_begin (&span);
   g_signal_emit_by_name (context, "commit", text);
+  nimf_span_end (&span, "gtk commit", 0);
 }
 
 static gboolean
@@ -401,6 +474,89 @@ on_retrieve_surrounding (NimfIM           *im,
   return retval;
 }
 
+/*
+ * A nimf context costs a round trip and a server side input context, so
+ * it is made on the first focus in or key event, not for every widget,
+ * and dropped again after a while out of focus.
+ */
+static NimfIM *
+nimf_gtk_im_context_get_im (NimfGtkIMContext *context)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  if (G_LIKELY (context->im))
+    return context->im;
+
+  context->im = nimf_im_new ();
+
+  g_signal_connect (context->im, "commit",
+                    G_CALLBACK (on_commit), context);
+  g_signal_connect (context->im, "delete-surrounding",
+                    G_CALLBACK (on_delete_surrounding), context);
+  g_signal_connect (context->im, "preedit-changed",
+                    G_CALLBACK (on_preedit_changed), context);
+  g_signal_connect (context->im, "preedit-end",
+                    G_CALLBACK (on_preedit_end), context);
+  g_signal_connect (context->im, "preedit-start",
+                    G_CALLBACK (on_preedit_start), context);
+  g_signal_connect (context->im, "retrieve-surrounding",
+                    G_CALLBACK (on_retrieve_surrounding), context);
+
+  /* the server starts with use_preedit TRUE */
+  if (!context->use_preedit && !context->always_use_preedit)
+    nimf_im_set_use_preedit (context->im, FALSE);
+
+  if (context->has_cursor_area)
+    nimf_im_set_cursor_location (context->im,
+                                 (const NimfRectangle *) &context->cursor_area);
+
+  if (context->engine_id)
+  {
+    nimf_im_set_engine_by_id (context->im, context->engine_id);
+    g_free (context->engine_id);
+    context->engine_id = NULL;
+  }
+
+  return context->im;
+}
+
+static void
+nimf_gtk_im_context_free_im (NimfGtkIMContext *context)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  if (context->idle_timeout_id)
+  {
+    g_source_remove (context->idle_timeout_id);
+    context->idle_timeout_id = 0;
+  }
+
+  if (context->im)
+  {
+    g_signal_handlers_disconnect_by_data (context->im, context);
+    g_object_unref (context->im);
+    context->im = NULL;
+  }
+}
+
+static gboolean
+on_idle_timeout (NimfGtkIMContext *context)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  context->idle_timeout_id = 0;
+
+  if (context->im)
+  {
+    g_free (context->engine_id);
+    context->engine_id = nimf_im_get_engine_id (context->im);
+  }
+
+  nimf_gtk_im_context_free_im (context);
+
+  return G_SOURCE_REMOVE;
+}
+
 static void
 nimf_gtk_im_context_update_event_filter (NimfGtkIMContext *context)
 {
@@ -461,7 +617,7 @@ on_changed_always_use_preedit (GSettings        *settings,
   context->always_use_preedit =
     g_settings_get_boolean (context->settings, key);
 
-  if (context->always_use_preedit)
+  if (context->always_use_preedit && context->im)
     nimf_im_set_use_preedit (context->im, TRUE);
 }
 
@@ -470,21 +626,8 @@ nimf_gtk_im_context_init (NimfGtkIMContext *context)
 {
   g_debug (G_STRLOC ": %s", G_STRFUNC);
 
-  context->im = nimf_im_new ();
-  context->simple = gtk_im_context_simple_new ();
-
-  g_signal_connect (context->im, "commit",
-                    G_CALLBACK (on_commit), context);
-  g_signal_connect (context->im, "delete-surrounding",
-                    G_CALLBACK (on_delete_surrounding), context);
-  g_signal_connect (context->im, "preedit-changed",
-                    G_CALLBACK (on_preedit_changed), context);
-  g_signal_connect (context->im, "preedit-end",
-                    G_CALLBACK (on_preedit_end), context);
-  g_signal_connect (context->im, "preedit-start",
-                    G_CALLBACK (on_preedit_start), context);
-  g_signal_connect (context->im, "retrieve-surrounding",
-                    G_CALLBACK (on_retrieve_surrounding), context);
+  context->simple      = gtk_im_context_simple_new ();
+  context->use_preedit = TRUE;
 
   g_signal_connect (context->simple, "commit",
                     G_CALLBACK (on_commit), context);
@@ -533,7 +676,8 @@ nimf_gtk_im_context_finalize (GObject *object)
   if (context->has_event_filter)
     gdk_window_remove_filter (NULL, (GdkFilterFunc) on_gdk_x_event, context);
 
-  g_object_unref (context->im);
+  nimf_gtk_im_context_free_im (context);
+  g_free (context->engine_id);
   g_object_unref (context->simple);
   g_object_unref (context->settings);
 
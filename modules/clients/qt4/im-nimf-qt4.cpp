@@ -145,7 +145,12 @@ NimfInputContext::on_commit (NimfIM      *im,
   QString str = QString::fromUtf8 (text);
   QInputMethodEvent event;
   event.setCommitString (str);
+
+  NimfSpan span;
+
+  nimf_span_begin (&span);
   context->sendEvent (event);
+  nimf_span_end (&span, "qt4 commit", 0);
 }
 
 gboolean
@@ -302,6 +307,9 @@ NimfInputContext::filterEvent (const QEvent *event)
       return false;
   }
 
+  NimfSpan span;
+
+  nimf_span_begin (&span);
   nimf_event = nimf_event_new (type);
   nimf_event->key.state            = key_event->nativeModifiers  ();
   nimf_event->key.keyval           = key_event->nativeVirtualKey ();
@@ -309,6 +317,7 @@ NimfInputContext::filterEvent (const QEvent *event)
 
   retval = nimf_im_filter_event (m_im, nimf_event);
   nimf_event_free (nimf_event);
+  nimf_span_end (&span, "qt4 filterEvent", 0);
 
   return retval;
 }
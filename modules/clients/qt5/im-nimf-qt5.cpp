@@ -25,16 +25,21 @@
 #include <QtGui/qpa/qplatforminputcontextplugin_p.h>
 #include <QtWidgets/QApplication>
 #include <QtWidgets/QWidget>
+#include <QTimerEvent>
 #include <nimf.h>
 
+#define NIMF_QT5_IDLE_TIMEOUT 60000 /* ms out of focus */
+
+class NimfInputContext;
+
 class NimfEventHandler : public QObject
 {
   Q_OBJECT
 
 public:
-  NimfEventHandler(NimfIM *im)
+  NimfEventHandler(NimfInputContext *context)
   {
-    m_im = im;
+    m_context = context;
   };
 
   ~NimfEventHandler()
@@ -44,17 +49,9 @@ protected:
   bool eventFilter(QObject *obj, QEvent *event);
 
 private:
-  NimfIM *m_im;
+  NimfInputContext *m_context;
 };
 
-bool NimfEventHandler::eventFilter(QObject *obj, QEvent *event)
-{
-  if (event->type() == QEvent::MouseButtonPress)
-    nimf_im_reset (m_im);
-
-  return QObject::eventFilter(obj, event);
-}
-
 class NimfInputContext : public QPlatformInputContext
 {
   Q_OBJECT
@@ -97,13 +94,30 @@ public:
   static void on_changed_reset_on_mouse_button_press (GSettings *settings,
                                                       gchar     *key,
                                                       gpointer   user_data);
+protected:
+  virtual void timerEvent (QTimerEvent *event);
+
 private:
-  NimfIM           *m_im;
+  NimfIM *im ();
+  void    freeIM ();
+
+  NimfIM           *m_im; /* NULL until focused or fed a key */
+  gchar            *m_engine_id; /* of m_im when it was dropped */
   NimfRectangle     m_cursor_area;
+  bool              m_has_cursor_area;
+  int               m_idle_timer_id;
   GSettings        *m_settings;
   NimfEventHandler *m_handler;
 };
 
+bool NimfEventHandler::eventFilter(QObject *obj, QEvent *event)
+{
+  if (event->type() == QEvent::MouseButtonPress)
+    m_context->reset ();
+
+  return QObject::eventFilter(obj, event);
+}
+
 /* nimf signal callbacks */
 void
 NimfInputContext::on_preedit_start (NimfIM *im, gpointer user_data)
@@ -188,7 +202,11 @@ NimfInputContext::on_commit (NimfIM      *im,
   if (!obj)
     return;
 
+  NimfSpan span;
+
+  nimf_span_begin (&span);
   QCoreApplication::sendEvent (obj, &event);
+  nimf_span_end (&span, "qt5 commit", 0);
 }
 
 gboolean
@@ -221,7 +239,7 @@ NimfInputContext::on_changed_reset_on_mouse_button_press (GSettings *settings,
   {
     if (context->m_handler == NULL)
     {
-      context->m_handler = new NimfEventHandler(context->m_im);
+      context->m_handler = new NimfEventHandler(context);
       qApp->installEventFilter(context->m_handler);
     }
   }
@@ -241,6 +259,47 @@ NimfInputContext::NimfInputContext ()
   g_debug (G_STRLOC ": %s", G_STRFUNC);
 
   m_settings = g_settings_new ("org.nimf.clients.qt5");
+  m_im = NULL;
+  m_engine_id = NULL;
+  m_cursor_area.x      = 0;
+  m_cursor_area.y      = 0;
+  m_cursor_area.width  = 0;
+  m_cursor_area.height = 0;
+  m_has_cursor_area = false;
+  m_idle_timer_id   = 0;
+
+  g_signal_connect (m_settings, "changed::reset-on-mouse-button-press",
+                    G_CALLBACK (NimfInputContext::on_changed_reset_on_mouse_button_press), this);
+  m_handler = NULL;
+  g_signal_emit_by_name (m_settings, "changed::reset-on-mouse-button-press",
+                                     "reset-on-mouse-button-press");
+}
+
+NimfInputContext::~NimfInputContext ()
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  if (m_handler)
+    delete m_handler;
+
+  freeIM ();
+  g_free (m_engine_id);
+  g_object_unref (m_settings);
+}
+
+/*
+ * A nimf context costs a round trip and a server side input context, so
+ * it is made on the first focus in or key event and dropped again after
+ * a while out of focus.
+ */
+NimfIM *
+NimfInputContext::im ()
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  if (G_LIKELY (m_im))
+    return m_im;
+
   m_im = nimf_im_new ();
 
   g_signal_connect (m_im, "preedit-start",
@@ -258,22 +317,56 @@ NimfInputContext::NimfInputContext ()
                     G_CALLBACK (NimfInputContext::on_delete_surrounding),
                     this);
 
-  g_signal_connect (m_settings, "changed::reset-on-mouse-button-press",
-                    G_CALLBACK (NimfInputContext::on_changed_reset_on_mouse_button_press), this);
-  m_handler = NULL;
-  g_signal_emit_by_name (m_settings, "changed::reset-on-mouse-button-press",
-                                     "reset-on-mouse-button-press");
+  if (m_has_cursor_area)
+    nimf_im_set_cursor_location (m_im, &m_cursor_area);
+
+  if (m_engine_id)
+  {
+    nimf_im_set_engine_by_id (m_im, m_engine_id);
+    g_free (m_engine_id);
+    m_engine_id = NULL;
+  }
+
+  return m_im;
 }
 
-NimfInputContext::~NimfInputContext ()
+void
+NimfInputContext::freeIM ()
 {
   g_debug (G_STRLOC ": %s", G_STRFUNC);
 
-  if (m_handler)
-    delete m_handler;
+  if (m_idle_timer_id)
+  {
+    killTimer (m_idle_timer_id);
+    m_idle_timer_id = 0;
+  }
 
-  g_object_unref (m_im);
-  g_object_unref (m_settings);
+  if (m_im)
+  {
+    g_signal_handlers_disconnect_by_data (m_im, this);
+    g_object_unref (m_im);
+    m_im = NULL;
+  }
+}
+
+void
+NimfInputContext::timerEvent (QTimerEvent *event)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  if (event->timerId () == m_idle_timer_id)
+  {
+    /* there is one context per application, keep its input mode */
+    if (m_im)
+    {
+      g_free (m_engine_id);
+      m_engine_id = nimf_im_get_engine_id (m_im);
+    }
+
+    freeIM ();
+  }
+  else
+    QPlatformInputContext::timerEvent (event);
 }
 
 bool
@@ -287,14 +380,18 @@ void
 NimfInputContext::reset ()
 {
   g_debug (G_STRLOC ": %s", G_STRFUNC);
-  nimf_im_reset (m_im);
+
+  if (m_im)
+    nimf_im_reset (m_im);
 }
 
 void
 NimfInputContext::commit ()
 {
   g_debug (G_STRLOC ": %s", G_STRFUNC);
-  nimf_im_reset (m_im);
+
+  if (m_im)
+    nimf_im_reset (m_im);
 }
 
 void
@@ -322,8 +419,10 @@ NimfInputContext::update (Qt::InputMethodQueries queries) /* FIXME */
       m_cursor_area.y      = rect.y ();
       m_cursor_area.width  = rect.width ();
       m_cursor_area.height = rect.height ();
+      m_has_cursor_area    = true;
 
-      nimf_im_set_cursor_location (m_im, &m_cursor_area);
+      if (m_im)
+        nimf_im_set_cursor_location (m_im, &m_cursor_area);
     }
   }
 }
@@ -361,13 +460,17 @@ NimfInputContext::filterEvent (const QEvent *event)
       return false;
   }
 
+  NimfSpan span;
+
+  nimf_span_begin (&span);
   nimf_event = nimf_event_new (type);
   nimf_event->key.state            = key_event->nativeModifiers  ();
   nimf_event->key.keyval           = key_event->nativeVirtualKey ();
   nimf_event->key.hardware_keycode = key_event->nativeScanCode   (); /* FIXME: guint16 quint32 */
 
-  retval = nimf_im_filter_event (m_im, nimf_event);
+  retval = nimf_im_filter_event (im (), nimf_event);
   nimf_event_free (nimf_event);
+  nimf_span_end (&span, "qt5 filterEvent", 0);
 
   return retval;
 }
@@ -424,13 +527,26 @@ NimfInputContext::setFocusObject (QObject *object)
 {
   g_debug (G_STRLOC ": %s", G_STRFUNC);
 
-  if (!object || !inputMethodAccepted())
+  if ((!object || !inputMethodAccepted()) && m_im)
+  {
     nimf_im_focus_out (m_im);
 
+    if (m_idle_timer_id == 0)
+      m_idle_timer_id = startTimer (NIMF_QT5_IDLE_TIMEOUT);
+  }
+
   QPlatformInputContext::setFocusObject (object);
 
   if (object && inputMethodAccepted())
-    nimf_im_focus_in (m_im);
+  {
+    if (m_idle_timer_id)
+    {
+      killTimer (m_idle_timer_id);
+      m_idle_timer_id = 0;
+    }
+
+    nimf_im_focus_in (im ());
+  }
 
   update (Qt::ImCursorRectangle);
 }
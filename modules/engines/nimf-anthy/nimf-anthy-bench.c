@@ -0,0 +1,154 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 2; tab-width: 2 -*- */
+/*
+ * nimf-anthy-bench.c
+ * This file is part of Nimf.
+ *
+ * Copyright (C) 2017 Hodong Kim <cogniti@gmail.com>
+ *
+ * Nimf is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Nimf is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program;  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Walks through every segment of a long input with the Right key, the
+ * way nimf-anthy did before and after NimfAnthyConversion, and prints
+ * the time taken.  Build with "make nimf-anthy-bench".
+ */
+
+#include "nimf-anthy-conversion.h"
+#include <stdlib.h>
+
+#define PAGE_SIZE 10
+
+static const gchar *default_sentence = "きょうはとてもいいてんきなので、"
+                                       "ともだちとこうえんへさんぽにいきました。";
+
+/* the old nimf_anthy_update_candidate (): convert and walk the stats again */
+static gint64
+bench_reconvert (anthy_context_t  context,
+                 const gchar     *text,
+                 gint             n_passes)
+{
+  struct anthy_conv_stat    conv_stat;
+  struct anthy_segment_stat segment_stat;
+  gchar   buffer[256];
+  gint64  start = g_get_monotonic_time ();
+  gint    pass, index, i;
+
+  for (pass = 0; pass < n_passes; pass++)
+  {
+    index = 0;
+
+    do {
+      anthy_set_string (context, text);
+      anthy_get_stat (context, &conv_stat);
+
+      for (i = 0; i < index; i++)
+        anthy_get_segment_stat (context, i, &segment_stat);
+
+      anthy_get_segment_stat (context, index, &segment_stat);
+
+      for (i = 0; i < MIN (PAGE_SIZE, segment_stat.nr_candidate); i++)
+        anthy_get_segment (context, index, i, buffer, sizeof (buffer));
+    } while (++index < conv_stat.nr_segment);
+  }
+
+  return g_get_monotonic_time () - start;
+}
+
+static gint64
+bench_incremental (const gchar *text,
+                   gint         n_passes)
+{
+  NimfAnthyConversion *conversion = nimf_anthy_conversion_new ();
+  gint64 start = g_get_monotonic_time ();
+  gint   pass, index, i;
+
+  for (pass = 0; pass < n_passes; pass++)
+  {
+    index = 0;
+
+    do {
+      const struct anthy_segment_stat *stat;
+
+      nimf_anthy_conversion_set_string (conversion, text);
+      nimf_anthy_conversion_get_offset (conversion, index);
+      stat = nimf_anthy_conversion_get_segment_stat (conversion, index);
+
+      if (stat == NULL)
+        break;
+
+      for (i = 0; i < MIN (PAGE_SIZE, stat->nr_candidate); i++)
+        nimf_anthy_conversion_get_candidate (conversion, index, i);
+    } while (++index < nimf_anthy_conversion_get_n_segments (conversion));
+  }
+
+  nimf_anthy_conversion_free (conversion);
+
+  return g_get_monotonic_time () - start;
+}
+
+int
+main (int argc, char **argv)
+{
+  anthy_context_t context;
+  GString        *text;
+  gint            n_repeats = 8;
+  gint            n_passes  = 3;
+  gint            i;
+
+  GOptionContext *option_context;
+  GOptionEntry    entries[] = {
+    {"repeats", 'r', 0, G_OPTION_ARG_INT, &n_repeats, "Times to repeat the sentence", "N"},
+    {"passes",  'p', 0, G_OPTION_ARG_INT, &n_passes,  "Walks through all segments", "N"},
+    {NULL}
+  };
+
+  option_context = g_option_context_new ("[SENTENCE] - Benchmark nimf-anthy conversion");
+  g_option_context_add_main_entries (option_context, entries, NULL);
+
+  if (!g_option_context_parse (option_context, &argc, &argv, NULL))
+  {
+    g_option_context_free (option_context);
+    return EXIT_FAILURE;
+  }
+
+  g_option_context_free (option_context);
+
+  if (anthy_init () < 0)
+  {
+    g_printerr ("anthy is not initialized\n");
+    return EXIT_FAILURE;
+  }
+
+  context = anthy_create_context ();
+  anthy_context_set_encoding (context, ANTHY_UTF8_ENCODING);
+
+  text = g_string_new (NULL);
+
+  for (i = 0; i < MAX (n_repeats, 1); i++)
+    g_string_append (text, argc > 1 ? argv[1] : default_sentence);
+
+  g_print ("%ld characters, %d passes\n",
+           g_utf8_strlen (text->str, -1), n_passes);
+  g_print ("reconvert:   %8.1f ms\n",
+           bench_reconvert (context, text->str, n_passes) / 1000.0);
+  g_print ("incremental: %8.1f ms\n",
+           bench_incremental (text->str, n_passes) / 1000.0);
+
+  g_string_free (text, TRUE);
+  anthy_release_context (context);
+  anthy_quit ();
+
+  return EXIT_SUCCESS;
+}
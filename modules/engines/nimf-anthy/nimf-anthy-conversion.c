@@ -0,0 +1,263 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 2; tab-width: 2 -*- */
+/*
+ * nimf-anthy-conversion.c
+ * This file is part of Nimf.
+ *
+ * Copyright (C) 2017 Hodong Kim <cogniti@gmail.com>
+ *
+ * Nimf is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Nimf is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program;  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "nimf-anthy-conversion.h"
+#include <string.h>
+
+#define NIMF_ANTHY_BUFFER_SIZE  256
+
+/* anthy keeps global state; contexts of different threads share this lock */
+static GMutex nimf_anthy_mutex;
+
+typedef struct
+{
+  struct anthy_segment_stat stat;
+  gint                      offset;     /* in characters */
+  GPtrArray                *candidates; /* filled on demand */
+} NimfAnthySegment;
+
+/*
+ * Remembers the string last given to anthy_set_string (), so moving
+ * between segments doesn't convert again, with the stats, offsets and
+ * fetched candidates of its segments.  Everything is dropped when the
+ * string changes, since anthy may split the whole string differently.
+ */
+struct _NimfAnthyConversion
+{
+  anthy_context_t  context;
+  gchar           *string;
+  GArray          *segments;
+};
+
+static void
+nimf_anthy_segment_clear (NimfAnthySegment *segment)
+{
+  if (segment->candidates)
+    g_ptr_array_unref (segment->candidates);
+}
+
+NimfAnthyConversion *
+nimf_anthy_conversion_new ()
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  NimfAnthyConversion *conversion = g_slice_new0 (NimfAnthyConversion);
+
+  g_mutex_lock (&nimf_anthy_mutex);
+  /* FIXME */
+  /* anthy_set_personality () */
+  conversion->context = anthy_create_context ();
+  anthy_context_set_encoding (conversion->context, ANTHY_UTF8_ENCODING);
+  g_mutex_unlock (&nimf_anthy_mutex);
+
+  conversion->segments = g_array_new (FALSE, TRUE, sizeof (NimfAnthySegment));
+  g_array_set_clear_func (conversion->segments,
+                          (GDestroyNotify) nimf_anthy_segment_clear);
+
+  return conversion;
+}
+
+void
+nimf_anthy_conversion_free (NimfAnthyConversion *conversion)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  g_mutex_lock (&nimf_anthy_mutex);
+  anthy_release_context (conversion->context);
+  g_mutex_unlock (&nimf_anthy_mutex);
+
+  g_array_free (conversion->segments, TRUE);
+  g_free (conversion->string);
+  g_slice_free (NimfAnthyConversion, conversion);
+}
+
+static void
+nimf_anthy_conversion_invalidate (NimfAnthyConversion *conversion)
+{
+  g_free (conversion->string);
+  conversion->string = NULL;
+  g_array_set_size (conversion->segments, 0);
+}
+
+void
+nimf_anthy_conversion_reset (NimfAnthyConversion *conversion)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  g_mutex_lock (&nimf_anthy_mutex);
+  anthy_reset_context (conversion->context);
+  g_mutex_unlock (&nimf_anthy_mutex);
+
+  nimf_anthy_conversion_invalidate (conversion);
+}
+
+/* returns TRUE if @string was converted, FALSE if it was already */
+gboolean
+nimf_anthy_conversion_set_string (NimfAnthyConversion *conversion,
+                                  const gchar         *string)
+{
+  return nimf_anthy_conversion_set_string_unless (conversion, string,
+                                                  NULL, NULL);
+}
+
+/*
+ * Like nimf_anthy_conversion_set_string (), but gives up, leaving nothing
+ * converted, if @stop returns TRUE before one of its anthy calls.  anthy
+ * can't be interrupted inside a call, but a conversion nobody wants any
+ * more doesn't keep the lock past the call it is in.
+ */
+gboolean
+nimf_anthy_conversion_set_string_unless (NimfAnthyConversion *conversion,
+                                         const gchar         *string,
+                                         NimfAnthyStopFunc    stop,
+                                         gpointer             user_data)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  struct anthy_conv_stat conv_stat;
+  gint offset = 0;
+  gint i;
+
+  if (g_strcmp0 (conversion->string, string) == 0)
+    return FALSE;
+
+  nimf_anthy_conversion_invalidate (conversion);
+  g_mutex_lock (&nimf_anthy_mutex);
+
+  if ((stop && stop (user_data)) ||
+      anthy_set_string (conversion->context, string) != 0)
+  {
+    g_mutex_unlock (&nimf_anthy_mutex);
+    return TRUE;
+  }
+
+  if ((stop && stop (user_data)) ||
+      anthy_get_stat (conversion->context, &conv_stat) != 0)
+  {
+    g_mutex_unlock (&nimf_anthy_mutex);
+    return TRUE;
+  }
+
+  conversion->string = g_strdup (string);
+  g_array_set_size (conversion->segments, MAX (conv_stat.nr_segment, 0));
+
+  for (i = 0; i < (gint) conversion->segments->len; i++)
+  {
+    NimfAnthySegment *segment = &g_array_index (conversion->segments,
+                                                NimfAnthySegment, i);
+
+    anthy_get_segment_stat (conversion->context, i, &segment->stat);
+    segment->offset = offset;
+    offset += segment->stat.seg_len;
+  }
+
+  g_mutex_unlock (&nimf_anthy_mutex);
+
+  return TRUE;
+}
+
+const gchar *
+nimf_anthy_conversion_get_string (NimfAnthyConversion *conversion)
+{
+  return conversion->string;
+}
+
+gint
+nimf_anthy_conversion_get_n_segments (NimfAnthyConversion *conversion)
+{
+  return conversion->segments->len;
+}
+
+static NimfAnthySegment *
+nimf_anthy_conversion_get_segment (NimfAnthyConversion *conversion,
+                                   gint                 segment)
+{
+  if (segment < 0 || segment >= (gint) conversion->segments->len)
+    return NULL;
+
+  return &g_array_index (conversion->segments, NimfAnthySegment, segment);
+}
+
+const struct anthy_segment_stat *
+nimf_anthy_conversion_get_segment_stat (NimfAnthyConversion *conversion,
+                                        gint                 segment)
+{
+  NimfAnthySegment *seg = nimf_anthy_conversion_get_segment (conversion,
+                                                             segment);
+  return seg ? &seg->stat : NULL;
+}
+
+gint
+nimf_anthy_conversion_get_offset (NimfAnthyConversion *conversion,
+                                  gint                 segment)
+{
+  NimfAnthySegment *seg = nimf_anthy_conversion_get_segment (conversion,
+                                                             segment);
+  return seg ? seg->offset : 0;
+}
+
+const gchar *
+nimf_anthy_conversion_get_candidate (NimfAnthyConversion *conversion,
+                                     gint                 segment,
+                                     gint                 index)
+{
+  NimfAnthySegment *seg = nimf_anthy_conversion_get_segment (conversion,
+                                                             segment);
+  gchar buffer[NIMF_ANTHY_BUFFER_SIZE];
+
+  if (seg == NULL || index < 0 || index >= seg->stat.nr_candidate)
+    return NULL;
+
+  if (seg->candidates == NULL)
+  {
+    seg->candidates = g_ptr_array_new_with_free_func (g_free);
+    g_ptr_array_set_size (seg->candidates, seg->stat.nr_candidate);
+  }
+
+  if (g_ptr_array_index (seg->candidates, index) == NULL)
+  {
+    g_mutex_lock (&nimf_anthy_mutex);
+
+    if (anthy_get_segment (conversion->context, segment, index,
+                           buffer, NIMF_ANTHY_BUFFER_SIZE) < 0)
+      buffer[0] = '\0';
+
+    g_mutex_unlock (&nimf_anthy_mutex);
+    g_ptr_array_index (seg->candidates, index) = g_strdup (buffer);
+  }
+
+  return g_ptr_array_index (seg->candidates, index);
+}
+
+void
+nimf_anthy_conversion_commit_segment (NimfAnthyConversion *conversion,
+                                      gint                 segment,
+                                      gint                 index)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  if (nimf_anthy_conversion_get_segment (conversion, segment))
+  {
+    g_mutex_lock (&nimf_anthy_mutex);
+    anthy_commit_segment (conversion->context, segment, index);
+    g_mutex_unlock (&nimf_anthy_mutex);
+  }
+}
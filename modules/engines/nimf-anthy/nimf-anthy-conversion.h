@@ -0,0 +1,60 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 2; tab-width: 2 -*- */
+/*
+ * nimf-anthy-conversion.h
+ * This file is part of Nimf.
+ *
+ * Copyright (C) 2017 Hodong Kim <cogniti@gmail.com>
+ *
+ * Nimf is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Nimf is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program;  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __NIMF_ANTHY_CONVERSION_H__
+#define __NIMF_ANTHY_CONVERSION_H__
+
+#include <glib.h>
+#include <anthy/anthy.h>
+
+G_BEGIN_DECLS
+
+typedef struct _NimfAnthyConversion NimfAnthyConversion;
+
+typedef gboolean (* NimfAnthyStopFunc) (gpointer user_data);
+
+NimfAnthyConversion *nimf_anthy_conversion_new   (void);
+void         nimf_anthy_conversion_free          (NimfAnthyConversion *conversion);
+void         nimf_anthy_conversion_reset         (NimfAnthyConversion *conversion);
+gboolean     nimf_anthy_conversion_set_string    (NimfAnthyConversion *conversion,
+                                                  const gchar         *string);
+gboolean     nimf_anthy_conversion_set_string_unless
+                                                 (NimfAnthyConversion *conversion,
+                                                  const gchar         *string,
+                                                  NimfAnthyStopFunc    stop,
+                                                  gpointer             user_data);
+const gchar *nimf_anthy_conversion_get_string    (NimfAnthyConversion *conversion);
+gint         nimf_anthy_conversion_get_n_segments (NimfAnthyConversion *conversion);
+const struct anthy_segment_stat *
+             nimf_anthy_conversion_get_segment_stat (NimfAnthyConversion *conversion,
+                                                     gint                 segment);
+gint         nimf_anthy_conversion_get_offset    (NimfAnthyConversion *conversion,
+                                                  gint                 segment);
+const gchar *nimf_anthy_conversion_get_candidate (NimfAnthyConversion *conversion,
+                                                  gint                 segment,
+                                                  gint                 index);
+void         nimf_anthy_conversion_commit_segment (NimfAnthyConversion *conversion,
+                                                   gint                 segment,
+                                                   gint                 index);
+
+G_END_DECLS
+
+#endif /* __NIMF_ANTHY_CONVERSION_H__ */
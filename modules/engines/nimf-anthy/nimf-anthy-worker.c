@@ -0,0 +1,255 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 2; tab-width: 2 -*- */
+/*
+ * nimf-anthy-worker.c
+ * This file is part of Nimf.
+ *
+ * Copyright (C) 2017 Hodong Kim <cogniti@gmail.com>
+ *
+ * Nimf is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Nimf is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program;  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "nimf-anthy-worker.h"
+
+#define NIMF_ANTHY_WORKER_DELAY      200 /* ms without typing */
+#define NIMF_ANTHY_WORKER_N_PREFETCH 10  /* the first candidate page */
+
+typedef struct
+{
+  NimfAnthyWorker *worker;
+  gchar           *string;
+  guint            generation;
+} NimfAnthyJob;
+
+/*
+ * Converts the preedit on a pool thread, with a conversion of its own,
+ * once typing pauses.  A job only counts if its generation is still the
+ * current one when it finishes; nimf_anthy_worker_schedule () and
+ * nimf_anthy_worker_cancel () bump the generation.  anthy can't be
+ * interrupted inside a call, so a stale job stops at the next anthy call
+ * and what it did is thrown away.
+ */
+struct _NimfAnthyWorker
+{
+  GThreadPool         *pool;
+  GMutex               mutex;
+  GCond                cond;
+  NimfAnthyConversion *conversion; /* used by the pool thread */
+  gchar               *string;     /* of the current generation */
+  guint                generation;
+  gboolean             running;
+  gboolean             ready;      /* conversion holds string */
+  guint                timeout_id; /* used in the main thread only */
+};
+
+static void
+nimf_anthy_job_free (NimfAnthyJob *job)
+{
+  g_free (job->string);
+  g_slice_free (NimfAnthyJob, job);
+}
+
+static gboolean
+nimf_anthy_job_is_stale (NimfAnthyJob *job)
+{
+  return g_atomic_int_get (&job->worker->generation) != job->generation;
+}
+
+static void
+nimf_anthy_worker_run (NimfAnthyJob    *job,
+                       NimfAnthyWorker *worker)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  const struct anthy_segment_stat *stat;
+  gint i;
+
+  g_mutex_lock (&worker->mutex);
+
+  if (job->generation != worker->generation)
+  {
+    g_mutex_unlock (&worker->mutex);
+    nimf_anthy_job_free (job);
+    return;
+  }
+
+  worker->running = TRUE;
+  g_mutex_unlock (&worker->mutex);
+
+  nimf_anthy_conversion_set_string_unless (worker->conversion, job->string,
+                                           (NimfAnthyStopFunc) nimf_anthy_job_is_stale,
+                                           job);
+  stat = nimf_anthy_conversion_get_segment_stat (worker->conversion, 0);
+
+  for (i = 0; stat && i < MIN (NIMF_ANTHY_WORKER_N_PREFETCH, stat->nr_candidate); i++)
+  {
+    if (nimf_anthy_job_is_stale (job))
+      break;
+
+    nimf_anthy_conversion_get_candidate (worker->conversion, 0, i);
+  }
+
+  g_mutex_lock (&worker->mutex);
+  worker->running = FALSE;
+  worker->ready   = job->generation == worker->generation;
+  g_cond_broadcast (&worker->cond);
+  g_mutex_unlock (&worker->mutex);
+
+  nimf_anthy_job_free (job);
+}
+
+NimfAnthyWorker *
+nimf_anthy_worker_new ()
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  NimfAnthyWorker *worker = g_slice_new0 (NimfAnthyWorker);
+
+  g_mutex_init (&worker->mutex);
+  g_cond_init  (&worker->cond);
+  worker->conversion = nimf_anthy_conversion_new ();
+  worker->pool = g_thread_pool_new ((GFunc) nimf_anthy_worker_run, worker,
+                                    1, FALSE, NULL);
+  return worker;
+}
+
+/* the caller holds the mutex */
+static void
+nimf_anthy_worker_drop (NimfAnthyWorker *worker)
+{
+  g_atomic_int_inc (&worker->generation);
+  worker->ready = FALSE;
+  g_free (worker->string);
+  worker->string = NULL;
+}
+
+void
+nimf_anthy_worker_cancel (NimfAnthyWorker *worker)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  if (worker->timeout_id)
+  {
+    g_source_remove (worker->timeout_id);
+    worker->timeout_id = 0;
+  }
+
+  g_mutex_lock (&worker->mutex);
+  nimf_anthy_worker_drop (worker);
+  g_mutex_unlock (&worker->mutex);
+}
+
+void
+nimf_anthy_worker_free (NimfAnthyWorker *worker)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  /* queued jobs become stale and return at once */
+  nimf_anthy_worker_cancel (worker);
+  g_thread_pool_free (worker->pool, FALSE, TRUE);
+
+  nimf_anthy_conversion_free (worker->conversion);
+  g_free (worker->string);
+  g_mutex_clear (&worker->mutex);
+  g_cond_clear  (&worker->cond);
+  g_slice_free (NimfAnthyWorker, worker);
+}
+
+static gboolean
+on_timeout (NimfAnthyWorker *worker)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  NimfAnthyJob *job = g_slice_new (NimfAnthyJob);
+
+  worker->timeout_id = 0;
+
+  g_mutex_lock (&worker->mutex);
+  job->worker     = worker;
+  job->string     = g_strdup (worker->string);
+  job->generation = worker->generation;
+  g_mutex_unlock (&worker->mutex);
+
+  g_thread_pool_push (worker->pool, job, NULL);
+
+  return G_SOURCE_REMOVE;
+}
+
+/* converts @string once nothing else is scheduled for a while */
+void
+nimf_anthy_worker_schedule (NimfAnthyWorker *worker,
+                            const gchar     *string)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  g_mutex_lock (&worker->mutex);
+
+  if (g_strcmp0 (worker->string, string) == 0)
+  {
+    g_mutex_unlock (&worker->mutex);
+    return;
+  }
+
+  nimf_anthy_worker_drop (worker);
+  worker->string = g_strdup (string);
+  g_mutex_unlock (&worker->mutex);
+
+  if (worker->timeout_id)
+    g_source_remove (worker->timeout_id);
+
+  worker->timeout_id = g_timeout_add (NIMF_ANTHY_WORKER_DELAY,
+                                      (GSourceFunc) on_timeout, worker);
+}
+
+/*
+ * If @string has been converted, swaps *@conversion for the result and
+ * returns TRUE.  Waits if @string is being converted, since that ends
+ * sooner than converting it again.  Anything scheduled is cancelled.
+ */
+gboolean
+nimf_anthy_worker_take (NimfAnthyWorker      *worker,
+                        const gchar          *string,
+                        NimfAnthyConversion **conversion)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  gboolean retval = FALSE;
+
+  if (worker->timeout_id)
+  {
+    g_source_remove (worker->timeout_id);
+    worker->timeout_id = 0;
+  }
+
+  g_mutex_lock (&worker->mutex);
+
+  if (g_strcmp0 (worker->string, string) == 0)
+  {
+    while (worker->running)
+      g_cond_wait (&worker->cond, &worker->mutex);
+
+    if (worker->ready)
+    {
+      NimfAnthyConversion *tmp = *conversion;
+
+      *conversion        = worker->conversion;
+      worker->conversion = tmp;
+      retval = TRUE;
+    }
+  }
+
+  nimf_anthy_worker_drop (worker);
+  g_mutex_unlock (&worker->mutex);
+
+  return retval;
+}
@@ -0,0 +1,43 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 2; tab-width: 2 -*- */
+/*
+ * nimf-anthy-worker.h
+ * This file is part of Nimf.
+ *
+ * Copyright (C) 2017 Hodong Kim <cogniti@gmail.com>
+ *
+ * Nimf is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Nimf is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program;  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __NIMF_ANTHY_WORKER_H__
+#define __NIMF_ANTHY_WORKER_H__
+
+#include <glib.h>
+#include "nimf-anthy-conversion.h"
+
+G_BEGIN_DECLS
+
+typedef struct _NimfAnthyWorker NimfAnthyWorker;
+
+NimfAnthyWorker *nimf_anthy_worker_new      (void);
+void             nimf_anthy_worker_free     (NimfAnthyWorker      *worker);
+void             nimf_anthy_worker_schedule (NimfAnthyWorker      *worker,
+                                             const gchar          *string);
+void             nimf_anthy_worker_cancel   (NimfAnthyWorker      *worker);
+gboolean         nimf_anthy_worker_take     (NimfAnthyWorker      *worker,
+                                             const gchar          *string,
+                                             NimfAnthyConversion **conversion);
+
+G_END_DECLS
+
+#endif /* __NIMF_ANTHY_WORKER_H__ */
@@ -22,6 +22,8 @@
 #include <nimf.h>
 #include <anthy/anthy.h>
 #include <glib/gi18n.h>
+#include "nimf-anthy-conversion.h"
+#include "nimf-anthy-worker.h"
 
 #define NIMF_TYPE_ANTHY             (nimf_anthy_get_type ())
 #define NIMF_ANTHY(obj)             (G_TYPE_CHECK_INSTANCE_CAST ((obj), NIMF_TYPE_ANTHY, NimfAnthy))
@@ -30,8 +32,6 @@
 #define NIMF_IS_ANTHY_CLASS(klass)  (G_TYPE_CHECK_CLASS_TYPE ((klass), NIMF_TYPE_ANTHY))
 #define NIMF_ANTHY_GET_CLASS(obj)   (G_TYPE_INSTANCE_GET_CLASS ((obj), NIMF_TYPE_ANTHY, NimfAnthyClass))
 
-#define NIMF_ANTHY_BUFFER_SIZE  256
-
 typedef struct _NimfAnthy      NimfAnthy;
 typedef struct _NimfAnthyClass NimfAnthyClass;
 
@@ -47,13 +47,10 @@ struct _NimfAnthy
   glong             offset;
   gchar            *id;
 
-  anthy_context_t           context;
-  struct anthy_conv_stat    conv_stat;
+  NimfAnthyConversion      *conversion;
+  NimfAnthyWorker          *worker;
   struct anthy_segment_stat segment_stat;
   gint                      segment_index;
-  gchar                     buffer[NIMF_ANTHY_BUFFER_SIZE];
-  gint                      current_page;
-  gint                      n_pages;
 };
 
 struct _NimfAnthyClass
@@ -63,7 +60,7 @@ struct _NimfAnthyClass
 };
 
 static gint        nimf_anthy_ref_count = 0;
-static GHashTable *nimf_anthy_romaji = NULL;;
+static NimfRomaji  *nimf_anthy_romaji = NULL;
 
 G_DEFINE_DYNAMIC_TYPE (NimfAnthy, nimf_anthy, NIMF_TYPE_ENGINE);
 
@@ -122,7 +119,8 @@ void nimf_anthy_reset (NimfEngine    *engine,
     g_free (commit_str);
   }
 
-  anthy_reset_context (NIMF_ANTHY (engine)->context);
+  nimf_anthy_worker_cancel (anthy->worker);
+  nimf_anthy_conversion_reset (anthy->conversion);
 }
 
 void
@@ -142,14 +140,6 @@ nimf_anthy_focus_out (NimfEngine    *engine,
   nimf_anthy_reset (engine, target);
 }
 
-static gint
-nimf_anthy_get_current_page (NimfEngine *engine)
-{
-  g_debug (G_STRLOC ": %s", G_STRFUNC);
-
-  return NIMF_ANTHY (engine)->current_page;
-}
-
 static void
 on_candidate_clicked (NimfEngine    *engine,
                       NimfServiceIM *target,
@@ -183,7 +173,8 @@ on_candidate_clicked (NimfEngine    *engine,
   nimf_anthy_update_preedit (engine, target, new_preedit,
                              g_utf8_strlen (anthy->preedit1->str, -1));
   nimf_candidate_hide_window (anthy->candidate);
-  anthy_commit_segment (anthy->context, anthy->segment_index, index);
+  nimf_anthy_conversion_commit_segment (anthy->conversion,
+                                        anthy->segment_index, index);
 
   g_free (sub1);
   g_free (sub2);
@@ -191,172 +182,84 @@ on_candidate_clicked (NimfEngine    *engine,
 }
 
 static void
-nimf_anthy_update_page (NimfEngine    *engine,
-                        NimfServiceIM *target)
+nimf_anthy_fill_candidates (NimfAnthy         *anthy,
+                            gint               offset,
+                            gint               n_items,
+                            NimfCandidateItem *items)
 {
   g_debug (G_STRLOC ": %s", G_STRFUNC);
 
-  NimfAnthy *anthy = NIMF_ANTHY (engine);
-
   gint i;
 
-  anthy->n_pages = (anthy->segment_stat.nr_candidate + 9) / 10;
-  nimf_candidate_clear (anthy->candidate, target);
-
-  for (i = (anthy->current_page - 1) * 10;
-       i < MIN (anthy->current_page * 10, anthy->segment_stat.nr_candidate);
-       i++)
+  for (i = 0; i < n_items; i++)
   {
-    anthy_get_segment (anthy->context, anthy->segment_index, i,
-                       anthy->buffer, NIMF_ANTHY_BUFFER_SIZE);
-    nimf_candidate_append (anthy->candidate, anthy->buffer, NULL);
-  }
-
-  nimf_candidate_select_first_item_in_page (anthy->candidate);
-  nimf_candidate_set_page_values (anthy->candidate, target,
-                                  anthy->current_page, anthy->n_pages, 10);
-}
-
-static gboolean
-nimf_anthy_page_up (NimfEngine *engine, NimfServiceIM *target)
-{
-  g_debug (G_STRLOC ": %s", G_STRFUNC);
-
-  NimfAnthy *anthy = NIMF_ANTHY (engine);
+    const gchar *text;
 
-  if (anthy->current_page <= 1)
-  {
-    nimf_candidate_select_first_item_in_page (anthy->candidate);
-    return FALSE;
+    text = nimf_anthy_conversion_get_candidate (anthy->conversion,
+                                                anthy->segment_index,
+                                                offset + i);
+    items[i].text = g_strdup (text);
   }
-
-  anthy->current_page--;
-  nimf_anthy_update_page (engine, target);
-  nimf_candidate_select_last_item_in_page (anthy->candidate);
-
-  return TRUE;
-}
-
-static gboolean
-nimf_anthy_page_down (NimfEngine *engine, NimfServiceIM *target)
-{
-  g_debug (G_STRLOC ": %s", G_STRFUNC);
-
-  NimfAnthy *anthy = NIMF_ANTHY (engine);
-
-  if (anthy->current_page == anthy->n_pages)
-  {
-    nimf_candidate_select_last_item_in_page (anthy->candidate);
-    return FALSE;
-  }
-
-  anthy->current_page++;
-  nimf_anthy_update_page (engine, target);
-  nimf_candidate_select_first_item_in_page (anthy->candidate);
-
-  return TRUE;
 }
 
 static void
-nimf_anthy_page_home (NimfEngine *engine, NimfServiceIM *target)
-{
-  g_debug (G_STRLOC ": %s", G_STRFUNC);
-
-  NimfAnthy *anthy = NIMF_ANTHY (engine);
-
-  if (anthy->current_page <= 1)
-  {
-    nimf_candidate_select_first_item_in_page (anthy->candidate);
-    return;
-  }
-
-  anthy->current_page = 1;
-  nimf_anthy_update_page (engine, target);
-  nimf_candidate_select_first_item_in_page (anthy->candidate);
-}
-
-static void
-nimf_anthy_page_end (NimfEngine *engine, NimfServiceIM *target)
+nimf_anthy_update_candidate (NimfEngine    *engine,
+                             NimfServiceIM *target,
+                             NimfEvent     *event)
 {
   g_debug (G_STRLOC ": %s", G_STRFUNC);
 
   NimfAnthy *anthy = NIMF_ANTHY (engine);
+  gint       n_segments;
 
-  if (anthy->current_page == anthy->n_pages)
+  /* converts only if preedit1 changed since the last time */
+  if (g_strcmp0 (nimf_anthy_conversion_get_string (anthy->conversion),
+                 anthy->preedit1->str) != 0)
   {
-    nimf_candidate_select_last_item_in_page (anthy->candidate);
-    return;
-  }
+    NimfSpan     span;
+    const gchar *name;
+    gint64       start = g_get_monotonic_time ();
 
-  anthy->current_page = anthy->n_pages;
-  nimf_anthy_update_page (engine, target);
-  nimf_candidate_select_last_item_in_page (anthy->candidate);
-}
-
-static void
-on_candidate_scrolled (NimfEngine    *engine,
-                       NimfServiceIM *target,
-                       gdouble        value)
-{
-  g_debug (G_STRLOC ": %s", G_STRFUNC);
-
-  NimfAnthy *anthy = NIMF_ANTHY (engine);
+    nimf_span_begin (&span);
 
-  if ((gint) value == nimf_anthy_get_current_page (engine))
-    return;
+    if (nimf_anthy_worker_take (anthy->worker, anthy->preedit1->str,
+                                &anthy->conversion))
+    {
+      name = "anthy conversion (ready)";
+    }
+    else
+    {
+      nimf_anthy_conversion_set_string (anthy->conversion, anthy->preedit1->str);
+      name = "anthy conversion";
+    }
 
-  while (anthy->n_pages > 1)
-  {
-    gint d = (gint) value - nimf_anthy_get_current_page (engine);
-
-    if (d > 0)
-      nimf_anthy_page_down (engine, target);
-    else if (d < 0)
-      nimf_anthy_page_up (engine, target);
-    else if (d == 0)
-      break;
+    nimf_span_end (&span, name, target->icid);
+    g_debug (G_STRLOC ": %s: %s took %" G_GINT64_FORMAT " us", G_STRFUNC,
+             name, g_get_monotonic_time () - start);
   }
-}
-
-static void
-nimf_anthy_update_candidate (NimfEngine    *engine,
-                             NimfServiceIM *target,
-                             NimfEvent     *event)
-{
-  g_debug (G_STRLOC ": %s", G_STRFUNC);
-
-  NimfAnthy *anthy = NIMF_ANTHY (engine);
-  gint       i;
-
-  anthy_set_string (anthy->context, anthy->preedit1->str);
-  anthy_get_stat (anthy->context, &anthy->conv_stat);
 
-  /* calculate offset */
-  anthy->offset = 0;
+  n_segments = nimf_anthy_conversion_get_n_segments (anthy->conversion);
 
-  for (i = 0; i < anthy->segment_index; i++)
-  {
-    anthy_get_segment_stat (anthy->context, i, &anthy->segment_stat);
-    anthy->offset += anthy->segment_stat.seg_len;
-  }
+  if (anthy->segment_index >= n_segments)
+    anthy->segment_index = 0;
 
-  if (anthy->conv_stat.nr_segment > 0)
+  anthy->offset = nimf_anthy_conversion_get_offset (anthy->conversion,
+                                                    anthy->segment_index);
+  if (n_segments > 0)
   {
-    anthy_get_segment_stat (anthy->context, anthy->segment_index,
-                            &anthy->segment_stat);
-    anthy->current_page = 1;
-    nimf_anthy_update_page (engine, target);
+    anthy->segment_stat =
+      *nimf_anthy_conversion_get_segment_stat (anthy->conversion,
+                                               anthy->segment_index);
+    nimf_candidate_set_source (anthy->candidate, target,
+                               anthy->segment_stat.nr_candidate, 10,
+                               (NimfCandidateFillFunc) nimf_anthy_fill_candidates,
+                               anthy);
     nimf_candidate_show_window (anthy->candidate, target, FALSE);
   }
   else
   {
-    if (anthy->n_pages > 0)
-    {
-      nimf_candidate_hide_window (anthy->candidate);
-      nimf_candidate_clear (anthy->candidate, target);
-      anthy->n_pages = 0;
-      anthy->current_page = 0;
-    }
+    nimf_candidate_hide_window (anthy->candidate);
+    nimf_candidate_clear (anthy->candidate, target);
   }
 }
 
@@ -368,7 +271,8 @@ nimf_anthy_romaji_filter_event (NimfEngine    *engine,
   g_debug (G_STRLOC ": %s", G_STRFUNC);
 
   NimfAnthy   *anthy = NIMF_ANTHY (engine);
-  const gchar *str;
+  const gchar *kana;
+  gsize        kana_len;
 
   if (event->key.keyval == NIMF_KEY_space ||
       (event->key.state & NIMF_MODIFIER_MASK) == NIMF_CONTROL_MASK ||
@@ -415,42 +319,72 @@ nimf_anthy_romaji_filter_event (NimfEngine    *engine,
 
   while (TRUE)
   {
-    str = g_hash_table_lookup (nimf_anthy_romaji, anthy->preedit2->str);
-
-    if (str)
+    switch (nimf_romaji_match (nimf_anthy_romaji, anthy->preedit2->str,
+                               anthy->preedit2->len, &kana, &kana_len))
     {
-      if (str[0] != 0)
-      {
-        g_string_append (anthy->preedit1, str);
-        g_string_assign (anthy->preedit2, "");
-      }
-
-      break;
+      case NIMF_ROMAJI_MATCH:
+        g_string_append_len (anthy->preedit1, kana, kana_len);
+        g_string_truncate (anthy->preedit2, 0);
+        return TRUE;
+      case NIMF_ROMAJI_PARTIAL_MATCH:
+        return TRUE;
+      case NIMF_ROMAJI_NO_MATCH:
+      default:
+        break;
     }
-    else
+
+    /* commit what came before the last letter, converted if it is a
+     * romaji itself, and retry with the last letter */
+    if (anthy->preedit2->len > 1)
     {
-      if (anthy->preedit2->len > 1)
-      {
-        static gchar c[2] = {0};
+      gchar c = anthy->preedit2->str[anthy->preedit2->len - 1];
 
+      nimf_romaji_match (nimf_anthy_romaji, anthy->preedit2->str,
+                         anthy->preedit2->len - 1, &kana, &kana_len);
+      if (kana)
+        g_string_append_len (anthy->preedit1, kana, kana_len);
+      else
         g_string_append_len (anthy->preedit1, anthy->preedit2->str,
                              anthy->preedit2->len - 1);
-        c[0] = anthy->preedit2->str[anthy->preedit2->len - 1];
-        g_string_assign (anthy->preedit2, c);
-      }
-      else
-      {
-        g_string_append (anthy->preedit1, anthy->preedit2->str);
-        g_string_assign (anthy->preedit2, "");
 
-        break;
-      }
+      g_string_truncate (anthy->preedit2, 0);
+      g_string_append_c (anthy->preedit2, c);
+    }
+    else
+    {
+      g_string_append_len (anthy->preedit1, anthy->preedit2->str,
+                           anthy->preedit2->len);
+      g_string_truncate (anthy->preedit2, 0);
+
+      return TRUE;
     }
   }
 
   return TRUE;
 }
 
+/* converts what Space would convert in the background, once typing pauses */
+static void
+nimf_anthy_schedule_conversion (NimfAnthy *anthy)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  gchar *string;
+
+  if (g_strcmp0 (anthy->preedit2->str, "n") == 0)
+    string = g_strjoin (NULL, anthy->preedit1->str, "ん", NULL);
+  else
+    string = g_strdup (anthy->preedit1->str);
+
+  if (string[0] == '\0' ||
+      g_strcmp0 (nimf_anthy_conversion_get_string (anthy->conversion), string) == 0)
+    nimf_anthy_worker_cancel (anthy->worker);
+  else
+    nimf_anthy_worker_schedule (anthy->worker, string);
+
+  g_free (string);
+}
+
 gboolean
 nimf_anthy_filter_event (NimfEngine    *engine,
                          NimfServiceIM *target,
@@ -497,7 +431,8 @@ nimf_anthy_filter_event (NimfEngine    *engine,
         if (anthy->segment_index > 0)
           anthy->segment_index--;
         else
-          anthy->segment_index = anthy->conv_stat.nr_segment - 1;
+          anthy->segment_index =
+            nimf_anthy_conversion_get_n_segments (anthy->conversion) - 1;
 
         nimf_anthy_update_candidate (engine, target, event);
 
@@ -518,7 +453,8 @@ nimf_anthy_filter_event (NimfEngine    *engine,
         return TRUE;
       case NIMF_KEY_Right:
       case NIMF_KEY_KP_Right:
-        if (anthy->segment_index < anthy->conv_stat.nr_segment - 1)
+        if (anthy->segment_index <
+            nimf_anthy_conversion_get_n_segments (anthy->conversion) - 1)
           anthy->segment_index++;
         else
           anthy->segment_index = 0;
@@ -542,17 +478,17 @@ nimf_anthy_filter_event (NimfEngine    *engine,
         return TRUE;
       case NIMF_KEY_Page_Up:
       case NIMF_KEY_KP_Page_Up:
-        nimf_anthy_page_up (engine, target);
+        nimf_candidate_page_up (anthy->candidate);
         return TRUE;
       case NIMF_KEY_Page_Down:
       case NIMF_KEY_KP_Page_Down:
-        nimf_anthy_page_down (engine, target);
+        nimf_candidate_page_down (anthy->candidate);
         return TRUE;
       case NIMF_KEY_Home:
-        nimf_anthy_page_home (engine, target);
+        nimf_candidate_page_home (anthy->candidate);
         return TRUE;
       case NIMF_KEY_End:
-        nimf_anthy_page_end (engine, target);
+        nimf_candidate_page_end (anthy->candidate);
         return TRUE;
       case NIMF_KEY_0:
       case NIMF_KEY_1:
@@ -575,9 +511,6 @@ nimf_anthy_filter_event (NimfEngine    *engine,
       case NIMF_KEY_KP_8:
       case NIMF_KEY_KP_9:
         {
-          if (anthy->current_page < 1)
-            break;
-
           gint i, n;
 
           if (event->key.keyval >= NIMF_KEY_0 &&
@@ -589,14 +522,17 @@ nimf_anthy_filter_event (NimfEngine    *engine,
           else
             break;
 
-          i = (anthy->current_page - 1) * 10 + n;
+          i = nimf_candidate_get_item_index (anthy->candidate, n);
 
-          if (i < MIN (anthy->current_page * 10,
-                       anthy->segment_stat.nr_candidate))
+          if (i >= 0)
           {
-            anthy_get_segment (anthy->context, anthy->segment_index,
-                               i, anthy->buffer, NIMF_ANTHY_BUFFER_SIZE);
-            on_candidate_clicked (engine, target, anthy->buffer, -1);
+            gchar *text;
+
+            text = g_strdup (nimf_anthy_conversion_get_candidate (anthy->conversion,
+                                                                  anthy->segment_index,
+                                                                  i));
+            on_candidate_clicked (engine, target, text, i);
+            g_free (text);
 
             return TRUE;
           }
@@ -656,6 +592,10 @@ nimf_anthy_filter_event (NimfEngine    *engine,
 
     retval = TRUE;
   }
+  else
+  {
+    nimf_anthy_schedule_conversion (anthy);
+  }
 
   return retval;
 }
@@ -674,368 +614,20 @@ nimf_anthy_init (NimfAnthy *anthy)
   anthy->preedit_attrs[1] = nimf_preedit_attr_new (NIMF_PREEDIT_ATTR_HIGHLIGHT, 0, 0);
   anthy->preedit_attrs[2] = NULL;
 
-  if (nimf_anthy_romaji)
-  {
-    g_hash_table_ref (nimf_anthy_romaji);
-  }
-  else
+  if (nimf_anthy_romaji == NULL)
   {
-    nimf_anthy_romaji = g_hash_table_new_full (g_str_hash, g_str_equal,
-                                               NULL, g_free);
-    g_hash_table_insert (nimf_anthy_romaji, "a", g_strdup ("あ"));
-    g_hash_table_insert (nimf_anthy_romaji, "b", g_strdup ("")); /* dummy */
-    g_hash_table_insert (nimf_anthy_romaji, "ba", g_strdup ("ば"));
-    g_hash_table_insert (nimf_anthy_romaji, "be", g_strdup ("べ"));
-    g_hash_table_insert (nimf_anthy_romaji, "bi", g_strdup ("び"));
-    g_hash_table_insert (nimf_anthy_romaji, "bo", g_strdup ("ぼ"));
-    g_hash_table_insert (nimf_anthy_romaji, "bu", g_strdup ("ぶ"));
-    g_hash_table_insert (nimf_anthy_romaji, "by", g_strdup ("")); /* dummy */
-    g_hash_table_insert (nimf_anthy_romaji, "bya", g_strdup ("びゃ"));
-    g_hash_table_insert (nimf_anthy_romaji, "bye", g_strdup ("びぇ"));
-    g_hash_table_insert (nimf_anthy_romaji, "byi", g_strdup ("びぃ"));
-    g_hash_table_insert (nimf_anthy_romaji, "byo", g_strdup ("びょ"));
-    g_hash_table_insert (nimf_anthy_romaji, "byu", g_strdup ("びゅ"));
-    g_hash_table_insert (nimf_anthy_romaji, "c", g_strdup ("")); /* dummy */
-    g_hash_table_insert (nimf_anthy_romaji, "ca", g_strdup ("か"));
-    g_hash_table_insert (nimf_anthy_romaji, "ce", g_strdup ("せ"));
-    g_hash_table_insert (nimf_anthy_romaji, "ch", g_strdup ("")); /* dummy */
-    g_hash_table_insert (nimf_anthy_romaji, "cha", g_strdup ("ちゃ"));
-    g_hash_table_insert (nimf_anthy_romaji, "che", g_strdup ("ちぇ"));
-    g_hash_table_insert (nimf_anthy_romaji, "chi", g_strdup ("ち"));
-    g_hash_table_insert (nimf_anthy_romaji, "cho", g_strdup ("ちょ"));
-    g_hash_table_insert (nimf_anthy_romaji, "chu", g_strdup ("ちゅ"));
-    g_hash_table_insert (nimf_anthy_romaji, "ci", g_strdup ("し"));
-    g_hash_table_insert (nimf_anthy_romaji, "co", g_strdup ("こ"));
-    g_hash_table_insert (nimf_anthy_romaji, "cu", g_strdup ("く"));
-    g_hash_table_insert (nimf_anthy_romaji, "cy", g_strdup ("")); /* dummy */
-    g_hash_table_insert (nimf_anthy_romaji, "cya", g_strdup ("ちゃ"));
-    g_hash_table_insert (nimf_anthy_romaji, "cye", g_strdup ("ちぇ"));
-    g_hash_table_insert (nimf_anthy_romaji, "cyi", g_strdup ("ちぃ"));
-    g_hash_table_insert (nimf_anthy_romaji, "cyo", g_strdup ("ちょ"));
-    g_hash_table_insert (nimf_anthy_romaji, "cyu", g_strdup ("ちゅ"));
-    g_hash_table_insert (nimf_anthy_romaji, "d", g_strdup ("")); /* dummy */
-    g_hash_table_insert (nimf_anthy_romaji, "da", g_strdup ("だ"));
-    g_hash_table_insert (nimf_anthy_romaji, "de", g_strdup ("で"));
-    g_hash_table_insert (nimf_anthy_romaji, "dh", g_strdup ("")); /* dummy */
-    g_hash_table_insert (nimf_anthy_romaji, "dha", g_strdup ("でゃ"));
-    g_hash_table_insert (nimf_anthy_romaji, "dhe", g_strdup ("でぇ"));
-    g_hash_table_insert (nimf_anthy_romaji, "dhi", g_strdup ("でぃ"));
-    g_hash_table_insert (nimf_anthy_romaji, "dho", g_strdup ("でょ"));
-    g_hash_table_insert (nimf_anthy_romaji, "dhu", g_strdup ("でゅ"));
-    g_hash_table_insert (nimf_anthy_romaji, "di", g_strdup ("ぢ"));
-    g_hash_table_insert (nimf_anthy_romaji, "do", g_strdup ("ど"));
-    g_hash_table_insert (nimf_anthy_romaji, "du", g_strdup ("づ"));
-    g_hash_table_insert (nimf_anthy_romaji, "dw", g_strdup ("")); /* dummy */
-    g_hash_table_insert (nimf_anthy_romaji, "dwa", g_strdup ("どぁ"));
-    g_hash_table_insert (nimf_anthy_romaji, "dwe", g_strdup ("どぇ"));
-    g_hash_table_insert (nimf_anthy_romaji, "dwi", g_strdup ("どぃ"));
-    g_hash_table_insert (nimf_anthy_romaji, "dwo", g_strdup ("どぉ"));
-    g_hash_table_insert (nimf_anthy_romaji, "dwu", g_strdup ("どぅ"));
-    g_hash_table_insert (nimf_anthy_romaji, "dy", g_strdup ("")); /* dummy */
-    g_hash_table_insert (nimf_anthy_romaji, "dya", g_strdup ("ぢゃ"));
-    g_hash_table_insert (nimf_anthy_romaji, "dye", g_strdup ("ぢぇ"));
-    g_hash_table_insert (nimf_anthy_romaji, "dyi", g_strdup ("ぢぃ"));
-    g_hash_table_insert (nimf_anthy_romaji, "dyo", g_strdup ("ぢょ"));
-    g_hash_table_insert (nimf_anthy_romaji, "dyu", g_strdup ("ぢゅ"));
-    g_hash_table_insert (nimf_anthy_romaji, "e", g_strdup ("え"));
-    g_hash_table_insert (nimf_anthy_romaji, "f", g_strdup ("")); /* dummy */
-    g_hash_table_insert (nimf_anthy_romaji, "fa", g_strdup ("ふぁ"));
-    g_hash_table_insert (nimf_anthy_romaji, "fe", g_strdup ("ふぇ"));
-    g_hash_table_insert (nimf_anthy_romaji, "fi", g_strdup ("ふぃ"));
-    g_hash_table_insert (nimf_anthy_romaji, "fo", g_strdup ("ふぉ"));
-    g_hash_table_insert (nimf_anthy_romaji, "fu", g_strdup ("ふ"));
-    g_hash_table_insert (nimf_anthy_romaji, "fw", g_strdup ("")); /* dummy */
-    g_hash_table_insert (nimf_anthy_romaji, "fwa", g_strdup ("ふぁ"));
-    g_hash_table_insert (nimf_anthy_romaji, "fwe", g_strdup ("ふぇ"));
-    g_hash_table_insert (nimf_anthy_romaji, "fwi", g_strdup ("ふぃ"));
-    g_hash_table_insert (nimf_anthy_romaji, "fwo", g_strdup ("ふぉ"));
-    g_hash_table_insert (nimf_anthy_romaji, "fwu", g_strdup ("ふう"));
-    g_hash_table_insert (nimf_anthy_romaji, "fy", g_strdup ("")); /* dummy */
-    g_hash_table_insert (nimf_anthy_romaji, "fya", g_strdup ("ふゃ"));
-    g_hash_table_insert (nimf_anthy_romaji, "fye", g_strdup ("ふぇ"));
-    g_hash_table_insert (nimf_anthy_romaji, "fyi", g_strdup ("ふぃ"));
-    g_hash_table_insert (nimf_anthy_romaji, "fyo", g_strdup ("ふょ"));
-    g_hash_table_insert (nimf_anthy_romaji, "fyu", g_strdup ("ふゅ"));
-    g_hash_table_insert (nimf_anthy_romaji, "g", g_strdup ("")); /* dummy */
-    g_hash_table_insert (nimf_anthy_romaji, "ga", g_strdup ("が"));
-    g_hash_table_insert (nimf_anthy_romaji, "ge", g_strdup ("げ"));
-    g_hash_table_insert (nimf_anthy_romaji, "gi", g_strdup ("ぎ"));
-    g_hash_table_insert (nimf_anthy_romaji, "go", g_strdup ("ご"));
-    g_hash_table_insert (nimf_anthy_romaji, "gu", g_strdup ("ぐ"));
-    g_hash_table_insert (nimf_anthy_romaji, "gw", g_strdup ("")); /* dummy */
-    g_hash_table_insert (nimf_anthy_romaji, "gwa", g_strdup ("ぐぁ"));
-    g_hash_table_insert (nimf_anthy_romaji, "gwe", g_strdup ("ぐえ"));
-    g_hash_table_insert (nimf_anthy_romaji, "gwi", g_strdup ("ぐぃ"));
-    g_hash_table_insert (nimf_anthy_romaji, "gwo", g_strdup ("ぐぉ"));
-    g_hash_table_insert (nimf_anthy_romaji, "gwu", g_strdup ("ぐぅ"));
-    g_hash_table_insert (nimf_anthy_romaji, "gy", g_strdup ("")); /* dummy */
-    g_hash_table_insert (nimf_anthy_romaji, "gya", g_strdup ("ぎゃ"));
-    g_hash_table_insert (nimf_anthy_romaji, "gye", g_strdup ("ぎぇ"));
-    g_hash_table_insert (nimf_anthy_romaji, "gyi", g_strdup ("ぎぃ"));
-    g_hash_table_insert (nimf_anthy_romaji, "gyo", g_strdup ("ぎょ"));
-    g_hash_table_insert (nimf_anthy_romaji, "gyu", g_strdup ("ぎゅ"));
-    g_hash_table_insert (nimf_anthy_romaji, "h", g_strdup ("")); /* dummy */
-    g_hash_table_insert (nimf_anthy_romaji, "ha", g_strdup ("は"));
-    g_hash_table_insert (nimf_anthy_romaji, "he", g_strdup ("へ"));
-    g_hash_table_insert (nimf_anthy_romaji, "hi", g_strdup ("ひ"));
-    g_hash_table_insert (nimf_anthy_romaji, "ho", g_strdup ("ほ"));
-    g_hash_table_insert (nimf_anthy_romaji, "hu", g_strdup ("ふ"));
-    g_hash_table_insert (nimf_anthy_romaji, "hy", g_strdup ("")); /* dummy */
-    g_hash_table_insert (nimf_anthy_romaji, "hya", g_strdup ("ひゃ"));
-    g_hash_table_insert (nimf_anthy_romaji, "hye", g_strdup ("ひぇ"));
-    g_hash_table_insert (nimf_anthy_romaji, "hyi", g_strdup ("ひぃ"));
-    g_hash_table_insert (nimf_anthy_romaji, "hyo", g_strdup ("ひょ"));
-    g_hash_table_insert (nimf_anthy_romaji, "hyu", g_strdup ("ひゅ"));
-    g_hash_table_insert (nimf_anthy_romaji, "i", g_strdup ("い"));
-    g_hash_table_insert (nimf_anthy_romaji, "j", g_strdup ("")); /* dummy */
-    g_hash_table_insert (nimf_anthy_romaji, "ja", g_strdup ("じゃ"));
-    g_hash_table_insert (nimf_anthy_romaji, "je", g_strdup ("じぇ"));
-    g_hash_table_insert (nimf_anthy_romaji, "ji", g_strdup ("じ"));
-    g_hash_table_insert (nimf_anthy_romaji, "jo", g_strdup ("じょ"));
-    g_hash_table_insert (nimf_anthy_romaji, "ju", g_strdup ("じゅ"));
-    g_hash_table_insert (nimf_anthy_romaji, "jy", g_strdup ("")); /* dummy */
-    g_hash_table_insert (nimf_anthy_romaji, "jya", g_strdup ("じゃ"));
-    g_hash_table_insert (nimf_anthy_romaji, "jye", g_strdup ("じぇ"));
-    g_hash_table_insert (nimf_anthy_romaji, "jyi", g_strdup ("じぃ"));
-    g_hash_table_insert (nimf_anthy_romaji, "jyo", g_strdup ("じょ"));
-    g_hash_table_insert (nimf_anthy_romaji, "jyu", g_strdup ("じゅ"));
-    g_hash_table_insert (nimf_anthy_romaji, "k", g_strdup ("")); /* dummy */
-    g_hash_table_insert (nimf_anthy_romaji, "ka", g_strdup ("か"));
-    g_hash_table_insert (nimf_anthy_romaji, "ke", g_strdup ("け"));
-    g_hash_table_insert (nimf_anthy_romaji, "ki", g_strdup ("き"));
-    g_hash_table_insert (nimf_anthy_romaji, "ko", g_strdup ("こ"));
-    g_hash_table_insert (nimf_anthy_romaji, "ku", g_strdup ("く"));
-    g_hash_table_insert (nimf_anthy_romaji, "kw", g_strdup ("")); /* dummy */
-    g_hash_table_insert (nimf_anthy_romaji, "kwa", g_strdup ("くぁ"));
-    g_hash_table_insert (nimf_anthy_romaji, "ky", g_strdup ("")); /* dummy */
-    g_hash_table_insert (nimf_anthy_romaji, "kya", g_strdup ("きゃ"));
-    g_hash_table_insert (nimf_anthy_romaji, "kye", g_strdup ("きぇ"));
-    g_hash_table_insert (nimf_anthy_romaji, "kyi", g_strdup ("きぃ"));
-    g_hash_table_insert (nimf_anthy_romaji, "kyo", g_strdup ("きょ"));
-    g_hash_table_insert (nimf_anthy_romaji, "kyu", g_strdup ("きゅ"));
-    g_hash_table_insert (nimf_anthy_romaji, "l", g_strdup ("")); /* dummy */
-    g_hash_table_insert (nimf_anthy_romaji, "la", g_strdup ("ぁ"));
-    g_hash_table_insert (nimf_anthy_romaji, "le", g_strdup ("ぇ"));
-    g_hash_table_insert (nimf_anthy_romaji, "li", g_strdup ("ぃ"));
-    g_hash_table_insert (nimf_anthy_romaji, "lk", g_strdup ("")); /* dummy */
-    g_hash_table_insert (nimf_anthy_romaji, "lka", g_strdup ("ヵ"));
-    g_hash_table_insert (nimf_anthy_romaji, "lke", g_strdup ("ヶ"));
-    g_hash_table_insert (nimf_anthy_romaji, "lo", g_strdup ("ぉ"));
-    g_hash_table_insert (nimf_anthy_romaji, "lt", g_strdup ("")); /* dummy */
-    g_hash_table_insert (nimf_anthy_romaji, "lts", g_strdup ("")); /* dummy */
-    g_hash_table_insert (nimf_anthy_romaji, "ltsu", g_strdup ("っ"));
-    g_hash_table_insert (nimf_anthy_romaji, "ltu", g_strdup ("っ"));
-    g_hash_table_insert (nimf_anthy_romaji, "lu", g_strdup ("ぅ"));
-    g_hash_table_insert (nimf_anthy_romaji, "lw", g_strdup ("")); /* dummy */
-    g_hash_table_insert (nimf_anthy_romaji, "lwa", g_strdup ("ゎ"));
-    g_hash_table_insert (nimf_anthy_romaji, "ly", g_strdup ("")); /* dummy */
-    g_hash_table_insert (nimf_anthy_romaji, "lya", g_strdup ("ゃ"));
-    g_hash_table_insert (nimf_anthy_romaji, "lye", g_strdup ("ぇ"));
-    g_hash_table_insert (nimf_anthy_romaji, "lyi", g_strdup ("ぃ"));
-    g_hash_table_insert (nimf_anthy_romaji, "lyo", g_strdup ("ょ"));
-    g_hash_table_insert (nimf_anthy_romaji, "lyu", g_strdup ("ゅ"));
-    g_hash_table_insert (nimf_anthy_romaji, "m", g_strdup ("")); /* dummy */
-    g_hash_table_insert (nimf_anthy_romaji, "ma", g_strdup ("ま"));
-    g_hash_table_insert (nimf_anthy_romaji, "me", g_strdup ("め"));
-    g_hash_table_insert (nimf_anthy_romaji, "mi", g_strdup ("み"));
-    g_hash_table_insert (nimf_anthy_romaji, "mo", g_strdup ("も"));
-    g_hash_table_insert (nimf_anthy_romaji, "mu", g_strdup ("む"));
-    g_hash_table_insert (nimf_anthy_romaji, "my", g_strdup ("")); /* dummy */
-    g_hash_table_insert (nimf_anthy_romaji, "mya", g_strdup ("みゃ"));
-    g_hash_table_insert (nimf_anthy_romaji, "mye", g_strdup ("みぇ"));
-    g_hash_table_insert (nimf_anthy_romaji, "myi", g_strdup ("みぃ"));
-    g_hash_table_insert (nimf_anthy_romaji, "myo", g_strdup ("みょ"));
-    g_hash_table_insert (nimf_anthy_romaji, "myu", g_strdup ("みゅ"));
-    g_hash_table_insert (nimf_anthy_romaji, "n", g_strdup ("")); /* dummy */
-    g_hash_table_insert (nimf_anthy_romaji, "na", g_strdup ("な"));
-    g_hash_table_insert (nimf_anthy_romaji, "ne", g_strdup ("ね"));
-    g_hash_table_insert (nimf_anthy_romaji, "ni", g_strdup ("に"));
-    g_hash_table_insert (nimf_anthy_romaji, "nn", g_strdup ("ん"));
-    g_hash_table_insert (nimf_anthy_romaji, "no", g_strdup ("の"));
-    g_hash_table_insert (nimf_anthy_romaji, "nu", g_strdup ("ぬ"));
-    g_hash_table_insert (nimf_anthy_romaji, "ny", g_strdup ("")); /* dummy */
-    g_hash_table_insert (nimf_anthy_romaji, "nya", g_strdup ("にゃ"));
-    g_hash_table_insert (nimf_anthy_romaji, "nye", g_strdup ("にぇ"));
-    g_hash_table_insert (nimf_anthy_romaji, "nyi", g_strdup ("にぃ"));
-    g_hash_table_insert (nimf_anthy_romaji, "nyo", g_strdup ("にょ"));
-    g_hash_table_insert (nimf_anthy_romaji, "nyu", g_strdup ("にゅ"));
-    g_hash_table_insert (nimf_anthy_romaji, "o", g_strdup ("お"));
-    g_hash_table_insert (nimf_anthy_romaji, "p", g_strdup ("")); /* dummy */
-    g_hash_table_insert (nimf_anthy_romaji, "pa", g_strdup ("ぱ"));
-    g_hash_table_insert (nimf_anthy_romaji, "pe", g_strdup ("ぺ"));
-    g_hash_table_insert (nimf_anthy_romaji, "pi", g_strdup ("ぴ"));
-    g_hash_table_insert (nimf_anthy_romaji, "po", g_strdup ("ぽ"));
-    g_hash_table_insert (nimf_anthy_romaji, "pu", g_strdup ("ぷ"));
-    g_hash_table_insert (nimf_anthy_romaji, "py", g_strdup ("")); /* dummy */
-    g_hash_table_insert (nimf_anthy_romaji, "pya", g_strdup ("ぴゃ"));
-    g_hash_table_insert (nimf_anthy_romaji, "pye", g_strdup ("ぴぇ"));
-    g_hash_table_insert (nimf_anthy_romaji, "pyi", g_strdup ("ぴぃ"));
-    g_hash_table_insert (nimf_anthy_romaji, "pyo", g_strdup ("ぴょ"));
-    g_hash_table_insert (nimf_anthy_romaji, "pyu", g_strdup ("ぴゅ"));
-    g_hash_table_insert (nimf_anthy_romaji, "q", g_strdup ("")); /* dummy */
-    g_hash_table_insert (nimf_anthy_romaji, "qa", g_strdup ("くぁ"));
-    g_hash_table_insert (nimf_anthy_romaji, "qe", g_strdup ("くぇ"));
-    g_hash_table_insert (nimf_anthy_romaji, "qi", g_strdup ("くぃ"));
-    g_hash_table_insert (nimf_anthy_romaji, "qo", g_strdup ("くぉ"));
-    g_hash_table_insert (nimf_anthy_romaji, "qu", g_strdup ("く"));
-    g_hash_table_insert (nimf_anthy_romaji, "qw", g_strdup ("")); /* dummy */
-    g_hash_table_insert (nimf_anthy_romaji, "qwa", g_strdup ("くぁ"));
-    g_hash_table_insert (nimf_anthy_romaji, "qwe", g_strdup ("くぇ"));
-    g_hash_table_insert (nimf_anthy_romaji, "qwi", g_strdup ("くぃ"));
-    g_hash_table_insert (nimf_anthy_romaji, "qwo", g_strdup ("くぉ"));
-    g_hash_table_insert (nimf_anthy_romaji, "qwu", g_strdup ("くぅ"));
-    g_hash_table_insert (nimf_anthy_romaji, "qy", g_strdup ("")); /* dummy */
-    g_hash_table_insert (nimf_anthy_romaji, "qya", g_strdup ("くゃ"));
-    g_hash_table_insert (nimf_anthy_romaji, "qye", g_strdup ("くぇ"));
-    g_hash_table_insert (nimf_anthy_romaji, "qyi", g_strdup ("くぃ"));
-    g_hash_table_insert (nimf_anthy_romaji, "qyo", g_strdup ("くょ"));
-    g_hash_table_insert (nimf_anthy_romaji, "qyu", g_strdup ("くゅ"));
-    g_hash_table_insert (nimf_anthy_romaji, "r", g_strdup ("")); /* dummy */
-    g_hash_table_insert (nimf_anthy_romaji, "ra", g_strdup ("ら"));
-    g_hash_table_insert (nimf_anthy_romaji, "re", g_strdup ("れ"));
-    g_hash_table_insert (nimf_anthy_romaji, "ri", g_strdup ("り"));
-    g_hash_table_insert (nimf_anthy_romaji, "ro", g_strdup ("ろ"));
-    g_hash_table_insert (nimf_anthy_romaji, "ru", g_strdup ("る"));
-    g_hash_table_insert (nimf_anthy_romaji, "ry", g_strdup ("")); /* dummy */
-    g_hash_table_insert (nimf_anthy_romaji, "rya", g_strdup ("りゃ"));
-    g_hash_table_insert (nimf_anthy_romaji, "rye", g_strdup ("りぇ"));
-    g_hash_table_insert (nimf_anthy_romaji, "ryi", g_strdup ("りぃ"));
-    g_hash_table_insert (nimf_anthy_romaji, "ryo", g_strdup ("りょ"));
-    g_hash_table_insert (nimf_anthy_romaji, "ryu", g_strdup ("りゅ"));
-    g_hash_table_insert (nimf_anthy_romaji, "s", g_strdup ("")); /* dummy */
-    g_hash_table_insert (nimf_anthy_romaji, "sa", g_strdup ("さ"));
-    g_hash_table_insert (nimf_anthy_romaji, "se", g_strdup ("せ"));
-    g_hash_table_insert (nimf_anthy_romaji, "sh", g_strdup ("")); /* dummy */
-    g_hash_table_insert (nimf_anthy_romaji, "sha", g_strdup ("しゃ"));
-    g_hash_table_insert (nimf_anthy_romaji, "she", g_strdup ("しぇ"));
-    g_hash_table_insert (nimf_anthy_romaji, "shi", g_strdup ("し"));
-    g_hash_table_insert (nimf_anthy_romaji, "sho", g_strdup ("しょ"));
-    g_hash_table_insert (nimf_anthy_romaji, "shu", g_strdup ("しゅ"));
-    g_hash_table_insert (nimf_anthy_romaji, "si", g_strdup ("し"));
-    g_hash_table_insert (nimf_anthy_romaji, "so", g_strdup ("そ"));
-    g_hash_table_insert (nimf_anthy_romaji, "su", g_strdup ("す"));
-    g_hash_table_insert (nimf_anthy_romaji, "sw", g_strdup ("")); /* dummy */
-    g_hash_table_insert (nimf_anthy_romaji, "swa", g_strdup ("すぁ"));
-    g_hash_table_insert (nimf_anthy_romaji, "swe", g_strdup ("すぇ"));
-    g_hash_table_insert (nimf_anthy_romaji, "swi", g_strdup ("すぃ"));
-    g_hash_table_insert (nimf_anthy_romaji, "swo", g_strdup ("すぉ"));
-    g_hash_table_insert (nimf_anthy_romaji, "swu", g_strdup ("すぅ"));
-    g_hash_table_insert (nimf_anthy_romaji, "sy", g_strdup ("")); /* dummy */
-    g_hash_table_insert (nimf_anthy_romaji, "sya", g_strdup ("しゃ"));
-    g_hash_table_insert (nimf_anthy_romaji, "sye", g_strdup ("しぇ"));
-    g_hash_table_insert (nimf_anthy_romaji, "syi", g_strdup ("しぃ"));
-    g_hash_table_insert (nimf_anthy_romaji, "syo", g_strdup ("しょ"));
-    g_hash_table_insert (nimf_anthy_romaji, "syu", g_strdup ("しゅ"));
-    g_hash_table_insert (nimf_anthy_romaji, "t", g_strdup ("")); /* dummy */
-    g_hash_table_insert (nimf_anthy_romaji, "ta", g_strdup ("た"));
-    g_hash_table_insert (nimf_anthy_romaji, "te", g_strdup ("て"));
-    g_hash_table_insert (nimf_anthy_romaji, "th", g_strdup ("")); /* dummy */
-    g_hash_table_insert (nimf_anthy_romaji, "tha", g_strdup ("てゃ"));
-    g_hash_table_insert (nimf_anthy_romaji, "the", g_strdup ("てぇ"));
-    g_hash_table_insert (nimf_anthy_romaji, "thi", g_strdup ("てぃ"));
-    g_hash_table_insert (nimf_anthy_romaji, "tho", g_strdup ("てょ"));
-    g_hash_table_insert (nimf_anthy_romaji, "thu", g_strdup ("てゅ"));
-    g_hash_table_insert (nimf_anthy_romaji, "ti", g_strdup ("ち"));
-    g_hash_table_insert (nimf_anthy_romaji, "to", g_strdup ("と"));
-    g_hash_table_insert (nimf_anthy_romaji, "ts", g_strdup ("")); /* dummy */
-    g_hash_table_insert (nimf_anthy_romaji, "tsa", g_strdup ("つぁ"));
-    g_hash_table_insert (nimf_anthy_romaji, "tse", g_strdup ("つぇ"));
-    g_hash_table_insert (nimf_anthy_romaji, "tsi", g_strdup ("つぃ"));
-    g_hash_table_insert (nimf_anthy_romaji, "tso", g_strdup ("つぉ"));
-    g_hash_table_insert (nimf_anthy_romaji, "tsu", g_strdup ("つ"));
-    g_hash_table_insert (nimf_anthy_romaji, "tu", g_strdup ("つ"));
-    g_hash_table_insert (nimf_anthy_romaji, "tw", g_strdup ("")); /* dummy */
-    g_hash_table_insert (nimf_anthy_romaji, "twa", g_strdup ("とぁ"));
-    g_hash_table_insert (nimf_anthy_romaji, "twe", g_strdup ("とぇ"));
-    g_hash_table_insert (nimf_anthy_romaji, "twi", g_strdup ("とぃ"));
-    g_hash_table_insert (nimf_anthy_romaji, "two", g_strdup ("とぉ"));
-    g_hash_table_insert (nimf_anthy_romaji, "twu", g_strdup ("とぅ"));
-    g_hash_table_insert (nimf_anthy_romaji, "ty", g_strdup ("")); /* dummy */
-    g_hash_table_insert (nimf_anthy_romaji, "tya", g_strdup ("ちゃ"));
-    g_hash_table_insert (nimf_anthy_romaji, "tye", g_strdup ("ちぇ"));
-    g_hash_table_insert (nimf_anthy_romaji, "tyi", g_strdup ("ちぃ"));
-    g_hash_table_insert (nimf_anthy_romaji, "tyo", g_strdup ("ちょ"));
-    g_hash_table_insert (nimf_anthy_romaji, "tyu", g_strdup ("ちゅ"));
-    g_hash_table_insert (nimf_anthy_romaji, "u", g_strdup ("う"));
-    g_hash_table_insert (nimf_anthy_romaji, "v", g_strdup ("")); /* dummy */
-    g_hash_table_insert (nimf_anthy_romaji, "va", g_strdup ("ヴぁ"));
-    g_hash_table_insert (nimf_anthy_romaji, "ve", g_strdup ("ヴぇ"));
-    g_hash_table_insert (nimf_anthy_romaji, "vi", g_strdup ("ヴぃ"));
-    g_hash_table_insert (nimf_anthy_romaji, "vo", g_strdup ("ヴぉ"));
-    g_hash_table_insert (nimf_anthy_romaji, "vu", g_strdup ("ヴ"));
-    g_hash_table_insert (nimf_anthy_romaji, "vy", g_strdup ("")); /* dummy */
-    g_hash_table_insert (nimf_anthy_romaji, "vya", g_strdup ("ヴゃ"));
-    g_hash_table_insert (nimf_anthy_romaji, "vye", g_strdup ("ヴぇ"));
-    g_hash_table_insert (nimf_anthy_romaji, "vyi", g_strdup ("ヴぃ"));
-    g_hash_table_insert (nimf_anthy_romaji, "vyo", g_strdup ("ヴょ"));
-    g_hash_table_insert (nimf_anthy_romaji, "vyu", g_strdup ("ヴゅ"));
-    g_hash_table_insert (nimf_anthy_romaji, "w", g_strdup ("")); /* dummy */
-    g_hash_table_insert (nimf_anthy_romaji, "wa", g_strdup ("わ"));
-    g_hash_table_insert (nimf_anthy_romaji, "we", g_strdup ("うぇ"));
-    g_hash_table_insert (nimf_anthy_romaji, "wh", g_strdup ("")); /* dummy */
-    g_hash_table_insert (nimf_anthy_romaji, "wha", g_strdup ("うぁ"));
-    g_hash_table_insert (nimf_anthy_romaji, "whe", g_strdup ("うぇ"));
-    g_hash_table_insert (nimf_anthy_romaji, "whi", g_strdup ("うぃ"));
-    g_hash_table_insert (nimf_anthy_romaji, "who", g_strdup ("うぉ"));
-    g_hash_table_insert (nimf_anthy_romaji, "whu", g_strdup ("う"));
-    g_hash_table_insert (nimf_anthy_romaji, "wi", g_strdup ("うぃ"));
-    g_hash_table_insert (nimf_anthy_romaji, "wo", g_strdup ("を"));
-    g_hash_table_insert (nimf_anthy_romaji, "wu", g_strdup ("う"));
-    g_hash_table_insert (nimf_anthy_romaji, "wy", g_strdup ("")); /* dummy */
-    g_hash_table_insert (nimf_anthy_romaji, "wye", g_strdup ("ゑ"));
-    g_hash_table_insert (nimf_anthy_romaji, "wyi", g_strdup ("ゐ"));
-    g_hash_table_insert (nimf_anthy_romaji, "x", g_strdup ("")); /* dummy */
-    g_hash_table_insert (nimf_anthy_romaji, "xa", g_strdup ("ぁ"));
-    g_hash_table_insert (nimf_anthy_romaji, "xe", g_strdup ("ぇ"));
-    g_hash_table_insert (nimf_anthy_romaji, "xi", g_strdup ("ぃ"));
-    g_hash_table_insert (nimf_anthy_romaji, "xk", g_strdup ("")); /* dummy */
-    g_hash_table_insert (nimf_anthy_romaji, "xka", g_strdup ("ヵ"));
-    g_hash_table_insert (nimf_anthy_romaji, "xke", g_strdup ("ヶ"));
-    g_hash_table_insert (nimf_anthy_romaji, "xn", g_strdup ("ん"));
-    g_hash_table_insert (nimf_anthy_romaji, "xo", g_strdup ("ぉ"));
-    g_hash_table_insert (nimf_anthy_romaji, "xt", g_strdup ("")); /* dummy */
-    g_hash_table_insert (nimf_anthy_romaji, "xts", g_strdup ("")); /* dummy */
-    g_hash_table_insert (nimf_anthy_romaji, "xtsu", g_strdup ("っ"));
-    g_hash_table_insert (nimf_anthy_romaji, "xtu", g_strdup ("っ"));
-    g_hash_table_insert (nimf_anthy_romaji, "xu", g_strdup ("ぅ"));
-    g_hash_table_insert (nimf_anthy_romaji, "xw", g_strdup ("")); /* dummy */
-    g_hash_table_insert (nimf_anthy_romaji, "xwa", g_strdup ("ゎ"));
-    g_hash_table_insert (nimf_anthy_romaji, "xy", g_strdup ("")); /* dummy */
-    g_hash_table_insert (nimf_anthy_romaji, "xya", g_strdup ("ゃ"));
-    g_hash_table_insert (nimf_anthy_romaji, "xye", g_strdup ("ぇ"));
-    g_hash_table_insert (nimf_anthy_romaji, "xyi", g_strdup ("ぃ"));
-    g_hash_table_insert (nimf_anthy_romaji, "xyo", g_strdup ("ょ"));
-    g_hash_table_insert (nimf_anthy_romaji, "xyu", g_strdup ("ゅ"));
-    g_hash_table_insert (nimf_anthy_romaji, "y", g_strdup ("")); /* dummy */
-    g_hash_table_insert (nimf_anthy_romaji, "ya", g_strdup ("や"));
-    g_hash_table_insert (nimf_anthy_romaji, "ye", g_strdup ("いぇ"));
-    g_hash_table_insert (nimf_anthy_romaji, "yi", g_strdup ("い"));
-    g_hash_table_insert (nimf_anthy_romaji, "yo", g_strdup ("よ"));
-    g_hash_table_insert (nimf_anthy_romaji, "yu", g_strdup ("ゆ"));
-    g_hash_table_insert (nimf_anthy_romaji, "z", g_strdup ("")); /* dummy */
-    g_hash_table_insert (nimf_anthy_romaji, "za", g_strdup ("ざ"));
-    g_hash_table_insert (nimf_anthy_romaji, "ze", g_strdup ("ぜ"));
-    g_hash_table_insert (nimf_anthy_romaji, "zi", g_strdup ("じ"));
-    g_hash_table_insert (nimf_anthy_romaji, "zo", g_strdup ("ぞ"));
-    g_hash_table_insert (nimf_anthy_romaji, "zu", g_strdup ("ず"));
-    g_hash_table_insert (nimf_anthy_romaji, "zy", g_strdup ("")); /* dummy */
-    g_hash_table_insert (nimf_anthy_romaji, "zya", g_strdup ("じゃ"));
-    g_hash_table_insert (nimf_anthy_romaji, "zye", g_strdup ("じぇ"));
-    g_hash_table_insert (nimf_anthy_romaji, "zyi", g_strdup ("じぃ"));
-    g_hash_table_insert (nimf_anthy_romaji, "zyo", g_strdup ("じょ"));
-    g_hash_table_insert (nimf_anthy_romaji, "zyu", g_strdup ("じゅ"));
-    g_hash_table_insert (nimf_anthy_romaji, ",", g_strdup ("、"));
-    g_hash_table_insert (nimf_anthy_romaji, ".", g_strdup ("。"));
+    gchar *path = g_build_filename (g_get_user_config_dir (), "nimf",
+                                    "romaji.txt", NULL);
+    nimf_anthy_romaji = nimf_romaji_new (path);
+    g_free (path);
   }
 
   if (anthy_init () < 0)
     g_error (G_STRLOC ": %s: anthy is not initialized", G_STRFUNC);
 
-  /* FIXME */
-  /* anthy_set_personality () */
-  anthy->context = anthy_create_context ();
+  anthy->conversion = nimf_anthy_conversion_new ();
+  anthy->worker     = nimf_anthy_worker_new ();
   nimf_anthy_ref_count++;
-  anthy_context_set_encoding (anthy->context, ANTHY_UTF8_ENCODING);
 }
 
 static void
@@ -1049,12 +641,14 @@ nimf_anthy_finalize (GObject *object)
   g_string_free (anthy->preedit2, TRUE);
   nimf_preedit_attr_freev (anthy->preedit_attrs);
   g_free (anthy->id);
-  g_hash_table_unref (nimf_anthy_romaji);
+  nimf_anthy_worker_free (anthy->worker);
+  nimf_anthy_conversion_free (anthy->conversion);
 
   if (--nimf_anthy_ref_count == 0)
   {
-    anthy_release_context (anthy->context);
     anthy_quit ();
+    nimf_romaji_free (nimf_anthy_romaji);
+    nimf_anthy_romaji = NULL;
   }
 
   G_OBJECT_CLASS (nimf_anthy_parent_class)->finalize (object);
@@ -1093,10 +687,7 @@ nimf_anthy_class_init (NimfAnthyClass *class)
   engine_class->focus_in           = nimf_anthy_focus_in;
   engine_class->focus_out          = nimf_anthy_focus_out;
 
-  engine_class->candidate_page_up   = nimf_anthy_page_up;
-  engine_class->candidate_page_down = nimf_anthy_page_down;
   engine_class->candidate_clicked   = on_candidate_clicked;
-  engine_class->candidate_scrolled  = on_candidate_scrolled;
 
   engine_class->get_id             = nimf_anthy_get_id;
   engine_class->get_icon_name      = nimf_anthy_get_icon_name;
@@ -0,0 +1,119 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 2; tab-width: 2 -*- */
+/*
+ * nimf-chewing-bench.c
+ * This file is part of Nimf.
+ *
+ * Copyright (C) 2017 Hodong Kim <cogniti@gmail.com>
+ *
+ * Nimf is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Nimf is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program;  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Prints what a ChewingContext costs to create, in time and RSS, for the
+ * first one and for each one after it.  nimf-chewing used to create one
+ * per input context; it now creates one per focused input context.
+ * Build with "make nimf-chewing-bench".
+ */
+
+#include <glib.h>
+#include <chewing.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+static glong
+get_rss ()
+{
+  gchar *contents;
+  glong  size, resident;
+  glong  retval = -1;
+
+  if (!g_file_get_contents ("/proc/self/statm", &contents, NULL, NULL))
+    return -1;
+
+  if (sscanf (contents, "%ld %ld", &size, &resident) == 2)
+    retval = resident * (sysconf (_SC_PAGESIZE) / 1024);
+
+  g_free (contents);
+
+  return retval;
+}
+
+int
+main (int argc, char **argv)
+{
+  ChewingContext **contexts;
+  gint             n_contexts = 10;
+  gint64           start, first_time = 0, extra_time = 0;
+  glong            rss, first_rss = 0, extra_rss = 0;
+  gint             i;
+
+  GOptionContext *option_context;
+  GOptionEntry    entries[] = {
+    {"contexts", 'n', 0, G_OPTION_ARG_INT, &n_contexts, "Contexts to create", "N"},
+    {NULL}
+  };
+
+  option_context = g_option_context_new ("- Benchmark ChewingContext creation");
+  g_option_context_add_main_entries (option_context, entries, NULL);
+
+  if (!g_option_context_parse (option_context, &argc, &argv, NULL))
+  {
+    g_option_context_free (option_context);
+    return EXIT_FAILURE;
+  }
+
+  g_option_context_free (option_context);
+
+  n_contexts = MAX (n_contexts, 2);
+  contexts   = g_new0 (ChewingContext *, n_contexts);
+
+  for (i = 0; i < n_contexts; i++)
+  {
+    rss   = get_rss ();
+    start = g_get_monotonic_time ();
+
+    contexts[i] = chewing_new ();
+
+    if (contexts[i] == NULL)
+    {
+      g_printerr ("chewing_new () failed\n");
+      return EXIT_FAILURE;
+    }
+
+    if (i == 0)
+    {
+      first_time = g_get_monotonic_time () - start;
+      first_rss  = get_rss () - rss;
+    }
+    else
+    {
+      extra_time += g_get_monotonic_time () - start;
+      extra_rss  += get_rss () - rss;
+    }
+  }
+
+  g_print ("first context:     %8.1f ms %8ld kB\n",
+           first_time / 1000.0, first_rss);
+  g_print ("each extra one:    %8.1f ms %8ld kB\n",
+           extra_time / 1000.0 / (n_contexts - 1),
+           extra_rss / (n_contexts - 1));
+
+  for (i = 0; i < n_contexts; i++)
+    chewing_delete (contexts[i]);
+
+  g_free (contexts);
+
+  return EXIT_SUCCESS;
+}
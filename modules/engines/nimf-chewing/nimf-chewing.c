@@ -42,7 +42,7 @@ struct _NimfChewing
   GString          *preedit;
   NimfPreeditAttr **preedit_attrs;
   NimfPreeditState  preedit_state;
-  ChewingContext   *context;
+  ChewingContext   *context; /* while focused */
 };
 
 struct _NimfChewingClass
@@ -51,8 +51,115 @@ struct _NimfChewingClass
   NimfEngineClass parent_class;
 };
 
+#define NIMF_CHEWING_MAX_IDLE_CONTEXTS 2
+
+/*
+ * chewing_new () maps the dictionary and opens the user phrase database,
+ * so a ChewingContext is checked out on focus-in and returned on
+ * focus-out rather than created for every input context.
+ */
+static GQueue             nimf_chewing_idle_contexts = G_QUEUE_INIT;
+static gint               nimf_chewing_ref_count     = 0;
+static NimfEngineMetrics *nimf_chewing_metrics       = NULL;
+
 G_DEFINE_DYNAMIC_TYPE (NimfChewing, nimf_chewing, NIMF_TYPE_ENGINE);
 
+static ChewingContext *
+nimf_chewing_context_new (NimfChewing *chewing)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  ChewingContext *context;
+  NimfServer     *server = NULL;
+  gint64          start  = g_get_monotonic_time ();
+  glong           rss_kb = nimf_metrics_get_rss ();
+  gint            keys[10] = {'1', '2', '3', '4', '5', '6', '7', '8', '9', '0'};
+
+  context = chewing_new ();
+
+  if (context == NULL)
+  {
+    g_warning (G_STRLOC ": %s: chewing_new () failed", G_STRFUNC);
+    return NULL;
+  }
+
+  chewing_set_candPerPage          (context, 10);
+  chewing_set_maxChiSymbolLen      (context, 16);
+  chewing_set_addPhraseDirection   (context, FALSE);
+  chewing_set_phraseChoiceRearward (context, FALSE);
+  chewing_set_autoShiftCur         (context, FALSE);
+  chewing_set_spaceAsSelection     (context, TRUE);
+  chewing_set_escCleanAllBuf       (context, TRUE);
+  chewing_set_selKey               (context, keys, 10);
+
+  if (nimf_chewing_metrics == NULL)
+  {
+    g_object_get (chewing, "server", &server, NULL);
+
+    if (server)
+    {
+      nimf_chewing_metrics = nimf_metrics_get_engine (server->metrics,
+                                                      chewing->id);
+      g_object_unref (server);
+    }
+  }
+
+  if (nimf_chewing_metrics)
+  {
+    nimf_chewing_metrics->n_sessions++;
+    nimf_chewing_metrics->session_rss_kb = nimf_metrics_get_rss () - rss_kb;
+    nimf_chewing_metrics->session_time   = g_get_monotonic_time () - start;
+  }
+
+  return context;
+}
+
+static void
+nimf_chewing_context_free (ChewingContext *context)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  chewing_delete (context);
+
+  if (nimf_chewing_metrics)
+    nimf_chewing_metrics->n_sessions--;
+}
+
+static ChewingContext *
+nimf_chewing_check_out (NimfChewing *chewing)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  if (chewing->context)
+    return chewing->context;
+
+  chewing->context = g_queue_pop_head (&nimf_chewing_idle_contexts);
+
+  if (chewing->context == NULL)
+    chewing->context = nimf_chewing_context_new (chewing);
+
+  return chewing->context;
+}
+
+static void
+nimf_chewing_return (NimfChewing *chewing)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  if (chewing->context == NULL)
+    return;
+
+  chewing_Reset (chewing->context);
+
+  if (g_queue_get_length (&nimf_chewing_idle_contexts) <
+      NIMF_CHEWING_MAX_IDLE_CONTEXTS)
+    g_queue_push_head (&nimf_chewing_idle_contexts, chewing->context);
+  else
+    nimf_chewing_context_free (chewing->context);
+
+  chewing->context = NULL;
+}
+
 void
 nimf_chewing_reset (NimfEngine    *engine,
                     NimfServiceIM *target)
@@ -74,7 +181,8 @@ nimf_chewing_reset (NimfEngine    *engine,
     nimf_engine_emit_preedit_end (engine, target);
   }
 
-  chewing_Reset (NIMF_CHEWING (engine)->context);
+  if (chewing->context)
+    chewing_Reset (chewing->context);
 }
 
 void
@@ -82,6 +190,8 @@ nimf_chewing_focus_in (NimfEngine    *engine,
                        NimfServiceIM *context)
 {
   g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  nimf_chewing_check_out (NIMF_CHEWING (engine));
 }
 
 void
@@ -92,6 +202,7 @@ nimf_chewing_focus_out (NimfEngine    *engine,
 
   nimf_candidate_hide_window (NIMF_CHEWING (engine)->candidate);
   nimf_chewing_reset (engine, target);
+  nimf_chewing_return (NIMF_CHEWING (engine));
 }
 
 static void nimf_chewing_update (NimfEngine    *engine,
@@ -178,6 +289,9 @@ on_candidate_clicked (NimfEngine    *engine,
 
   NimfChewing *chewing = NIMF_CHEWING (engine);
 
+  if (chewing->context == NULL)
+    return;
+
   chewing_handle_Default (chewing->context, (index + 1) % 10 + 48);
   nimf_chewing_update (engine, target);
 }
@@ -191,7 +305,8 @@ on_candidate_scrolled (NimfEngine    *engine,
 
   NimfChewing *chewing = NIMF_CHEWING (engine);
 
-  if ((gint) value == chewing_cand_CurrentPage (chewing->context) + 1)
+  if (chewing->context == NULL ||
+      (gint) value == chewing_cand_CurrentPage (chewing->context) + 1)
     return;
 
   while (chewing_cand_TotalPage (chewing->context) > 1)
@@ -218,7 +333,9 @@ nimf_chewing_filter_event (NimfEngine    *engine,
 
   NimfChewing *chewing = NIMF_CHEWING (engine);
 
-  if (event->key.type == NIMF_EVENT_KEY_RELEASE)
+  /* in case a key comes without focus-in */
+  if (event->key.type == NIMF_EVENT_KEY_RELEASE ||
+      nimf_chewing_check_out (chewing) == NULL)
     return FALSE;
 
   if ((event->key.state & NIMF_MODIFIER_MASK) == 0 ||
@@ -349,7 +466,6 @@ nimf_chewing_init (NimfChewing *chewing)
 {
   g_debug (G_STRLOC ": %s", G_STRFUNC);
 
-  gint keys[10] = {'1', '2', '3', '4', '5', '6', '7', '8', '9', '0'};
   chewing->candidate = nimf_candidate_get_default ();
   chewing->id      = g_strdup ("nimf-chewing");
   chewing->preedit = g_string_new ("");
@@ -358,15 +474,7 @@ nimf_chewing_init (NimfChewing *chewing)
   chewing->preedit_attrs[1] = nimf_preedit_attr_new (NIMF_PREEDIT_ATTR_HIGHLIGHT, 0, 0);
   chewing->preedit_attrs[2] = NULL;
 
-  chewing->context = chewing_new ();
-  chewing_set_candPerPage          (chewing->context, 10);
-  chewing_set_maxChiSymbolLen      (chewing->context, 16);
-  chewing_set_addPhraseDirection   (chewing->context, FALSE);
-  chewing_set_phraseChoiceRearward (chewing->context, FALSE);
-  chewing_set_autoShiftCur         (chewing->context, FALSE);
-  chewing_set_spaceAsSelection     (chewing->context, TRUE);
-  chewing_set_escCleanAllBuf       (chewing->context, TRUE);
-  chewing_set_selKey               (chewing->context, keys, 10);
+  nimf_chewing_ref_count++;
 }
 
 static void
@@ -379,7 +487,17 @@ nimf_chewing_finalize (GObject *object)
   g_string_free (chewing->preedit, TRUE);
   nimf_preedit_attr_freev (chewing->preedit_attrs);
   g_free (chewing->id);
-  chewing_delete (chewing->context);
+  nimf_chewing_return (chewing);
+
+  if (--nimf_chewing_ref_count == 0)
+  {
+    ChewingContext *context;
+
+    while ((context = g_queue_pop_head (&nimf_chewing_idle_contexts)))
+      nimf_chewing_context_free (context);
+
+    nimf_chewing_metrics = NULL;
+  }
 
   G_OBJECT_CLASS (nimf_chewing_parent_class)->finalize (object);
 }
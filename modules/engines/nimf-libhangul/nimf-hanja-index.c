@@ -0,0 +1,743 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 2; tab-width: 2 -*- */
+/*
+ * nimf-hanja-index.c
+ * This file is part of Nimf.
+ *
+ * Copyright (C) 2017 Hodong Kim <cogniti@gmail.com>
+ *
+ * Nimf is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Nimf is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program;  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "nimf-hanja-index.h"
+#include <glib/gstdio.h>
+#include <string.h>
+
+/*
+ * The hanja and symbol tables are compiled once into
+ * $XDG_CACHE_HOME/nimf/hanja.idx and mapped read-only afterwards:
+ *
+ *   header | keys, sorted by key | entries, grouped by key | string pool
+ *
+ * A key found in the hanja table hides the same key in the symbol table,
+ * as hanja_table_match_exact () on the two tables did.  The index is
+ * rebuilt when the mtime or size of a table changes.
+ */
+
+#define NIMF_HANJA_INDEX_MAGIC       "NIMFHJX"
+#define NIMF_HANJA_INDEX_VERSION     1
+#define NIMF_HANJA_INDEX_CACHE_SIZE  32
+#define NIMF_HANJA_INDEX_MAX_RECENT  256
+#define NIMF_HANJA_INDEX_SAVE_DELAY  10 /* seconds */
+
+typedef struct
+{
+  gchar   magic[8];
+  guint32 version;
+  guint32 n_keys;
+  guint32 n_entries;
+  guint32 pool_size;
+  gint64  mtime[2]; /* hanja, symbol */
+  gint64  size[2];
+} NimfHanjaIndexHeader;
+
+typedef struct
+{
+  guint32 key; /* offset in the string pool */
+  guint32 first_entry;
+  guint32 n_entries;
+} NimfHanjaIndexKey;
+
+typedef struct
+{
+  guint32 value;
+  guint32 comment;
+} NimfHanjaIndexEntry;
+
+typedef struct
+{
+  const gchar *key;
+  const gchar *value;
+  const gchar *comment;
+  guint        seq;
+} NimfHanjaRecord;
+
+typedef struct
+{
+  gchar  *key;
+  GArray *entries;
+} NimfHanjaCached;
+
+typedef struct
+{
+  gchar *key;
+  gchar *value;
+} NimfHanjaRecent;
+
+struct _NimfHanjaIndex
+{
+  GBytes                     *bytes;
+  const NimfHanjaIndexHeader *header;
+  const NimfHanjaIndexKey    *keys;
+  const NimfHanjaIndexEntry  *entries;
+  const gchar                *pool;
+  /* lookups, most recently used first */
+  GQueue                     *cache;
+  GHashTable                 *cache_links;
+  /* selections, most recent first */
+  GQueue                     *recent;
+  gchar                      *recent_path;
+  guint                       save_source_id;
+};
+
+static void
+nimf_hanja_cached_free (NimfHanjaCached *cached)
+{
+  g_free (cached->key);
+  g_array_unref (cached->entries);
+  g_slice_free (NimfHanjaCached, cached);
+}
+
+static void
+nimf_hanja_recent_free (NimfHanjaRecent *recent)
+{
+  g_free (recent->key);
+  g_free (recent->value);
+  g_slice_free (NimfHanjaRecent, recent);
+}
+
+static gboolean
+nimf_hanja_index_stat (const gchar *path,
+                       gint64      *mtime,
+                       gint64      *size)
+{
+  GStatBuf st;
+
+  *mtime = -1;
+  *size  = -1;
+
+  if (path == NULL || g_stat (path, &st) != 0)
+    return FALSE;
+
+  *mtime = st.st_mtime;
+  *size  = st.st_size;
+
+  return TRUE;
+}
+
+/* lines are "key:value:comment"; modifies @contents */
+static void
+nimf_hanja_index_parse (gchar      *contents,
+                        GArray     *records,
+                        GHashTable *hidden_keys,
+                        GHashTable *seen_keys)
+{
+  gchar *line;
+  gchar *next;
+
+  for (line = contents; line; line = next)
+  {
+    NimfHanjaRecord record;
+    gchar *p;
+
+    next = strchr (line, '\n');
+
+    if (next)
+      *next++ = '\0';
+
+    g_strchomp (line);
+
+    if (line[0] == '#' || line[0] == '\0')
+      continue;
+
+    record.key = line;
+
+    if ((p = strchr (line, ':')) == NULL)
+      continue;
+
+    *p++ = '\0';
+    record.value   = p;
+    record.comment = "";
+
+    if ((p = strchr (p, ':')))
+    {
+      *p++ = '\0';
+      record.comment = p;
+    }
+
+    if (record.key[0] == '\0' || record.value[0] == '\0')
+      continue;
+
+    if (hidden_keys && g_hash_table_contains (hidden_keys, record.key))
+      continue;
+
+    if (seen_keys)
+      g_hash_table_add (seen_keys, (gpointer) record.key);
+
+    record.seq = records->len;
+    g_array_append_val (records, record);
+  }
+}
+
+static gint
+nimf_hanja_record_compare (const NimfHanjaRecord *a,
+                           const NimfHanjaRecord *b)
+{
+  gint retval = strcmp (a->key, b->key);
+
+  if (retval)
+    return retval;
+
+  return a->seq < b->seq ? -1 : a->seq > b->seq;
+}
+
+static guint32
+nimf_hanja_index_pool_add (GByteArray  *pool,
+                           GHashTable  *offsets,
+                           const gchar *string)
+{
+  gpointer offset;
+
+  /* the pool starts with "" */
+  if (string[0] == '\0')
+    return 0;
+
+  if (g_hash_table_lookup_extended (offsets, string, NULL, &offset))
+    return GPOINTER_TO_UINT (offset);
+
+  offset = GUINT_TO_POINTER (pool->len);
+  g_byte_array_append (pool, (const guint8 *) string, strlen (string) + 1);
+  g_hash_table_insert (offsets, (gpointer) string, offset);
+
+  return GPOINTER_TO_UINT (offset);
+}
+
+static GBytes *
+nimf_hanja_index_build (const gchar *hanja_path,
+                        const gchar *symbol_path,
+                        const gint64 mtime[2],
+                        const gint64 size[2])
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  NimfHanjaIndexHeader header = { NIMF_HANJA_INDEX_MAGIC };
+  GArray     *records;
+  GArray     *keys;
+  GArray     *entries;
+  GByteArray *pool;
+  GByteArray *data;
+  GHashTable *hanja_keys;
+  GHashTable *offsets;
+  gchar      *hanja_contents;
+  gchar      *symbol_contents = NULL;
+  GError     *error = NULL;
+  guint       i;
+
+  if (!g_file_get_contents (hanja_path, &hanja_contents, NULL, &error))
+  {
+    g_warning (G_STRLOC ": %s: %s", G_STRFUNC, error->message);
+    g_clear_error (&error);
+    return NULL;
+  }
+
+  records    = g_array_new (FALSE, FALSE, sizeof (NimfHanjaRecord));
+  hanja_keys = g_hash_table_new (g_str_hash, g_str_equal);
+  nimf_hanja_index_parse (hanja_contents, records, NULL, hanja_keys);
+
+  if (size[1] >= 0 &&
+      g_file_get_contents (symbol_path, &symbol_contents, NULL, NULL))
+    nimf_hanja_index_parse (symbol_contents, records, hanja_keys, NULL);
+
+  g_array_sort (records, (GCompareFunc) nimf_hanja_record_compare);
+
+  keys    = g_array_new (FALSE, FALSE, sizeof (NimfHanjaIndexKey));
+  entries = g_array_sized_new (FALSE, FALSE, sizeof (NimfHanjaIndexEntry),
+                               records->len);
+  pool    = g_byte_array_new ();
+  offsets = g_hash_table_new (g_str_hash, g_str_equal);
+  g_byte_array_append (pool, (const guint8 *) "", 1);
+
+  for (i = 0; i < records->len; i++)
+  {
+    NimfHanjaRecord    *record = &g_array_index (records, NimfHanjaRecord, i);
+    NimfHanjaIndexEntry entry;
+
+    if (i == 0 ||
+        strcmp (record->key, g_array_index (records, NimfHanjaRecord, i - 1).key))
+    {
+      NimfHanjaIndexKey key;
+
+      key.key         = nimf_hanja_index_pool_add (pool, offsets, record->key);
+      key.first_entry = entries->len;
+      key.n_entries   = 0;
+      g_array_append_val (keys, key);
+    }
+
+    g_array_index (keys, NimfHanjaIndexKey, keys->len - 1).n_entries++;
+    entry.value   = nimf_hanja_index_pool_add (pool, offsets, record->value);
+    entry.comment = nimf_hanja_index_pool_add (pool, offsets, record->comment);
+    g_array_append_val (entries, entry);
+  }
+
+  header.version   = NIMF_HANJA_INDEX_VERSION;
+  header.n_keys    = keys->len;
+  header.n_entries = entries->len;
+  header.pool_size = pool->len;
+  memcpy (header.mtime, mtime, sizeof (header.mtime));
+  memcpy (header.size,  size,  sizeof (header.size));
+
+  data = g_byte_array_sized_new (sizeof (header) +
+                                 keys->len * sizeof (NimfHanjaIndexKey) +
+                                 entries->len * sizeof (NimfHanjaIndexEntry) +
+                                 pool->len);
+  g_byte_array_append (data, (const guint8 *) &header, sizeof (header));
+  g_byte_array_append (data, (const guint8 *) keys->data,
+                       keys->len * sizeof (NimfHanjaIndexKey));
+  g_byte_array_append (data, (const guint8 *) entries->data,
+                       entries->len * sizeof (NimfHanjaIndexEntry));
+  g_byte_array_append (data, pool->data, pool->len);
+
+  g_hash_table_unref (offsets);
+  g_hash_table_unref (hanja_keys);
+  g_byte_array_free (pool, TRUE);
+  g_array_free (entries, TRUE);
+  g_array_free (keys, TRUE);
+  g_array_free (records, TRUE);
+  g_free (symbol_contents);
+  g_free (hanja_contents);
+
+  return g_byte_array_free_to_bytes (data);
+}
+
+static gboolean
+nimf_hanja_index_is_valid (GBytes       *bytes,
+                           const gint64  mtime[2],
+                           const gint64  size[2])
+{
+  const NimfHanjaIndexHeader *header;
+  const gchar *data;
+  gsize        len;
+
+  data = g_bytes_get_data (bytes, &len);
+
+  if (len < sizeof (NimfHanjaIndexHeader))
+    return FALSE;
+
+  header = (const NimfHanjaIndexHeader *) data;
+
+  if (memcmp (header->magic, NIMF_HANJA_INDEX_MAGIC, sizeof (header->magic)) ||
+      header->version != NIMF_HANJA_INDEX_VERSION ||
+      memcmp (header->mtime, mtime, sizeof (header->mtime)) ||
+      memcmp (header->size,  size,  sizeof (header->size)))
+    return FALSE;
+
+  if (len != sizeof (NimfHanjaIndexHeader) +
+             (gsize) header->n_keys    * sizeof (NimfHanjaIndexKey) +
+             (gsize) header->n_entries * sizeof (NimfHanjaIndexEntry) +
+             header->pool_size)
+    return FALSE;
+
+  /* so that every offset below pool_size is a terminated string */
+  return header->pool_size > 0 && data[len - 1] == '\0';
+}
+
+static GBytes *
+nimf_hanja_index_map (const gchar  *path,
+                      const gint64  mtime[2],
+                      const gint64  size[2])
+{
+  GMappedFile *file;
+  GBytes      *bytes;
+
+  file = g_mapped_file_new (path, FALSE, NULL);
+
+  if (file == NULL)
+    return NULL;
+
+  bytes = g_mapped_file_get_bytes (file);
+  g_mapped_file_unref (file);
+
+  if (!nimf_hanja_index_is_valid (bytes, mtime, size))
+  {
+    g_bytes_unref (bytes);
+    return NULL;
+  }
+
+  return bytes;
+}
+
+static void
+nimf_hanja_index_load_recent (NimfHanjaIndex *index)
+{
+  gchar  *contents;
+  gchar **lines;
+  gint    i;
+
+  if (!g_file_get_contents (index->recent_path, &contents, NULL, NULL))
+    return;
+
+  lines = g_strsplit (contents, "\n", -1);
+
+  for (i = 0; lines[i] && index->recent->length < NIMF_HANJA_INDEX_MAX_RECENT; i++)
+  {
+    NimfHanjaRecent *recent;
+    gchar           *p = strchr (lines[i], ':');
+
+    if (p == NULL || p == lines[i] || p[1] == '\0')
+      continue;
+
+    recent = g_slice_new (NimfHanjaRecent);
+    recent->key   = g_strndup (lines[i], p - lines[i]);
+    recent->value = g_strdup (p + 1);
+    g_queue_push_tail (index->recent, recent);
+  }
+
+  g_strfreev (lines);
+  g_free (contents);
+}
+
+static void
+nimf_hanja_index_save_recent (NimfHanjaIndex *index)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  GString *string = g_string_new (NULL);
+  GError  *error  = NULL;
+  gchar   *dir;
+  GList   *l;
+
+  for (l = index->recent->head; l; l = l->next)
+  {
+    NimfHanjaRecent *recent = l->data;
+
+    g_string_append_printf (string, "%s:%s\n", recent->key, recent->value);
+  }
+
+  dir = g_path_get_dirname (index->recent_path);
+  g_mkdir_with_parents (dir, 0700);
+
+  if (!g_file_set_contents (index->recent_path, string->str, string->len,
+                            &error))
+  {
+    g_warning (G_STRLOC ": %s: %s", G_STRFUNC, error->message);
+    g_clear_error (&error);
+  }
+
+  g_free (dir);
+  g_string_free (string, TRUE);
+}
+
+static gboolean
+on_save_timeout (NimfHanjaIndex *index)
+{
+  index->save_source_id = 0;
+  nimf_hanja_index_save_recent (index);
+
+  return G_SOURCE_REMOVE;
+}
+
+/* returns NULL if the hanja table can't be read */
+NimfHanjaIndex *
+nimf_hanja_index_new (const gchar *hanja_path,
+                      const gchar *symbol_path)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  NimfHanjaIndex *index;
+  GBytes         *bytes;
+  gchar          *path;
+  gint64          mtime[2];
+  gint64          size[2];
+
+  if (!nimf_hanja_index_stat (hanja_path, &mtime[0], &size[0]))
+    return NULL;
+
+  nimf_hanja_index_stat (symbol_path, &mtime[1], &size[1]);
+
+  path  = g_build_filename (g_get_user_cache_dir (), "nimf", "hanja.idx", NULL);
+  bytes = nimf_hanja_index_map (path, mtime, size);
+
+  if (bytes == NULL)
+  {
+    GError *error = NULL;
+    GBytes *mapped;
+    gchar  *dir;
+
+    bytes = nimf_hanja_index_build (hanja_path, symbol_path, mtime, size);
+
+    if (bytes == NULL)
+    {
+      g_free (path);
+      return NULL;
+    }
+
+    dir = g_path_get_dirname (path);
+    g_mkdir_with_parents (dir, 0700);
+    g_free (dir);
+
+    if (g_file_set_contents (path, g_bytes_get_data (bytes, NULL),
+                             g_bytes_get_size (bytes), &error))
+    {
+      /* share the pages with other processes */
+      if ((mapped = nimf_hanja_index_map (path, mtime, size)))
+      {
+        g_bytes_unref (bytes);
+        bytes = mapped;
+      }
+    }
+    else
+    {
+      g_warning (G_STRLOC ": %s: %s", G_STRFUNC, error->message);
+      g_clear_error (&error);
+    }
+  }
+
+  g_free (path);
+
+  index = g_slice_new0 (NimfHanjaIndex);
+  index->bytes   = bytes;
+  index->header  = g_bytes_get_data (bytes, NULL);
+  index->keys    = (const NimfHanjaIndexKey *) (index->header + 1);
+  index->entries = (const NimfHanjaIndexEntry *) (index->keys +
+                                                  index->header->n_keys);
+  index->pool    = (const gchar *) (index->entries + index->header->n_entries);
+  index->cache       = g_queue_new ();
+  index->cache_links = g_hash_table_new (g_str_hash, g_str_equal);
+  index->recent      = g_queue_new ();
+  index->recent_path = g_build_filename (g_get_user_data_dir (), "nimf",
+                                         "hanja-recent", NULL);
+  nimf_hanja_index_load_recent (index);
+
+  return index;
+}
+
+void
+nimf_hanja_index_free (NimfHanjaIndex *index)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  if (index->save_source_id)
+  {
+    g_source_remove (index->save_source_id);
+    nimf_hanja_index_save_recent (index);
+  }
+
+  g_hash_table_unref (index->cache_links);
+  g_queue_free_full (index->cache,  (GDestroyNotify) nimf_hanja_cached_free);
+  g_queue_free_full (index->recent, (GDestroyNotify) nimf_hanja_recent_free);
+  g_free (index->recent_path);
+  g_bytes_unref (index->bytes);
+  g_slice_free (NimfHanjaIndex, index);
+}
+
+const gchar *
+nimf_hanja_index_get_value (NimfHanjaIndex *index,
+                            guint32         entry)
+{
+  guint32 offset;
+
+  if (entry >= index->header->n_entries)
+    return "";
+
+  offset = index->entries[entry].value;
+
+  return offset < index->header->pool_size ? index->pool + offset : "";
+}
+
+const gchar *
+nimf_hanja_index_get_comment (NimfHanjaIndex *index,
+                              guint32         entry)
+{
+  guint32 offset;
+
+  if (entry >= index->header->n_entries)
+    return "";
+
+  offset = index->entries[entry].comment;
+
+  return offset < index->header->pool_size ? index->pool + offset : "";
+}
+
+static const NimfHanjaIndexKey *
+nimf_hanja_index_find (NimfHanjaIndex *index,
+                       const gchar    *key)
+{
+  guint32 low  = 0;
+  guint32 high = index->header->n_keys;
+
+  while (low < high)
+  {
+    guint32 mid = low + (high - low) / 2;
+    guint32 offset = index->keys[mid].key;
+    gint    cmp;
+
+    if (offset >= index->header->pool_size)
+      return NULL;
+
+    cmp = strcmp (key, index->pool + offset);
+
+    if (cmp == 0)
+      return &index->keys[mid];
+    else if (cmp < 0)
+      high = mid;
+    else
+      low = mid + 1;
+  }
+
+  return NULL;
+}
+
+static void
+nimf_hanja_index_uncache (NimfHanjaIndex *index,
+                          const gchar    *key)
+{
+  GList *link = g_hash_table_lookup (index->cache_links, key);
+
+  if (link == NULL)
+    return;
+
+  g_hash_table_remove (index->cache_links, key);
+  nimf_hanja_cached_free (link->data);
+  g_queue_delete_link (index->cache, link);
+}
+
+/*
+ * Returns the entries of @key, the ones the user selected recently
+ * first, or NULL.  Free with g_array_unref ().
+ */
+GArray *
+nimf_hanja_index_lookup (NimfHanjaIndex *index,
+                         const gchar    *key)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  const NimfHanjaIndexKey *found;
+  NimfHanjaCached         *cached;
+  GArray                  *entries;
+  gboolean                *is_added;
+  GList                   *link;
+  guint32                  i;
+
+  if (key == NULL)
+    return NULL;
+
+  if ((link = g_hash_table_lookup (index->cache_links, key)))
+  {
+    g_queue_unlink (index->cache, link);
+    g_queue_push_head_link (index->cache, link);
+
+    return g_array_ref (((NimfHanjaCached *) link->data)->entries);
+  }
+
+  found = nimf_hanja_index_find (index, key);
+
+  if (found == NULL || found->n_entries == 0 ||
+      found->n_entries   > index->header->n_entries ||
+      found->first_entry > index->header->n_entries - found->n_entries)
+    return NULL;
+
+  entries  = g_array_sized_new (FALSE, FALSE, sizeof (guint32),
+                                found->n_entries);
+  is_added = g_new0 (gboolean, found->n_entries);
+
+  for (link = index->recent->head; link; link = link->next)
+  {
+    NimfHanjaRecent *recent = link->data;
+
+    if (strcmp (recent->key, key))
+      continue;
+
+    for (i = 0; i < found->n_entries; i++)
+    {
+      guint32 entry = found->first_entry + i;
+
+      if (!is_added[i] &&
+          strcmp (nimf_hanja_index_get_value (index, entry), recent->value) == 0)
+      {
+        g_array_append_val (entries, entry);
+        is_added[i] = TRUE;
+        break;
+      }
+    }
+  }
+
+  for (i = 0; i < found->n_entries; i++)
+  {
+    guint32 entry = found->first_entry + i;
+
+    if (!is_added[i])
+      g_array_append_val (entries, entry);
+  }
+
+  g_free (is_added);
+
+  cached = g_slice_new (NimfHanjaCached);
+  cached->key     = g_strdup (key);
+  cached->entries = entries;
+  g_queue_push_head (index->cache, cached);
+  g_hash_table_insert (index->cache_links, cached->key, index->cache->head);
+
+  if (index->cache->length > NIMF_HANJA_INDEX_CACHE_SIZE)
+    nimf_hanja_index_uncache (index,
+                              ((NimfHanjaCached *) index->cache->tail->data)->key);
+
+  return g_array_ref (entries);
+}
+
+void
+nimf_hanja_index_add_selection (NimfHanjaIndex *index,
+                                const gchar    *key,
+                                guint32         entry)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  NimfHanjaRecent *recent;
+  const gchar     *value = nimf_hanja_index_get_value (index, entry);
+  GList           *link;
+
+  if (key == NULL || value[0] == '\0')
+    return;
+
+  for (link = index->recent->head; link; link = link->next)
+  {
+    recent = link->data;
+
+    if (strcmp (recent->key, key) == 0 && strcmp (recent->value, value) == 0)
+    {
+      if (link == index->recent->head)
+        return;
+
+      g_queue_unlink (index->recent, link);
+      g_queue_push_head_link (index->recent, link);
+      break;
+    }
+  }
+
+  if (link == NULL)
+  {
+    recent = g_slice_new (NimfHanjaRecent);
+    recent->key   = g_strdup (key);
+    recent->value = g_strdup (value);
+    g_queue_push_head (index->recent, recent);
+
+    if (index->recent->length > NIMF_HANJA_INDEX_MAX_RECENT)
+      nimf_hanja_recent_free (g_queue_pop_tail (index->recent));
+  }
+
+  nimf_hanja_index_uncache (index, key);
+
+  if (index->save_source_id == 0)
+    index->save_source_id =
+      g_timeout_add_seconds (NIMF_HANJA_INDEX_SAVE_DELAY,
+                             (GSourceFunc) on_save_timeout, index);
+}
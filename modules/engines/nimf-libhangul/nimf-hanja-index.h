@@ -0,0 +1,46 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 2; tab-width: 2 -*- */
+/*
+ * nimf-hanja-index.h
+ * This file is part of Nimf.
+ *
+ * Copyright (C) 2017 Hodong Kim <cogniti@gmail.com>
+ *
+ * Nimf is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Nimf is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program;  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __NIMF_HANJA_INDEX_H__
+#define __NIMF_HANJA_INDEX_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _NimfHanjaIndex NimfHanjaIndex;
+
+NimfHanjaIndex *nimf_hanja_index_new           (const gchar    *hanja_path,
+                                                const gchar    *symbol_path);
+void            nimf_hanja_index_free          (NimfHanjaIndex *index);
+GArray         *nimf_hanja_index_lookup        (NimfHanjaIndex *index,
+                                                const gchar    *key);
+const gchar    *nimf_hanja_index_get_value     (NimfHanjaIndex *index,
+                                                guint32         entry);
+const gchar    *nimf_hanja_index_get_comment   (NimfHanjaIndex *index,
+                                                guint32         entry);
+void            nimf_hanja_index_add_selection (NimfHanjaIndex *index,
+                                                const gchar    *key,
+                                                guint32         entry);
+
+G_END_DECLS
+
+#endif /* __NIMF_HANJA_INDEX_H__ */
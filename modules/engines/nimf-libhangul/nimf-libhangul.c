@@ -21,6 +21,7 @@
 
 #include <nimf.h>
 #include <hangul.h>
+#include "nimf-hanja-index.h"
 #include <glib/gi18n.h>
 
 #define NIMF_TYPE_LIBHANGUL             (nimf_libhangul_get_type ())
@@ -54,8 +55,9 @@ struct _NimfLibhangul
   gboolean            is_committing;
 
   HanjaList          *hanja_list;
-  gint                current_page;
-  gint                n_pages;
+  /* with nimf_libhangul_hanja_index, instead of hanja_list */
+  GArray             *hanja_entries;
+  gchar              *hanja_key;
 };
 
 struct _NimfLibhangulClass
@@ -64,9 +66,10 @@ struct _NimfLibhangulClass
   NimfEngineClass parent_class;
 };
 
-static HanjaTable *nimf_libhangul_hanja_table  = NULL;
-static HanjaTable *nimf_libhangul_symbol_table = NULL;
-static gint        nimf_libhangul_hanja_table_ref_count = 0;
+static NimfHanjaIndex *nimf_libhangul_hanja_index  = NULL;
+static HanjaTable     *nimf_libhangul_hanja_table  = NULL;
+static HanjaTable     *nimf_libhangul_symbol_table = NULL;
+static gint            nimf_libhangul_hanja_table_ref_count = 0;
 
 G_DEFINE_DYNAMIC_TYPE (NimfLibhangul, nimf_libhangul, NIMF_TYPE_ENGINE);
 
@@ -234,6 +237,12 @@ on_candidate_clicked (NimfEngine    *engine,
 
   NimfLibhangul *hangul = NIMF_LIBHANGUL (engine);
 
+  if (hangul->hanja_entries && index >= 0 &&
+      index < (gint) hangul->hanja_entries->len)
+    nimf_hanja_index_add_selection (nimf_libhangul_hanja_index,
+                                    hangul->hanja_key,
+                                    g_array_index (hangul->hanja_entries,
+                                                   guint32, index));
   if (text)
   {
     /* hangul_ic 내부의 commit text가 사라집니다 */
@@ -245,152 +254,50 @@ on_candidate_clicked (NimfEngine    *engine,
   nimf_candidate_hide_window (hangul->candidate);
 }
 
-static gint
-nimf_libhangul_get_current_page (NimfEngine *engine)
-{
-  g_debug (G_STRLOC ": %s", G_STRFUNC);
-
-  return NIMF_LIBHANGUL (engine)->current_page;
-}
-
 static void
-nimf_libhangul_update_page (NimfEngine    *engine,
-                            NimfServiceIM *target)
-{
-  g_debug (G_STRLOC ": %s", G_STRFUNC);
-
-  NimfLibhangul *hangul = NIMF_LIBHANGUL (engine);
-
-  if (hangul->hanja_list == NULL)
-    return;
-
-  gint i;
-  gint list_len = hanja_list_get_size (hangul->hanja_list);
-  nimf_candidate_clear (hangul->candidate, target);
-
-  for (i = (hangul->current_page - 1) * 10;
-       i < MIN (hangul->current_page * 10, list_len); i++)
-  {
-    const Hanja *hanja = hanja_list_get_nth (hangul->hanja_list, i);
-    const char  *item1 = hanja_get_value    (hanja);
-    const char  *item2 = hanja_get_comment  (hanja);
-    nimf_candidate_append (hangul->candidate, item1, item2);
-  }
-
-  nimf_candidate_set_page_values (hangul->candidate, target,
-                                  hangul->current_page, hangul->n_pages, 10);
-}
-
-static gboolean
-nimf_libhangul_page_up (NimfEngine *engine, NimfServiceIM *target)
-{
-  g_debug (G_STRLOC ": %s", G_STRFUNC);
-
-  NimfLibhangul *hangul = NIMF_LIBHANGUL (engine);
-
-  if (hangul->hanja_list == NULL)
-    return FALSE;
-
-  if (hangul->current_page <= 1)
-  {
-    nimf_candidate_select_first_item_in_page (hangul->candidate);
-    return FALSE;
-  }
-
-  hangul->current_page--;
-  nimf_libhangul_update_page (engine, target);
-  nimf_candidate_select_last_item_in_page (hangul->candidate);
-
-  return TRUE;
-}
-
-static gboolean
-nimf_libhangul_page_down (NimfEngine *engine, NimfServiceIM *target)
+nimf_libhangul_clear_hanja (NimfLibhangul *hangul)
 {
-  g_debug (G_STRLOC ": %s", G_STRFUNC);
-
-  NimfLibhangul *hangul = NIMF_LIBHANGUL (engine);
-
-  if (hangul->hanja_list == NULL)
-    return FALSE;
-
-  if (hangul->current_page == hangul->n_pages)
-  {
-    nimf_candidate_select_last_item_in_page (hangul->candidate);
-    return FALSE;
-  }
+  hanja_list_delete (hangul->hanja_list);
+  hangul->hanja_list = NULL;
 
-  hangul->current_page++;
-  nimf_libhangul_update_page (engine, target);
-  nimf_candidate_select_first_item_in_page (hangul->candidate);
+  if (hangul->hanja_entries)
+    g_array_unref (hangul->hanja_entries);
 
-  return TRUE;
+  hangul->hanja_entries = NULL;
+  g_free (hangul->hanja_key);
+  hangul->hanja_key = NULL;
 }
 
 static void
-nimf_libhangul_page_home (NimfEngine *engine, NimfServiceIM *target)
+nimf_libhangul_fill_candidates (NimfLibhangul     *hangul,
+                                gint               offset,
+                                gint               n_items,
+                                NimfCandidateItem *items)
 {
   g_debug (G_STRLOC ": %s", G_STRFUNC);
 
-  NimfLibhangul *hangul = NIMF_LIBHANGUL (engine);
-
-  if (hangul->hanja_list == NULL)
-    return;
+  gint i;
 
-  if (hangul->current_page <= 1)
+  if (hangul->hanja_entries)
   {
-    nimf_candidate_select_first_item_in_page (hangul->candidate);
-    return;
-  }
-
-  hangul->current_page = 1;
-  nimf_libhangul_update_page (engine, target);
-  nimf_candidate_select_first_item_in_page (hangul->candidate);
-}
-
-static void
-nimf_libhangul_page_end (NimfEngine *engine, NimfServiceIM *target)
-{
-  g_debug (G_STRLOC ": %s", G_STRFUNC);
-
-  NimfLibhangul *hangul = NIMF_LIBHANGUL (engine);
+    for (i = 0; i < n_items; i++)
+    {
+      NimfHanjaIndex *index = nimf_libhangul_hanja_index;
+      guint32 entry = g_array_index (hangul->hanja_entries, guint32, offset + i);
 
-  if (hangul->hanja_list == NULL)
-    return;
+      items[i].text  = g_strdup (nimf_hanja_index_get_value   (index, entry));
+      items[i].extra = g_strdup (nimf_hanja_index_get_comment (index, entry));
+    }
 
-  if (hangul->current_page == hangul->n_pages)
-  {
-    nimf_candidate_select_last_item_in_page (hangul->candidate);
     return;
   }
 
-  hangul->current_page = hangul->n_pages;
-  nimf_libhangul_update_page (engine, target);
-  nimf_candidate_select_last_item_in_page (hangul->candidate);
-}
-
-static void
-on_candidate_scrolled (NimfEngine    *engine,
-                       NimfServiceIM *target,
-                       gdouble        value)
-{
-  g_debug (G_STRLOC ": %s", G_STRFUNC);
-
-  NimfLibhangul *hangul = NIMF_LIBHANGUL (engine);
-
-  if ((gint) value == nimf_libhangul_get_current_page (engine))
-    return;
-
-  while (hangul->n_pages > 1)
+  for (i = 0; i < n_items; i++)
   {
-    gint d = (gint) value - nimf_libhangul_get_current_page (engine);
-
-    if (d > 0)
-      nimf_libhangul_page_down (engine, target);
-    else if (d < 0)
-      nimf_libhangul_page_up (engine, target);
-    else if (d == 0)
-      break;
+    const Hanja *hanja = hanja_list_get_nth (hangul->hanja_list, offset + i);
+
+    items[i].text  = g_strdup (hanja_get_value   (hanja));
+    items[i].extra = g_strdup (hanja_get_comment (hanja));
   }
 }
 
@@ -454,27 +361,37 @@ nimf_libhangul_filter_event (NimfEngine    *engine,
   {
     if (nimf_candidate_is_window_visible (hangul->candidate) == FALSE)
     {
-      hanja_list_delete (hangul->hanja_list);
-      nimf_candidate_clear (hangul->candidate, target);
-      hangul->hanja_list = hanja_table_match_exact (nimf_libhangul_hanja_table,
-                                                    hangul->preedit_string);
-      if (hangul->hanja_list == NULL)
-        hangul->hanja_list = hanja_table_match_exact (nimf_libhangul_symbol_table,
+      gint n_items;
+
+      nimf_libhangul_clear_hanja (hangul);
+
+      if (nimf_libhangul_hanja_index)
+      {
+        hangul->hanja_key     = g_strdup (hangul->preedit_string);
+        hangul->hanja_entries = nimf_hanja_index_lookup (nimf_libhangul_hanja_index,
+                                                         hangul->hanja_key);
+        n_items = hangul->hanja_entries ? hangul->hanja_entries->len : 0;
+      }
+      else
+      {
+        hangul->hanja_list = hanja_table_match_exact (nimf_libhangul_hanja_table,
                                                       hangul->preedit_string);
-      hangul->n_pages = (hanja_list_get_size (hangul->hanja_list) + 9) / 10;
-      hangul->current_page = 1;
-      nimf_libhangul_update_page (engine, target);
+        if (hangul->hanja_list == NULL)
+          hangul->hanja_list = hanja_table_match_exact (nimf_libhangul_symbol_table,
+                                                        hangul->preedit_string);
+        n_items = hanja_list_get_size (hangul->hanja_list);
+      }
+
+      nimf_candidate_set_source (hangul->candidate, target, n_items, 10,
+                                 (NimfCandidateFillFunc) nimf_libhangul_fill_candidates,
+                                 hangul);
       nimf_candidate_show_window (hangul->candidate, target, FALSE);
-      nimf_candidate_select_first_item_in_page (hangul->candidate);
     }
     else
     {
       nimf_candidate_hide_window (hangul->candidate);
       nimf_candidate_clear (hangul->candidate, target);
-      hanja_list_delete (hangul->hanja_list);
-      hangul->hanja_list = NULL;
-      hangul->current_page = 0;
-      hangul->n_pages = 0;
+      nimf_libhangul_clear_hanja (hangul);
     }
 
     return TRUE;
@@ -488,7 +405,8 @@ nimf_libhangul_filter_event (NimfEngine    *engine,
       case NIMF_KEY_KP_Enter:
         {
           gchar *text = nimf_candidate_get_selected_text (hangul->candidate);
-          on_candidate_clicked (engine, target, text, -1);
+          on_candidate_clicked (engine, target, text,
+                                nimf_candidate_get_selected_index (hangul->candidate));
           g_free (text);
         }
         break;
@@ -502,17 +420,17 @@ nimf_libhangul_filter_event (NimfEngine    *engine,
         break;
       case NIMF_KEY_Page_Up:
       case NIMF_KEY_KP_Page_Up:
-        nimf_libhangul_page_up (engine, target);
+        nimf_candidate_page_up (hangul->candidate);
         break;
       case NIMF_KEY_Page_Down:
       case NIMF_KEY_KP_Page_Down:
-        nimf_libhangul_page_down (engine, target);
+        nimf_candidate_page_down (hangul->candidate);
         break;
       case NIMF_KEY_Home:
-        nimf_libhangul_page_home (engine, target);
+        nimf_candidate_page_home (hangul->candidate);
         break;
       case NIMF_KEY_End:
-        nimf_libhangul_page_end (engine, target);
+        nimf_candidate_page_end (hangul->candidate);
         break;
       case NIMF_KEY_Escape:
         nimf_candidate_hide_window (hangul->candidate);
@@ -538,11 +456,7 @@ nimf_libhangul_filter_event (NimfEngine    *engine,
       case NIMF_KEY_KP_8:
       case NIMF_KEY_KP_9:
         {
-          if (hangul->hanja_list == NULL || hangul->current_page < 1)
-            break;
-
           gint i, n;
-          gint list_len = hanja_list_get_size (hangul->hanja_list);
 
           if (event->key.keyval >= NIMF_KEY_0 &&
               event->key.keyval <= NIMF_KEY_9)
@@ -553,13 +467,16 @@ nimf_libhangul_filter_event (NimfEngine    *engine,
           else
             break;
 
-          i = (hangul->current_page - 1) * 10 + n;
+          i = nimf_candidate_get_item_index (hangul->candidate, n);
 
-          if (i < MIN (hangul->current_page * 10, list_len))
+          if (i >= 0)
           {
-            const Hanja *hanja = hanja_list_get_nth (hangul->hanja_list, i);
-            const char  *text = hanja_get_value (hanja);
-            on_candidate_clicked (engine, target, (gchar *) text, -1);
+            gchar *text;
+
+            nimf_candidate_select_item_by_index_in_page (hangul->candidate, n);
+            text = nimf_candidate_get_selected_text (hangul->candidate);
+            on_candidate_clicked (engine, target, text, i);
+            g_free (text);
           }
         }
         break;
@@ -738,8 +655,13 @@ nimf_libhangul_init (NimfLibhangul *hangul)
 
   if (nimf_libhangul_hanja_table_ref_count == 0)
   {
-    nimf_libhangul_hanja_table  = hanja_table_load (NULL);
-    nimf_libhangul_symbol_table = hanja_table_load (MSSYMBOL_PATH);
+    nimf_libhangul_hanja_index = nimf_hanja_index_new (HANJA_PATH,
+                                                       MSSYMBOL_PATH);
+    if (nimf_libhangul_hanja_index == NULL)
+    {
+      nimf_libhangul_hanja_table  = hanja_table_load (NULL);
+      nimf_libhangul_symbol_table = hanja_table_load (MSSYMBOL_PATH);
+    }
   }
 
   nimf_libhangul_hanja_table_ref_count++;
@@ -770,13 +692,25 @@ nimf_libhangul_finalize (GObject *object)
 
   NimfLibhangul *hangul = NIMF_LIBHANGUL (object);
 
+  nimf_libhangul_clear_hanja (hangul);
+
   if (--nimf_libhangul_hanja_table_ref_count == 0)
   {
-    hanja_table_delete (nimf_libhangul_hanja_table);
-    hanja_table_delete (nimf_libhangul_symbol_table);
+    if (nimf_libhangul_hanja_index)
+    {
+      nimf_hanja_index_free (nimf_libhangul_hanja_index);
+    }
+    else
+    {
+      hanja_table_delete (nimf_libhangul_hanja_table);
+      hanja_table_delete (nimf_libhangul_symbol_table);
+    }
+
+    nimf_libhangul_hanja_index  = NULL;
+    nimf_libhangul_hanja_table  = NULL;
+    nimf_libhangul_symbol_table = NULL;
   }
 
-  hanja_list_delete (hangul->hanja_list);
   hangul_ic_delete (hangul->context);
   g_free (hangul->preedit_string);
   nimf_preedit_attr_freev (hangul->preedit_attrs);
@@ -821,10 +755,7 @@ nimf_libhangul_class_init (NimfLibhangulClass *class)
   engine_class->focus_in           = nimf_libhangul_focus_in;
   engine_class->focus_out          = nimf_libhangul_focus_out;
 
-  engine_class->candidate_page_up   = nimf_libhangul_page_up;
-  engine_class->candidate_page_down = nimf_libhangul_page_down;
   engine_class->candidate_clicked   = on_candidate_clicked;
-  engine_class->candidate_scrolled  = on_candidate_scrolled;
 
   engine_class->get_id             = nimf_libhangul_get_id;
   engine_class->get_icon_name      = nimf_libhangul_get_icon_name;
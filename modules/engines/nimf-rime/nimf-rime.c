@@ -44,9 +44,13 @@ struct _NimfRime
   NimfPreeditAttr **preedit_attrs;
   NimfPreeditState  preedit_state;
   gint              cursor_pos;
-  RimeSessionId     session_id;
+  RimeSessionId     session_id; /* 0 until deployment finishes */
+  NimfServiceIM    *target;     /* while focused */
   gint              current_page;
   gint              n_pages;
+  gint              page_size;
+  GString          *menu;       /* the page shown, see nimf_rime_menu_to_string () */
+  GString          *next_menu;
 };
 
 struct _NimfRimeClass
@@ -55,7 +59,23 @@ struct _NimfRimeClass
   NimfEngineClass parent_class;
 };
 
-static gint nimf_rime_ref_count = 0;
+typedef enum
+{
+  NIMF_RIME_STATE_STOPPED,
+  NIMF_RIME_STATE_DEPLOYING,
+  NIMF_RIME_STATE_READY
+} NimfRimeState;
+
+/*
+ * Deployment may take seconds after a schema change, so RimeInitialize ()
+ * and maintenance run on nimf_rime_deploy_thread.  Sessions are created
+ * once it is done; until then keys go to the client unfiltered.
+ */
+static gint           nimf_rime_ref_count     = 0;
+static NimfRimeState  nimf_rime_state         = NIMF_RIME_STATE_STOPPED;
+static GThread       *nimf_rime_deploy_thread = NULL;
+static guint          nimf_rime_deploy_serial = 0;
+static GList         *nimf_rime_instances     = NULL;
 
 G_DEFINE_DYNAMIC_TYPE (NimfRime, nimf_rime, NIMF_TYPE_ENGINE);
 
@@ -97,14 +117,19 @@ void nimf_rime_reset (NimfEngine    *engine,
 
   nimf_candidate_hide_window (rime->candidate);
   nimf_rime_update_preedit (engine, target, "", 0);
-  RimeProcessKey (rime->session_id, NIMF_KEY_Escape, 0);
+  g_string_truncate (rime->menu, 0);
+
+  if (rime->session_id)
+    RimeProcessKey (rime->session_id, NIMF_KEY_Escape, 0);
 }
 
 void
 nimf_rime_focus_in (NimfEngine    *engine,
-                    NimfServiceIM *context)
+                    NimfServiceIM *target)
 {
   g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  NIMF_RIME (engine)->target = target;
 }
 
 void
@@ -115,79 +140,96 @@ nimf_rime_focus_out (NimfEngine    *engine,
 
   nimf_candidate_hide_window (NIMF_RIME (engine)->candidate);
   nimf_rime_reset (engine, target);
+  NIMF_RIME (engine)->target = NULL;
+}
+
+/* the candidate page as one string, to tell whether it changed */
+static void
+nimf_rime_menu_to_string (RimeMenu *menu,
+                          GString  *string)
+{
+  gint i;
+
+  g_string_printf (string, "%d %d %d", menu->page_no, menu->page_size,
+                   menu->is_last_page);
+
+  for (i = 0; i < menu->num_candidates; i++)
+  {
+    g_string_append_c (string, '\x1e');
+    g_string_append   (string, menu->candidates[i].text);
+    g_string_append_c (string, '\x1f');
+
+    if (menu->candidates[i].comment)
+      g_string_append (string, menu->candidates[i].comment);
+  }
 }
 
 static void
 nimf_rime_update_candidate (NimfEngine    *engine,
-                            NimfServiceIM *target)
+                            NimfServiceIM *target,
+                            RimeContext   *context)
 {
   g_debug (G_STRLOC ": %s", G_STRFUNC);
 
   NimfRime *rime = NIMF_RIME (engine);
+  GString  *tmp;
   int i;
 
-  RIME_STRUCT (RimeContext, context);
+  nimf_rime_menu_to_string (&context->menu, rime->next_menu);
 
-  if (!RimeGetContext (rime->session_id, &context) ||
-      context.composition.length == 0)
+  if (!g_string_equal (rime->menu, rime->next_menu))
   {
-    nimf_candidate_hide_window (rime->candidate);
-    RimeFreeContext (&context);
-    return;
-  }
+    rime->current_page = context->menu.page_no + 1;
+    rime->n_pages      = context->menu.page_no + 1;
+    rime->page_size    = context->menu.page_size;
 
-  rime->current_page = context.menu.page_no + 1;
-  rime->n_pages = context.menu.page_no + 1;
+    if (!context->menu.is_last_page)
+      rime->n_pages++;
 
-  if (!context.menu.is_last_page)
-    rime->n_pages++;
+    nimf_candidate_clear (rime->candidate, target);
 
-  nimf_candidate_clear (rime->candidate, target);
+    for (i = 0; i < context->menu.num_candidates; i++)
+      nimf_candidate_append (rime->candidate,
+                             context->menu.candidates[i].text,
+                             context->menu.candidates[i].comment);
 
-  for (i = 0; i < context.menu.num_candidates; i++)
-  {
-    nimf_candidate_append (rime->candidate,
-                           context.menu.candidates[i].text,
-                           context.menu.candidates[i].comment);
-    nimf_candidate_select_item_by_index_in_page (rime->candidate,
-                                                 context.menu.highlighted_candidate_index);
+    nimf_candidate_set_page_values (rime->candidate, target,
+                                    rime->current_page, rime->n_pages, 5);
+
+    tmp             = rime->menu;
+    rime->menu      = rime->next_menu;
+    rime->next_menu = tmp;
   }
 
-  nimf_candidate_set_page_values (rime->candidate, target,
-                                  context.menu.page_no + 1, rime->n_pages, 5);
-  RimeFreeContext (&context);
+  nimf_candidate_select_item_by_index_in_page (rime->candidate,
+                                               context->menu.highlighted_candidate_index);
 }
 
 static void nimf_rime_update_preedit2 (NimfEngine    *engine,
-                                       NimfServiceIM *target)
+                                       NimfServiceIM *target,
+                                       RimeContext   *context)
 {
   g_debug (G_STRLOC ": %s", G_STRFUNC);
 
-  NimfRime *rime = NIMF_RIME (engine);
+  NimfRime    *rime    = NIMF_RIME (engine);
+  const gchar *preview = context->commit_text_preview;
+  gint         cursor_pos;
 
-  RIME_STRUCT (RimeContext, context);
+  if (preview == NULL)
+    preview = "";
 
-  if (!RimeGetContext (rime->session_id, &context) ||
-      context.composition.length == 0)
-  {
-    nimf_rime_update_preedit (engine, target, "", 0);
-    nimf_candidate_hide_window (rime->candidate);
-    RimeFreeContext (&context);
-    return;
-  }
+  cursor_pos = g_utf8_strlen (preview, -1);
 
-  if (context.commit_text_preview)
-    nimf_rime_update_preedit (engine, target, context.commit_text_preview,
-                              g_utf8_strlen (context.commit_text_preview, -1));
-  else
-    nimf_rime_update_preedit (engine, target, "", 0);
+  if (rime->cursor_pos != cursor_pos || g_strcmp0 (rime->preedit->str, preview))
+    nimf_rime_update_preedit (engine, target, preview, cursor_pos);
 
+  /* does nothing if unchanged */
   nimf_candidate_set_auxiliary_text (rime->candidate,
-                                     context.composition.preedit,
-                                     context.composition.cursor_pos);
-  RimeFreeContext (&context);
+                                     context->composition.preedit,
+                                     context->composition.cursor_pos);
 }
 
+/* fetches the context once and sends only what changed since the last key */
 static void nimf_rime_update (NimfEngine    *engine,
                               NimfServiceIM *target)
 {
@@ -209,24 +251,28 @@ static void nimf_rime_update (NimfEngine    *engine,
   if (!RimeGetContext (rime->session_id, &context) ||
       context.composition.length == 0)
   {
-    nimf_rime_update_preedit (engine, target, "", 0);
+    if (rime->preedit->len > 0)
+      nimf_rime_update_preedit (engine, target, "", 0);
+
     nimf_candidate_hide_window (rime->candidate);
+    g_string_truncate (rime->menu, 0);
     RimeFreeContext (&context);
     return;
   }
 
-  nimf_rime_update_preedit2 (engine, target);
+  nimf_rime_update_preedit2 (engine, target, &context);
 
   if (context.menu.num_candidates)
   {
-    nimf_rime_update_candidate (engine, target);
+    nimf_rime_update_candidate (engine, target, &context);
 
     if (!nimf_candidate_is_window_visible (rime->candidate))
       nimf_candidate_show_window (rime->candidate, target, TRUE);
   }
-  else
+  else if (rime->menu->len > 0)
   {
     nimf_candidate_clear (rime->candidate, target);
+    g_string_truncate (rime->menu, 0);
   }
 
   RimeFreeContext (&context);
@@ -243,20 +289,10 @@ on_candidate_clicked (NimfEngine    *engine,
   NimfRime *rime = NIMF_RIME (engine);
   RimeApi  *api  = rime_get_api();
 
-  if (RIME_API_AVAILABLE (api, select_candidate))
+  if (rime->menu->len > 0 && RIME_API_AVAILABLE (api, select_candidate))
   {
-    RIME_STRUCT(RimeContext, context);
-
-    if (!RimeGetContext (rime->session_id, &context) ||
-        context.composition.length == 0)
-    {
-      RimeFreeContext (&context);
-      return;
-    }
-
     api->select_candidate (rime->session_id,
-                           context.menu.page_no * context.menu.page_size + index);
-    RimeFreeContext (&context);
+                           (rime->current_page - 1) * rime->page_size + index);
     nimf_rime_update (engine, target);
   }
 }
@@ -267,7 +303,7 @@ nimf_rime_page_up (NimfEngine *engine, NimfServiceIM *target)
   g_debug (G_STRLOC ": %s", G_STRFUNC);
 
   RimeProcessKey (NIMF_RIME (engine)->session_id, NIMF_KEY_Page_Up, 0);
-  nimf_rime_update_candidate (engine, target);
+  nimf_rime_update (engine, target);
 
   return TRUE;
 }
@@ -278,7 +314,7 @@ nimf_rime_page_down (NimfEngine *engine, NimfServiceIM *target)
   g_debug (G_STRLOC ": %s", G_STRFUNC);
 
   RimeProcessKey (NIMF_RIME (engine)->session_id, NIMF_KEY_Page_Down, 0);
-  nimf_rime_update_candidate (engine, target);
+  nimf_rime_update (engine, target);
 
   return TRUE;
 }
@@ -297,7 +333,8 @@ on_candidate_scrolled (NimfEngine    *engine,
 
   while (rime->n_pages > 1)
   {
-    gint d = (gint) value - rime->current_page;
+    gint d    = (gint) value - rime->current_page;
+    gint page = rime->current_page;
 
     if (d > 0)
       nimf_rime_page_down (engine, target);
@@ -305,9 +342,11 @@ on_candidate_scrolled (NimfEngine    *engine,
       nimf_rime_page_up (engine, target);
     else if (d == 0)
       break;
-  }
 
-  nimf_rime_update_preedit2 (engine, target);
+    /* no more pages that way */
+    if (rime->current_page == page)
+      break;
+  }
 }
 
 gboolean
@@ -321,7 +360,7 @@ nimf_rime_filter_event (NimfEngine    *engine,
 
   gboolean retval;
 
-  if (event->key.type == NIMF_EVENT_KEY_RELEASE)
+  if (event->key.type == NIMF_EVENT_KEY_RELEASE || rime->session_id == 0)
     return FALSE;
 
   retval = RimeProcessKey (rime->session_id, event->key.keyval,
@@ -331,6 +370,66 @@ nimf_rime_filter_event (NimfEngine    *engine,
   return retval;
 }
 
+static void
+nimf_rime_start_session (NimfRime *rime)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  rime->session_id = RimeCreateSession ();
+
+  if (rime->target)
+    nimf_engine_emit_engine_changed (NIMF_ENGINE (rime), rime->target);
+}
+
+static gboolean
+on_deployed (gpointer serial)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  /* the last instance was finalized meanwhile */
+  if (GPOINTER_TO_UINT (serial) != nimf_rime_deploy_serial ||
+      nimf_rime_deploy_thread == NULL)
+    return G_SOURCE_REMOVE;
+
+  g_thread_join (nimf_rime_deploy_thread);
+  nimf_rime_deploy_thread = NULL;
+  nimf_rime_state = NIMF_RIME_STATE_READY;
+  g_list_foreach (nimf_rime_instances, (GFunc) nimf_rime_start_session, NULL);
+
+  return G_SOURCE_REMOVE;
+}
+
+static gpointer
+nimf_rime_deploy (gpointer serial)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  gchar *user_data_dir;
+
+  user_data_dir = g_strconcat (g_getenv ("HOME"), "/.config/nimf/rime", NULL);
+
+  if (!g_file_test (user_data_dir, G_FILE_TEST_IS_DIR))
+    g_mkdir_with_parents (user_data_dir, 0700);
+
+  RIME_STRUCT (RimeTraits, traits);
+  traits.shared_data_dir        = "/usr/share/rime-data";
+  traits.user_data_dir          = user_data_dir;
+  traits.distribution_name      = _("Rime");
+  traits.distribution_code_name = "nimf-rime";
+  traits.distribution_version   = "1.2";
+  traits.app_name               = "rime.nimf";
+
+  RimeInitialize (&traits);
+
+  if (RimeStartMaintenance (False))
+    RimeJoinMaintenanceThread ();
+
+  g_free (user_data_dir);
+  g_idle_add (on_deployed, serial);
+
+  return NULL;
+}
+
 static void
 nimf_rime_init (NimfRime *rime)
 {
@@ -339,36 +438,26 @@ nimf_rime_init (NimfRime *rime)
   rime->candidate = nimf_candidate_get_default ();
   rime->id        = g_strdup ("nimf-rime");
   rime->preedit   = g_string_new ("");
+  rime->menu      = g_string_new ("");
+  rime->next_menu = g_string_new ("");
   rime->preedit_attrs  = g_malloc0_n (2, sizeof (NimfPreeditAttr *));
   rime->preedit_attrs[0] = nimf_preedit_attr_new (NIMF_PREEDIT_ATTR_UNDERLINE, 0, 0);
   rime->preedit_attrs[1] = NULL;
 
-  if (nimf_rime_ref_count == 0)
+  if (nimf_rime_state == NIMF_RIME_STATE_STOPPED)
   {
-    gchar *user_data_dir;
-
-    user_data_dir = g_strconcat (g_getenv ("HOME"), "/.config/nimf/rime", NULL);
-
-    if (!g_file_test (user_data_dir, G_FILE_TEST_IS_DIR))
-      g_mkdir_with_parents (user_data_dir, 0700);
-
-    RIME_STRUCT (RimeTraits, traits);
-    traits.shared_data_dir        = "/usr/share/rime-data";
-    traits.user_data_dir          = user_data_dir;
-    traits.distribution_name      = _("Rime");
-    traits.distribution_code_name = "nimf-rime";
-    traits.distribution_version   = "1.2";
-    traits.app_name               = "rime.nimf";
-
-    RimeInitialize (&traits);
-    RimeStartMaintenance (False);
-
-    g_free (user_data_dir);
+    nimf_rime_state = NIMF_RIME_STATE_DEPLOYING;
+    nimf_rime_deploy_serial++;
+    nimf_rime_deploy_thread =
+      g_thread_new ("nimf-rime-deploy", nimf_rime_deploy,
+                    GUINT_TO_POINTER (nimf_rime_deploy_serial));
   }
 
   nimf_rime_ref_count++;
+  nimf_rime_instances = g_list_prepend (nimf_rime_instances, rime);
 
-  rime->session_id = RimeCreateSession();
+  if (nimf_rime_state == NIMF_RIME_STATE_READY)
+    rime->session_id = RimeCreateSession ();
 }
 
 static void
@@ -379,6 +468,8 @@ nimf_rime_finalize (GObject *object)
   NimfRime *rime = NIMF_RIME (object);
 
   g_string_free (rime->preedit, TRUE);
+  g_string_free (rime->menu, TRUE);
+  g_string_free (rime->next_menu, TRUE);
   nimf_preedit_attr_freev (rime->preedit_attrs);
   g_free (rime->id);
 
@@ -388,8 +479,19 @@ nimf_rime_finalize (GObject *object)
     rime->session_id = 0;
   }
 
+  nimf_rime_instances = g_list_remove (nimf_rime_instances, rime);
+
   if (--nimf_rime_ref_count == 0)
+  {
+    if (nimf_rime_deploy_thread)
+    {
+      g_thread_join (nimf_rime_deploy_thread);
+      nimf_rime_deploy_thread = NULL;
+    }
+
     RimeFinalize ();
+    nimf_rime_state = NIMF_RIME_STATE_STOPPED;
+  }
 
   G_OBJECT_CLASS (nimf_rime_parent_class)->finalize (object);
 }
@@ -411,6 +513,10 @@ nimf_rime_get_icon_name (NimfEngine *engine)
 
   g_return_val_if_fail (NIMF_IS_ENGINE (engine), NULL);
 
+  /* deploying */
+  if (NIMF_RIME (engine)->session_id == 0)
+    return "nimf-indicator-warning";
+
   return NIMF_RIME (engine)->id;
 }
 
@@ -54,6 +54,13 @@ private:
 typedef struct _NimfSunpinyin      NimfSunpinyin;
 typedef struct _NimfSunpinyinClass NimfSunpinyinClass;
 
+typedef struct
+{
+  CIMIView          *view;
+  CHotkeyProfile    *hotkey_profile;
+  NimfEngineMetrics *metrics;
+} NimfSunpinyinSession;
+
 struct _NimfSunpinyin
 {
   NimfEngine parent_instance;
@@ -64,9 +71,9 @@ struct _NimfSunpinyin
   NimfPreeditAttr  **preedit_attrs;
   NimfPreeditState   preedit_state;
 
-  CIMIView       *view;
-  CHotkeyProfile *hotkey_profile;
-  NimfWinHandler *win_handler;
+  NimfSunpinyinSession *session; /* while focused */
+  CIMIView             *view;    /* of the session */
+  NimfWinHandler       *win_handler;
 
   gchar *commit_str;
   const IPreeditString *ppd;
@@ -83,6 +90,18 @@ struct _NimfSunpinyinClass
 
 GType nimf_sunpinyin_get_type (void) G_GNUC_CONST;
 
+#define NIMF_SUNPINYIN_MAX_IDLE_SESSIONS 2
+
+/*
+ * A session is checked out on focus-in and returned on focus-out, so there
+ * are about as many sessions as focused contexts, not one per context.
+ * libsunpinyin maps lm_sc.t3g and pydict_sc.bin read-only once per process
+ * and all sessions share them; a session only holds its lattice and
+ * candidate buffers.
+ */
+static GQueue nimf_sunpinyin_idle_sessions = G_QUEUE_INIT;
+static gint   nimf_sunpinyin_ref_count     = 0;
+
 NimfWinHandler::NimfWinHandler(NimfEngine *engine)
   : m_engine(engine)
 {
@@ -166,35 +185,127 @@ NimfWinHandler::updateStatus(int key, int value)
 
 G_DEFINE_DYNAMIC_TYPE (NimfSunpinyin, nimf_sunpinyin, NIMF_TYPE_ENGINE);
 
-static void
-nimf_sunpinyin_init (NimfSunpinyin *pinyin)
+static NimfSunpinyinSession *
+nimf_sunpinyin_session_new (NimfSunpinyin *pinyin)
 {
   g_debug (G_STRLOC ": %s", G_STRFUNC);
 
-  pinyin->candidate = nimf_candidate_get_default ();
-  pinyin->id = g_strdup ("nimf-sunpinyin");
-  pinyin->preedit_string   = g_strdup ("");
-  pinyin->preedit_attrs    = (NimfPreeditAttr **) g_malloc0_n (2, sizeof (NimfPreeditAttr *));
-  pinyin->preedit_attrs[0] = nimf_preedit_attr_new (NIMF_PREEDIT_ATTR_UNDERLINE, 0, 0);
-  pinyin->preedit_attrs[1] = NULL;
+  NimfSunpinyinSession *session;
+  NimfServer           *server = NULL;
+  CIMIView             *view;
+  gint64                start  = g_get_monotonic_time ();
+  glong                 rss_kb = nimf_metrics_get_rss ();
 
   CSunpinyinSessionFactory& factory = CSunpinyinSessionFactory::getFactory();
   factory.setPinyinScheme(CSunpinyinSessionFactory::QUANPIN);
   factory.setCandiWindowSize(10);
-  pinyin->view = factory.createSession();
+  view = factory.createSession();
 
-  if (!pinyin->view)
+  if (!view)
   {
     g_warning (G_STRLOC ": %s: factory.createSession() failed.\n"
                "You probably need to install sunpinyin-data", G_STRFUNC);
-    return;
+    return NULL;
   }
 
-  pinyin->hotkey_profile = new CHotkeyProfile();
-  pinyin->view->setHotkeyProfile(pinyin->hotkey_profile);
+  session = g_slice_new0 (NimfSunpinyinSession);
+  session->view = view;
+  session->hotkey_profile = new CHotkeyProfile();
+  session->view->setHotkeyProfile(session->hotkey_profile);
+
+  g_object_get (pinyin, "server", &server, NULL);
+
+  if (server)
+  {
+    session->metrics = nimf_metrics_get_engine (server->metrics, pinyin->id);
+    session->metrics->n_sessions++;
+    session->metrics->session_rss_kb = nimf_metrics_get_rss () - rss_kb;
+    session->metrics->session_time   = g_get_monotonic_time () - start;
+    g_object_unref (server);
+  }
+
+  return session;
+}
+
+static void
+nimf_sunpinyin_session_free (NimfSunpinyinSession *session)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  CSunpinyinSessionFactory& factory = CSunpinyinSessionFactory::getFactory();
+  factory.destroySession(session->view);
+  delete session->hotkey_profile;
+
+  if (session->metrics)
+    session->metrics->n_sessions--;
+
+  g_slice_free (NimfSunpinyinSession, session);
+}
+
+static CIMIView *
+nimf_sunpinyin_check_out (NimfSunpinyin *pinyin)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
 
-  pinyin->win_handler = new NimfWinHandler(NIMF_ENGINE (pinyin));
+  if (pinyin->session)
+    return pinyin->view;
+
+  pinyin->session = (NimfSunpinyinSession *)
+    g_queue_pop_head (&nimf_sunpinyin_idle_sessions);
+
+  if (pinyin->session == NULL)
+    pinyin->session = nimf_sunpinyin_session_new (pinyin);
+
+  if (pinyin->session == NULL)
+    return NULL;
+
+  pinyin->view = pinyin->session->view;
   pinyin->view->attachWinHandler(pinyin->win_handler);
+  pinyin->current_page = 1;
+
+  return pinyin->view;
+}
+
+static void
+nimf_sunpinyin_return (NimfSunpinyin *pinyin)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  if (pinyin->session == NULL)
+    return;
+
+  pinyin->view->updateWindows(pinyin->view->clearIC());
+  pinyin->view->attachWinHandler(NULL);
+  /* they point into the session */
+  pinyin->ppd = NULL;
+  pinyin->pcl = NULL;
+
+  if (g_queue_get_length (&nimf_sunpinyin_idle_sessions) <
+      NIMF_SUNPINYIN_MAX_IDLE_SESSIONS)
+    g_queue_push_head (&nimf_sunpinyin_idle_sessions, pinyin->session);
+  else
+    nimf_sunpinyin_session_free (pinyin->session);
+
+  pinyin->session      = NULL;
+  pinyin->view         = NULL;
+  pinyin->current_page = 0;
+  pinyin->n_pages      = 0;
+}
+
+static void
+nimf_sunpinyin_init (NimfSunpinyin *pinyin)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  pinyin->candidate = nimf_candidate_get_default ();
+  pinyin->id = g_strdup ("nimf-sunpinyin");
+  pinyin->preedit_string   = g_strdup ("");
+  pinyin->preedit_attrs    = (NimfPreeditAttr **) g_malloc0_n (2, sizeof (NimfPreeditAttr *));
+  pinyin->preedit_attrs[0] = nimf_preedit_attr_new (NIMF_PREEDIT_ATTR_UNDERLINE, 0, 0);
+  pinyin->preedit_attrs[1] = NULL;
+  pinyin->win_handler      = new NimfWinHandler(NIMF_ENGINE (pinyin));
+
+  nimf_sunpinyin_ref_count++;
 }
 
 static void
@@ -204,19 +315,23 @@ nimf_sunpinyin_finalize (GObject *object)
 
   NimfSunpinyin *pinyin = NIMF_SUNPINYIN (object);
 
+  nimf_sunpinyin_return (pinyin);
+
   g_free (pinyin->id);
   g_free (pinyin->preedit_string);
   nimf_preedit_attr_freev (pinyin->preedit_attrs);
   g_free (pinyin->commit_str);
 
-  if (pinyin->view)
+  delete pinyin->win_handler;
+
+  if (--nimf_sunpinyin_ref_count == 0)
   {
-    CSunpinyinSessionFactory& factory = CSunpinyinSessionFactory::getFactory();
-    factory.destroySession(pinyin->view);
-  }
+    NimfSunpinyinSession *session;
 
-  delete pinyin->win_handler;
-  delete pinyin->hotkey_profile;
+    while ((session = (NimfSunpinyinSession *)
+                      g_queue_pop_head (&nimf_sunpinyin_idle_sessions)))
+      nimf_sunpinyin_session_free (session);
+  }
 
   G_OBJECT_CLASS (nimf_sunpinyin_parent_class)->finalize (object);
 }
@@ -278,7 +393,8 @@ void nimf_sunpinyin_update (NimfEngine    *engine,
 
   NimfSunpinyin *pinyin = NIMF_SUNPINYIN (engine);
 
-  g_return_if_fail (pinyin->view != NULL);
+  if (pinyin->view == NULL)
+    return;
 
   /* commit */
   if (pinyin->commit_str)
@@ -325,7 +441,9 @@ nimf_sunpinyin_reset (NimfEngine    *engine,
 
   NimfSunpinyin *pinyin = NIMF_SUNPINYIN (engine);
 
-  g_return_if_fail (pinyin->view != NULL);
+  /* nothing to reset without a session */
+  if (pinyin->view == NULL)
+    return;
 
   pinyin->view->updateWindows(pinyin->view->clearIC());
   nimf_sunpinyin_update (engine, target);
@@ -339,7 +457,8 @@ nimf_sunpinyin_focus_in (NimfEngine    *engine,
 
   NimfSunpinyin *pinyin = NIMF_SUNPINYIN (engine);
 
-  g_return_if_fail (pinyin->view != NULL);
+  if (!nimf_sunpinyin_check_out (pinyin))
+    return;
 
   /* FIXME: This is a workaround for a bug of nimf-sunpinyin
    * "focus-in" may be the next "focus-out". So I put the code that performs
@@ -360,6 +479,7 @@ nimf_sunpinyin_focus_out (NimfEngine    *engine,
   g_return_if_fail (NIMF_IS_ENGINE (engine));
 
   nimf_sunpinyin_reset (engine, target);
+  nimf_sunpinyin_return (NIMF_SUNPINYIN (engine));
 }
 
 static gint
@@ -377,6 +497,9 @@ nimf_sunpinyin_page_up (NimfEngine *engine, NimfServiceIM *target)
 
   NimfSunpinyin *pinyin = NIMF_SUNPINYIN (engine);
 
+  if (pinyin->view == NULL)
+    return FALSE;
+
   if (pinyin->current_page <= 1)
   {
     nimf_candidate_select_first_item_in_page (pinyin->candidate);
@@ -398,6 +521,9 @@ nimf_sunpinyin_page_down (NimfEngine *engine, NimfServiceIM *target)
 
   NimfSunpinyin *pinyin = NIMF_SUNPINYIN (engine);
 
+  if (pinyin->view == NULL)
+    return FALSE;
+
   if (pinyin->current_page >= pinyin->n_pages)
   {
     nimf_candidate_select_last_item_in_page (pinyin->candidate);
@@ -419,6 +545,9 @@ nimf_sunpinyin_page_home (NimfEngine *engine, NimfServiceIM *target)
 
   NimfSunpinyin *pinyin = NIMF_SUNPINYIN (engine);
 
+  if (pinyin->view == NULL)
+    return;
+
   if (pinyin->current_page <= 1)
   {
     nimf_candidate_select_first_item_in_page (pinyin->candidate);
@@ -438,6 +567,9 @@ nimf_sunpinyin_page_end (NimfEngine *engine, NimfServiceIM *target)
 
   NimfSunpinyin *pinyin = NIMF_SUNPINYIN (engine);
 
+  if (pinyin->view == NULL)
+    return;
+
   if (pinyin->current_page >= pinyin->n_pages)
   {
     nimf_candidate_select_last_item_in_page (pinyin->candidate);
@@ -459,6 +591,9 @@ on_candidate_scrolled (NimfEngine    *engine,
 
   NimfSunpinyin *pinyin = NIMF_SUNPINYIN (engine);
 
+  if (pinyin->view == NULL)
+    return;
+
   if ((gint) value == nimf_sunpinyin_get_current_page (engine))
     return;
 
@@ -484,7 +619,9 @@ nimf_sunpinyin_filter_event (NimfEngine    *engine,
 
   NimfSunpinyin *pinyin = NIMF_SUNPINYIN (engine);
 
-  g_return_val_if_fail (pinyin->view != NULL, FALSE);
+  /* in case a key comes without focus-in */
+  if (!nimf_sunpinyin_check_out (pinyin))
+    return FALSE;
 
   gboolean retval = FALSE;
 
@@ -557,7 +694,12 @@ on_candidate_clicked (NimfEngine    *engine,
 {
   g_debug (G_STRLOC ": %s", G_STRFUNC);
 
-  NIMF_SUNPINYIN (engine)->view->onCandidateSelectRequest(index);
+  NimfSunpinyin *pinyin = NIMF_SUNPINYIN (engine);
+
+  if (pinyin->view == NULL)
+    return;
+
+  pinyin->view->onCandidateSelectRequest(index);
   nimf_sunpinyin_update (engine, target);
 }
 
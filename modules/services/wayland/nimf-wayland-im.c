@@ -43,7 +43,22 @@ nimf_wayland_im_emit_commit (NimfServiceIM *im,
 {
   g_debug (G_STRLOC ": %s", G_STRFUNC);
 
-  NimfWayland *wayland = NIMF_WAYLAND_IM (im)->wayland;
+  NimfWaylandIM *wayland_im = NIMF_WAYLAND_IM (im);
+  NimfWayland   *wayland    = wayland_im->wayland;
+
+  /* late emits after deactivate or unavailable have nowhere to go */
+  if (wayland->use_v2)
+  {
+    if (!wayland->input_method_v2)
+      return;
+
+    g_string_append (wayland_im->commit_string, text);
+    wayland_im->pending = TRUE;
+    return;
+  }
+
+  if (!wayland->context)
+    return;
 
   zwp_input_method_context_v1_commit_string (wayland->context,
                                              wayland->serial,
@@ -75,6 +90,18 @@ nimf_wayland_im_emit_preedit_changed (NimfServiceIM    *im,
 
   NimfWayland *wayland = NIMF_WAYLAND_IM (im)->wayland;
 
+  /* the string itself is in im, see nimf_wayland_im_send_pending () */
+  if (wayland->use_v2)
+  {
+    if (wayland->input_method_v2)
+      NIMF_WAYLAND_IM (im)->pending = TRUE;
+
+    return;
+  }
+
+  if (!wayland->context)
+    return;
+
   zwp_input_method_context_v1_preedit_cursor (wayland->context, cursor_pos);
   zwp_input_method_context_v1_preedit_string (wayland->context,
                wayland->serial, preedit_string, preedit_string);
@@ -89,12 +116,62 @@ void nimf_wayland_im_emit_preedit_end (NimfServiceIM *im)
     return;
 
   im->preedit_state = NIMF_PREEDIT_STATE_END;
+  NIMF_WAYLAND_IM (im)->pending = TRUE;
+}
+
+/*
+ * input-method-v2 state is double-buffered and a commit without a
+ * preedit clears it, so everything emitted since the last call goes out
+ * here as one set_preedit_string, one commit_string and one commit.
+ * The event source calls this before it flushes.
+ */
+void
+nimf_wayland_im_send_pending (NimfWaylandIM *wayland_im)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  NimfServiceIM *im      = NIMF_SERVICE_IM (wayland_im);
+  NimfWayland   *wayland = wayland_im->wayland;
+  const gchar   *cursor;
+
+  if (!wayland_im->pending)
+    return;
+
+  wayland_im->pending = FALSE;
+
+  if (!wayland->input_method_v2 || !wayland->active)
+  {
+    g_string_truncate (wayland_im->commit_string, 0);
+    return;
+  }
+
+  if (im->preedit_state == NIMF_PREEDIT_STATE_START &&
+      im->preedit_string && im->preedit_string[0])
+  {
+    cursor = g_utf8_offset_to_pointer (im->preedit_string,
+                                       im->preedit_cursor_pos);
+    zwp_input_method_v2_set_preedit_string (wayland->input_method_v2,
+                                            im->preedit_string,
+                                            cursor - im->preedit_string,
+                                            cursor - im->preedit_string);
+  }
+
+  if (wayland_im->commit_string->len > 0)
+  {
+    zwp_input_method_v2_commit_string (wayland->input_method_v2,
+                                       wayland_im->commit_string->str);
+    g_string_truncate (wayland_im->commit_string, 0);
+  }
+
+  zwp_input_method_v2_commit (wayland->input_method_v2, wayland->serial);
 }
 
 static void
 nimf_wayland_im_init (NimfWaylandIM *im)
 {
   g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  im->commit_string = g_string_new ("");
 }
 
 static void
@@ -102,6 +179,8 @@ nimf_wayland_im_finalize (GObject *object)
 {
   g_debug (G_STRLOC ": %s", G_STRFUNC);
 
+  g_string_free (NIMF_WAYLAND_IM (object)->commit_string, TRUE);
+
   G_OBJECT_CLASS (nimf_wayland_im_parent_class)->finalize (object);
 }
 
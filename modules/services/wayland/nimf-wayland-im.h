@@ -48,11 +48,15 @@ struct _NimfWaylandIM
 {
   NimfServiceIM parent_instance;
   NimfWayland *wayland;
+  /* input-method-v2 state, sent by nimf_wayland_im_send_pending () */
+  GString     *commit_string;
+  gboolean     pending;
 };
 
 GType          nimf_wayland_im_get_type (void) G_GNUC_CONST;
 NimfWaylandIM *nimf_wayland_im_new      (NimfServer  *server,
                                          NimfWayland *wayland);
+void           nimf_wayland_im_send_pending (NimfWaylandIM *im);
 
 G_END_DECLS
 
@@ -0,0 +1,709 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 2; tab-width: 2 -*- */
+/*
+ * nimf-wayland-order-test.c
+ * This file is part of Nimf.
+ *
+ * Copyright (C) 2017 Hodong Kim <cogniti@gmail.com>
+ *
+ * Nimf is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Nimf is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program;  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * A text-input-v3 client that types Hangul through a virtual keyboard and
+ * checks what the input-method-v2 service of nimf sends back:
+ *
+ *  - the text a key commits reaches the client before the key itself,
+ *    so "gks" then Space shows "한 ", not " 한";
+ *  - the preedit goes away in the same done event that commits it, so
+ *    the client never shows an empty preedit in between.
+ *
+ * It needs a compositor with text-input-v3, input-method-v2 and
+ * virtual-keyboard-v1, like sway, and nimf with nimf-libhangul and the
+ * default trigger key (Hangul):
+ *
+ *   WLR_BACKENDS=headless WLR_LIBINPUT_NO_DEVICES=1 sway -c /dev/null &
+ *   WAYLAND_DISPLAY=wayland-1 nimf &
+ *   WAYLAND_DISPLAY=wayland-1 ./nimf-wayland-order-test
+ *
+ * It exits with 0 if the checks pass, 1 if one fails, and 77 if the
+ * compositor lacks what it needs.  Build with
+ * "make nimf-wayland-order-test".
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/input-event-codes.h>
+#include <wayland-client.h>
+#include <xkbcommon/xkbcommon.h>
+#include "text-input-unstable-v3-client-protocol.h"
+#include "virtual-keyboard-unstable-v1-client-protocol.h"
+#include "xdg-shell-client-protocol.h"
+
+#define NIMF_ORDER_TEST_SKIP    77
+#define NIMF_ORDER_TEST_TIMEOUT 2000 /* ms */
+#define NIMF_ORDER_TEST_DELAY   30   /* ms after each key */
+
+typedef struct
+{
+  gboolean  is_key;
+  guint     key;
+  guint     state;
+  gchar    *preedit; /* of a done event */
+  gchar    *commit;
+} NimfOrderEvent;
+
+typedef struct
+{
+  struct wl_display                      *display;
+  struct wl_compositor                   *compositor;
+  struct wl_shm                          *shm;
+  struct xdg_wm_base                     *wm_base;
+  struct wl_seat                         *seat;
+  struct wl_keyboard                     *keyboard;
+  struct zwp_text_input_manager_v3       *text_input_manager;
+  struct zwp_virtual_keyboard_manager_v1 *virtual_keyboard_manager;
+  struct wl_surface                      *surface;
+  struct wl_buffer                       *buffer;
+  struct zwp_text_input_v3               *text_input;
+  struct zwp_virtual_keyboard_v1         *virtual_keyboard;
+  gboolean  configured;
+  gboolean  focused;
+  gboolean  text_input_entered;
+  /* text-input-v3 state, applied on done */
+  gchar    *preedit;
+  gchar    *commit;
+  /* what the client saw, in order */
+  GPtrArray *events;
+  gboolean   verbose;
+} NimfOrderTest;
+
+static void
+nimf_order_event_free (NimfOrderEvent *event)
+{
+  g_free (event->preedit);
+  g_free (event->commit);
+  g_slice_free (NimfOrderEvent, event);
+}
+
+static gint
+nimf_order_test_open_tmp (gsize size)
+{
+  gchar *path;
+  gint   fd;
+
+  fd = g_file_open_tmp ("nimf-wayland-order-test-XXXXXX", &path, NULL);
+
+  if (fd < 0)
+    return -1;
+
+  g_unlink (path);
+  g_free (path);
+
+  if (ftruncate (fd, size) < 0)
+  {
+    close (fd);
+    return -1;
+  }
+
+  return fd;
+}
+
+/* xdg_wm_base */
+static void
+wm_base_ping (void               *data,
+              struct xdg_wm_base *wm_base,
+              uint32_t            serial)
+{
+  xdg_wm_base_pong (wm_base, serial);
+}
+
+static const struct xdg_wm_base_listener wm_base_listener = {
+  .ping = wm_base_ping
+};
+
+/* xdg_surface */
+static void
+xdg_surface_configure (void               *data,
+                       struct xdg_surface *xdg_surface,
+                       uint32_t            serial)
+{
+  NimfOrderTest *test = data;
+
+  xdg_surface_ack_configure (xdg_surface, serial);
+  wl_surface_attach (test->surface, test->buffer, 0, 0);
+  wl_surface_commit (test->surface);
+  test->configured = TRUE;
+}
+
+static const struct xdg_surface_listener xdg_surface_listener = {
+  .configure = xdg_surface_configure
+};
+
+static void
+xdg_toplevel_configure (void                *data,
+                        struct xdg_toplevel *toplevel,
+                        int32_t              width,
+                        int32_t              height,
+                        struct wl_array     *states)
+{
+}
+
+static void
+xdg_toplevel_close (void                *data,
+                    struct xdg_toplevel *toplevel)
+{
+}
+
+static const struct xdg_toplevel_listener xdg_toplevel_listener = {
+  .configure = xdg_toplevel_configure,
+  .close     = xdg_toplevel_close
+};
+
+/* wl_keyboard */
+static void
+keyboard_keymap (void               *data,
+                 struct wl_keyboard *keyboard,
+                 uint32_t            format,
+                 int32_t             fd,
+                 uint32_t            size)
+{
+  close (fd);
+}
+
+static void
+keyboard_enter (void               *data,
+                struct wl_keyboard *keyboard,
+                uint32_t            serial,
+                struct wl_surface  *surface,
+                struct wl_array    *keys)
+{
+  NimfOrderTest *test = data;
+
+  test->focused = TRUE;
+}
+
+static void
+keyboard_leave (void               *data,
+                struct wl_keyboard *keyboard,
+                uint32_t            serial,
+                struct wl_surface  *surface)
+{
+  NimfOrderTest *test = data;
+
+  test->focused = FALSE;
+}
+
+static void
+keyboard_key (void               *data,
+              struct wl_keyboard *keyboard,
+              uint32_t            serial,
+              uint32_t            time,
+              uint32_t            key,
+              uint32_t            state)
+{
+  NimfOrderTest  *test  = data;
+  NimfOrderEvent *event = g_slice_new0 (NimfOrderEvent);
+
+  event->is_key = TRUE;
+  event->key    = key;
+  event->state  = state;
+  g_ptr_array_add (test->events, event);
+
+  if (test->verbose)
+    g_print ("key %u %s\n", key,
+             state == WL_KEYBOARD_KEY_STATE_PRESSED ? "pressed" : "released");
+}
+
+static void
+keyboard_modifiers (void               *data,
+                    struct wl_keyboard *keyboard,
+                    uint32_t            serial,
+                    uint32_t            mods_depressed,
+                    uint32_t            mods_latched,
+                    uint32_t            mods_locked,
+                    uint32_t            group)
+{
+}
+
+static const struct wl_keyboard_listener keyboard_listener = {
+  .keymap    = keyboard_keymap,
+  .enter     = keyboard_enter,
+  .leave     = keyboard_leave,
+  .key       = keyboard_key,
+  .modifiers = keyboard_modifiers
+};
+
+/* wl_seat */
+static void
+seat_capabilities (void           *data,
+                   struct wl_seat *seat,
+                   uint32_t        capabilities)
+{
+  NimfOrderTest *test = data;
+
+  if ((capabilities & WL_SEAT_CAPABILITY_KEYBOARD) && !test->keyboard)
+  {
+    test->keyboard = wl_seat_get_keyboard (seat);
+    wl_keyboard_add_listener (test->keyboard, &keyboard_listener, test);
+  }
+}
+
+static const struct wl_seat_listener seat_listener = {
+  .capabilities = seat_capabilities
+};
+
+/* zwp_text_input_v3 */
+static void
+text_input_enter (void                     *data,
+                  struct zwp_text_input_v3 *text_input,
+                  struct wl_surface        *surface)
+{
+  NimfOrderTest *test = data;
+
+  test->text_input_entered = TRUE;
+  zwp_text_input_v3_enable (text_input);
+  zwp_text_input_v3_commit (text_input);
+}
+
+static void
+text_input_leave (void                     *data,
+                  struct zwp_text_input_v3 *text_input,
+                  struct wl_surface        *surface)
+{
+  NimfOrderTest *test = data;
+
+  test->text_input_entered = FALSE;
+}
+
+static void
+text_input_preedit_string (void                     *data,
+                           struct zwp_text_input_v3 *text_input,
+                           const char               *text,
+                           int32_t                   cursor_begin,
+                           int32_t                   cursor_end)
+{
+  NimfOrderTest *test = data;
+
+  g_free (test->preedit);
+  test->preedit = g_strdup (text);
+}
+
+static void
+text_input_commit_string (void                     *data,
+                          struct zwp_text_input_v3 *text_input,
+                          const char               *text)
+{
+  NimfOrderTest *test = data;
+
+  g_free (test->commit);
+  test->commit = g_strdup (text);
+}
+
+static void
+text_input_delete_surrounding_text (void                     *data,
+                                    struct zwp_text_input_v3 *text_input,
+                                    uint32_t                  before_length,
+                                    uint32_t                  after_length)
+{
+}
+
+static void
+text_input_done (void                     *data,
+                 struct zwp_text_input_v3 *text_input,
+                 uint32_t                  serial)
+{
+  NimfOrderTest  *test  = data;
+  NimfOrderEvent *event = g_slice_new0 (NimfOrderEvent);
+
+  /* the state not sent since the last done is cleared */
+  event->preedit = test->preedit;
+  event->commit  = test->commit;
+  test->preedit  = NULL;
+  test->commit   = NULL;
+  g_ptr_array_add (test->events, event);
+
+  if (test->verbose)
+    g_print ("done preedit \"%s\" commit \"%s\"\n",
+             event->preedit ? event->preedit : "",
+             event->commit  ? event->commit  : "");
+}
+
+static const struct zwp_text_input_v3_listener text_input_listener = {
+  .enter                   = text_input_enter,
+  .leave                   = text_input_leave,
+  .preedit_string          = text_input_preedit_string,
+  .commit_string           = text_input_commit_string,
+  .delete_surrounding_text = text_input_delete_surrounding_text,
+  .done                    = text_input_done
+};
+
+/* wl_registry */
+static void
+registry_global (void               *data,
+                 struct wl_registry *registry,
+                 uint32_t            name,
+                 const char         *interface,
+                 uint32_t            version)
+{
+  NimfOrderTest *test = data;
+
+  if (strcmp (interface, wl_compositor_interface.name) == 0)
+  {
+    test->compositor = wl_registry_bind (registry, name,
+                                         &wl_compositor_interface, 1);
+  }
+  else if (strcmp (interface, wl_shm_interface.name) == 0)
+  {
+    test->shm = wl_registry_bind (registry, name, &wl_shm_interface, 1);
+  }
+  else if (strcmp (interface, xdg_wm_base_interface.name) == 0)
+  {
+    test->wm_base = wl_registry_bind (registry, name,
+                                      &xdg_wm_base_interface, 1);
+    xdg_wm_base_add_listener (test->wm_base, &wm_base_listener, test);
+  }
+  else if (strcmp (interface, wl_seat_interface.name) == 0 && !test->seat)
+  {
+    test->seat = wl_registry_bind (registry, name, &wl_seat_interface, 1);
+    wl_seat_add_listener (test->seat, &seat_listener, test);
+  }
+  else if (strcmp (interface, zwp_text_input_manager_v3_interface.name) == 0)
+  {
+    test->text_input_manager =
+      wl_registry_bind (registry, name,
+                        &zwp_text_input_manager_v3_interface, 1);
+  }
+  else if (strcmp (interface,
+                   zwp_virtual_keyboard_manager_v1_interface.name) == 0)
+  {
+    test->virtual_keyboard_manager =
+      wl_registry_bind (registry, name,
+                        &zwp_virtual_keyboard_manager_v1_interface, 1);
+  }
+}
+
+static void
+registry_global_remove (void               *data,
+                        struct wl_registry *registry,
+                        uint32_t            name)
+{
+}
+
+static const struct wl_registry_listener registry_listener = {
+  .global        = registry_global,
+  .global_remove = registry_global_remove
+};
+
+/* dispatches events for @timeout ms, or until *@flag is set */
+static void
+nimf_order_test_dispatch (NimfOrderTest  *test,
+                          gint            timeout,
+                          const gboolean *flag)
+{
+  gint64 end = g_get_monotonic_time () + timeout * G_TIME_SPAN_MILLISECOND;
+
+  while (!flag || !*flag)
+  {
+    struct pollfd pfd = { wl_display_get_fd (test->display), POLLIN, 0 };
+    gint64        now;
+
+    while (wl_display_prepare_read (test->display) != 0)
+      wl_display_dispatch_pending (test->display);
+
+    wl_display_flush (test->display);
+    now = g_get_monotonic_time ();
+
+    if (now >= end)
+    {
+      wl_display_cancel_read (test->display);
+      break;
+    }
+
+    if (poll (&pfd, 1, (end - now) / G_TIME_SPAN_MILLISECOND + 1) > 0)
+      wl_display_read_events (test->display);
+    else
+      wl_display_cancel_read (test->display);
+
+    wl_display_dispatch_pending (test->display);
+  }
+}
+
+static gboolean
+nimf_order_test_set_keymap (NimfOrderTest *test)
+{
+  struct xkb_context    *context;
+  struct xkb_keymap     *keymap;
+  struct xkb_rule_names  names = { NULL, NULL, "us", NULL, NULL };
+  gchar                 *string;
+  gsize                  size;
+  gint                   fd;
+
+  context = xkb_context_new (XKB_CONTEXT_NO_FLAGS);
+  keymap  = xkb_keymap_new_from_names (context, &names,
+                                       XKB_KEYMAP_COMPILE_NO_FLAGS);
+  xkb_context_unref (context);
+
+  if (!keymap)
+    return FALSE;
+
+  string = xkb_keymap_get_as_string (keymap, XKB_KEYMAP_FORMAT_TEXT_V1);
+  xkb_keymap_unref (keymap);
+  size = strlen (string) + 1;
+  fd   = nimf_order_test_open_tmp (size);
+
+  if (fd < 0 || pwrite (fd, string, size, 0) != (gssize) size)
+  {
+    if (fd >= 0)
+      close (fd);
+
+    free (string);
+    return FALSE;
+  }
+
+  zwp_virtual_keyboard_v1_keymap (test->virtual_keyboard,
+                                  WL_KEYBOARD_KEYMAP_FORMAT_XKB_V1, fd, size);
+  close (fd);
+  free (string);
+
+  return TRUE;
+}
+
+static void
+nimf_order_test_type (NimfOrderTest *test,
+                      guint          key)
+{
+  guint32 time = g_get_monotonic_time () / G_TIME_SPAN_MILLISECOND;
+
+  zwp_virtual_keyboard_v1_key (test->virtual_keyboard, time, key,
+                               WL_KEYBOARD_KEY_STATE_PRESSED);
+  nimf_order_test_dispatch (test, NIMF_ORDER_TEST_DELAY, NULL);
+  zwp_virtual_keyboard_v1_key (test->virtual_keyboard, time + 1, key,
+                               WL_KEYBOARD_KEY_STATE_RELEASED);
+  nimf_order_test_dispatch (test, NIMF_ORDER_TEST_DELAY, NULL);
+}
+
+/*
+ * Types "gks" and then @key, which the engine doesn't take, and checks the
+ * events received from @start on.
+ */
+static gboolean
+nimf_order_test_check (NimfOrderTest *test,
+                       guint          key,
+                       const gchar   *key_name)
+{
+  const gchar *expected = "한";
+  guint        start = test->events->len;
+  gint         commit_index = -1;
+  gint         key_index    = -1;
+  gboolean     in_preedit   = FALSE;
+  gboolean     retval       = TRUE;
+  guint        i;
+
+  nimf_order_test_type (test, KEY_G);
+  nimf_order_test_type (test, KEY_K);
+  nimf_order_test_type (test, KEY_S);
+  nimf_order_test_type (test, key);
+
+  for (i = start; i < test->events->len; i++)
+  {
+    NimfOrderEvent *event = g_ptr_array_index (test->events, i);
+
+    if (event->is_key)
+    {
+      if (key_index < 0 && event->key == key &&
+          event->state == WL_KEYBOARD_KEY_STATE_PRESSED)
+        key_index = i;
+
+      continue;
+    }
+
+    if (commit_index < 0 && g_strcmp0 (event->commit, expected) == 0)
+    {
+      commit_index = i;
+
+      if (event->preedit && event->preedit[0])
+      {
+        g_print ("FAIL: %s: \"%s\" was committed with preedit \"%s\" left\n",
+                 key_name, expected, event->preedit);
+        retval = FALSE;
+      }
+    }
+    else if (commit_index < 0)
+    {
+      gboolean has_preedit = event->preedit && event->preedit[0];
+
+      if (in_preedit && !has_preedit && !(event->commit && event->commit[0]))
+      {
+        g_print ("FAIL: %s: the preedit went away before the commit\n",
+                 key_name);
+        retval = FALSE;
+      }
+
+      in_preedit = has_preedit;
+    }
+  }
+
+  if (commit_index < 0)
+  {
+    g_print ("FAIL: %s: \"%s\" was never committed; "
+             "is nimf-libhangul on and in Korean mode?\n", key_name, expected);
+    return FALSE;
+  }
+
+  if (key_index < 0)
+  {
+    g_print ("FAIL: %s: the key never reached the client\n", key_name);
+    return FALSE;
+  }
+
+  if (key_index < commit_index)
+  {
+    g_print ("FAIL: %s: the key reached the client before \"%s\"\n",
+             key_name, expected);
+    return FALSE;
+  }
+
+  if (retval)
+    g_print ("PASS: %s\n", key_name);
+
+  return retval;
+}
+
+int
+main (int argc, char **argv)
+{
+  NimfOrderTest        test = { NULL };
+  struct wl_registry  *registry;
+  struct xdg_surface  *xdg_surface;
+  struct xdg_toplevel *xdg_toplevel;
+  struct wl_shm_pool  *pool;
+  gboolean             no_trigger = FALSE;
+  gboolean             passed;
+  gint                 fd;
+
+  GOptionContext *option_context;
+  GOptionEntry    entries[] = {
+    {"no-trigger", 0, 0, G_OPTION_ARG_NONE, &no_trigger,
+     "Don't press Hangul first; nimf is in Korean mode already", NULL},
+    {"verbose", 'v', 0, G_OPTION_ARG_NONE, &test.verbose,
+     "Print the events received", NULL},
+    {NULL}
+  };
+
+  option_context = g_option_context_new ("- Check the order of commits and keys");
+  g_option_context_add_main_entries (option_context, entries, NULL);
+
+  if (!g_option_context_parse (option_context, &argc, &argv, NULL))
+  {
+    g_option_context_free (option_context);
+    return EXIT_FAILURE;
+  }
+
+  g_option_context_free (option_context);
+
+  if (!(test.display = wl_display_connect (NULL)))
+  {
+    g_printerr ("SKIP: Can't connect to a Wayland display\n");
+    return NIMF_ORDER_TEST_SKIP;
+  }
+
+  test.events = g_ptr_array_new_with_free_func ((GDestroyNotify) nimf_order_event_free);
+  registry = wl_display_get_registry (test.display);
+  wl_registry_add_listener (registry, &registry_listener, &test);
+  wl_display_roundtrip (test.display);
+  wl_display_roundtrip (test.display);
+
+  if (!test.compositor || !test.shm || !test.wm_base || !test.keyboard ||
+      !test.text_input_manager || !test.virtual_keyboard_manager)
+  {
+    g_printerr ("SKIP: The compositor lacks text-input-v3, "
+                "virtual-keyboard-v1, xdg-shell or a keyboard\n");
+    wl_display_disconnect (test.display);
+    return NIMF_ORDER_TEST_SKIP;
+  }
+
+  /* a mapped window, so it gets the keyboard focus */
+  fd = nimf_order_test_open_tmp (32 * 32 * 4);
+
+  if (fd < 0)
+  {
+    g_printerr ("Can't create a buffer: %s\n", g_strerror (errno));
+    return EXIT_FAILURE;
+  }
+
+  pool = wl_shm_create_pool (test.shm, fd, 32 * 32 * 4);
+  test.buffer = wl_shm_pool_create_buffer (pool, 0, 32, 32, 32 * 4,
+                                           WL_SHM_FORMAT_ARGB8888);
+  wl_shm_pool_destroy (pool);
+  close (fd);
+
+  test.surface = wl_compositor_create_surface (test.compositor);
+  xdg_surface  = xdg_wm_base_get_xdg_surface (test.wm_base, test.surface);
+  xdg_toplevel = xdg_surface_get_toplevel (xdg_surface);
+  xdg_surface_add_listener (xdg_surface, &xdg_surface_listener, &test);
+  xdg_toplevel_add_listener (xdg_toplevel, &xdg_toplevel_listener, &test);
+  xdg_toplevel_set_title (xdg_toplevel, "nimf-wayland-order-test");
+  wl_surface_commit (test.surface);
+
+  test.text_input = zwp_text_input_manager_v3_get_text_input
+                      (test.text_input_manager, test.seat);
+  zwp_text_input_v3_add_listener (test.text_input, &text_input_listener,
+                                  &test);
+  test.virtual_keyboard = zwp_virtual_keyboard_manager_v1_create_virtual_keyboard
+                            (test.virtual_keyboard_manager, test.seat);
+
+  if (!nimf_order_test_set_keymap (&test))
+  {
+    g_printerr ("Can't set the keymap of the virtual keyboard\n");
+    return EXIT_FAILURE;
+  }
+
+  nimf_order_test_dispatch (&test, NIMF_ORDER_TEST_TIMEOUT, &test.configured);
+  nimf_order_test_dispatch (&test, NIMF_ORDER_TEST_TIMEOUT,
+                            &test.text_input_entered);
+
+  if (!test.text_input_entered)
+  {
+    g_printerr ("FAIL: The window didn't get text input focus\n");
+    return EXIT_FAILURE;
+  }
+
+  /* let nimf activate and grab the keyboard */
+  nimf_order_test_dispatch (&test, 300, NULL);
+
+  if (!no_trigger)
+    nimf_order_test_type (&test, KEY_HANGEUL);
+
+  passed = nimf_order_test_check (&test, KEY_SPACE, "Space");
+  passed = nimf_order_test_check (&test, KEY_ENTER, "Enter") && passed;
+
+  zwp_virtual_keyboard_v1_destroy (test.virtual_keyboard);
+  zwp_text_input_v3_destroy (test.text_input);
+  xdg_toplevel_destroy (xdg_toplevel);
+  xdg_surface_destroy (xdg_surface);
+  wl_surface_destroy (test.surface);
+  wl_buffer_destroy (test.buffer);
+  wl_display_roundtrip (test.display);
+  wl_display_disconnect (test.display);
+  g_ptr_array_unref (test.events);
+  g_free (test.preedit);
+  g_free (test.commit);
+
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
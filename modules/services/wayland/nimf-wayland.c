@@ -31,6 +31,8 @@
 #include "nimf-wayland.h"
 #include "nimf-service.h"
 
+#define NIMF_WAYLAND_MAX_KEYMAPS 8
+
 G_DEFINE_DYNAMIC_TYPE (NimfWayland, nimf_wayland, NIMF_TYPE_SERVICE);
 
 typedef struct
@@ -50,6 +52,10 @@ static gboolean nimf_wayland_source_prepare (GSource *base,
 
   *timeout = -1;
 
+  /* what this iteration emitted, in one commit */
+  if (source->wayland->im)
+    nimf_wayland_im_send_pending (source->wayland->im);
+
   if (source->reading)
     return FALSE;
 
@@ -232,17 +238,79 @@ static const struct zwp_input_method_context_v1_listener input_method_context_li
 };
 
 static void
-input_method_keyboard_keymap (void               *data,
-                              struct wl_keyboard *wl_keyboard,
-                              uint32_t            format,
-                              int32_t             fd,
-                              uint32_t            size)
+nimf_wayland_keymap_free (NimfWaylandKeymap *keymap)
 {
   g_debug (G_STRLOC ": %s", G_STRFUNC);
 
-  NimfWayland *wayland = data;
+  xkb_state_unref  (keymap->state);
+  xkb_keymap_unref (keymap->keymap);
+  g_slice_free (NimfWaylandKeymap, keymap);
+}
+
+static NimfWaylandKeymap *
+nimf_wayland_keymap_new (struct xkb_context *xkb_context,
+                         const char         *string)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  NimfWaylandKeymap *keymap;
+  struct xkb_keymap *xkb_keymap;
+  struct xkb_state  *state;
+
+  xkb_keymap = xkb_keymap_new_from_string (xkb_context,
+                                           string,
+                                           XKB_KEYMAP_FORMAT_TEXT_V1,
+                                           XKB_KEYMAP_COMPILE_NO_FLAGS);
+  if (!xkb_keymap)
+  {
+    g_critical (G_STRLOC ": %s: xkb_keymap_new_from_string() failed",
+                G_STRFUNC);
+    return NULL;
+  }
+
+  state = xkb_state_new (xkb_keymap);
+  if (!state)
+  {
+    g_critical (G_STRLOC ": %s: xkb_state_new() failed", G_STRFUNC);
+    xkb_keymap_unref (xkb_keymap);
+    return NULL;
+  }
+
+  keymap = g_slice_new (NimfWaylandKeymap);
+  keymap->keymap = xkb_keymap;
+  keymap->state  = state;
+
+  keymap->shift_mask   = 1 << xkb_keymap_mod_get_index (xkb_keymap, "Shift");
+  keymap->lock_mask    = 1 << xkb_keymap_mod_get_index (xkb_keymap, "Lock");
+  keymap->control_mask = 1 << xkb_keymap_mod_get_index (xkb_keymap, "Control");
+  keymap->mod1_mask    = 1 << xkb_keymap_mod_get_index (xkb_keymap, "Mod1");
+  keymap->mod2_mask    = 1 << xkb_keymap_mod_get_index (xkb_keymap, "Mod2");
+  keymap->mod3_mask    = 1 << xkb_keymap_mod_get_index (xkb_keymap, "Mod3");
+  keymap->mod4_mask    = 1 << xkb_keymap_mod_get_index (xkb_keymap, "Mod4");
+  keymap->mod5_mask    = 1 << xkb_keymap_mod_get_index (xkb_keymap, "Mod5");
+  keymap->super_mask   = 1 << xkb_keymap_mod_get_index (xkb_keymap, "Super");
+  keymap->hyper_mask   = 1 << xkb_keymap_mod_get_index (xkb_keymap, "Hyper");
+  keymap->meta_mask    = 1 << xkb_keymap_mod_get_index (xkb_keymap, "Meta");
+
+  return keymap;
+}
+
+/*
+ * Takes @fd.  Compositors send the keymap again on every focus change
+ * and layout switch, almost always one they sent before, so compiled
+ * keymaps are kept by the content of their string.
+ */
+static void
+nimf_wayland_set_keymap (NimfWayland *wayland,
+                         uint32_t     format,
+                         int32_t      fd,
+                         uint32_t     size)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
 
-  char *map_str;
+  NimfWaylandKeymap *keymap;
+  GBytes            *bytes;
+  char              *map_str;
 
   if (format != WL_KEYBOARD_KEYMAP_FORMAT_XKB_V1)
   {
@@ -257,149 +325,164 @@ input_method_keyboard_keymap (void               *data,
     return;
   }
 
-  wayland->keymap = xkb_keymap_new_from_string (wayland->xkb_context,
-                                                map_str,
-                                                XKB_KEYMAP_FORMAT_TEXT_V1,
-                                                XKB_KEYMAP_COMPILE_NO_FLAGS);
-  munmap (map_str, size);
-  close (fd);
+  bytes  = g_bytes_new_static (map_str, size);
+  keymap = g_hash_table_lookup (wayland->keymaps, bytes);
+  g_bytes_unref (bytes);
 
-  if (!wayland->keymap)
+  if (!keymap)
   {
-    g_critical (G_STRLOC ": %s: xkb_keymap_new_from_string() failed",
-                G_STRFUNC);
-    return;
-  }
+    keymap = nimf_wayland_keymap_new (wayland->xkb_context, map_str);
 
-  wayland->state = xkb_state_new (wayland->keymap);
-  if (!wayland->state)
-  {
-    g_critical (G_STRLOC ": %s: xkb_state_new() failed", G_STRFUNC);
-    xkb_keymap_unref(wayland->keymap);
-    return;
+    if (keymap)
+    {
+      if (g_hash_table_size (wayland->keymaps) >= NIMF_WAYLAND_MAX_KEYMAPS)
+        g_hash_table_remove_all (wayland->keymaps);
+
+      g_hash_table_insert (wayland->keymaps, g_bytes_new (map_str, size),
+                           keymap);
+    }
   }
 
-  wayland->shift_mask =
-    1 << xkb_keymap_mod_get_index (wayland->keymap, "Shift");
-  wayland->lock_mask =
-    1 << xkb_keymap_mod_get_index (wayland->keymap, "Lock");
-  wayland->control_mask =
-    1 << xkb_keymap_mod_get_index (wayland->keymap, "Control");
-  wayland->mod1_mask =
-    1 << xkb_keymap_mod_get_index (wayland->keymap, "Mod1");
-  wayland->mod2_mask =
-    1 << xkb_keymap_mod_get_index (wayland->keymap, "Mod2");
-  wayland->mod3_mask =
-    1 << xkb_keymap_mod_get_index (wayland->keymap, "Mod3");
-  wayland->mod4_mask =
-    1 << xkb_keymap_mod_get_index (wayland->keymap, "Mod4");
-  wayland->mod5_mask =
-    1 << xkb_keymap_mod_get_index (wayland->keymap, "Mod5");
-  wayland->super_mask =
-    1 << xkb_keymap_mod_get_index (wayland->keymap, "Super");
-  wayland->hyper_mask =
-    1 << xkb_keymap_mod_get_index (wayland->keymap, "Hyper");
-  wayland->meta_mask =
-    1 << xkb_keymap_mod_get_index (wayland->keymap, "Meta");
+  munmap (map_str, size);
+  close (fd);
+
+  wayland->keymap = keymap;
 }
 
-static void
-input_method_keyboard_key (void *data,
-                           struct wl_keyboard *wl_keyboard,
-                           uint32_t serial,
-                           uint32_t time,
-                           uint32_t key,
-                           uint32_t state_w)
+/* returns TRUE if the engine took the key */
+static gboolean
+nimf_wayland_filter_key (NimfWayland *wayland,
+                         uint32_t     key,
+                         uint32_t     state_w)
 {
   g_debug (G_STRLOC ": %s", G_STRFUNC);
 
-  NimfWayland *wayland = data;
   uint32_t code;
   uint32_t num_syms;
   const xkb_keysym_t *syms;
   xkb_keysym_t sym;
   enum wl_keyboard_key_state state = state_w;
   guint32 modifiers;
-  NimfEvent *event;
+  NimfEvent event; /* filter_event () doesn't keep it */
 
-  if (!wayland->state)
-    return;
+  if (!wayland->keymap)
+    return FALSE;
 
   code = key + 8;
-  num_syms = xkb_state_key_get_syms (wayland->state, code, &syms);
+  num_syms = xkb_state_key_get_syms (wayland->keymap->state, code, &syms);
 
   sym = XKB_KEY_NoSymbol;
   if (num_syms == 1)
     sym = syms[0];
 
-  event = nimf_event_new (NIMF_EVENT_NOTHING);
-
   modifiers = wayland->modifiers;
   if (state == WL_KEYBOARD_KEY_STATE_RELEASED)
   {
       modifiers |= NIMF_RELEASE_MASK;
-      event->key.type = NIMF_EVENT_KEY_RELEASE;
+      event.key.type = NIMF_EVENT_KEY_RELEASE;
   }
   else
   {
-    event->key.type = NIMF_EVENT_KEY_PRESS;
+    event.key.type = NIMF_EVENT_KEY_PRESS;
   }
 
-  event->key.state = modifiers;
-  event->key.keyval = sym;
-  event->key.hardware_keycode = code;
+  event.key.state = modifiers;
+  event.key.keyval = sym;
+  event.key.hardware_keycode = code;
 
-  if (!nimf_service_im_filter_event (NIMF_SERVICE_IM (wayland->im), event))
-    zwp_input_method_context_v1_key (wayland->context, serial, time, key, state);
-
-  nimf_event_free (event);
+  return nimf_service_im_filter_event (NIMF_SERVICE_IM (wayland->im), &event);
 }
 
 static void
-input_method_keyboard_modifiers (void *data,
-                                 struct wl_keyboard *wl_keyboard,
-                                 uint32_t serial,
-                                 uint32_t mods_depressed,
-                                 uint32_t mods_latched,
-                                 uint32_t mods_locked,
-                                 uint32_t group)
+nimf_wayland_set_modifiers (NimfWayland *wayland,
+                            uint32_t     mods_depressed,
+                            uint32_t     mods_latched,
+                            uint32_t     mods_locked,
+                            uint32_t     group)
 {
   g_debug (G_STRLOC ": %s", G_STRFUNC);
 
-  NimfWayland *wayland = data;
-  struct zwp_input_method_context_v1 *context = wayland->context;
-  xkb_mod_mask_t mask;
+  NimfWaylandKeymap *keymap = wayland->keymap;
+  xkb_mod_mask_t     mask;
 
-  xkb_state_update_mask (wayland->state, mods_depressed,
+  if (!keymap)
+    return;
+
+  xkb_state_update_mask (keymap->state, mods_depressed,
                          mods_latched, mods_locked, 0, 0, group);
-  mask = xkb_state_serialize_mods (wayland->state,
+  mask = xkb_state_serialize_mods (keymap->state,
                                    XKB_STATE_MODS_DEPRESSED |
                                    XKB_STATE_MODS_LATCHED);
   wayland->modifiers = 0;
-  if (mask & wayland->shift_mask)
+  if (mask & keymap->shift_mask)
     wayland->modifiers |= NIMF_SHIFT_MASK;
-  if (mask & wayland->lock_mask)
+  if (mask & keymap->lock_mask)
     wayland->modifiers |= NIMF_LOCK_MASK;
-  if (mask & wayland->control_mask)
+  if (mask & keymap->control_mask)
     wayland->modifiers |= NIMF_CONTROL_MASK;
-  if (mask & wayland->mod1_mask)
+  if (mask & keymap->mod1_mask)
     wayland->modifiers |= NIMF_MOD1_MASK;
-  if (mask & wayland->mod2_mask)
+  if (mask & keymap->mod2_mask)
     wayland->modifiers |= NIMF_MOD2_MASK;
-  if (mask & wayland->mod3_mask)
+  if (mask & keymap->mod3_mask)
     wayland->modifiers |= NIMF_MOD3_MASK;
-  if (mask & wayland->mod4_mask)
+  if (mask & keymap->mod4_mask)
     wayland->modifiers |= NIMF_MOD4_MASK;
-  if (mask & wayland->mod5_mask)
+  if (mask & keymap->mod5_mask)
     wayland->modifiers |= NIMF_MOD5_MASK;
-  if (mask & wayland->super_mask)
+  if (mask & keymap->super_mask)
     wayland->modifiers |= NIMF_SUPER_MASK;
-  if (mask & wayland->hyper_mask)
+  if (mask & keymap->hyper_mask)
     wayland->modifiers |= NIMF_HYPER_MASK;
-  if (mask & wayland->meta_mask)
+  if (mask & keymap->meta_mask)
     wayland->modifiers |= NIMF_META_MASK;
+}
 
-  zwp_input_method_context_v1_modifiers (context, serial,
+static void
+input_method_keyboard_keymap (void               *data,
+                              struct wl_keyboard *wl_keyboard,
+                              uint32_t            format,
+                              int32_t             fd,
+                              uint32_t            size)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  nimf_wayland_set_keymap (data, format, fd, size);
+}
+
+static void
+input_method_keyboard_key (void *data,
+                           struct wl_keyboard *wl_keyboard,
+                           uint32_t serial,
+                           uint32_t time,
+                           uint32_t key,
+                           uint32_t state_w)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  NimfWayland *wayland = data;
+
+  if (!nimf_wayland_filter_key (wayland, key, state_w))
+    zwp_input_method_context_v1_key (wayland->context, serial, time, key,
+                                     state_w);
+}
+
+static void
+input_method_keyboard_modifiers (void *data,
+                                 struct wl_keyboard *wl_keyboard,
+                                 uint32_t serial,
+                                 uint32_t mods_depressed,
+                                 uint32_t mods_latched,
+                                 uint32_t mods_locked,
+                                 uint32_t group)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  NimfWayland *wayland = data;
+
+  nimf_wayland_set_modifiers (wayland, mods_depressed, mods_latched,
+                              mods_locked, group);
+  zwp_input_method_context_v1_modifiers (wayland->context, serial,
                                          mods_depressed, mods_depressed,
                                          mods_latched, group);
 }
@@ -457,6 +540,204 @@ static const struct zwp_input_method_v1_listener input_method_listener = {
   input_method_deactivate
 };
 
+static void
+keyboard_grab_keymap (void                                     *data,
+                      struct zwp_input_method_keyboard_grab_v2 *keyboard_grab,
+                      uint32_t                                  format,
+                      int32_t                                   fd,
+                      uint32_t                                  size)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  NimfWayland *wayland = data;
+
+  /* keys nimf doesn't take go back through the virtual keyboard */
+  zwp_virtual_keyboard_v1_keymap (wayland->virtual_keyboard, format, fd, size);
+  nimf_wayland_set_keymap (wayland, format, fd, size);
+}
+
+static void
+keyboard_grab_key (void                                     *data,
+                   struct zwp_input_method_keyboard_grab_v2 *keyboard_grab,
+                   uint32_t                                  serial,
+                   uint32_t                                  time,
+                   uint32_t                                  key,
+                   uint32_t                                  state)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  NimfWayland *wayland = data;
+
+  if (nimf_wayland_filter_key (wayland, key, state))
+    return;
+
+  /* a commit made by this very key goes out before the key does */
+  if (wayland->im)
+    nimf_wayland_im_send_pending (wayland->im);
+
+  zwp_virtual_keyboard_v1_key (wayland->virtual_keyboard, time, key, state);
+}
+
+static void
+keyboard_grab_modifiers (void                                     *data,
+                         struct zwp_input_method_keyboard_grab_v2 *keyboard_grab,
+                         uint32_t                                  serial,
+                         uint32_t                                  mods_depressed,
+                         uint32_t                                  mods_latched,
+                         uint32_t                                  mods_locked,
+                         uint32_t                                  group)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  NimfWayland *wayland = data;
+
+  nimf_wayland_set_modifiers (wayland, mods_depressed, mods_latched,
+                              mods_locked, group);
+
+  if (wayland->im)
+    nimf_wayland_im_send_pending (wayland->im);
+
+  zwp_virtual_keyboard_v1_modifiers (wayland->virtual_keyboard,
+                                     mods_depressed, mods_latched,
+                                     mods_locked, group);
+}
+
+static void
+keyboard_grab_repeat_info (void                                     *data,
+                           struct zwp_input_method_keyboard_grab_v2 *keyboard_grab,
+                           int32_t                                   rate,
+                           int32_t                                   delay)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+}
+
+static const struct zwp_input_method_keyboard_grab_v2_listener keyboard_grab_listener = {
+  keyboard_grab_keymap,
+  keyboard_grab_key,
+  keyboard_grab_modifiers,
+  keyboard_grab_repeat_info
+};
+
+static void
+input_method_v2_activate (void                       *data,
+                          struct zwp_input_method_v2 *input_method)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  NIMF_WAYLAND (data)->pending_active = TRUE;
+}
+
+static void
+input_method_v2_deactivate (void                       *data,
+                            struct zwp_input_method_v2 *input_method)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  NIMF_WAYLAND (data)->pending_active = FALSE;
+}
+
+static void
+input_method_v2_surrounding_text (void                       *data,
+                                  struct zwp_input_method_v2 *input_method,
+                                  const char                 *text,
+                                  uint32_t                    cursor,
+                                  uint32_t                    anchor)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+}
+
+static void
+input_method_v2_text_change_cause (void                       *data,
+                                   struct zwp_input_method_v2 *input_method,
+                                   uint32_t                    cause)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+}
+
+static void
+input_method_v2_content_type (void                       *data,
+                              struct zwp_input_method_v2 *input_method,
+                              uint32_t                    hint,
+                              uint32_t                    purpose)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+}
+
+static void
+input_method_v2_done (void                       *data,
+                      struct zwp_input_method_v2 *input_method)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  NimfWayland *wayland = data;
+
+  wayland->serial++;
+
+  if (wayland->pending_active == wayland->active)
+    return;
+
+  if (wayland->pending_active)
+  {
+    /* activation starts from an empty state on both sides */
+    g_string_truncate (wayland->im->commit_string, 0);
+    wayland->im->pending = FALSE;
+    wayland->active = TRUE;
+    wayland->keyboard_grab =
+      zwp_input_method_v2_grab_keyboard (wayland->input_method_v2);
+    zwp_input_method_keyboard_grab_v2_add_listener (wayland->keyboard_grab,
+                                                    &keyboard_grab_listener,
+                                                    wayland);
+  }
+  else
+  {
+    /* too late to send anything, the text input has gone */
+    nimf_service_im_reset (NIMF_SERVICE_IM (wayland->im));
+    wayland->active = FALSE;
+
+    if (wayland->keyboard_grab)
+    {
+      zwp_input_method_keyboard_grab_v2_release (wayland->keyboard_grab);
+      wayland->keyboard_grab = NULL;
+    }
+  }
+}
+
+static void
+input_method_v2_unavailable (void                       *data,
+                             struct zwp_input_method_v2 *input_method)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  NimfWayland *wayland = data;
+
+  g_warning (G_STRLOC ": %s: Another input method is running", G_STRFUNC);
+
+  /* whatever the engine emits here is dropped, see nimf-wayland-im.c */
+  nimf_service_im_reset     (NIMF_SERVICE_IM (wayland->im));
+  nimf_service_im_focus_out (NIMF_SERVICE_IM (wayland->im));
+
+  if (wayland->keyboard_grab)
+  {
+    zwp_input_method_keyboard_grab_v2_release (wayland->keyboard_grab);
+    wayland->keyboard_grab = NULL;
+  }
+
+  zwp_input_method_v2_destroy (wayland->input_method_v2);
+  wayland->input_method_v2 = NULL;
+  wayland->active         = FALSE;
+  wayland->pending_active = FALSE;
+}
+
+static const struct zwp_input_method_v2_listener input_method_v2_listener = {
+  input_method_v2_activate,
+  input_method_v2_deactivate,
+  input_method_v2_surrounding_text,
+  input_method_v2_text_change_cause,
+  input_method_v2_content_type,
+  input_method_v2_done,
+  input_method_v2_unavailable
+};
+
 static void
 registry_handle_global (void               *data,
                         struct wl_registry *registry,
@@ -469,12 +750,17 @@ registry_handle_global (void               *data,
   NimfWayland *wayland = data;
 
   if (!g_strcmp0 (interface, "zwp_input_method_v1"))
-  {
-    wayland->input_method =
-      wl_registry_bind (registry, name, &zwp_input_method_v1_interface, 1);
-    zwp_input_method_v1_add_listener (wayland->input_method,
-                                      &input_method_listener, wayland);
-  }
+    wayland->input_method_name = name;
+  else if (!g_strcmp0 (interface, "zwp_input_method_manager_v2"))
+    wayland->input_method_manager =
+      wl_registry_bind (registry, name,
+                        &zwp_input_method_manager_v2_interface, 1);
+  else if (!g_strcmp0 (interface, "zwp_virtual_keyboard_manager_v1"))
+    wayland->virtual_keyboard_manager =
+      wl_registry_bind (registry, name,
+                        &zwp_virtual_keyboard_manager_v1_interface, 1);
+  else if (!g_strcmp0 (interface, "wl_seat") && !wayland->seat)
+    wayland->seat = wl_registry_bind (registry, name, &wl_seat_interface, 1);
 }
 
 static void
@@ -505,7 +791,30 @@ static gboolean nimf_wayland_start (NimfService *service)
   wayland->registry = wl_display_get_registry (wayland->display);
   wl_registry_add_listener (wayland->registry, &registry_listener, wayland);
   wl_display_roundtrip (wayland->display);
-  if (wayland->input_method == NULL)
+
+  /* v2 needs a virtual keyboard to pass on the keys nimf doesn't take */
+  if (wayland->input_method_manager && wayland->virtual_keyboard_manager &&
+      wayland->seat)
+  {
+    wayland->use_v2 = TRUE;
+    wayland->input_method_v2 =
+      zwp_input_method_manager_v2_get_input_method (wayland->input_method_manager,
+                                                    wayland->seat);
+    zwp_input_method_v2_add_listener (wayland->input_method_v2,
+                                      &input_method_v2_listener, wayland);
+    wayland->virtual_keyboard =
+      zwp_virtual_keyboard_manager_v1_create_virtual_keyboard (
+        wayland->virtual_keyboard_manager, wayland->seat);
+  }
+  else if (wayland->input_method_name)
+  {
+    wayland->input_method =
+      wl_registry_bind (wayland->registry, wayland->input_method_name,
+                        &zwp_input_method_v1_interface, 1);
+    zwp_input_method_v1_add_listener (wayland->input_method,
+                                      &input_method_listener, wayland);
+  }
+  else
   {
     g_critical (G_STRLOC ": %s: No input_method global", G_STRFUNC);
     return FALSE;
@@ -517,6 +826,9 @@ static gboolean nimf_wayland_start (NimfService *service)
     return FALSE;
   }
 
+  wayland->keymaps = g_hash_table_new_full (g_bytes_hash, g_bytes_equal,
+                                    (GDestroyNotify) g_bytes_unref,
+                                    (GDestroyNotify) nimf_wayland_keymap_free);
   wayland->im = nimf_wayland_im_new (NIMF_SERVICE (wayland)->server, wayland);
   wayland->context = NULL;
   wayland->event_source = nimf_wayland_source_new (wayland);
@@ -555,6 +867,9 @@ nimf_wayland_finalize (GObject *object)
   if (wayland->im)
     g_object_unref (wayland->im);
 
+  if (wayland->keymaps)
+    g_hash_table_unref (wayland->keymaps);
+
   G_OBJECT_CLASS (nimf_wayland_parent_class)->finalize (object);
 }
 
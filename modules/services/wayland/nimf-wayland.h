@@ -37,6 +37,8 @@
 #include <wayland-server.h>
 #include <xkbcommon/xkbcommon.h>
 #include "input-method-unstable-v1-client-protocol.h"
+#include "input-method-unstable-v2-client-protocol.h"
+#include "virtual-keyboard-unstable-v1-client-protocol.h"
 
 #define NIMF_TYPE_WAYLAND             (nimf_wayland_get_type ())
 #define NIMF_WAYLAND(obj)             (G_TYPE_CHECK_INSTANCE_CAST ((obj), NIMF_TYPE_WAYLAND, NimfWayland))
@@ -47,6 +49,24 @@
 
 typedef struct _NimfWaylandIM  NimfWaylandIM;
 
+/* a compiled keymap, cached by the content of its string */
+typedef struct
+{
+  struct xkb_keymap *keymap;
+  struct xkb_state  *state;
+  xkb_mod_mask_t     shift_mask;
+  xkb_mod_mask_t     lock_mask;
+  xkb_mod_mask_t     control_mask;
+  xkb_mod_mask_t     mod1_mask;
+  xkb_mod_mask_t     mod2_mask;
+  xkb_mod_mask_t     mod3_mask;
+  xkb_mod_mask_t     mod4_mask;
+  xkb_mod_mask_t     mod5_mask;
+  xkb_mod_mask_t     super_mask;
+  xkb_mod_mask_t     hyper_mask;
+  xkb_mod_mask_t     meta_mask;
+} NimfWaylandKeymap;
+
 typedef struct _NimfWayland      NimfWayland;
 typedef struct _NimfWaylandClass NimfWaylandClass;
 
@@ -68,26 +88,26 @@ struct _NimfWayland
   struct wl_display  *display;
   struct wl_registry *registry;
   struct wl_keyboard *keyboard;
+  uint32_t            input_method_name; /* bound if v2 is missing */
+  /* input-method-v2, preferred over v1 */
+  struct wl_seat                           *seat;
+  struct zwp_input_method_manager_v2       *input_method_manager;
+  struct zwp_input_method_v2               *input_method_v2;
+  struct zwp_input_method_keyboard_grab_v2 *keyboard_grab;
+  struct zwp_virtual_keyboard_manager_v1   *virtual_keyboard_manager;
+  struct zwp_virtual_keyboard_v1           *virtual_keyboard;
+  gboolean use_v2; /* stays set after input_method_v2 has gone */
+  gboolean active;
+  gboolean pending_active; /* applied on done */
 
   struct xkb_context *xkb_context;
 
   NimfModifierType modifiers;
 
-  struct xkb_keymap *keymap;
-  struct xkb_state *state;
-  xkb_mod_mask_t shift_mask;
-  xkb_mod_mask_t lock_mask;
-  xkb_mod_mask_t control_mask;
-  xkb_mod_mask_t mod1_mask;
-  xkb_mod_mask_t mod2_mask;
-  xkb_mod_mask_t mod3_mask;
-  xkb_mod_mask_t mod4_mask;
-  xkb_mod_mask_t mod5_mask;
-  xkb_mod_mask_t super_mask;
-  xkb_mod_mask_t hyper_mask;
-  xkb_mod_mask_t meta_mask;
-
-  uint32_t serial;
+  GHashTable        *keymaps; /* GBytes to NimfWaylandKeymap */
+  NimfWaylandKeymap *keymap;  /* in keymaps */
+
+  uint32_t serial; /* v1: commit_state serial, v2: number of done events */
 };
 
 GType nimf_wayland_get_type (void) G_GNUC_CONST;
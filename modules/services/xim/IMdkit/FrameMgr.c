@@ -144,6 +144,43 @@ typedef union
 #define NO_VALUE -1
 #define NO_VALID_FIELD -2
 
+/*
+ * Every message builds a FrameMgr and a chain of records, so freed
+ * records are kept for the next message rather than handed back to
+ * malloc.  IMdkit is only used from one thread.
+ */
+#define FM_POOL_SIZE 32
+
+typedef struct
+{
+    int size;
+    int count;
+    void *items[FM_POOL_SIZE];
+} FmPoolRec, *FmPool;
+
+static FmPoolRec frame_mgr_pool  = { sizeof (FrameMgrRec) };
+static FmPoolRec frame_inst_pool = { sizeof (FrameInstRec) };
+static FmPoolRec frame_iter_pool = { sizeof (FrameIterRec) };
+static FmPoolRec iter_pool       = { sizeof (IterRec) };
+static FmPoolRec chain_pool      = { sizeof (ChainRec) };
+
+static void *FmPoolAlloc (FmPool pool)
+{
+    if (pool->count > 0)
+        return pool->items[--pool->count];
+    /*endif*/
+    return Xmalloc (pool->size);
+}
+
+static void FmPoolFree (FmPool pool, void *p)
+{
+    if (pool->count < FM_POOL_SIZE)
+        pool->items[pool->count++] = p;
+    else
+        Xfree (p);
+    /*endif*/
+}
+
 static FrameInst FrameInstInit(XimFrame frame);
 static void FrameInstFree(FrameInst fi);
 static XimFrameType FrameInstGetNextType(FrameInst fi, XimFrameTypeInfo info);
@@ -198,7 +235,7 @@ NO_VALUE : (it)->max_count)
     while (cur)                         \
     {                                   \
         tmp = cur->next;                \
-        Xfree (cur);                    \
+        FmPoolFree (&chain_pool, cur);  \
 	cur = tmp;                      \
     }                                   \
 }
@@ -217,7 +254,7 @@ FrameMgr FrameMgrInit (XimFrame frame, char* area, Bool byte_swap)
 {
     FrameMgr fm;
 
-    fm = (FrameMgr) Xmalloc (sizeof (FrameMgrRec));
+    fm = (FrameMgr) FmPoolAlloc (&frame_mgr_pool);
 
     fm->frame = frame;
     fm->fi = FrameInstInit (frame);
@@ -253,13 +290,13 @@ void FrameMgrFree (FrameMgr fm)
     while (p)
     {
         p = p->next;
-        Xfree (cur);
+        FmPoolFree (&frame_iter_pool, cur);
         cur = p;
     }
     /*endwhile*/
 
     FrameInstFree (fm->fi);
-    Xfree (fm);
+    FmPoolFree (&frame_mgr_pool, fm);
 }
 
 FmStatus FrameMgrSetBuffer (FrameMgr fm, void* area)
@@ -867,7 +904,7 @@ static FrameInst FrameInstInit (XimFrame frame)
 {
     FrameInst fi;
 
-    fi = (FrameInst) Xmalloc (sizeof (FrameInstRec));
+    fi = (FrameInst) FmPoolAlloc (&frame_inst_pool);
 
     fi->template = frame;
     fi->cur_no = 0;
@@ -904,7 +941,7 @@ static void FrameInstFree (FrameInst fi)
     /*endwhile*/
     ChainIterFree (&ci);
     ChainMgrFree (&fi->cm);
-    Xfree (fi);
+    FmPoolFree (&frame_inst_pool, fi);
 }
 
 static XimFrameType FrameInstGetNextType(FrameInst fi, XimFrameTypeInfo info)
@@ -1228,11 +1265,11 @@ static FrameIter _FrameMgrAppendIter (FrameMgr fm, Iter it, int end)
     if (!p)
     {
         fm->iters =
-        p = (FrameIter) Xmalloc (sizeof (FrameIterRec));
+        p = (FrameIter) FmPoolAlloc (&frame_iter_pool);
     }
     else
     {
-        p->next = (FrameIter) Xmalloc (sizeof (FrameIterRec));
+        p->next = (FrameIter) FmPoolAlloc (&frame_iter_pool);
         p = p->next;
     }
     /*endif*/
@@ -1264,7 +1301,7 @@ static void _FrameMgrRemoveIter (FrameMgr fm, FrameIter it)
             else
                 fm->iters = p->next;
             /*endif*/
-            Xfree (p);
+            FmPoolFree (&frame_iter_pool, p);
             break;
         }
         /*endif*/
@@ -1517,7 +1554,7 @@ static Iter IterInit (XimFrame frame, int count)
     Iter it;
     register XimFrameType type;
 
-    it = (Iter) Xmalloc (sizeof (IterRec));
+    it = (Iter) FmPoolAlloc (&iter_pool);
     it->template = frame;
     it->max_count = (count == NO_VALUE)  ?  0  :  count;
     it->allow_expansion = (count == NO_VALUE);
@@ -1530,7 +1567,7 @@ static Iter IterInit (XimFrame frame, int count)
     if (type & COUNTER_MASK)
     {
         /* COUNTER_XXX cannot be an item of a ITER */
-        Xfree (it);
+        FmPoolFree (&iter_pool, it);
         return NULL;
     }
     /*endif*/
@@ -1551,7 +1588,7 @@ static Iter IterInit (XimFrame frame, int count)
         break;
         
     default:
-        Xfree (it);
+        FmPoolFree (&iter_pool, it);
         return NULL; /* This should never occur */
     }
     /*endswitch*/
@@ -1600,7 +1637,7 @@ static void IterFree (Iter it)
 	break;
     }
     /*endswitch*/
-    Xfree (it);
+    FmPoolFree (&iter_pool, it);
 }
 
 static Bool IterIsLoopEnd (Iter it, Bool *myself)
@@ -2246,7 +2283,7 @@ static ExtraData ChainMgrSetData (ChainMgr cm,
                                   int frame_no,
                                   ExtraDataRec data)
 {
-    Chain cur = (Chain) Xmalloc (sizeof (ChainRec));
+    Chain cur = (Chain) FmPoolAlloc (&chain_pool);
 
     cur->frame_no = frame_no;
     cur->d = data;
@@ -52,6 +52,7 @@ extern "C" {
 #define IMFilterEventMask	"filterEventMask"
 #define IMProtocolDepend	"protocolDepend"
 #define IMUserData		"userData"
+#define IMXcbConnection		"xcbConnection"
 
 /* Masks for IM Attributes Name */
 #define I18N_IMSERVER_WIN	0x0001 /* IMServerWindow */
@@ -66,6 +67,7 @@ extern "C" {
 #define I18N_FILTERMASK		0x0200 /* IMFilterEventMask */
 #define I18N_PROTO_DEPEND	0x0400 /* IMProtoDepend */
 #define I18N_IM_USER_DATA	0x0800 /* IMUserData */
+#define I18N_XCB_CONNECTION	0x1000 /* IMXcbConnection */
 
 typedef struct
 {
@@ -36,6 +36,7 @@ IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
 #include <X11/Xlib.h>
 #include <X11/Xfuncs.h>
 #include <X11/Xos.h>
+#include <xcb/xcb.h>
 #include "XimProto.h"
 
 /*
@@ -166,6 +167,11 @@ typedef struct _Xi18nClient
     int		sync;
     XIMPending  *pending;
     Xi18nOffsetCache offset_cache;
+    Bool	utf8;		/* UTF8_STRING was negotiated */
+    unsigned char *reply_buffer;	/* see _Xi18nGetReplyBuffer () */
+    int		reply_buffer_size;
+    unsigned char *send_buffer;		/* header and data being sent */
+    int		send_buffer_size;
     void *trans_rec;		/* contains transport specific data  */
     struct _Xi18nClient *next;
 } Xi18nClient;
@@ -464,6 +470,7 @@ typedef int (*IMProtoHandler) (XIMS, IMProtocol*, void*);
 typedef struct _Xi18nAddressRec
 {
     Display	*dpy;
+    xcb_connection_t *xcb;	/* IMXcbConnection, carries the X transport */
     CARD8	im_byteOrder;	/* byte order 'B' or 'l' */
     /* IM Values */
     long	imvalue_mask;
@@ -490,6 +497,7 @@ typedef struct _Xi18nAddressRec
     CARD16	preeditAttr_id;
     CARD16	statusAttr_id;
     CARD16	separatorAttr_id;
+    CARD16	spotLocation_id;
     /* XIMExtension List */
     int		ext_num;
     XIMExt	extension[COMMON_EXTENSIONS_NUM];
@@ -511,6 +519,7 @@ typedef struct _Xi18nMethodsRec
     Bool (*send) (XIMS, CARD16, unsigned char*, long);
     Bool (*wait) (XIMS, CARD16, CARD8, CARD8);
     Bool (*disconnect) (XIMS, CARD16);
+    Bool (*filter) (XIMS, xcb_generic_event_t *);
 } Xi18nMethodsRec;
 
 typedef struct _Xi18nCore
@@ -36,17 +36,21 @@ IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
 #define _XIM_XCONNECT           "_XIM_XCONNECT"
 
 #define XCM_DATA_LIMIT		20
+#define XCM_SERVER_ATOMS	21	/* _server<connect_id>_<0..20> */
 
 typedef struct _XClient
 {
     Window	client_win;	/* client window */
     Window	accept_win;	/* accept window */
+    /* requested when the client connects, replies read on first use */
+    xcb_intern_atom_cookie_t server_atom_cookies[XCM_SERVER_ATOMS];
+    xcb_atom_t	server_atoms[XCM_SERVER_ATOMS];
 } XClient;
 
 typedef struct
 {
-    Atom	xim_request;
-    Atom	connect_request;
+    xcb_atom_t	xim_request;
+    xcb_atom_t	connect_request;
 } XSpecRec;
 
 #endif
@@ -125,6 +125,8 @@ static XIMAttr *CreateAttrList (Xi18n i18n_core,
             i18n_core->address.statusAttr_id = p->attribute_id;
         else if (strcmp (p->name, XNSeparatorofNestedList) == 0)
             i18n_core->address.separatorAttr_id = p->attribute_id;
+        else if (strcmp (p->name, XNSpotLocation) == 0)
+            i18n_core->address.spotLocation_id = p->attribute_id;
         /*endif*/
     }
     /*endfor*/
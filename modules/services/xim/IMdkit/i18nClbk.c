@@ -51,7 +51,7 @@ int _Xi18nGeometryCallback (XIMS ims, IMProtocol *call_data)
                        _Xi18nNeedSwap (i18n_core, connect_id));
 
     total_size = FrameMgrGetTotalSize (fm);
-    reply = (unsigned char *) malloc (total_size);
+    reply = _Xi18nGetReplyBuffer (i18n_core, connect_id, total_size);
     if (!reply)
     {
         _Xi18nSendMessage (ims, connect_id, XIM_ERROR, 0, 0, 0);
@@ -71,7 +71,6 @@ int _Xi18nGeometryCallback (XIMS ims, IMProtocol *call_data)
                        reply,
                        total_size);
     FrameMgrFree (fm);
-    XFree (reply);
 
     /* XIM_GEOMETRY is an asyncronous protocol,
        so return immediately. */
@@ -93,7 +92,7 @@ int _Xi18nPreeditStartCallback (XIMS ims, IMProtocol *call_data)
                        NULL,
                        _Xi18nNeedSwap (i18n_core, connect_id));
     total_size = FrameMgrGetTotalSize (fm);
-    reply = (unsigned char *) malloc (total_size);
+    reply = _Xi18nGetReplyBuffer (i18n_core, connect_id, total_size);
     if (!reply)
     {
         _Xi18nSendMessage(ims, connect_id, XIM_ERROR, 0, 0, 0);
@@ -113,7 +112,6 @@ int _Xi18nPreeditStartCallback (XIMS ims, IMProtocol *call_data)
                        reply,
                        total_size);
     FrameMgrFree (fm);
-    XFree (reply);
 
     return True;
 }
@@ -155,7 +153,7 @@ int _Xi18nPreeditDrawCallback (XIMS ims, IMProtocol *call_data)
     FrameMgrSetIterCount (fm, feedback_count);
 
     total_size = FrameMgrGetTotalSize (fm);
-    reply = (unsigned char *) malloc (total_size);
+    reply = _Xi18nGetReplyBuffer (i18n_core, connect_id, total_size);
     if (!reply)
     {
         _Xi18nSendMessage (ims, connect_id, XIM_ERROR, 0, 0, 0);
@@ -184,7 +182,6 @@ int _Xi18nPreeditDrawCallback (XIMS ims, IMProtocol *call_data)
                        reply,
                        total_size);
     FrameMgrFree (fm);
-    XFree (reply);
 
     /* XIM_PREEDIT_DRAW is an asyncronous protocol, so return immediately. */
     return True;
@@ -208,7 +205,7 @@ int _Xi18nPreeditCaretCallback (XIMS ims, IMProtocol *call_data)
                        _Xi18nNeedSwap (i18n_core, connect_id));
 
     total_size = FrameMgrGetTotalSize (fm);
-    reply = (unsigned char *) malloc (total_size);
+    reply = _Xi18nGetReplyBuffer (i18n_core, connect_id, total_size);
     if (!reply)
     {
         _Xi18nSendMessage (ims, connect_id, XIM_ERROR, 0, 0, 0);
@@ -231,7 +228,6 @@ int _Xi18nPreeditCaretCallback (XIMS ims, IMProtocol *call_data)
                        reply,
                        total_size);
     FrameMgrFree (fm);
-    XFree (reply);
 
     return True;
 }
@@ -252,7 +248,7 @@ int _Xi18nPreeditDoneCallback (XIMS ims, IMProtocol *call_data)
                        _Xi18nNeedSwap (i18n_core, connect_id));
 
     total_size = FrameMgrGetTotalSize (fm);
-    reply = (unsigned char *) malloc (total_size);
+    reply = _Xi18nGetReplyBuffer (i18n_core, connect_id, total_size);
     if (!reply)
     {
         _Xi18nSendMessage (ims, connect_id, XIM_ERROR, 0, 0, 0);
@@ -272,7 +268,6 @@ int _Xi18nPreeditDoneCallback (XIMS ims, IMProtocol *call_data)
                        reply,
                        total_size);
     FrameMgrFree (fm);
-    XFree (reply);
 
     /* XIM_PREEDIT_DONE is an asyncronous protocol, so return immediately. */
     return True;
@@ -293,7 +288,7 @@ int _Xi18nStatusStartCallback (XIMS ims, IMProtocol *call_data)
                        NULL,
                        _Xi18nNeedSwap (i18n_core, connect_id));
     total_size = FrameMgrGetTotalSize (fm);
-    reply = (unsigned char *) malloc (total_size);
+    reply = _Xi18nGetReplyBuffer (i18n_core, connect_id, total_size);
     if (!reply)
     {
         _Xi18nSendMessage (ims, connect_id, XIM_ERROR, 0, 0, 0);
@@ -313,7 +308,6 @@ int _Xi18nStatusStartCallback (XIMS ims, IMProtocol *call_data)
                        reply,
                        total_size);
     FrameMgrFree (fm);
-    XFree (reply);
 
     /* XIM_STATUS_START is an asyncronous protocol, so return immediately. */
     return True;
@@ -359,7 +353,7 @@ int _Xi18nStatusDrawCallback (XIMS ims, IMProtocol *call_data)
         FrameMgrSetIterCount (fm, feedback_count);
 
         total_size = FrameMgrGetTotalSize (fm);
-        reply = (unsigned char *) malloc (total_size);
+        reply = _Xi18nGetReplyBuffer (i18n_core, connect_id, total_size);
         if (!reply)
         {
             _Xi18nSendMessage (ims, connect_id, XIM_ERROR, 0, 0, 0);
@@ -386,7 +380,7 @@ int _Xi18nStatusDrawCallback (XIMS ims, IMProtocol *call_data)
                            _Xi18nNeedSwap (i18n_core, connect_id));
 
         total_size = FrameMgrGetTotalSize (fm);
-        reply = (unsigned char *) malloc (total_size);
+        reply = _Xi18nGetReplyBuffer (i18n_core, connect_id, total_size);
         if (!reply)
         {
             _Xi18nSendMessage (ims, connect_id, XIM_ERROR, 0, 0, 0);
@@ -409,7 +403,6 @@ int _Xi18nStatusDrawCallback (XIMS ims, IMProtocol *call_data)
                        reply,
                        total_size);
     FrameMgrFree (fm);
-    XFree (reply);
 
     /* XIM_STATUS_DRAW is an asyncronous protocol, so return immediately. */
     return True;
@@ -431,7 +424,7 @@ int _Xi18nStatusDoneCallback (XIMS ims, IMProtocol *call_data)
                        _Xi18nNeedSwap (i18n_core, connect_id));
 
     total_size = FrameMgrGetTotalSize (fm);
-    reply = (unsigned char *) malloc (total_size);
+    reply = _Xi18nGetReplyBuffer (i18n_core, connect_id, total_size);
     if (!reply)
     {
         _Xi18nSendMessage (ims, connect_id, XIM_ERROR, 0, 0, 0);
@@ -451,7 +444,6 @@ int _Xi18nStatusDoneCallback (XIMS ims, IMProtocol *call_data)
                        reply,
                        total_size);
     FrameMgrFree (fm);
-    XFree (reply);
 
     /* XIM_STATUS_DONE is an asyncronous protocol, so return immediately. */
     return True;
@@ -475,7 +467,7 @@ int _Xi18nStringConversionCallback (XIMS ims, IMProtocol *call_data)
                       _Xi18nNeedSwap (i18n_core, connect_id));
 
     total_size = FrameMgrGetTotalSize (fm);
-    reply = (unsigned char *) malloc (total_size);
+    reply = _Xi18nGetReplyBuffer (i18n_core, connect_id, total_size);
     if (!reply)
     {
         _Xi18nSendMessage (ims, connect_id, XIM_ERROR, 0, 0, 0);
@@ -497,7 +489,6 @@ int _Xi18nStringConversionCallback (XIMS ims, IMProtocol *call_data)
                        reply,
                        total_size);
     FrameMgrFree (fm);
-    XFree (reply);
 
     /* XIM_STR_CONVERSION is a syncronous protocol,
        so should wait here for XIM_STR_CONVERSION_REPLY. */
@@ -620,6 +620,48 @@ static void SwapAttributes (XICAttribute *list,
 }
 
 /* called from CreateICMessageProc and SetICValueMessageProc */
+static CARD16 GetCard16 (unsigned char *p, int need_swap)
+{
+    CARD16 value;
+
+    memmove (&value, p, sizeof (CARD16));
+    if (need_swap)
+        value = (CARD16) ((value << 8) | (value >> 8));
+    /*endif*/
+    return value;
+}
+
+/*
+ * Clients send XIM_SET_IC_VALUES with a new XNSpotLocation on nearly every
+ * caret move.  When the preedit spot location is all there is, it is read
+ * in place, without the generic decoding and its allocations.  @p points
+ * at the ic-attributes.
+ */
+static Bool ReadSpotLocationOnly (Xi18n i18n_core,
+                                  unsigned char *p,
+                                  CARD16 byte_length,
+                                  int need_swap,
+                                  XPoint *spot)
+{
+    /* preeditAttributes { spotLocation { x, y } } */
+    if (byte_length != sizeof (CARD16)*6
+        ||
+        GetCard16 (p, need_swap) != i18n_core->address.preeditAttr_id
+        ||
+        GetCard16 (p + 2, need_swap) != sizeof (CARD16)*4
+        ||
+        GetCard16 (p + 4, need_swap) != i18n_core->address.spotLocation_id
+        ||
+        GetCard16 (p + 6, need_swap) != sizeof (CARD16)*2)
+    {
+        return False;
+    }
+    /*endif*/
+    spot->x = (short) GetCard16 (p + 8, need_swap);
+    spot->y = (short) GetCard16 (p + 10, need_swap);
+    return True;
+}
+
 void _Xi18nChangeIC (XIMS ims,
                      IMProtocol *call_data,
                      unsigned char *p,
@@ -647,6 +689,7 @@ void _Xi18nChangeIC (XIMS ims,
     extern XimFrameRec set_ic_values_fr[];
     extern XimFrameRec set_ic_values_reply_fr[];
     CARD16 input_method_ID;
+    XPoint spot;
  
     void *value_buf = NULL;
     void *value_buf_ptr;
@@ -677,106 +720,128 @@ void _Xi18nChangeIC (XIMS ims,
         FrameMgrGetToken (fm, byte_length);
     }
     /*endif*/
-    attrib_list = (XICAttribute *) malloc (sizeof (XICAttribute)*IC_SIZE);
-    if (!attrib_list)
+    if (create_flag == False
+        &&
+        ReadSpotLocationOnly (i18n_core,
+                              p + sizeof (CARD16)*4,
+                              byte_length,
+                              _Xi18nNeedSwap (i18n_core, connect_id),
+                              &spot))
     {
-        _Xi18nSendMessage (ims, connect_id, XIM_ERROR, 0, 0, 0);
-        return;
-    }
-    /*endif*/
-    memset (attrib_list, 0, sizeof(XICAttribute)*IC_SIZE);
+        FrameMgrFree (fm);
 
-    attrib_num = 0;
-    while (FrameMgrIsIterLoopEnd (fm, &status) == False)
+        pre_attr[0].attribute_id = i18n_core->address.spotLocation_id;
+        pre_attr[0].name = XNSpotLocation;
+        pre_attr[0].name_length = strlen (XNSpotLocation);
+        pre_attr[0].type = XimType_XPoint;
+        pre_attr[0].value_length = sizeof (XPoint);
+        pre_attr[0].value = (void *) &spot;
+        preedit_ic_num = 1;
+    }
+    else
     {
-        void *value;
-        int value_length;
+        attrib_list = (XICAttribute *) malloc (sizeof (XICAttribute)*IC_SIZE);
+        if (!attrib_list)
+        {
+            _Xi18nSendMessage (ims, connect_id, XIM_ERROR, 0, 0, 0);
+            return;
+        }
+        /*endif*/
+        memset (attrib_list, 0, sizeof(XICAttribute)*IC_SIZE);
+
+        attrib_num = 0;
+        while (FrameMgrIsIterLoopEnd (fm, &status) == False)
+        {
+            void *value;
+            int value_length;
         
-        FrameMgrGetToken (fm, attrib_list[attrib_num].attribute_id);
-        FrameMgrGetToken (fm, value_length);
-        FrameMgrSetSize (fm, value_length);
-        attrib_list[attrib_num].value_length = value_length;
-        FrameMgrGetToken (fm, value);
-        attrib_list[attrib_num].value = (void *) malloc (value_length + 1);
-        memmove (attrib_list[attrib_num].value, value, value_length);
-	((char *)attrib_list[attrib_num].value)[value_length] = '\0';
-        attrib_num++;
-        total_value_length += (value_length + 1);
-    }
-    /*endwhile*/
+            FrameMgrGetToken (fm, attrib_list[attrib_num].attribute_id);
+            FrameMgrGetToken (fm, value_length);
+            FrameMgrSetSize (fm, value_length);
+            attrib_list[attrib_num].value_length = value_length;
+            FrameMgrGetToken (fm, value);
+            attrib_list[attrib_num].value = (void *) malloc (value_length + 1);
+            memmove (attrib_list[attrib_num].value, value, value_length);
+            ((char *)attrib_list[attrib_num].value)[value_length] = '\0';
+            attrib_num++;
+            total_value_length += (value_length + 1);
+        }
+        /*endwhile*/
 
-    value_buf = (void *) malloc (total_value_length);
-    value_buf_ptr = value_buf;
+        value_buf = (void *) malloc (total_value_length);
+        value_buf_ptr = value_buf;
 
-    if (!value_buf)
-    {
-        _Xi18nSendMessage (ims, connect_id, XIM_ERROR, 0, 0, 0);
-        for (i = 0;  i < attrib_num;  i++)
-            XFree (attrib_list[i].value);
-        /*endfor*/
-        XFree (attrib_list);
-        return;
-    }
-    /*endif*/
+        if (!value_buf)
+        {
+            _Xi18nSendMessage (ims, connect_id, XIM_ERROR, 0, 0, 0);
+            for (i = 0;  i < attrib_num;  i++)
+                XFree (attrib_list[i].value);
+            /*endfor*/
+            XFree (attrib_list);
+            return;
+        }
+        /*endif*/
 
-    for (i = 0;  i < attrib_num;  i++)
-    {
-        CARD16 number;
-        
-        if (IsNestedList (i18n_core, attrib_list[i].attribute_id))
+        for (i = 0;  i < attrib_num;  i++)
         {
-            if (attrib_list[i].attribute_id
-                == i18n_core->address.preeditAttr_id)
+            CARD16 number;
+        
+            if (IsNestedList (i18n_core, attrib_list[i].attribute_id))
             {
-                ReadICValue (i18n_core,
-                             attrib_list[i].attribute_id,
-                             attrib_list[i].value_length,
-                             attrib_list[i].value,
-                             &pre_attr[preedit_ic_num],
-                             &number,
-                             _Xi18nNeedSwap(i18n_core, connect_id),
-                             &value_buf_ptr);
-                preedit_ic_num += number;
+                if (attrib_list[i].attribute_id
+                    == i18n_core->address.preeditAttr_id)
+                {
+                    ReadICValue (i18n_core,
+                                 attrib_list[i].attribute_id,
+                                 attrib_list[i].value_length,
+                                 attrib_list[i].value,
+                                 &pre_attr[preedit_ic_num],
+                                 &number,
+                                 _Xi18nNeedSwap(i18n_core, connect_id),
+                                 &value_buf_ptr);
+                    preedit_ic_num += number;
+                }
+                else if (attrib_list[i].attribute_id == i18n_core->address.statusAttr_id)
+                {
+                    ReadICValue (i18n_core,
+                                 attrib_list[i].attribute_id,
+                                 attrib_list[i].value_length,
+                                 attrib_list[i].value,
+                                 &sts_attr[status_ic_num],
+                                 &number,
+                                 _Xi18nNeedSwap (i18n_core, connect_id),
+                                 &value_buf_ptr);
+                    status_ic_num += number;
+                }
+                else
+                {
+                    /* another nested list.. possible? */
+                }
+                /*endif*/
             }
-            else if (attrib_list[i].attribute_id == i18n_core->address.statusAttr_id)
+            else
             {
                 ReadICValue (i18n_core,
                              attrib_list[i].attribute_id,
                              attrib_list[i].value_length,
                              attrib_list[i].value,
-                             &sts_attr[status_ic_num],
+                             &ic_attr[ic_num],
                              &number,
                              _Xi18nNeedSwap (i18n_core, connect_id),
                              &value_buf_ptr);
-                status_ic_num += number;
-            }
-            else
-            {
-                /* another nested list.. possible? */
+                ic_num += number;
             }
             /*endif*/
         }
-        else
-        {
-            ReadICValue (i18n_core,
-                         attrib_list[i].attribute_id,
-                         attrib_list[i].value_length,
-                         attrib_list[i].value,
-                         &ic_attr[ic_num],
-                         &number,
-                         _Xi18nNeedSwap (i18n_core, connect_id),
-                         &value_buf_ptr);
-            ic_num += number;
-        }
-        /*endif*/
-    }
-    /*endfor*/
-    for (i = 0;  i < attrib_num;  i++)
-        XFree (attrib_list[i].value);
-    /*endfor*/
-    XFree (attrib_list);
+        /*endfor*/
+        for (i = 0;  i < attrib_num;  i++)
+            XFree (attrib_list[i].value);
+        /*endfor*/
+        XFree (attrib_list);
 
-    FrameMgrFree (fm);
+        FrameMgrFree (fm);
+    }
+    /*endif*/
 
     changeic->preedit_attr_num = preedit_ic_num;
     changeic->status_attr_num = status_ic_num;
@@ -823,7 +888,7 @@ void _Xi18nChangeIC (XIMS ims,
     }
     /*endif*/
     total_size = FrameMgrGetTotalSize (fm);
-    reply = (unsigned char *) malloc (total_size);
+    reply = _Xi18nGetReplyBuffer (i18n_core, connect_id, total_size);
     
     if (!reply)
     {
@@ -882,7 +947,6 @@ void _Xi18nChangeIC (XIMS ims,
     }
     /*endif*/
     FrameMgrFree (fm);
-    XFree(reply);
 }
 
 /* called from GetICValueMessageProc */
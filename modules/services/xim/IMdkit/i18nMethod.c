@@ -58,7 +58,7 @@ static int xi18n_syncXlib (XIMS, XPointer);
 #ifndef XIM_SERVERS
 #define XIM_SERVERS "XIM_SERVERS"
 #endif
-static Atom XIM_Servers = None;
+static xcb_atom_t XIM_Servers = XCB_ATOM_NONE;
 
 
 IMMethodsRec Xi18n_im_methods =
@@ -226,6 +226,14 @@ static char *ParseArgs (Xi18n i18n_core, int mode, XIMArg *args)
                 address->im_window = (Window) p->value;
                 address->imvalue_mask |= I18N_IMSERVER_WIN;
             }
+            else if (strcmp (p->name, IMXcbConnection) == 0)
+            {
+                if (address->imvalue_mask & I18N_XCB_CONNECTION)
+                    return IMXcbConnection;
+                /*endif*/
+                address->xcb = (xcb_connection_t *) p->value;
+                address->imvalue_mask |= I18N_XCB_CONNECTION;
+            }
             else if (strcmp (p->name, IMInputStyles) == 0)
             {
                 if (address->imvalue_mask & I18N_INPUT_STYLES)
@@ -380,6 +388,14 @@ static char *ParseArgs (Xi18n i18n_core, int mode, XIMArg *args)
                     return IMServerWindow;
                 /*endif*/
             }
+            else if (strcmp (p->name, IMXcbConnection) == 0)
+            {
+                if (address->imvalue_mask & I18N_XCB_CONNECTION)
+                    *((xcb_connection_t **) (p->value)) = address->xcb;
+                else
+                    return IMXcbConnection;
+                /*endif*/
+            }
             else if (strcmp (p->name, IMInputStyles) == 0)
             {
                 if (GetInputStyles (i18n_core,
@@ -505,134 +521,189 @@ static int CheckIMName (Xi18n i18n_core)
     return False;
 }
 
+static xcb_atom_t InternAtomReply (xcb_connection_t *c,
+                                   xcb_intern_atom_cookie_t cookie)
+{
+    xcb_intern_atom_reply_t *reply;
+    xcb_atom_t atom = XCB_ATOM_NONE;
+
+    if ((reply = xcb_intern_atom_reply (c, cookie, NULL)) != NULL)
+    {
+        atom = reply->atom;
+        free (reply);
+    }
+    /*endif*/
+    return atom;
+}
+
+static Window GetSelectionOwner (xcb_connection_t *c, xcb_atom_t selection)
+{
+    xcb_get_selection_owner_reply_t *reply;
+    Window owner = None;
+
+    reply = xcb_get_selection_owner_reply (c,
+                                           xcb_get_selection_owner (c,
+                                                                    selection),
+                                           NULL);
+    if (reply != NULL)
+    {
+        owner = reply->owner;
+        free (reply);
+    }
+    /*endif*/
+    return owner;
+}
+
+/* NULL if XIM_SERVERS is set but is not a list of atoms */
+static xcb_get_property_reply_t *GetXIMServers (xcb_connection_t *c,
+                                                Window root)
+{
+    xcb_get_property_reply_t *reply;
+
+    reply = xcb_get_property_reply (c,
+                                    xcb_get_property (c,
+                                                      False,
+                                                      root,
+                                                      XIM_Servers,
+                                                      XCB_ATOM_ATOM,
+                                                      0L,
+                                                      1000000L),
+                                    NULL);
+    if (reply == NULL)
+        return NULL;
+    /*endif*/
+    if (reply->type != XCB_ATOM_NONE
+        &&
+        (reply->type != XCB_ATOM_ATOM || reply->format != 32))
+    {
+        free (reply);
+        return NULL;
+    }
+    /*endif*/
+    return reply;
+}
+
+/* all four atoms are interned in one round trip */
+static xcb_atom_t InternXi18nAtoms (Xi18n i18n_core)
+{
+    xcb_connection_t *c = i18n_core->address.xcb;
+    xcb_intern_atom_cookie_t cookies[4];
+    xcb_atom_t atom;
+    char buf[256];
+
+    (void)snprintf(buf, 256, "@server=%s", i18n_core->address.im_name);
+    cookies[0] = xcb_intern_atom (c, False, strlen (buf), buf);
+    cookies[1] = xcb_intern_atom (c, False, strlen (XIM_SERVERS), XIM_SERVERS);
+    cookies[2] = xcb_intern_atom (c, False, strlen (LOCALES), LOCALES);
+    cookies[3] = xcb_intern_atom (c, False, strlen (TRANSPORT), TRANSPORT);
+
+    atom = InternAtomReply (c, cookies[0]);
+    XIM_Servers = InternAtomReply (c, cookies[1]);
+    i18n_core->address.Localename = InternAtomReply (c, cookies[2]);
+    i18n_core->address.Transportname = InternAtomReply (c, cookies[3]);
+    i18n_core->address.selection = atom;
+    return atom;
+}
+
 static int SetXi18nSelectionOwner(Xi18n i18n_core)
 {
     Display *dpy = i18n_core->address.dpy;
+    xcb_connection_t *c = i18n_core->address.xcb;
     Window ims_win = i18n_core->address.im_window;
     Window root = RootWindow (dpy, DefaultScreen (dpy));
-    Atom realtype;
-    int realformat;
-    unsigned long bytesafter;
-    long *data=NULL;
+    xcb_get_property_reply_t *reply;
+    xcb_atom_t *data;
     unsigned long length;
-    Atom atom;
+    xcb_atom_t atom;
     int i;
     int found;
     int forse = False;
-    char buf[256];
 
-    (void)snprintf(buf, 256, "@server=%s", i18n_core->address.im_name);
-    if ((atom = XInternAtom(dpy, buf, False)) == 0)
+    if ((atom = InternXi18nAtoms (i18n_core)) == XCB_ATOM_NONE
+        ||
+        XIM_Servers == XCB_ATOM_NONE)
+    {
         return False;
-    i18n_core->address.selection = atom;
-
-    if (XIM_Servers == None)
-        XIM_Servers = XInternAtom (dpy, XIM_SERVERS, False);
+    }
     /*endif*/
-    XGetWindowProperty (dpy,
-                        root,
-                        XIM_Servers,
-                        0L,
-                        1000000L,
-                        False,
-                        XA_ATOM,
-                        &realtype,
-                        &realformat,
-                        &length,
-                        &bytesafter,
-                        (unsigned char **) (&data));
-    if (realtype != None && (realtype != XA_ATOM || realformat != 32)) {
-        if (data != NULL)
-            XFree ((char *) data);
+    if ((reply = GetXIMServers (c, root)) == NULL)
         return False;
-    }
+    /*endif*/
+    data = (xcb_atom_t *) xcb_get_property_value (reply);
+    length = xcb_get_property_value_length (reply) / sizeof (xcb_atom_t);
 
     found = False;
     for (i = 0; i < length; i++) {
         if (data[i] == atom) {
             Window owner;
             found = True;
-            if ((owner = XGetSelectionOwner (dpy, atom)) != ims_win) {
+            if ((owner = GetSelectionOwner (c, atom)) != ims_win) {
                 if (owner == None  ||  forse == True)
-                    XSetSelectionOwner (dpy, atom, ims_win, CurrentTime);
+                    xcb_set_selection_owner (c, ims_win, atom,
+                                             XCB_CURRENT_TIME);
                 else
+                {
+                    free (reply);
                     return False;
+                }
             }
             break;
         }
     }
 
     if (found == False) {
-        XSetSelectionOwner (dpy, atom, ims_win, CurrentTime);
-        XChangeProperty (dpy,
-                         root,
-                         XIM_Servers,
-                         XA_ATOM,
-                         32,
-                         PropModePrepend,
-                         (unsigned char *) &atom,
-                         1);
+        xcb_set_selection_owner (c, ims_win, atom, XCB_CURRENT_TIME);
+        xcb_change_property (c,
+                             XCB_PROP_MODE_PREPEND,
+                             root,
+                             XIM_Servers,
+                             XCB_ATOM_ATOM,
+                             32,
+                             1,
+                             &atom);
     }
     else {
 	/* 
 	 * We always need to generate the PropertyNotify to the Root Window 
 	 */
-        XChangeProperty (dpy,
-                         root,
-                         XIM_Servers,
-                         XA_ATOM,
-                         32,
-                         PropModePrepend,
-                         (unsigned char *) data,
-                         0);
+        xcb_change_property (c,
+                             XCB_PROP_MODE_PREPEND,
+                             root,
+                             XIM_Servers,
+                             XCB_ATOM_ATOM,
+                             32,
+                             0,
+                             data);
     }
-    if (data != NULL)
-        XFree ((char *) data);
-    
-    /* Intern "LOCALES" and "TRANSOPORT" Target Atoms */
-    i18n_core->address.Localename = XInternAtom (dpy, LOCALES, False);
-    i18n_core->address.Transportname = XInternAtom (dpy, TRANSPORT, False);
-    return (XGetSelectionOwner (dpy, atom) == ims_win);
+    free (reply);
+
+    return (GetSelectionOwner (c, atom) == ims_win);
 }
 
 static int DeleteXi18nAtom(Xi18n i18n_core)
 {
     Display *dpy = i18n_core->address.dpy;
+    xcb_connection_t *c = i18n_core->address.xcb;
     Window root = RootWindow (dpy, DefaultScreen (dpy));
-    Atom realtype;
-    int realformat;
-    unsigned long bytesafter;
-    long *data=NULL;
+    xcb_get_property_reply_t *reply;
+    xcb_atom_t *data;
     unsigned long length;
-    Atom atom;
+    xcb_atom_t atom;
     int i, ret;
     int found;
-    char buf[256];
 
-    (void)snprintf(buf, 256, "@server=%s", i18n_core->address.im_name);
-    if ((atom = XInternAtom(dpy, buf, False)) == 0)
+    if ((atom = InternXi18nAtoms (i18n_core)) == XCB_ATOM_NONE)
         return False;
-    i18n_core->address.selection = atom;
-
-    if (XIM_Servers == None)
-        XIM_Servers = XInternAtom (dpy, XIM_SERVERS, False);
-    XGetWindowProperty (dpy,
-                        root,
-                        XIM_Servers,
-                        0L,
-                        1000000L,
-                        False,
-                        XA_ATOM,
-                        &realtype,
-                        &realformat,
-                        &length,
-                        &bytesafter,
-                        (unsigned char **) (&data));
-    if (realtype != XA_ATOM || realformat != 32) {
-        if (data != NULL)
-            XFree ((char *) data);
+    /*endif*/
+    if ((reply = GetXIMServers (c, root)) == NULL)
+        return False;
+    /*endif*/
+    if (reply->type != XCB_ATOM_ATOM) {
+        free (reply);
         return False;
     }
+    data = (xcb_atom_t *) xcb_get_property_value (reply);
+    length = xcb_get_property_value_length (reply) / sizeof (xcb_atom_t);
 
     found = False;
     for (i = 0; i < length; i++) {
@@ -645,33 +716,32 @@ static int DeleteXi18nAtom(Xi18n i18n_core)
     if (found == True) {
         for (i=i+1; i<length; i++)
             data[i-1] = data[i];
-        XChangeProperty (dpy,
-                         root,
-                         XIM_Servers,
-                         XA_ATOM,
-                         32,
-                         PropModeReplace,
-                         (unsigned char *)data,
-                         length-1);
+        xcb_change_property (c,
+                             XCB_PROP_MODE_REPLACE,
+                             root,
+                             XIM_Servers,
+                             XCB_ATOM_ATOM,
+                             32,
+                             length-1,
+                             data);
         ret = True;
     }
     else {
-        XChangeProperty (dpy,
-                         root,
-                         XIM_Servers,
-                         XA_ATOM,
-                         32,
-                         PropModePrepend,
-                         (unsigned char *)data,
-                         0);
+        xcb_change_property (c,
+                             XCB_PROP_MODE_PREPEND,
+                             root,
+                             XIM_Servers,
+                             XCB_ATOM_ATOM,
+                             32,
+                             0,
+                             data);
         ret = False;
     }
-    if (data != NULL)
-        XFree ((char *) data);
+    free (reply);
+    xcb_flush (c);
     return ret;
 }
 
-
 /* XIM protocol methods */
 static void *xi18n_setup (Display *dpy, XIMArg *args)
 {
@@ -707,18 +777,21 @@ static void *xi18n_setup (Display *dpy, XIMArg *args)
     return i18n_core;
 }
 
-static void ReturnSelectionNotify (Xi18n i18n_core, XSelectionRequestEvent *ev)
+static void ReturnSelectionNotify (Xi18n i18n_core,
+                                   xcb_selection_request_event_t *ev)
 {
-    XEvent event;
-    Display *dpy = i18n_core->address.dpy;
+    xcb_connection_t *c = i18n_core->address.xcb;
+    xcb_selection_notify_event_t event;
     char buf[4096];
 
-    event.type = SelectionNotify;
-    event.xselection.requestor = ev->requestor;
-    event.xselection.selection = ev->selection;
-    event.xselection.target = ev->target;
-    event.xselection.time = ev->time;
-    event.xselection.property = ev->property;
+    memset (&event, 0, sizeof (event));
+    event.response_type = XCB_SELECTION_NOTIFY;
+    event.requestor = ev->requestor;
+    event.selection = ev->selection;
+    event.target = ev->target;
+    event.time = ev->time;
+    event.property = ev->property;
+    buf[0] = '\0';
     if (ev->target == i18n_core->address.Localename)
     {
         snprintf (buf, 4096, "@locale=%s", i18n_core->address.im_locale);
@@ -728,42 +801,63 @@ static void ReturnSelectionNotify (Xi18n i18n_core, XSelectionRequestEvent *ev)
         snprintf (buf, 4096, "@transport=%s", i18n_core->address.im_addr);
     }
     /*endif*/
-    XChangeProperty (dpy,
-                     event.xselection.requestor,
-                     ev->target,
-                     ev->target,
-                     8,
-                     PropModeReplace,
-                     (unsigned char *) buf,
-                     strlen (buf));
-    XSendEvent (dpy, event.xselection.requestor, False, NoEventMask, &event);
-    XFlush (i18n_core->address.dpy);
+    xcb_change_property (c,
+                         XCB_PROP_MODE_REPLACE,
+                         event.requestor,
+                         ev->target,
+                         ev->target,
+                         8,
+                         strlen (buf),
+                         buf);
+    xcb_send_event (c,
+                    False,
+                    event.requestor,
+                    XCB_EVENT_MASK_NO_EVENT,
+                    (const char *) &event);
+    xcb_flush (c);
 }
 
-static Bool WaitXSelectionRequest (Display *dpy,
-                                   Window win,
-                                   XEvent *ev,
-                                   XPointer client_data)
+static Bool WaitXSelectionRequest (XIMS ims,
+                                   xcb_selection_request_event_t *ev)
 {
-    XIMS ims = (XIMS) client_data;
     Xi18n i18n_core = ims->protocol;
 
-    if (((XSelectionRequestEvent *) ev)->selection
-        == i18n_core->address.selection)
+    if (ev->owner == i18n_core->address.im_window
+        &&
+        ev->selection == i18n_core->address.selection)
     {
-        ReturnSelectionNotify (i18n_core, (XSelectionRequestEvent *) ev);
+        ReturnSelectionNotify (i18n_core, ev);
         return True;
     }
     /*endif*/
     return False;
 }
 
+/*
+ * The X transport talks to clients over the XCB connection given as
+ * IMXcbConnection; whoever reads that connection passes each event here.
+ * Returns True if the event belonged to the IM server.
+ */
+Bool _Xi18nFilterXcbEvent (XIMS ims, xcb_generic_event_t *event)
+{
+    Xi18n i18n_core = ims->protocol;
+
+    if ((event->response_type & ~0x80) == XCB_SELECTION_REQUEST)
+    {
+        return WaitXSelectionRequest (ims,
+                                      (xcb_selection_request_event_t *) event);
+    }
+    /*endif*/
+    return i18n_core->methods.filter (ims, event);
+}
+
 static Status xi18n_openIM(XIMS ims)
 {
     Xi18n i18n_core = ims->protocol;
-    Display *dpy = i18n_core->address.dpy;
 
-    if (!CheckIMName (i18n_core)
+    if (!(i18n_core->address.imvalue_mask & I18N_XCB_CONNECTION)
+        ||
+        !CheckIMName (i18n_core)
         ||
         !SetXi18nSelectionOwner (i18n_core)
         ||
@@ -777,29 +871,18 @@ static Status xi18n_openIM(XIMS ims)
     }
     /*endif*/
 
-    _XRegisterFilterByType (dpy,
-                            i18n_core->address.im_window,
-                            SelectionRequest,
-                            SelectionRequest,
-                            WaitXSelectionRequest,
-                            (XPointer)ims);
-    XFlush(dpy);
+    xcb_flush (i18n_core->address.xcb);
     return True;
 }
 
 static Status xi18n_closeIM(XIMS ims)
 {
     Xi18n i18n_core = ims->protocol;
-    Display *dpy = i18n_core->address.dpy;
 
     DeleteXi18nAtom(i18n_core);
     if (!i18n_core->methods.end (ims))
         return False;
     
-    _XUnregisterFilter (dpy,
-                        i18n_core->address.im_window,
-                        WaitXSelectionRequest,
-                        (XPointer)ims);
     XFree (i18n_core->address.im_name);
     XFree (i18n_core->address.im_locale);
     XFree (i18n_core->address.im_addr);
@@ -899,7 +982,9 @@ static Status xi18n_forwardEvent (XIMS ims, XPointer xp)
 
     total_size = FrameMgrGetTotalSize (fm);
     event_size = sizeof (xEvent);
-    reply = (unsigned char *) malloc (total_size + event_size);
+    reply = _Xi18nGetReplyBuffer (i18n_core,
+                                  call_data->connect_id,
+                                  total_size + event_size);
     if (!reply)
     {
         _Xi18nSendMessage (ims,
@@ -937,7 +1022,6 @@ static Status xi18n_forwardEvent (XIMS ims, XPointer xp)
                        reply,
                        total_size + event_size);
 
-    XFree (reply);
     FrameMgrFree (fm);
 
     return True;
@@ -968,7 +1052,9 @@ static Status xi18n_commit (XIMS ims, XPointer xp)
         str_length = strlen (call_data->commit_string);
         FrameMgrSetSize (fm, str_length);
         total_size = FrameMgrGetTotalSize (fm);
-        reply = (unsigned char *) malloc (total_size);
+        reply = _Xi18nGetReplyBuffer (i18n_core,
+                                      call_data->connect_id,
+                                      total_size);
         if (!reply)
         {
             _Xi18nSendMessage (ims,
@@ -1001,7 +1087,9 @@ static Status xi18n_commit (XIMS ims, XPointer xp)
             FrameMgrSetSize (fm, str_length);
         /*endif*/
         total_size = FrameMgrGetTotalSize (fm);
-        reply = (unsigned char *) malloc (total_size);
+        reply = _Xi18nGetReplyBuffer (i18n_core,
+                                      call_data->connect_id,
+                                      total_size);
         if (!reply)
         {
             _Xi18nSendMessage (ims,
@@ -1034,7 +1122,6 @@ static Status xi18n_commit (XIMS ims, XPointer xp)
                        reply,
                        total_size);
     FrameMgrFree (fm);
-    XFree (reply);
 
     return True;
 }
@@ -1101,7 +1101,7 @@ static void ResetICMessageProc (XIMS ims,
     FrameMgrSetSize (fm, resetic->length);
 
     total_size = FrameMgrGetTotalSize (fm);
-    reply = (unsigned char *) malloc (total_size);
+    reply = _Xi18nGetReplyBuffer (i18n_core, connect_id, total_size);
     if (!reply)
     {
         _Xi18nSendMessage (ims, connect_id, XIM_ERROR, 0, 0, 0);
@@ -1123,7 +1123,6 @@ static void ResetICMessageProc (XIMS ims,
                        reply,
                        total_size);
     FrameMgrFree (fm);
-    XFree(reply);
 }
 
 static int WireEventToEvent (Xi18n i18n_core,
@@ -1492,8 +1491,8 @@ static INT16 ChooseEncoding (Xi18n i18n_core,
     Xi18nAddressRec *address = (Xi18nAddressRec *) & i18n_core->address;
     XIMEncodings *p;
     int i, j;
-    int enc_index=0;
 
+    /* the first of our encodings, in our order, that the client lists */
     p = (XIMEncodings *) &address->encoding_list;
     for (i = 0;  i < (int) p->count_encodings;  i++)
     {
@@ -1501,17 +1500,14 @@ static INT16 ChooseEncoding (Xi18n i18n_core,
         {
             if (strcmp (p->supported_encodings[i],
                         enc_nego->encoding[j].name) == 0)
-            {
-                enc_index = j;
-                break;
-            }
+                return (INT16) j;
             /*endif*/
         }
         /*endfor*/
     }
     /*endfor*/
 
-    return (INT16) enc_index;
+    return (INT16) 0;
 #if 0
     return (INT16) XIM_Default_Encoding_IDX;
 #endif
@@ -1533,6 +1529,7 @@ static void EncodingNegotiatonMessageProc (XIMS ims,
         (IMEncodingNegotiationStruct *) &call_data->encodingnego;
     CARD16 connect_id = call_data->any.connect_id;
     CARD16 input_method_ID;
+    Xi18nClient *client;
 
     fm = FrameMgrInit (encoding_negotiation_fr,
                        (char *) p,
@@ -1570,7 +1567,7 @@ static void EncodingNegotiatonMessageProc (XIMS ims,
     if (byte_length > 0)
     {
         enc_nego->encodinginfo = (XIMStr *) malloc (sizeof (XIMStr)*10);
-        memset (enc_nego->encoding, 0, sizeof (XIMStr)*10);
+        memset (enc_nego->encodinginfo, 0, sizeof (XIMStr)*10);
         i = 0;
         while (FrameMgrIsIterLoopEnd (fm, &status) == False)
         {
@@ -1594,6 +1591,12 @@ static void EncodingNegotiatonMessageProc (XIMS ims,
     enc_nego->enc_index = ChooseEncoding (i18n_core, enc_nego);
     enc_nego->category = 0;
 
+    client = (Xi18nClient *) _Xi18nFindClient (i18n_core, connect_id);
+    if (client && enc_nego->enc_index < (INT16) enc_nego->encoding_number)
+        client->utf8 = strcmp (enc_nego->encoding[enc_nego->enc_index].name,
+                               "UTF8_STRING") == 0;
+    /*endif*/
+
 #ifdef PROTOCOL_RICH
     if (i18n_core->address.improto)
     {
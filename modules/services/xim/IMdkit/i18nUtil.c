@@ -112,6 +112,8 @@ void _Xi18nDeleteClient (Xi18n i18n_core, CARD16 connect_id)
             else
                 ccp0->next = ccp->next;
             /*endif*/
+            free (target->reply_buffer);
+            free (target->send_buffer);
             /* put it back to free list */
             target->next = i18n_core->address.free_clients;
             i18n_core->address.free_clients = target;
@@ -122,6 +124,46 @@ void _Xi18nDeleteClient (Xi18n i18n_core, CARD16 connect_id)
     /*endfor*/
 }
 
+static Bool GrowBuffer (unsigned char **buffer, int *buffer_size, int size)
+{
+    unsigned char *p;
+    int new_size;
+
+    if (*buffer_size >= size)
+        return True;
+    /*endif*/
+    new_size = (*buffer_size > 0)  ?  *buffer_size  :  64;
+    while (new_size < size)
+        new_size *= 2;
+    /*endwhile*/
+    if ((p = (unsigned char *) realloc (*buffer, new_size)) == NULL)
+        return False;
+    /*endif*/
+    *buffer = p;
+    *buffer_size = new_size;
+    return True;
+}
+
+/*
+ * Returns a buffer of the client's to build a message in, reused from
+ * one message to the next.  It is good until the next call for the same
+ * client, so take it right before building the message and do not free
+ * it.
+ */
+unsigned char *_Xi18nGetReplyBuffer (Xi18n i18n_core,
+                                     CARD16 connect_id,
+                                     int size)
+{
+    Xi18nClient *client = _Xi18nFindClient (i18n_core, connect_id);
+
+    if (client == NULL
+        ||
+        !GrowBuffer (&client->reply_buffer, &client->reply_buffer_size, size))
+        return NULL;
+    /*endif*/
+    return client->reply_buffer;
+}
+
 void _Xi18nSendMessage (XIMS ims,
                         CARD16 connect_id,
                         CARD8 major_opcode,
@@ -130,45 +172,43 @@ void _Xi18nSendMessage (XIMS ims,
                         long length)
 {
     Xi18n i18n_core = ims->protocol;
+    Xi18nClient *client = _Xi18nFindClient (i18n_core, connect_id);
     FrameMgr fm;
     extern XimFrameRec packet_header_fr[];
-    unsigned char *reply_hdr = NULL;
     int header_size;
-    unsigned char *reply = NULL;
-    unsigned char *replyp;
     int reply_length;
     long p_len = length/4;
 
+    if (client == NULL)
+        return;
+    /*endif*/
+
     fm = FrameMgrInit (packet_header_fr,
                        NULL,
                        _Xi18nNeedSwap (i18n_core, connect_id));
 
     header_size = FrameMgrGetTotalSize (fm);
-    reply_hdr = (unsigned char *) malloc (header_size);
-    if (reply_hdr == NULL)
+    reply_length = header_size + length;
+    if (!GrowBuffer (&client->send_buffer,
+                     &client->send_buffer_size,
+                     reply_length))
     {
-        _Xi18nSendMessage (ims, connect_id, XIM_ERROR, 0, 0, 0);
+        FrameMgrFree (fm);
         return;
     }
     /*endif*/
-    FrameMgrSetBuffer (fm, reply_hdr);
+    /* the header goes right in front of the data */
+    FrameMgrSetBuffer (fm, client->send_buffer);
 
     /* put data */
     FrameMgrPutToken (fm, major_opcode);
     FrameMgrPutToken (fm, minor_opcode);
     FrameMgrPutToken (fm, p_len);
 
-    reply_length = header_size + length;
-    reply = (unsigned char *) malloc (reply_length);
-    replyp = reply;
-    memmove (reply, reply_hdr, header_size);
-    replyp += header_size;
-    memmove (replyp, data, length);
+    memmove (client->send_buffer + header_size, data, length);
 
-    i18n_core->methods.send (ims, connect_id, reply, reply_length);
+    i18n_core->methods.send (ims, connect_id, client->send_buffer, reply_length);
 
-    XFree (reply);
-    XFree (reply_hdr);
     FrameMgrFree (fm);
 }
 
@@ -256,9 +296,12 @@ void _Xi18nSetEventMask (XIMS ims,
                        _Xi18nNeedSwap (i18n_core, connect_id));
 
     total_size = FrameMgrGetTotalSize (fm);
-    reply = (unsigned char *) malloc (total_size);
+    reply = _Xi18nGetReplyBuffer (i18n_core, connect_id, total_size);
     if (!reply)
+    {
+        FrameMgrFree (fm);
         return;
+    }
     /*endif*/
     memset (reply, 0, total_size);
     FrameMgrSetBuffer (fm, reply);
@@ -276,5 +319,4 @@ void _Xi18nSetEventMask (XIMS ims,
                        total_size);
 
     FrameMgrFree (fm);
-    XFree(reply);
 }
@@ -41,38 +41,60 @@ IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
 #include "Xi18nX.h"
 #include "XimFunc.h"
 
+/*
+ * Everything here goes over the XCB connection in address.xcb.  Requests
+ * are queued without waiting; the owner of the connection flushes it once
+ * per main loop iteration and hands every event to _Xi18nFilterXcbEvent.
+ */
+
 extern Xi18nClient *_Xi18nFindClient (Xi18n, CARD16);
 extern Xi18nClient *_Xi18nNewClient (Xi18n);
 extern void _Xi18nDeleteClient (Xi18n, CARD16);
 extern unsigned long _Xi18nLookupPropertyOffset (Xi18nOffsetCache *, Atom);
 extern void _Xi18nSetPropertyOffset (Xi18nOffsetCache *, Atom, unsigned long);
-static Bool WaitXConnectMessage (Display*, Window,
-                                 XEvent*, XPointer);
-static Bool WaitXIMProtocol (Display*, Window, XEvent*, XPointer);
+static Bool WaitXConnectMessage (XIMS, xcb_client_message_event_t *);
+static Bool WaitXIMProtocol (XIMS, xcb_client_message_event_t *);
 
 static XClient *NewXClient (Xi18n i18n_core, Window new_client)
 {
     Display *dpy = i18n_core->address.dpy;
+    xcb_connection_t *c = i18n_core->address.xcb;
     Xi18nClient *client = _Xi18nNewClient (i18n_core);
     XClient *x_client;
+    char atomName[16];
+    int i;
 
     x_client = (XClient *) malloc (sizeof (XClient));
+    memset (x_client, 0, sizeof (XClient));
     x_client->client_win = new_client;
-    x_client->accept_win = XCreateSimpleWindow (dpy,
-                                                DefaultRootWindow(dpy),
-                                                0,
-                                                0,
-                                                1,
-                                                1,
-                                                1,
-                                                0,
-                                                0);
+    x_client->accept_win = xcb_generate_id (c);
+    xcb_create_window (c,
+                       XCB_COPY_FROM_PARENT,
+                       x_client->accept_win,
+                       DefaultRootWindow (dpy),
+                       0,
+                       0,
+                       1,
+                       1,
+                       1,
+                       XCB_WINDOW_CLASS_INPUT_OUTPUT,
+                       XCB_COPY_FROM_PARENT,
+                       0,
+                       NULL);
+    /* pipelined; the replies are in by the time a long reply needs one */
+    for (i = 0;  i < XCM_SERVER_ATOMS;  i++)
+    {
+        sprintf (atomName, "_server%d_%d", client->connect_id, i);
+        x_client->server_atom_cookies[i] =
+            xcb_intern_atom (c, False, strlen (atomName), atomName);
+    }
+    /*endfor*/
     client->trans_rec = x_client;
     return ((XClient *) x_client);
 }
 
 static unsigned char *ReadXIMMessage (XIMS ims,
-                                      XClientMessageEvent *ev,
+                                      xcb_client_message_event_t *ev,
                                       int *connect_id)
 {
     Xi18n i18n_core = ims->protocol;
@@ -92,9 +114,13 @@ static unsigned char *ReadXIMMessage (XIMS ims,
         client = client->next;
     }
 
+    if (client == NULL)
+        return (unsigned char *) NULL; /* not one of our accept windows */
+    /*endif*/
+
     if (ev->format == 8) {
         /* ClientMessage only */
-        XimProtoHdr *hdr = (XimProtoHdr *) ev->data.b;
+        XimProtoHdr *hdr = (XimProtoHdr *) ev->data.data8;
         unsigned char *rec = (unsigned char *) (hdr + 1);
         register int total_size;
         CARD8 major_opcode;
@@ -133,14 +159,12 @@ static unsigned char *ReadXIMMessage (XIMS ims,
     }
     else if (ev->format == 32) {
         /* ClientMessage and WindowProperty */
-        unsigned long length = (unsigned long) ev->data.l[0];
-        Atom atom = (Atom) ev->data.l[1];
-        int return_code;
-        Atom actual_type_ret;
-        int actual_format_ret;
-        unsigned long bytes_after_ret;
+        xcb_connection_t *c = i18n_core->address.xcb;
+        unsigned long length = (unsigned long) ev->data.data32[0];
+        xcb_atom_t atom = (xcb_atom_t) ev->data.data32[1];
+        xcb_get_property_reply_t *reply;
         unsigned char *prop;
-        unsigned long nitems;
+        unsigned long nbytes;
         Xi18nOffsetCache *offset_cache = &client->offset_cache;
         unsigned long offset;
         unsigned long end;
@@ -158,52 +182,56 @@ static unsigned char *ReadXIMMessage (XIMS ims,
         /* The property data is retrieved in 32-bit chunks */
         long_begin = offset / 4;
         long_end = (end + 3) / 4;
-        return_code = XGetWindowProperty (i18n_core->address.dpy,
-                                          x_client->accept_win,
-                                          atom,
-                                          long_begin,
-                                          long_end - long_begin,
-                                          True,
-                                          AnyPropertyType,
-                                          &actual_type_ret,
-                                          &actual_format_ret,
-                                          &nitems,
-                                          &bytes_after_ret,
-                                          &prop);
-        if (return_code != Success || actual_format_ret == 0 || nitems == 0) {
-            if (return_code == Success)
-                XFree (prop);
+        /* the one round trip left: the data is needed right away */
+        reply = xcb_get_property_reply (c,
+                                        xcb_get_property (c,
+                                                          True,
+                                                          x_client->accept_win,
+                                                          atom,
+                                                          XCB_GET_PROPERTY_TYPE_ANY,
+                                                          long_begin,
+                                                          long_end - long_begin),
+                                        NULL);
+        nbytes = reply ? xcb_get_property_value_length (reply) : 0;
+        if (reply == NULL || reply->format == 0 || nbytes == 0
+            ||
+            nbytes < (offset % 4) + length)
+        {
+            free (reply);
             fprintf (stderr,
-                    "(XIM-IMdkit) ERROR: XGetWindowProperty failed.\n"
+                    "(XIM-IMdkit) ERROR: GetProperty failed.\n"
                     "Protocol data is likely to be inconsistent.\n");
             _Xi18nSetPropertyOffset (offset_cache, atom, 0);
             return (unsigned char *) NULL;
         }
         /* Update the offset to read next time as needed */
-        if (bytes_after_ret > 0)
+        if (reply->bytes_after > 0)
             _Xi18nSetPropertyOffset (offset_cache, atom, offset + length);
         else
             _Xi18nSetPropertyOffset (offset_cache, atom, 0);
         /* if hit, it might be an error */
         if ((p = (unsigned char *) malloc (length)) == NULL)
+        {
+            free (reply);
             return (unsigned char *) NULL;
-
+        }
+        /*endif*/
+        prop = (unsigned char *) xcb_get_property_value (reply);
         memcpy (p, prop + (offset % 4), length);
-        XFree (prop);
+        free (reply);
     }
     return (unsigned char *) p;
 }
 
-static void ReadXConnectMessage (XIMS ims, XClientMessageEvent *ev)
+static void ReadXConnectMessage (XIMS ims, xcb_client_message_event_t *ev)
 {
     Xi18n i18n_core = ims->protocol;
     XSpecRec *spec = (XSpecRec *) i18n_core->address.connect_addr;
-    XEvent event;
-    Display *dpy = i18n_core->address.dpy;
-    Window new_client = ev->data.l[0];
-    CARD32 major_version = ev->data.l[1];
-    CARD32 minor_version = ev->data.l[2];
-    XClient *x_client = NewXClient (i18n_core, new_client);
+    xcb_client_message_event_t event;
+    Window new_client = ev->data.data32[0];
+    CARD32 major_version = ev->data.data32[1];
+    CARD32 minor_version = ev->data.data32[2];
+    XClient *x_client;
 
     if (ev->window != i18n_core->address.im_window)
         return; /* incorrect connection request */
@@ -215,73 +243,89 @@ static void ReadXConnectMessage (XIMS ims, XClientMessageEvent *ev)
         /* Only supporting only-CM & Property-with-CM method */
     }
     /*endif*/
-    _XRegisterFilterByType (dpy,
-                            x_client->accept_win,
-                            ClientMessage,
-                            ClientMessage,
-                            WaitXIMProtocol,
-                            (XPointer)ims);
-    event.xclient.type = ClientMessage;
-    event.xclient.display = dpy;
-    event.xclient.window = new_client;
-    event.xclient.message_type = spec->connect_request;
-    event.xclient.format = 32;
-    event.xclient.data.l[0] = x_client->accept_win;
-    event.xclient.data.l[1] = major_version;
-    event.xclient.data.l[2] = minor_version;
-    event.xclient.data.l[3] = XCM_DATA_LIMIT;
-
-    XSendEvent (dpy,
-                new_client,
-                False,
-                NoEventMask,
-                &event);
-    XFlush (dpy);
+    x_client = NewXClient (i18n_core, new_client);
+
+    memset (&event, 0, sizeof (event));
+    event.response_type = XCB_CLIENT_MESSAGE;
+    event.window = new_client;
+    event.type = spec->connect_request;
+    event.format = 32;
+    event.data.data32[0] = x_client->accept_win;
+    event.data.data32[1] = major_version;
+    event.data.data32[2] = minor_version;
+    event.data.data32[3] = XCM_DATA_LIMIT;
+
+    xcb_send_event (i18n_core->address.xcb,
+                    False,
+                    new_client,
+                    XCB_EVENT_MASK_NO_EVENT,
+                    (const char *) &event);
+    xcb_flush (i18n_core->address.xcb);
 }
 
 static Bool Xi18nXBegin (XIMS ims)
 {
     Xi18n i18n_core = ims->protocol;
-    Display *dpy = i18n_core->address.dpy;
+    xcb_connection_t *c = i18n_core->address.xcb;
     XSpecRec *spec = (XSpecRec *) i18n_core->address.connect_addr;
+    xcb_intern_atom_cookie_t xim_request;
+    xcb_intern_atom_cookie_t connect_request;
+    xcb_intern_atom_reply_t *reply;
+
+    xim_request = xcb_intern_atom (c,
+                                   False,
+                                   strlen (_XIM_PROTOCOL),
+                                   _XIM_PROTOCOL);
+    connect_request = xcb_intern_atom (c,
+                                       False,
+                                       strlen (_XIM_XCONNECT),
+                                       _XIM_XCONNECT);
+
+    if ((reply = xcb_intern_atom_reply (c, xim_request, NULL)) == NULL)
+    {
+        xcb_discard_reply (c, connect_request.sequence);
+        return False;
+    }
+    /*endif*/
+    spec->xim_request = reply->atom;
+    free (reply);
+
+    if ((reply = xcb_intern_atom_reply (c, connect_request, NULL)) == NULL)
+        return False;
+    /*endif*/
+    spec->connect_request = reply->atom;
+    free (reply);
 
-    spec->xim_request = XInternAtom (i18n_core->address.dpy,
-                                     _XIM_PROTOCOL,
-                                     False);
-    spec->connect_request = XInternAtom (i18n_core->address.dpy,
-                                         _XIM_XCONNECT,
-                                         False);
-
-    _XRegisterFilterByType (dpy,
-                            i18n_core->address.im_window,
-                            ClientMessage,
-                            ClientMessage,
-                            WaitXConnectMessage,
-                            (XPointer)ims);
     return True;
 }
 
 static Bool Xi18nXEnd(XIMS ims)
 {
-    Xi18n i18n_core = ims->protocol;
-    Display *dpy = i18n_core->address.dpy;
-
-    _XUnregisterFilter (dpy,
-                        i18n_core->address.im_window,
-                        WaitXConnectMessage,
-                        (XPointer)ims);
     return True;
 }
 
-static char *MakeNewAtom (CARD16 connect_id, char *atomName)
+static xcb_atom_t GetServerAtom (xcb_connection_t *c, XClient *x_client)
 {
     static int sequence = 0;
-    
-    sprintf (atomName,
-             "_server%d_%d",
-             connect_id,
-             ((sequence > 20)  ?  (sequence = 0)  :  sequence++));
-    return atomName;
+    xcb_intern_atom_reply_t *reply;
+    int i;
+
+    i = (sequence >= XCM_SERVER_ATOMS)  ?  (sequence = 0)  :  sequence;
+    sequence++;
+
+    if (x_client->server_atoms[i] == XCB_ATOM_NONE)
+    {
+        reply = xcb_intern_atom_reply (c,
+                                       x_client->server_atom_cookies[i],
+                                       NULL);
+        if (reply == NULL)
+            return XCB_ATOM_NONE;
+        /*endif*/
+        x_client->server_atoms[i] = reply->atom;
+        free (reply);
+    }
+    /*endif*/
+    return x_client->server_atoms[i];
 }
 
 static Bool Xi18nXSend (XIMS ims,
@@ -290,96 +334,54 @@ static Bool Xi18nXSend (XIMS ims,
                         long length)
 {
     Xi18n i18n_core = ims->protocol;
+    xcb_connection_t *c = i18n_core->address.xcb;
     Xi18nClient *client = _Xi18nFindClient (i18n_core, connect_id);
     XSpecRec *spec = (XSpecRec *) i18n_core->address.connect_addr;
     XClient *x_client = (XClient *) client->trans_rec;
-    XEvent event;
+    xcb_client_message_event_t event;
 
-    event.type = ClientMessage;
-    event.xclient.window = x_client->client_win;
-    event.xclient.message_type = spec->xim_request;
+    memset (&event, 0, sizeof (event));
+    event.response_type = XCB_CLIENT_MESSAGE;
+    event.window = x_client->client_win;
+    event.type = spec->xim_request;
 
     if (length > XCM_DATA_LIMIT)
     {
-        Atom atom;
-        char atomName[16];
-        Atom actual_type_ret;
-        int actual_format_ret;
-        int return_code;
-        unsigned long nitems_ret;
-        unsigned long bytes_after_ret;
-        unsigned char *win_data;
-
-        event.xclient.format = 32;
-        atom = XInternAtom (i18n_core->address.dpy,
-                            MakeNewAtom (connect_id, atomName),
-                            False);
-        return_code = XGetWindowProperty (i18n_core->address.dpy,
-                                          x_client->client_win,
-                                          atom,
-                                          0L,
-                                          10000L,
-                                          False,
-                                          XA_STRING,
-                                          &actual_type_ret,
-                                          &actual_format_ret,
-                                          &nitems_ret,
-                                          &bytes_after_ret,
-                                          &win_data);
-        if (return_code != Success)
+        xcb_atom_t atom;
+
+        event.format = 32;
+        if ((atom = GetServerAtom (c, x_client)) == XCB_ATOM_NONE)
             return False;
         /*endif*/
-        if (win_data)
-            XFree ((char *) win_data);
-        /*endif*/
-        XChangeProperty (i18n_core->address.dpy,
-                         x_client->client_win,
-                         atom,
-                         XA_STRING,
-                         8,
-                         PropModeAppend,
-                         (unsigned char *) reply,
-                         length);
-        event.xclient.data.l[0] = length;
-        event.xclient.data.l[1] = atom;
+        /*
+         * Appending needs no look at the property first; a client window
+         * that has gone away shows up as an asynchronous BadWindow.
+         */
+        xcb_change_property (c,
+                             XCB_PROP_MODE_APPEND,
+                             x_client->client_win,
+                             atom,
+                             XCB_ATOM_STRING,
+                             8,
+                             length,
+                             reply);
+        event.data.data32[0] = length;
+        event.data.data32[1] = atom;
     }
     else
     {
-        unsigned char buffer[XCM_DATA_LIMIT];
-        int i;
-
-        event.xclient.format = 8;
-
-        /* Clear unused field with NULL */
-        memmove(buffer, reply, length);
-        for (i = length; i < XCM_DATA_LIMIT; i++)
-            buffer[i] = (char) 0;
-        /*endfor*/
-        length = XCM_DATA_LIMIT;
-        memmove (event.xclient.data.b, buffer, length);
-    }
-    XSendEvent (i18n_core->address.dpy,
-                x_client->client_win,
-                False,
-                NoEventMask,
-                &event);
-    XFlush (i18n_core->address.dpy);
-    return True;
-}
+        event.format = 8;
 
-static Bool CheckCMEvent (Display *display, XEvent *event, XPointer xi18n_core)
-{
-    Xi18n i18n_core = (Xi18n) ((void *) xi18n_core);
-    XSpecRec *spec = (XSpecRec *) i18n_core->address.connect_addr;
-
-    if ((event->type == ClientMessage)
-        &&
-        (event->xclient.message_type == spec->xim_request))
-    {
-        return  True;
+        /* the rest of data stays cleared */
+        memmove (event.data.data8, reply, length);
     }
-    /*endif*/
-    return  False;
+    xcb_send_event (c,
+                    False,
+                    x_client->client_win,
+                    XCB_EVENT_MASK_NO_EVENT,
+                    (const char *) &event);
+    /* flushed by the event source before the main loop polls */
+    return True;
 }
 
 static Bool Xi18nXWait (XIMS ims,
@@ -388,45 +390,61 @@ static Bool Xi18nXWait (XIMS ims,
                         CARD8 minor_opcode)
 {
     Xi18n i18n_core = ims->protocol;
-    XEvent event;
+    xcb_connection_t *c = i18n_core->address.xcb;
+    XSpecRec *spec = (XSpecRec *) i18n_core->address.connect_addr;
     Xi18nClient *client = _Xi18nFindClient (i18n_core, connect_id);
     XClient *x_client = (XClient *) client->trans_rec;
 
+    xcb_flush (c);
+
     for (;;)
     {
+        xcb_generic_event_t *event;
+        xcb_client_message_event_t *ev;
         unsigned char *packet;
         XimProtoHdr *hdr;
         int connect_id_ret = 0;
+        Bool done = False;
+        Bool retval = False;
 
-        XIfEvent (i18n_core->address.dpy,
-                  &event,
-                  CheckCMEvent,
-                  (XPointer) i18n_core);
-        if (event.xclient.window == x_client->accept_win)
+        if ((event = xcb_wait_for_event (c)) == NULL)
+            return False; /* the connection has broken */
+        /*endif*/
+        ev = (xcb_client_message_event_t *) event;
+        if ((event->response_type & ~0x80) != XCB_CLIENT_MESSAGE
+            ||
+            ev->type != spec->xim_request
+            ||
+            ev->window != x_client->accept_win)
         {
-            if ((packet = ReadXIMMessage (ims,
-                                          (XClientMessageEvent *) & event,
-                                          &connect_id_ret))
-                == (unsigned char*) NULL)
-            {
-                return False;
-            }
-            /*endif*/
-            hdr = (XimProtoHdr *)packet;
-
-            if ((hdr->major_opcode == major_opcode)
-                &&
-                (hdr->minor_opcode == minor_opcode))
-            {
-                return True;
-            }
-            else if (hdr->major_opcode == XIM_ERROR)
-            {
-                return False;
-            }
-            /*endif*/
+            /* other clients go on being served meanwhile */
+            _Xi18nFilterXcbEvent (ims, event);
+            free (event);
+            continue;
         }
         /*endif*/
+        packet = ReadXIMMessage (ims, ev, &connect_id_ret);
+        free (event);
+        if (packet == (unsigned char *) NULL)
+            return False;
+        /*endif*/
+        hdr = (XimProtoHdr *) packet;
+
+        if ((hdr->major_opcode == major_opcode)
+            &&
+            (hdr->minor_opcode == minor_opcode))
+        {
+            done = retval = True;
+        }
+        else if (hdr->major_opcode == XIM_ERROR)
+        {
+            done = True;
+        }
+        /*endif*/
+        free (packet);
+        if (done)
+            return retval;
+        /*endif*/
     }
     /*endfor*/
 }
@@ -434,20 +452,37 @@ static Bool Xi18nXWait (XIMS ims,
 static Bool Xi18nXDisconnect (XIMS ims, CARD16 connect_id)
 {
     Xi18n i18n_core = ims->protocol;
-    Display *dpy = i18n_core->address.dpy;
+    xcb_connection_t *c = i18n_core->address.xcb;
     Xi18nClient *client = _Xi18nFindClient (i18n_core, connect_id);
     XClient *x_client = (XClient *) client->trans_rec;
+    int i;
 
-    XDestroyWindow (dpy, x_client->accept_win);
-    _XUnregisterFilter (dpy,
-                        x_client->accept_win,
-                        WaitXIMProtocol,
-                        (XPointer)ims);
-    XFree (x_client);
+    xcb_destroy_window (c, x_client->accept_win);
+    for (i = 0;  i < XCM_SERVER_ATOMS;  i++)
+    {
+        if (x_client->server_atoms[i] == XCB_ATOM_NONE)
+            xcb_discard_reply (c, x_client->server_atom_cookies[i].sequence);
+        /*endif*/
+    }
+    /*endfor*/
+    free (x_client);
     _Xi18nDeleteClient (i18n_core, connect_id);
     return True;
 }
 
+static Bool Xi18nXFilter (XIMS ims, xcb_generic_event_t *event)
+{
+    xcb_client_message_event_t *ev = (xcb_client_message_event_t *) event;
+
+    if ((event->response_type & ~0x80) != XCB_CLIENT_MESSAGE)
+        return False;
+    /*endif*/
+    if (ev->window == ((Xi18n) ims->protocol)->address.im_window)
+        return WaitXConnectMessage (ims, ev);
+    /*endif*/
+    return WaitXIMProtocol (ims, ev);
+}
+
 Bool _Xi18nCheckXAddress (Xi18n i18n_core,
                           TransportSW *transSW,
                           char *address)
@@ -464,47 +499,36 @@ Bool _Xi18nCheckXAddress (Xi18n i18n_core,
     i18n_core->methods.send = Xi18nXSend;
     i18n_core->methods.wait = Xi18nXWait;
     i18n_core->methods.disconnect = Xi18nXDisconnect;
+    i18n_core->methods.filter = Xi18nXFilter;
     return True;
 }
 
-static Bool WaitXConnectMessage (Display *dpy,
-                                 Window win,
-                                 XEvent *ev,
-                                 XPointer client_data)
+static Bool WaitXConnectMessage (XIMS ims, xcb_client_message_event_t *ev)
 {
-    XIMS ims = (XIMS)client_data;
     Xi18n i18n_core = ims->protocol;
     XSpecRec *spec = (XSpecRec *) i18n_core->address.connect_addr;
 
-    if (((XClientMessageEvent *) ev)->message_type
-        == spec->connect_request)
+    if (ev->type == spec->connect_request)
     {
-        ReadXConnectMessage (ims, (XClientMessageEvent *) ev);
+        ReadXConnectMessage (ims, ev);
         return True;
     }
     /*endif*/
     return False;
 }
 
-static Bool WaitXIMProtocol (Display *dpy,
-                             Window win,
-                             XEvent *ev,
-                             XPointer client_data)
+static Bool WaitXIMProtocol (XIMS ims, xcb_client_message_event_t *ev)
 {
     extern void _Xi18nMessageHandler (XIMS, CARD16, unsigned char *, Bool *);
-    XIMS ims = (XIMS) client_data;
     Xi18n i18n_core = ims->protocol;
     XSpecRec *spec = (XSpecRec *) i18n_core->address.connect_addr;
     Bool delete = True;
     unsigned char *packet;
     int connect_id = 0;
 
-    if (((XClientMessageEvent *) ev)->message_type
-        == spec->xim_request)
+    if (ev->type == spec->xim_request)
     {
-        if ((packet = ReadXIMMessage (ims,
-                                      (XClientMessageEvent *) ev,
-                                      &connect_id))
+        if ((packet = ReadXIMMessage (ims, ev, &connect_id))
             == (unsigned char *)  NULL)
         {
             return False;
@@ -0,0 +1,166 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 2; tab-width: 2 -*- */
+/*
+ * nimf-xim-bench.c
+ * This file is part of Nimf.
+ *
+ * Copyright (C) 2017 Hodong Kim <cogniti@gmail.com>
+ *
+ * Nimf is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Nimf is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program;  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Builds the XIM_FORWARD_EVENT, XIM_COMMIT and XIM_PREEDIT_DRAW frames the
+ * way IMdkit does while typing, with a reply buffer allocated per message
+ * and with one buffer reused, and prints the time per message.  Build it
+ * before and after a FrameMgr change to compare.
+ * Build with "make nimf-xim-bench".
+ */
+
+#include <glib.h>
+#include <stdlib.h>
+#include <string.h>
+#include "IMdkit/FrameMgr.h"
+
+extern XimFrameRec forward_event_fr[];
+extern XimFrameRec commit_chars_fr[];
+extern XimFrameRec preedit_draw_fr[];
+
+static const gchar *text = "\xec\x95\x88\xeb\x85\x95\xed\x95\x98\xec\x84\xb8\xec\x9a\x94";
+
+static unsigned char *
+get_buffer (gboolean reuse, gint size)
+{
+  static unsigned char *buffer      = NULL;
+  static gint           buffer_size = 0;
+
+  if (!reuse)
+    return malloc (size);
+
+  if (buffer_size < size)
+  {
+    buffer_size = MAX (size, 64);
+    buffer = realloc (buffer, buffer_size);
+  }
+
+  return buffer;
+}
+
+static void
+build_messages (gboolean reuse)
+{
+  FrameMgr       fm;
+  unsigned char *reply;
+  CARD16         id = 1, flag = 1, serial = 0, str_length;
+  CARD32         caret = 3, chg_first = 0, chg_length = 3, status = 0;
+  CARD32         feedback = 2;
+  gint           i;
+
+  fm = FrameMgrInit (forward_event_fr, NULL, False);
+  reply = get_buffer (reuse, FrameMgrGetTotalSize (fm) + 32);
+  FrameMgrSetBuffer (fm, reply);
+  FrameMgrPutToken (fm, id);
+  FrameMgrPutToken (fm, id);
+  FrameMgrPutToken (fm, flag);
+  FrameMgrPutToken (fm, serial);
+  FrameMgrFree (fm);
+
+  if (!reuse)
+    free (reply);
+
+  fm = FrameMgrInit (commit_chars_fr, NULL, False);
+  str_length = strlen (text);
+  FrameMgrSetSize (fm, str_length);
+  reply = get_buffer (reuse, FrameMgrGetTotalSize (fm));
+  FrameMgrSetBuffer (fm, reply);
+  FrameMgrPutToken (fm, id);
+  FrameMgrPutToken (fm, id);
+  FrameMgrPutToken (fm, flag);
+  FrameMgrPutToken (fm, str_length);
+  FrameMgrPutToken (fm, text);
+  FrameMgrFree (fm);
+
+  if (!reuse)
+    free (reply);
+
+  fm = FrameMgrInit (preedit_draw_fr, NULL, False);
+  FrameMgrSetSize (fm, str_length);
+  FrameMgrSetIterCount (fm, 5);
+  reply = get_buffer (reuse, FrameMgrGetTotalSize (fm));
+  FrameMgrSetBuffer (fm, reply);
+  FrameMgrPutToken (fm, id);
+  FrameMgrPutToken (fm, id);
+  FrameMgrPutToken (fm, caret);
+  FrameMgrPutToken (fm, chg_first);
+  FrameMgrPutToken (fm, chg_length);
+  FrameMgrPutToken (fm, status);
+  FrameMgrPutToken (fm, str_length);
+  FrameMgrPutToken (fm, text);
+
+  for (i = 0; i < 5; i++)
+    FrameMgrPutToken (fm, feedback);
+
+  FrameMgrFree (fm);
+
+  if (!reuse)
+    free (reply);
+}
+
+static gint64
+bench (gboolean reuse,
+       gint     n_messages)
+{
+  gint64 start = g_get_monotonic_time ();
+  gint   i;
+
+  for (i = 0; i < n_messages; i++)
+    build_messages (reuse);
+
+  return g_get_monotonic_time () - start;
+}
+
+int
+main (int argc, char **argv)
+{
+  gint n_messages = 1000000;
+
+  GOptionContext *option_context;
+  GOptionEntry    entries[] = {
+    {"messages", 'n', 0, G_OPTION_ARG_INT, &n_messages, "Rounds of messages to build", "N"},
+    {NULL}
+  };
+
+  option_context = g_option_context_new ("- Benchmark building XIM frames");
+  g_option_context_add_main_entries (option_context, entries, NULL);
+
+  if (!g_option_context_parse (option_context, &argc, &argv, NULL))
+  {
+    g_option_context_free (option_context);
+    return EXIT_FAILURE;
+  }
+
+  g_option_context_free (option_context);
+
+  n_messages = MAX (n_messages, 1);
+
+  /* warm up the pools */
+  bench (TRUE, 1000);
+
+  g_print ("%d rounds of 3 messages\n", n_messages);
+  g_print ("reply per message: %8.1f ns/message\n",
+           bench (FALSE, n_messages) * 1000.0 / n_messages / 3);
+  g_print ("reused reply:      %8.1f ns/message\n",
+           bench (TRUE, n_messages) * 1000.0 / n_messages / 3);
+
+  return EXIT_SUCCESS;
+}
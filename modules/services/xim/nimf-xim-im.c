@@ -22,8 +22,47 @@
 #include "nimf-xim-im.h"
 #include <X11/Xutil.h>
 
+#define NIMF_XIM_MAX_COMPOUND_TEXTS 256
+
 G_DEFINE_TYPE (NimfXimIM, nimf_xim_im, NIMF_TYPE_SERVICE_IM);
 
+/*
+ * Returns @text as the client wants it, owned by @xim_im or the cache.
+ * Clients without UTF8_STRING get COMPOUND_TEXT, which goes through the
+ * Xlib locale converters, so conversions are kept for repeated strings.
+ */
+static const gchar *
+nimf_xim_im_encode (NimfXimIM   *xim_im,
+                    const gchar *text)
+{
+  XTextProperty  property;
+  gchar         *compound_text;
+
+  if (xim_im->utf8)
+    return text;
+
+  compound_text = g_hash_table_lookup (xim_im->xim->compound_texts, text);
+
+  if (compound_text)
+    return compound_text;
+
+  if (Xutf8TextListToTextProperty (xim_im->xim->xims->core.display,
+                                   (char **) &text, 1, XCompoundTextStyle,
+                                   &property) < Success)
+    return "";
+
+  if (g_hash_table_size (xim_im->xim->compound_texts) >=
+      NIMF_XIM_MAX_COMPOUND_TEXTS)
+    g_hash_table_remove_all (xim_im->xim->compound_texts);
+
+  compound_text = g_strndup ((gchar *) property.value, property.nitems);
+  g_hash_table_insert (xim_im->xim->compound_texts, g_strdup (text),
+                       compound_text);
+  XFree (property.value);
+
+  return compound_text;
+}
+
 static void
 nimf_xim_im_emit_commit (NimfServiceIM *im,
                          const gchar   *text)
@@ -31,20 +70,14 @@ nimf_xim_im_emit_commit (NimfServiceIM *im,
   g_debug (G_STRLOC ": %s", G_STRFUNC);
 
   NimfXimIM *xim_im = NIMF_XIM_IM (im);
-  XTextProperty property;
-  Xutf8TextListToTextProperty (xim_im->xim->xims->core.display,
-                               (char **)&text, 1, XCompoundTextStyle,
-                               &property);
 
   IMCommitStruct commit_data = {0};
   commit_data.major_code = XIM_COMMIT;
   commit_data.connect_id = xim_im->connect_id;
   commit_data.icid       = im->icid;
   commit_data.flag       = XimLookupChars;
-  commit_data.commit_string = (gchar *) property.value;
+  commit_data.commit_string = (gchar *) nimf_xim_im_encode (xim_im, text);
   IMCommitString (xim_im->xim->xims, (XPointer) &commit_data);
-
-  XFree (property.value);
 }
 
 static void nimf_xim_im_emit_preedit_start (NimfServiceIM *im)
@@ -65,10 +98,15 @@ static void nimf_xim_im_emit_preedit_start (NimfServiceIM *im)
     preedit_cb_data.connect_id = xim_im->connect_id;
     preedit_cb_data.icid       = im->icid;
     IMCallCallback (xim_im->xim->xims, (XPointer) &preedit_cb_data);
-    gtk_widget_hide (xim_im->xim->window);
+    nimf_xim_preedit_window_hide (xim_im->xim->preedit_window);
   }
   else
-    gtk_widget_show_all (xim_im->xim->window);
+  {
+    /* cleared while hidden, so the old preedit never shows */
+    nimf_xim_preedit_window_set_text (xim_im->xim->preedit_window,
+                                      "", NULL, 0);
+    nimf_xim_preedit_window_show (xim_im->xim->preedit_window);
+  }
 }
 
 static void
@@ -85,13 +123,25 @@ nimf_xim_im_emit_preedit_changed (NimfServiceIM    *im,
   {
     IMPreeditCBStruct preedit_cb_data = {0};
     XIMText           text;
-    XTextProperty     text_property;
-
-    static XIMFeedback *feedback;
-    gint i, j, len;
+    XIMFeedback      *feedback;
+    XIMFeedback       saved;
+    const gchar      *old_p, *new_p, *old_end, *new_end;
+    gchar            *string;
+    gint i, j, len, prefix, suffix, max_suffix;
 
     len = g_utf8_strlen (preedit_string, -1);
-    feedback = g_malloc0 (sizeof (XIMFeedback) * (len + 1));
+
+    if (xim_im->feedback_size < len + 1)
+    {
+      xim_im->feedback_size = len + 1;
+      xim_im->feedback     = g_renew (XIMFeedback, xim_im->feedback,
+                                      xim_im->feedback_size);
+      xim_im->old_feedback = g_renew (XIMFeedback, xim_im->old_feedback,
+                                      xim_im->feedback_size);
+    }
+
+    feedback = xim_im->feedback;
+    memset (feedback, 0, sizeof (XIMFeedback) * (len + 1));
 
     for (i = 0; attrs[i]; i++)
     {
@@ -110,48 +160,97 @@ nimf_xim_im_emit_preedit_changed (NimfServiceIM    *im,
       }
     }
 
-    feedback[len] = 0;
+    /* the unchanged head and tail, in characters and feedback */
+    old_p = xim_im->preedit->str;
+    new_p = preedit_string;
 
-    preedit_cb_data.major_code = XIM_PREEDIT_DRAW;
-    preedit_cb_data.connect_id = xim_im->connect_id;
-    preedit_cb_data.icid = im->icid;
-    preedit_cb_data.todo.draw.caret = len;
-    preedit_cb_data.todo.draw.chg_first = 0;
-    preedit_cb_data.todo.draw.chg_length = xim_im->preedit_length;
-    preedit_cb_data.todo.draw.text = &text;
+    for (prefix = 0; prefix < MIN (len, xim_im->preedit_length); prefix++)
+    {
+      if (g_utf8_get_char (old_p) != g_utf8_get_char (new_p) ||
+          xim_im->old_feedback[prefix] != feedback[prefix])
+        break;
+
+      old_p = g_utf8_next_char (old_p);
+      new_p = g_utf8_next_char (new_p);
+    }
 
-    text.feedback = feedback;
+    old_end    = xim_im->preedit->str + xim_im->preedit->len;
+    new_end    = preedit_string + strlen (preedit_string);
+    max_suffix = MIN (len, xim_im->preedit_length) - prefix;
 
-    if (len > 0)
+    for (suffix = 0; suffix < max_suffix; suffix++)
     {
-      Xutf8TextListToTextProperty (xim_im->xim->xims->core.display,
-                                   (char **) &preedit_string, 1,
-                                   XCompoundTextStyle, &text_property);
-      text.encoding_is_wchar = 0;
-      text.length = strlen ((char *) text_property.value);
-      text.string.multi_byte = (char *) text_property.value;
-      IMCallCallback (xim_im->xim->xims, (XPointer) &preedit_cb_data);
-      XFree (text_property.value);
+      const gchar *old_prev = g_utf8_prev_char (old_end);
+      const gchar *new_prev = g_utf8_prev_char (new_end);
+
+      if (g_utf8_get_char (old_prev) != g_utf8_get_char (new_prev) ||
+          xim_im->old_feedback[xim_im->preedit_length - suffix - 1] !=
+          feedback[len - suffix - 1])
+        break;
+
+      old_end = old_prev;
+      new_end = new_prev;
+    }
+
+    preedit_cb_data.connect_id = xim_im->connect_id;
+    preedit_cb_data.icid       = im->icid;
+
+    if (prefix == len && len == xim_im->preedit_length)
+    {
+      if (cursor_pos != xim_im->preedit_caret)
+      {
+        preedit_cb_data.major_code = XIM_PREEDIT_CARET;
+        preedit_cb_data.todo.caret.position  = cursor_pos;
+        preedit_cb_data.todo.caret.direction = XIMAbsolutePosition;
+        preedit_cb_data.todo.caret.style     = XIMIsPrimary;
+        IMCallCallback (xim_im->xim->xims, (XPointer) &preedit_cb_data);
+      }
     }
     else
     {
+      preedit_cb_data.major_code = XIM_PREEDIT_DRAW;
+      preedit_cb_data.todo.draw.caret      = cursor_pos;
+      preedit_cb_data.todo.draw.chg_first  = prefix;
+      preedit_cb_data.todo.draw.chg_length = xim_im->preedit_length - prefix - suffix;
+      preedit_cb_data.todo.draw.text       = &text;
+
+      /* feedback is read up to the first zero */
+      saved = feedback[len - suffix];
+      feedback[len - suffix] = 0;
+      text.feedback = feedback + prefix;
       text.encoding_is_wchar = 0;
-      text.length = 0;
-      text.string.multi_byte = "";
-      IMCallCallback (xim_im->xim->xims, (XPointer) &preedit_cb_data);
-      len = 0;
+
+      if (new_end > new_p)
+      {
+        string = g_strndup (new_p, new_end - new_p);
+        text.string.multi_byte = (char *) nimf_xim_im_encode (xim_im, string);
+        text.length = strlen (text.string.multi_byte);
+        IMCallCallback (xim_im->xim->xims, (XPointer) &preedit_cb_data);
+        g_free (string);
+      }
+      else
+      {
+        text.length = 0;
+        text.string.multi_byte = "";
+        IMCallCallback (xim_im->xim->xims, (XPointer) &preedit_cb_data);
+      }
+
+      feedback[len - suffix] = saved;
     }
 
+    g_string_assign (xim_im->preedit, preedit_string);
     xim_im->preedit_length = len;
+    xim_im->preedit_caret  = cursor_pos;
+    xim_im->feedback       = xim_im->old_feedback;
+    xim_im->old_feedback   = feedback;
 
-    g_free (feedback);
-    gtk_widget_hide (xim_im->xim->window);
+    nimf_xim_preedit_window_hide (xim_im->xim->preedit_window);
   }
   else
   {
-    gtk_entry_set_text (GTK_ENTRY (xim_im->xim->entry), preedit_string);
-    gtk_editable_set_position (GTK_EDITABLE (xim_im->xim->entry), cursor_pos);
-    gtk_widget_show_all (xim_im->xim->window);
+    nimf_xim_preedit_window_set_text (xim_im->xim->preedit_window,
+                                      preedit_string, attrs, cursor_pos);
+    nimf_xim_preedit_window_show (xim_im->xim->preedit_window);
   }
 }
 
@@ -174,9 +273,13 @@ static void nimf_xim_im_emit_preedit_end (NimfServiceIM *im)
     preedit_cb_data.connect_id = xim_im->connect_id;
     preedit_cb_data.icid       = im->icid;
     IMCallCallback (xim_im->xim->xims, (XPointer) &preedit_cb_data);
+
+    g_string_assign (xim_im->preedit, "");
+    xim_im->preedit_length = 0;
+    xim_im->preedit_caret  = 0;
   }
 
-  gtk_widget_hide (xim_im->xim->window);
+  nimf_xim_preedit_window_hide (xim_im->xim->preedit_window);
 }
 
 NimfXimIM *nimf_xim_im_new (NimfServer *server,
@@ -193,11 +296,17 @@ NimfXimIM *nimf_xim_im_new (NimfServer *server,
 static void
 nimf_xim_im_init (NimfXimIM *nimf_xim_im)
 {
+  nimf_xim_im->preedit = g_string_new ("");
 }
 
 static void
 nimf_xim_im_finalize (GObject *object)
 {
+  NimfXimIM *xim_im = NIMF_XIM_IM (object);
+
+  g_string_free (xim_im->preedit, TRUE);
+  g_free (xim_im->feedback);
+  g_free (xim_im->old_feedback);
 
   G_OBJECT_CLASS (nimf_xim_im_parent_class)->finalize (object);
 }
@@ -48,12 +48,22 @@ struct _NimfXimIMClass
 struct _NimfXimIM
 {
   NimfServiceIM parent_instance;
-  guint16  connect_id;
-  gint     preedit_length;
-  CARD32   input_style;
-  Window   client_window;
-  Window   focus_window;
-  NimfXim *xim;
+  guint16      connect_id;
+  gboolean     utf8;
+  /* what the client shows, to send only what changes */
+  GString     *preedit;
+  gint         preedit_length;
+  gint         preedit_caret;
+  XIMFeedback *feedback;
+  XIMFeedback *old_feedback;
+  gint         feedback_size;
+  CARD32       input_style;
+  Window       client_window;
+  Window       focus_window;
+  XPoint       spot_location;  /* relative to the focus window */
+  gboolean     spot_location_changed;
+  CARD32       forward_mask;   /* last XIM_SET_EVENT_MASK sent */
+  NimfXim     *xim;
 };
 
 GType nimf_xim_im_get_type (void) G_GNUC_CONST;
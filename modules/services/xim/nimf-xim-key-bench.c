@@ -0,0 +1,194 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 2; tab-width: 2 -*- */
+/*
+ * nimf-xim-key-bench.c
+ * This file is part of Nimf.
+ *
+ * Copyright (C) 2017 Hodong Kim <cogniti@gmail.com>
+ *
+ * Nimf is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Nimf is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program;  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * An XIM client that feeds key presses and releases to a running nimf
+ * through XFilterEvent, the way a toolkit does, and prints the keys per
+ * second the XIM service handles.  Run it under Xvfb against nimf built
+ * before and after a change to the XIM transport to compare:
+ *
+ *   Xvfb :9 & DISPLAY=:9 nimf & DISPLAY=:9 ./nimf-xim-key-bench -n 20000
+ *
+ * Build with "make nimf-xim-key-bench".
+ */
+
+#include <glib.h>
+#include <locale.h>
+#include <stdlib.h>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/keysym.h>
+
+static gint n_committed = 0;
+
+static void
+drain_events (Display *display,
+              XIC      xic)
+{
+  XEvent event;
+  gchar  buf[64];
+  Status status;
+
+  while (XPending (display))
+  {
+    XNextEvent (display, &event);
+
+    if (XFilterEvent (&event, None) || event.type != KeyPress)
+      continue;
+
+    /* keys nimf passed back and commits both end up here */
+    if (Xutf8LookupString (xic, &event.xkey, buf, sizeof buf - 1,
+                           NULL, &status) > 0)
+      n_committed++;
+  }
+}
+
+static void
+send_key (Display *display,
+          XIC      xic,
+          Window   window,
+          gint     type,
+          KeyCode  keycode)
+{
+  XEvent event = { 0 };
+
+  event.xkey.type        = type;
+  event.xkey.display     = display;
+  event.xkey.window      = window;
+  event.xkey.root        = DefaultRootWindow (display);
+  event.xkey.time        = CurrentTime;
+  event.xkey.keycode     = keycode;
+  event.xkey.same_screen = True;
+
+  /* forwarded to nimf and back, synchronously for a press */
+  if (!XFilterEvent (&event, None) && type == KeyPress)
+  {
+    gchar  buf[64];
+    Status status;
+
+    if (Xutf8LookupString (xic, &event.xkey, buf, sizeof buf - 1,
+                           NULL, &status) > 0)
+      n_committed++;
+  }
+
+  drain_events (display, xic);
+}
+
+int
+main (int argc, char **argv)
+{
+  gint     n_keys = 10000;
+  Display *display;
+  Window   window;
+  XIM      xim;
+  XIC      xic;
+  KeyCode  keycode;
+  gint64   start, elapsed;
+  gint     i;
+
+  GOptionContext *option_context;
+  GOptionEntry    entries[] = {
+    {"keys", 'n', 0, G_OPTION_ARG_INT, &n_keys, "Keys to type", "N"},
+    {NULL}
+  };
+
+  option_context = g_option_context_new ("- Benchmark XIM key throughput");
+  g_option_context_add_main_entries (option_context, entries, NULL);
+
+  if (!g_option_context_parse (option_context, &argc, &argv, NULL))
+  {
+    g_option_context_free (option_context);
+    return EXIT_FAILURE;
+  }
+
+  g_option_context_free (option_context);
+
+  n_keys = MAX (n_keys, 1);
+
+  setlocale (LC_CTYPE, "");
+  XSetLocaleModifiers ("@im=nimf");
+
+  if (!(display = XOpenDisplay (NULL)))
+  {
+    g_printerr ("Can't open display\n");
+    return EXIT_FAILURE;
+  }
+
+  if (!(xim = XOpenIM (display, NULL, NULL, NULL)))
+  {
+    g_printerr ("Can't open the nimf input method; is nimf running?\n");
+    XCloseDisplay (display);
+    return EXIT_FAILURE;
+  }
+
+  window = XCreateSimpleWindow (display, DefaultRootWindow (display),
+                                0, 0, 1, 1, 0, 0, 0);
+  xic = XCreateIC (xim,
+                   XNInputStyle,   XIMPreeditNothing | XIMStatusNothing,
+                   XNClientWindow, window,
+                   XNFocusWindow,  window,
+                   NULL);
+
+  if (!xic)
+  {
+    g_printerr ("Can't create an input context\n");
+    XCloseIM (xim);
+    XCloseDisplay (display);
+    return EXIT_FAILURE;
+  }
+
+  XSetICFocus (xic);
+  keycode = XKeysymToKeycode (display, XK_a);
+
+  /* warm up the connection */
+  for (i = 0; i < 100; i++)
+  {
+    send_key (display, xic, window, KeyPress,   keycode);
+    send_key (display, xic, window, KeyRelease, keycode);
+  }
+
+  XSync (display, False);
+  drain_events (display, xic);
+  n_committed = 0;
+
+  start = g_get_monotonic_time ();
+
+  for (i = 0; i < n_keys; i++)
+  {
+    send_key (display, xic, window, KeyPress,   keycode);
+    send_key (display, xic, window, KeyRelease, keycode);
+  }
+
+  XSync (display, False);
+  drain_events (display, xic);
+  elapsed = MAX (g_get_monotonic_time () - start, 1);
+
+  g_print ("%d keys, %d strings back\n", n_keys, n_committed);
+  g_print ("%10.1f keys/s\n", n_keys * 1000000.0 / elapsed);
+  g_print ("%10.1f us/key (press and release)\n", (gdouble) elapsed / n_keys);
+
+  XDestroyIC (xic);
+  XCloseIM (xim);
+  XDestroyWindow (display, window);
+  XCloseDisplay (display);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,432 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 2; tab-width: 2 -*- */
+/*
+ * nimf-xim-preedit-window.c
+ * This file is part of Nimf.
+ *
+ * Copyright (C) 2017 Hodong Kim <cogniti@gmail.com>
+ *
+ * Nimf is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Nimf is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program;  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "nimf-xim-preedit-window.h"
+#include <cairo-xlib.h>
+#include <pango/pangocairo.h>
+#include <string.h>
+
+#define NIMF_XIM_PREEDIT_WINDOW_FONT    "Sans 11"
+#define NIMF_XIM_PREEDIT_WINDOW_PADDING 2
+
+enum
+{
+  NIMF_XIM_PREEDIT_STYLE_HIGHLIGHT = 1 << 0,
+  NIMF_XIM_PREEDIT_STYLE_UNDERLINE = 1 << 1
+};
+
+/*
+ * Preedit for clients without XIMPreeditCallbacks, drawn with Pango and
+ * Cairo straight onto an override-redirect window.  Only the characters
+ * that changed and the carets are repainted, and the window is resized
+ * only when the text width changes.
+ */
+struct _NimfXimPreeditWindow
+{
+  Display         *display;
+  Window           window;
+  cairo_surface_t *surface;
+  PangoLayout     *layout;
+  cairo_region_t  *exposed;     /* until the last Expose of a series */
+  GString         *text;
+  gint             length;      /* in characters */
+  gint             cursor_pos;
+  guint8          *styles;      /* per character */
+  guint8          *old_styles;
+  gint             styles_size;
+  gint             x, y;
+  gint             width, height;
+  gint             text_height;
+  gboolean         visible;
+};
+
+static gint
+nimf_xim_preedit_window_index_to_x (NimfXimPreeditWindow *window,
+                                    gint                  index)
+{
+  PangoRectangle pos;
+
+  pango_layout_index_to_pos (window->layout, index, &pos);
+
+  return NIMF_XIM_PREEDIT_WINDOW_PADDING + PANGO_PIXELS (pos.x);
+}
+
+static gint
+nimf_xim_preedit_window_caret_x (NimfXimPreeditWindow *window)
+{
+  const gchar *caret;
+
+  caret = g_utf8_offset_to_pointer (window->text->str, window->cursor_pos);
+
+  return nimf_xim_preedit_window_index_to_x (window,
+                                             caret - window->text->str);
+}
+
+static void
+nimf_xim_preedit_window_paint (NimfXimPreeditWindow *window,
+                               const cairo_region_t *region)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  cairo_rectangle_int_t rect;
+  cairo_t *cr;
+  gint     i;
+
+  if (cairo_region_is_empty (region))
+    return;
+
+  cr = cairo_create (window->surface);
+
+  for (i = 0; i < cairo_region_num_rectangles (region); i++)
+  {
+    cairo_region_get_rectangle (region, i, &rect);
+    cairo_rectangle (cr, rect.x, rect.y, rect.width, rect.height);
+  }
+
+  cairo_clip (cr);
+  cairo_set_source_rgb (cr, 1.0, 1.0, 1.0);
+  cairo_paint (cr);
+  cairo_set_source_rgb (cr, 0.0, 0.0, 0.0);
+  cairo_move_to (cr, NIMF_XIM_PREEDIT_WINDOW_PADDING,
+                     NIMF_XIM_PREEDIT_WINDOW_PADDING);
+  pango_cairo_show_layout (cr, window->layout);
+  cairo_rectangle (cr, nimf_xim_preedit_window_caret_x (window),
+                   NIMF_XIM_PREEDIT_WINDOW_PADDING, 1, window->text_height);
+  cairo_fill (cr);
+  cairo_destroy (cr);
+  cairo_surface_flush (window->surface);
+}
+
+static void
+nimf_xim_preedit_window_set_attrs (NimfXimPreeditWindow *window,
+                                   const gchar          *text,
+                                   NimfPreeditAttr     **attrs)
+{
+  PangoAttrList  *attr_list;
+  PangoAttribute *attr;
+  gint            i;
+
+  attr_list = pango_attr_list_new ();
+
+  for (i = 0; attrs && attrs[i]; i++)
+  {
+    switch (attrs[i]->type)
+    {
+      case NIMF_PREEDIT_ATTR_HIGHLIGHT:
+        attr = pango_attr_background_new (0xc0c0, 0xd8d8, 0xffff);
+        break;
+      case NIMF_PREEDIT_ATTR_UNDERLINE:
+        attr = pango_attr_underline_new (PANGO_UNDERLINE_SINGLE);
+        break;
+      default:
+        continue;
+    }
+
+    attr->start_index = g_utf8_offset_to_pointer (text, attrs[i]->start_index) - text;
+    attr->end_index   = g_utf8_offset_to_pointer (text, attrs[i]->end_index)   - text;
+    pango_attr_list_insert (attr_list, attr);
+  }
+
+  pango_layout_set_attributes (window->layout, attr_list);
+  pango_attr_list_unref (attr_list);
+}
+
+void
+nimf_xim_preedit_window_set_text (NimfXimPreeditWindow *window,
+                                  const gchar          *text,
+                                  NimfPreeditAttr     **attrs,
+                                  gint                  cursor_pos)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  cairo_region_t       *damage;
+  cairo_rectangle_int_t rect;
+  const gchar          *old_p, *new_p, *old_end, *new_end;
+  guint8               *styles;
+  gboolean              text_changed;
+  gint i, j, len, prefix, suffix, max_suffix, width;
+  gint old_x0, old_x1, old_width, old_caret;
+  gint new_x0, new_x1, new_width, new_caret;
+
+  len = g_utf8_strlen (text, -1);
+  cursor_pos = CLAMP (cursor_pos, 0, len);
+
+  if (window->styles_size < len + 1)
+  {
+    window->styles_size = len + 1;
+    window->styles      = g_renew (guint8, window->styles,
+                                   window->styles_size);
+    window->old_styles  = g_renew (guint8, window->old_styles,
+                                   window->styles_size);
+  }
+
+  styles = window->styles;
+  memset (styles, 0, len + 1);
+
+  for (i = 0; attrs && attrs[i]; i++)
+  {
+    guint8 style;
+
+    if (attrs[i]->type == NIMF_PREEDIT_ATTR_HIGHLIGHT)
+      style = NIMF_XIM_PREEDIT_STYLE_HIGHLIGHT;
+    else if (attrs[i]->type == NIMF_PREEDIT_ATTR_UNDERLINE)
+      style = NIMF_XIM_PREEDIT_STYLE_UNDERLINE;
+    else
+      continue;
+
+    for (j = attrs[i]->start_index; j < MIN (attrs[i]->end_index, len); j++)
+      styles[j] |= style;
+  }
+
+  /* the unchanged head and tail, in characters and styles */
+  old_p = window->text->str;
+  new_p = text;
+
+  for (prefix = 0; prefix < MIN (len, window->length); prefix++)
+  {
+    if (g_utf8_get_char (old_p) != g_utf8_get_char (new_p) ||
+        window->old_styles[prefix] != styles[prefix])
+      break;
+
+    old_p = g_utf8_next_char (old_p);
+    new_p = g_utf8_next_char (new_p);
+  }
+
+  old_end    = window->text->str + window->text->len;
+  new_end    = text + strlen (text);
+  max_suffix = MIN (len, window->length) - prefix;
+
+  for (suffix = 0; suffix < max_suffix; suffix++)
+  {
+    const gchar *old_prev = g_utf8_prev_char (old_end);
+    const gchar *new_prev = g_utf8_prev_char (new_end);
+
+    if (g_utf8_get_char (old_prev) != g_utf8_get_char (new_prev) ||
+        window->old_styles[window->length - suffix - 1] !=
+        styles[len - suffix - 1])
+      break;
+
+    old_end = old_prev;
+    new_end = new_prev;
+  }
+
+  text_changed = prefix != len || len != window->length;
+
+  if (!text_changed && cursor_pos == window->cursor_pos)
+    return;
+
+  /* where things were, while the layout still holds the old text */
+  old_x0    = nimf_xim_preedit_window_index_to_x (window,
+                                                  old_p - window->text->str);
+  old_x1    = nimf_xim_preedit_window_index_to_x (window,
+                                                  old_end - window->text->str);
+  old_caret = nimf_xim_preedit_window_caret_x (window);
+  pango_layout_get_pixel_size (window->layout, &old_width, NULL);
+
+  if (text_changed)
+  {
+    pango_layout_set_text (window->layout, text, -1);
+    nimf_xim_preedit_window_set_attrs (window, text, attrs);
+    g_string_assign (window->text, text);
+    window->length     = len;
+    window->styles     = window->old_styles;
+    window->old_styles = styles;
+  }
+
+  window->cursor_pos = cursor_pos;
+
+  new_x0    = nimf_xim_preedit_window_index_to_x (window, new_p - text);
+  new_x1    = nimf_xim_preedit_window_index_to_x (window, new_end - text);
+  new_caret = nimf_xim_preedit_window_caret_x (window);
+  pango_layout_get_pixel_size (window->layout, &new_width, NULL);
+
+  damage = cairo_region_create ();
+  rect.y      = 0;
+  rect.height = window->height;
+
+  if (text_changed)
+  {
+    rect.x = MIN (old_x0, new_x0);
+
+    /* the tail only needs a repaint if it moved */
+    if (old_x1 == new_x1)
+      rect.width = new_x1 - rect.x;
+    else
+      rect.width = NIMF_XIM_PREEDIT_WINDOW_PADDING +
+                   MAX (old_width, new_width) + 1 - rect.x;
+
+    if (rect.width > 0)
+      cairo_region_union_rectangle (damage, &rect);
+  }
+
+  rect.width = 1;
+  rect.x     = old_caret;
+  cairo_region_union_rectangle (damage, &rect);
+  rect.x     = new_caret;
+  cairo_region_union_rectangle (damage, &rect);
+
+  width = new_width + 2 * NIMF_XIM_PREEDIT_WINDOW_PADDING + 1;
+
+  if (width != window->width)
+  {
+    /* a wider window gets an Expose for what it gained */
+    window->width = width;
+    XResizeWindow (window->display, window->window,
+                   window->width, window->height);
+    cairo_xlib_surface_set_size (window->surface,
+                                 window->width, window->height);
+  }
+
+  if (window->visible)
+    nimf_xim_preedit_window_paint (window, damage);
+
+  cairo_region_destroy (damage);
+}
+
+void
+nimf_xim_preedit_window_move (NimfXimPreeditWindow *window,
+                              gint                  x,
+                              gint                  y)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  if (x == window->x && y == window->y)
+    return;
+
+  window->x = x;
+  window->y = y;
+  XMoveWindow (window->display, window->window, x, y);
+}
+
+void
+nimf_xim_preedit_window_show (NimfXimPreeditWindow *window)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  if (window->visible)
+    return;
+
+  /* painted on Expose */
+  window->visible = TRUE;
+  XMapRaised (window->display, window->window);
+}
+
+void
+nimf_xim_preedit_window_hide (NimfXimPreeditWindow *window)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  if (!window->visible)
+    return;
+
+  window->visible = FALSE;
+  XUnmapWindow (window->display, window->window);
+}
+
+/* returns TRUE if @event was for @window */
+gboolean
+nimf_xim_preedit_window_handle_event (NimfXimPreeditWindow *window,
+                                      XEvent               *event)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  cairo_rectangle_int_t rect;
+
+  if (event->xany.window != window->window)
+    return FALSE;
+
+  if (event->type == Expose)
+  {
+    rect.x      = event->xexpose.x;
+    rect.y      = event->xexpose.y;
+    rect.width  = event->xexpose.width;
+    rect.height = event->xexpose.height;
+    cairo_region_union_rectangle (window->exposed, &rect);
+
+    if (event->xexpose.count == 0)
+    {
+      nimf_xim_preedit_window_paint (window, window->exposed);
+      cairo_region_destroy (window->exposed);
+      window->exposed = cairo_region_create ();
+    }
+  }
+
+  return TRUE;
+}
+
+NimfXimPreeditWindow *
+nimf_xim_preedit_window_new (Display *display)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  NimfXimPreeditWindow  *window = g_slice_new0 (NimfXimPreeditWindow);
+  PangoContext          *context;
+  PangoFontDescription  *desc;
+  XSetWindowAttributes   attrs;
+  gint                   screen = DefaultScreen (display);
+
+  context = pango_font_map_create_context (pango_cairo_font_map_get_default ());
+  window->layout = pango_layout_new (context);
+  desc = pango_font_description_from_string (NIMF_XIM_PREEDIT_WINDOW_FONT);
+  pango_layout_set_font_description (window->layout, desc);
+  pango_font_description_free (desc);
+  g_object_unref (context);
+  /* an empty layout is one line high */
+  pango_layout_get_pixel_size (window->layout, NULL, &window->text_height);
+
+  window->display = display;
+  window->text    = g_string_new ("");
+  window->exposed = cairo_region_create ();
+  window->width   = 2 * NIMF_XIM_PREEDIT_WINDOW_PADDING + 1;
+  window->height  = 2 * NIMF_XIM_PREEDIT_WINDOW_PADDING + window->text_height;
+
+  attrs.override_redirect = True;
+  attrs.background_pixel  = WhitePixel (display, screen);
+  attrs.border_pixel      = BlackPixel (display, screen);
+  attrs.bit_gravity       = NorthWestGravity; /* keeps what is drawn */
+  attrs.event_mask        = ExposureMask;
+
+  window->window = XCreateWindow (display, RootWindow (display, screen),
+                                  0, 0, window->width, window->height, 1,
+                                  CopyFromParent, InputOutput, CopyFromParent,
+                                  CWOverrideRedirect | CWBackPixel |
+                                  CWBorderPixel | CWBitGravity | CWEventMask,
+                                  &attrs);
+  window->surface = cairo_xlib_surface_create (display, window->window,
+                                               DefaultVisual (display, screen),
+                                               window->width, window->height);
+  return window;
+}
+
+void
+nimf_xim_preedit_window_free (NimfXimPreeditWindow *window)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  cairo_surface_destroy (window->surface);
+  XDestroyWindow (window->display, window->window);
+  g_object_unref (window->layout);
+  cairo_region_destroy (window->exposed);
+  g_string_free (window->text, TRUE);
+  g_free (window->styles);
+  g_free (window->old_styles);
+  g_slice_free (NimfXimPreeditWindow, window);
+}
@@ -0,0 +1,48 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 2; tab-width: 2 -*- */
+/*
+ * nimf-xim-preedit-window.h
+ * This file is part of Nimf.
+ *
+ * Copyright (C) 2017 Hodong Kim <cogniti@gmail.com>
+ *
+ * Nimf is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Nimf is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program;  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __NIMF_XIM_PREEDIT_WINDOW_H__
+#define __NIMF_XIM_PREEDIT_WINDOW_H__
+
+#include <nimf.h>
+#include <X11/Xlib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _NimfXimPreeditWindow NimfXimPreeditWindow;
+
+NimfXimPreeditWindow *nimf_xim_preedit_window_new  (Display              *display);
+void     nimf_xim_preedit_window_free         (NimfXimPreeditWindow *window);
+void     nimf_xim_preedit_window_set_text     (NimfXimPreeditWindow *window,
+                                               const gchar          *text,
+                                               NimfPreeditAttr     **attrs,
+                                               gint                  cursor_pos);
+void     nimf_xim_preedit_window_move         (NimfXimPreeditWindow *window,
+                                               gint                  x,
+                                               gint                  y);
+void     nimf_xim_preedit_window_show         (NimfXimPreeditWindow *window);
+void     nimf_xim_preedit_window_hide         (NimfXimPreeditWindow *window);
+gboolean nimf_xim_preedit_window_handle_event (NimfXimPreeditWindow *window,
+                                               XEvent               *event);
+
+G_END_DECLS
+
+#endif /* __NIMF_XIM_PREEDIT_WINDOW_H__ */
@@ -21,20 +21,53 @@
 
 #include "nimf-xim.h"
 
+extern Xi18nClient *_Xi18nFindClient (Xi18n, CARD16);
+extern void _Xi18nSetEventMask (XIMS, CARD16, CARD16, CARD16, CARD32, CARD32);
+extern Bool _Xi18nFilterXcbEvent (XIMS, xcb_generic_event_t *);
+
 G_DEFINE_DYNAMIC_TYPE (NimfXim, nimf_xim, NIMF_TYPE_SERVICE);
 
+/*
+ * Key releases are forwarded only while the engine of @xim_im wants
+ * them; otherwise the client keeps them and skips a round trip per key.
+ * XIM masks work per event type, so presses always come through.
+ */
+static void
+nimf_xim_update_event_mask (NimfXim   *xim,
+                            NimfXimIM *xim_im)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  NimfEngine *engine = NIMF_SERVICE_IM (xim_im)->engine;
+  CARD32      mask   = KeyPressMask;
+
+  if (engine && nimf_engine_wants_key_release (engine))
+    mask |= KeyReleaseMask;
+
+  if (mask == xim_im->forward_mask)
+    return;
+
+  xim_im->forward_mask = mask;
+  _Xi18nSetEventMask (xim->xims, xim_im->connect_id, xim_im->connect_id,
+                      NIMF_SERVICE_IM (xim_im)->icid, mask, ~mask);
+}
+
 static void nimf_xim_set_engine_by_id (NimfService *service,
                                        const gchar *engine_id)
 {
   g_debug (G_STRLOC ": %s", G_STRFUNC);
 
+  NimfXim       *xim = NIMF_XIM (service);
   GHashTableIter iter;
   gpointer       im;
 
-  g_hash_table_iter_init (&iter, NIMF_XIM (service)->ims);
+  g_hash_table_iter_init (&iter, xim->ims);
 
   while (g_hash_table_iter_next (&iter, NULL, &im))
+  {
     nimf_service_im_set_engine_by_id (im, engine_id);
+    nimf_xim_update_event_mask (xim, im);
+  }
 }
 
 static guint16
@@ -67,6 +100,20 @@ static int nimf_xim_set_ic_values (NimfXim          *xim,
   im = g_hash_table_lookup (xim->ims, GUINT_TO_POINTER (data->icid));
   xim_im = NIMF_XIM_IM (im);
 
+  /*
+   * A spot location comes with nearly every caret move; keep the last one
+   * and hand it to the engine before the next key event.
+   */
+  if (data->ic_attr_num == 0 && data->status_attr_num == 0 &&
+      data->preedit_attr_num == 1 &&
+      g_strcmp0 (XNSpotLocation, data->preedit_attr[0].name) == 0)
+  {
+    xim_im->spot_location = *(XPoint *) data->preedit_attr[0].value;
+    xim_im->spot_location_changed = TRUE;
+
+    return 1;
+  }
+
   for (i = 0; i < data->ic_attr_num; i++)
   {
     if (g_strcmp0 (XNInputStyle, data->ic_attr[i].name) == 0)
@@ -100,6 +147,11 @@ static int nimf_xim_set_ic_values (NimfXim          *xim,
           break;
       }
     }
+    else if (g_strcmp0 (XNSpotLocation, data->preedit_attr[i].name) == 0)
+    {
+      xim_im->spot_location = *(XPoint *) data->preedit_attr[i].value;
+      xim_im->spot_location_changed = TRUE;
+    }
     else
       g_critical (G_STRLOC ": %s: %s is ignored",
                   G_STRFUNC, data->preedit_attr[i].name);
@@ -124,8 +176,14 @@ static int nimf_xim_create_ic (NimfXim          *xim,
 
   if (!xim_im)
   {
+    Xi18nClient *client;
+
     xim_im = nimf_xim_im_new (NIMF_SERVICE (xim)->server, xim);
     xim_im->connect_id = data->connect_id;
+    client = _Xi18nFindClient (xim->xims->protocol, data->connect_id);
+    xim_im->utf8 = client && client->utf8;
+    /* IMdkit sends IMFilterEventMask once the IC is created */
+    xim_im->forward_mask = KeyPressMask;
     data->icid = nimf_xim_add_im (xim, xim_im);
     g_debug (G_STRLOC ": icid = %d", data->icid);
   }
@@ -195,6 +253,33 @@ static int nimf_xim_get_ic_values (NimfXim          *xim,
   return 1;
 }
 
+static void
+nimf_xim_update_cursor_location (NimfXim   *xim,
+                                 NimfXimIM *xim_im)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  NimfRectangle area = {0};
+  Window        window, child;
+
+  xim_im->spot_location_changed = FALSE;
+
+  window = xim_im->focus_window ? xim_im->focus_window : xim_im->client_window;
+
+  if (window == None ||
+      !XTranslateCoordinates (xim->xims->core.display, window,
+                              DefaultRootWindow (xim->xims->core.display),
+                              xim_im->spot_location.x,
+                              xim_im->spot_location.y,
+                              &area.x, &area.y, &child))
+    return;
+
+  nimf_service_im_set_cursor_location (NIMF_SERVICE_IM (xim_im), &area);
+
+  if (!(xim_im->input_style & XIMPreeditCallbacks))
+    nimf_xim_preedit_window_move (xim->preedit_window, area.x, area.y);
+}
+
 static int nimf_xim_forward_event (NimfXim              *xim,
                                    IMForwardEventStruct *data)
 {
@@ -231,8 +316,14 @@ static int nimf_xim_forward_event (NimfXim              *xim,
 
   NimfServiceIM *im;
   im = g_hash_table_lookup (xim->ims, GUINT_TO_POINTER (data->icid));
+
+  if (NIMF_XIM_IM (im)->spot_location_changed)
+    nimf_xim_update_cursor_location (xim, NIMF_XIM_IM (im));
+
   retval  = nimf_service_im_filter_event (im, event);
   nimf_event_free (event);
+  /* trigger keys and hotkeys switch engines here */
+  nimf_xim_update_event_mask (xim, NIMF_XIM_IM (im));
 
   if (G_UNLIKELY (!retval))
     IMForwardEvent (xim->xims, (XPointer) data);
@@ -250,6 +341,7 @@ static int nimf_xim_set_ic_focus (NimfXim             *xim,
            G_STRFUNC, data->icid, im->icid);
 
   nimf_service_im_focus_in (im);
+  nimf_xim_update_event_mask (xim, NIMF_XIM_IM (im));
 
   return 1;
 }
@@ -309,6 +401,10 @@ on_incoming_message (XIMS        xims,
       g_debug (G_STRLOC ": XIM_PREEDIT_START_REPLY");
       retval = 1;
       break;
+    case XIM_PREEDIT_CARET_REPLY:
+      g_debug (G_STRLOC ": XIM_PREEDIT_CARET_REPLY");
+      retval = 1;
+      break;
     case XIM_CREATE_IC:
       retval = nimf_xim_create_ic (xim, &data->changeic);
       break;
@@ -360,6 +456,7 @@ on_xerror (Display *display, XErrorEvent *error)
 typedef struct
 {
   GSource  source;
+  NimfXim *xim;
   Display *display;
   GPollFD  poll_fd;
 } NimfXEventSource;
@@ -371,7 +468,8 @@ static gboolean nimf_xevent_source_prepare (GSource *source,
 
   Display *display = ((NimfXEventSource *) source)->display;
   *timeout = -1;
-  return XPending (display) > 0;
+  XFlush (display);
+  return XEventsQueued (display, QueuedAlready) > 0;
 }
 
 static gboolean nimf_xevent_source_check (GSource *source)
@@ -381,9 +479,9 @@ static gboolean nimf_xevent_source_check (GSource *source)
   NimfXEventSource *display_source = (NimfXEventSource *) source;
 
   if (display_source->poll_fd.revents & G_IO_IN)
-    return XPending (display_source->display) > 0;
+    return XEventsQueued (display_source->display, QueuedAfterReading) > 0;
   else
-    return FALSE;
+    return XEventsQueued (display_source->display, QueuedAlready) > 0;
 }
 
 static gboolean nimf_xevent_source_dispatch (GSource     *source,
@@ -392,14 +490,19 @@ static gboolean nimf_xevent_source_dispatch (GSource     *source,
 {
   g_debug (G_STRLOC ": %s", G_STRFUNC);
 
+  NimfXim *xim     = ((NimfXEventSource*) source)->xim;
   Display *display = ((NimfXEventSource*) source)->display;
   XEvent   event;
+  gint     n_events;
 
-  while (XPending (display))
+  /* what has been read so far, without a read and a flush per event */
+  while ((n_events = XEventsQueued (display, QueuedAlready)) > 0)
   {
-    XNextEvent (display, &event);
-    if (XFilterEvent (&event, None))
-      continue;
+    while (n_events--)
+    {
+      XNextEvent (display, &event);
+      nimf_xim_preedit_window_handle_event (xim->preedit_window, &event);
+    }
   }
 
   return TRUE;
@@ -417,7 +520,8 @@ static GSourceFuncs event_funcs = {
   nimf_xevent_source_finalize
 };
 
-static GSource *nimf_xevent_source_new (Display *display)
+static GSource *nimf_xevent_source_new (NimfXim *xim,
+                                        Display *display)
 {
   g_debug (G_STRLOC ": %s", G_STRFUNC);
 
@@ -426,6 +530,7 @@ static GSource *nimf_xevent_source_new (Display *display)
 
   source = g_source_new (&event_funcs, sizeof (NimfXEventSource));
   xevent_source = (NimfXEventSource *) source;
+  xevent_source->xim     = xim;
   xevent_source->display = display;
 
   xevent_source->poll_fd.fd = ConnectionNumber (xevent_source->display);
@@ -438,14 +543,138 @@ static GSource *nimf_xevent_source_new (Display *display)
   return source;
 }
 
+/*
+ * The XIM transport has a connection of its own, so its events never go
+ * through Xlib.  Requests are queued without waiting and flushed once per
+ * iteration; one read takes whatever the server has sent, and the queued
+ * events are then handled as a batch.
+ */
+typedef struct
+{
+  GSource              source;
+  NimfXim             *xim;
+  xcb_connection_t    *xcb;
+  xcb_generic_event_t *event; /* read ahead by prepare or check */
+  GPollFD              poll_fd;
+} NimfXcbSource;
+
+static gboolean nimf_xcb_source_prepare (GSource *source,
+                                         gint    *timeout)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  NimfXcbSource *xcb_source = (NimfXcbSource *) source;
+
+  *timeout = -1;
+  xcb_flush (xcb_source->xcb);
+
+  if (!xcb_source->event)
+    xcb_source->event = xcb_poll_for_queued_event (xcb_source->xcb);
+
+  return xcb_source->event != NULL;
+}
+
+static gboolean nimf_xcb_source_check (GSource *source)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  NimfXcbSource *xcb_source = (NimfXcbSource *) source;
+
+  if (!xcb_source->event && xcb_source->poll_fd.revents & G_IO_IN)
+    xcb_source->event = xcb_poll_for_event (xcb_source->xcb);
+
+  return xcb_source->event != NULL ||
+         xcb_connection_has_error (xcb_source->xcb);
+}
+
+static void
+on_xcb_error (xcb_generic_error_t *error)
+{
+  g_warning (G_STRLOC ": %s: X error: "
+    "sequence: %u, error_code: %d major_code: %d minor_code: %d resource_id=%u",
+    G_STRFUNC, error->sequence, error->error_code, error->major_code,
+    error->minor_code, error->resource_id);
+}
+
+static gboolean nimf_xcb_source_dispatch (GSource     *source,
+                                          GSourceFunc  callback,
+                                          gpointer     user_data)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  NimfXcbSource       *xcb_source = (NimfXcbSource *) source;
+  xcb_generic_event_t *event;
+
+  if (xcb_connection_has_error (xcb_source->xcb))
+  {
+    g_warning (G_STRLOC ": %s: The XIM connection is broken", G_STRFUNC);
+    return G_SOURCE_REMOVE;
+  }
+
+  while ((event = xcb_source->event))
+  {
+    xcb_source->event = NULL;
+
+    if (event->response_type == 0)
+      on_xcb_error ((xcb_generic_error_t *) event);
+    else
+      _Xi18nFilterXcbEvent (xcb_source->xim->xims, event);
+
+    free (event);
+
+    if (!xcb_source->event)
+      xcb_source->event = xcb_poll_for_queued_event (xcb_source->xcb);
+  }
+
+  return G_SOURCE_CONTINUE;
+}
+
+static void nimf_xcb_source_finalize (GSource *source)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  free (((NimfXcbSource *) source)->event);
+}
+
+static GSourceFuncs xcb_source_funcs = {
+  nimf_xcb_source_prepare,
+  nimf_xcb_source_check,
+  nimf_xcb_source_dispatch,
+  nimf_xcb_source_finalize
+};
+
+static GSource *nimf_xcb_source_new (NimfXim          *xim,
+                                     xcb_connection_t *xcb)
+{
+  g_debug (G_STRLOC ": %s", G_STRFUNC);
+
+  GSource       *source;
+  NimfXcbSource *xcb_source;
+
+  source = g_source_new (&xcb_source_funcs, sizeof (NimfXcbSource));
+  xcb_source = (NimfXcbSource *) source;
+  xcb_source->xim = xim;
+  xcb_source->xcb = xcb;
+
+  xcb_source->poll_fd.fd     = xcb_get_file_descriptor (xcb);
+  xcb_source->poll_fd.events = G_IO_IN;
+  g_source_add_poll (source, &xcb_source->poll_fd);
+
+  g_source_set_priority (source, G_PRIORITY_DEFAULT);
+  g_source_set_can_recurse (source, TRUE);
+
+  return source;
+}
+
 static gboolean nimf_xim_start (NimfService *service)
 {
   g_debug (G_STRLOC ": %s", G_STRFUNC);
 
-  NimfXim *xim = NIMF_XIM (service);
-  Display *display;
-  Window   window;
-  XIMS     xims;
+  NimfXim          *xim = NIMF_XIM (service);
+  Display          *display;
+  xcb_connection_t *xcb;
+  xcb_window_t      window;
+  XIMS              xims;
 
   display = XOpenDisplay (NULL);
 
@@ -462,7 +691,13 @@ static gboolean nimf_xim_start (NimfService *service)
     0
   };
 
+  /*
+   * Xlib offers its locale codeset (e.g. "UTF-8") along with COMPOUND_TEXT
+   * but fails XOpenIM unless COMPOUND_TEXT is chosen, so only UTF8_STRING
+   * is taken as UTF-8.
+   */
   XIMEncoding ims_encodings[] = {
+    "UTF8_STRING",
     "COMPOUND_TEXT",
     NULL
   };
@@ -476,24 +711,40 @@ static gboolean nimf_xim_start (NimfService *service)
   encodings.count_encodings = sizeof (ims_encodings) / sizeof (XIMEncoding) - 1;
   encodings.supported_encodings = ims_encodings;
 
-  XSetWindowAttributes attrs;
+  /* the same server as display, for the transport alone */
+  xcb = xcb_connect (DisplayString (display), NULL);
 
-  attrs.event_mask = KeyPressMask | KeyReleaseMask;
-  attrs.override_redirect = True;
+  if (xcb_connection_has_error (xcb))
+  {
+    g_warning (G_STRLOC ": %s: Can't connect to %s with XCB", G_STRFUNC,
+               DisplayString (display));
+    xcb_disconnect (xcb);
+    XCloseDisplay (display);
+    return FALSE;
+  }
 
-  window = XCreateWindow (display,      /* Display *display */
-                          DefaultRootWindow (display),  /* Window parent */
-                          0, 0,         /* int x, y */
-                          1, 1,         /* unsigned int width, height */
-                          0,            /* unsigned int border_width */
-                          0,            /* int depth */
-                          InputOutput,  /* unsigned int class */
-                          CopyFromParent, /* Visual *visual */
-                          CWOverrideRedirect | CWEventMask, /* unsigned long valuemask */
-                          &attrs);      /* XSetWindowAttributes *attributes */
+  /* clients talk to the creator of the window, so XCB creates it */
+  uint32_t values[] = {
+    True,                                             /* override redirect */
+    XCB_EVENT_MASK_KEY_PRESS | XCB_EVENT_MASK_KEY_RELEASE /* event mask */
+  };
+
+  window = xcb_generate_id (xcb);
+  xcb_create_window (xcb,
+                     XCB_COPY_FROM_PARENT,        /* depth */
+                     window,
+                     DefaultRootWindow (display), /* parent */
+                     0, 0,                        /* x, y */
+                     1, 1,                        /* width, height */
+                     0,                           /* border width */
+                     XCB_WINDOW_CLASS_INPUT_OUTPUT,
+                     XCB_COPY_FROM_PARENT,        /* visual */
+                     XCB_CW_OVERRIDE_REDIRECT | XCB_CW_EVENT_MASK,
+                     values);
 
   xims = IMOpenIM (display,
                    IMModifiers,        "Xi18n",
+                   IMXcbConnection,    xcb,
                    IMServerWindow,     window,
                    IMServerName,       PACKAGE,
                    IMLocale,           "C,en,ja,ko,zh", /* FIXME: Make get_supported_locales() */
@@ -502,12 +753,24 @@ static gboolean nimf_xim_start (NimfService *service)
                    IMEncodingList,     &encodings,
                    IMProtocolHandler,  on_incoming_message,
                    IMUserData,         xim,
-                   IMFilterEventMask,  KeyPressMask | KeyReleaseMask,
+                   IMFilterEventMask,  KeyPressMask,
                    NULL);
 
+  if (xims == NULL)
+  {
+    g_warning (G_STRLOC ": %s: IMOpenIM failed", G_STRFUNC);
+    xcb_disconnect (xcb);
+    XCloseDisplay (display);
+    return FALSE;
+  }
+
   xim->xims = xims;
-  xim->xevent_source = nimf_xevent_source_new (display);
+  xim->xcb  = xcb;
+  xim->preedit_window = nimf_xim_preedit_window_new (display);
+  xim->xevent_source = nimf_xevent_source_new (xim, display);
   g_source_attach (xim->xevent_source, service->server->main_context);
+  xim->xcb_source = nimf_xcb_source_new (xim, xcb);
+  g_source_attach (xim->xcb_source, service->server->main_context);
   XSetErrorHandler (on_xerror);
 
   return TRUE;
@@ -543,17 +806,8 @@ nimf_xim_init (NimfXim *xim)
                                          g_direct_equal,
                                          NULL,
                                          (GDestroyNotify) g_object_unref);
-  gtk_init (NULL, NULL);
-  /* gtk entry */
-  xim->entry = gtk_entry_new ();
-  gtk_editable_set_editable (GTK_EDITABLE (xim->entry), FALSE);
-  /* gtk window */
-  xim->window = gtk_window_new (GTK_WINDOW_POPUP);
-  gtk_window_set_type_hint (GTK_WINDOW (xim->window),
-                            GDK_WINDOW_TYPE_HINT_POPUP_MENU);
-  gtk_container_set_border_width (GTK_CONTAINER (xim->window), 1);
-  gtk_container_add (GTK_CONTAINER (xim->window), xim->entry);
-  gtk_window_move (GTK_WINDOW (xim->window), 0, 0);
+  xim->compound_texts = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                               g_free, g_free);
 }
 
 static void nimf_xim_finalize (GObject *object)
@@ -563,8 +817,8 @@ static void nimf_xim_finalize (GObject *object)
   NimfXim *xim = NIMF_XIM (object);
 
   g_hash_table_unref (xim->ims);
+  g_hash_table_unref (xim->compound_texts);
   g_free (xim->id);
-  gtk_widget_destroy (xim->window);
 
   if (xim->xevent_source)
   {
@@ -572,6 +826,18 @@ static void nimf_xim_finalize (GObject *object)
     g_source_unref   (xim->xevent_source);
   }
 
+  if (xim->xcb_source)
+  {
+    g_source_destroy (xim->xcb_source);
+    g_source_unref   (xim->xcb_source);
+  }
+
+  if (xim->preedit_window)
+    nimf_xim_preedit_window_free (xim->preedit_window);
+
+  if (xim->xcb)
+    xcb_disconnect (xim->xcb);
+
   G_OBJECT_CLASS (nimf_xim_parent_class)->finalize (object);
 }
 
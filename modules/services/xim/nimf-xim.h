@@ -28,7 +28,7 @@
 #include <X11/XKBlib.h>
 #include "IMdkit/Xi18n.h"
 #include "nimf-xim-im.h"
-#include <gtk/gtk.h>
+#include "nimf-xim-preedit-window.h"
 
 G_BEGIN_DECLS
 
@@ -46,13 +46,15 @@ struct _NimfXim
 {
   NimfService parent_instance;
 
-  GSource    *xevent_source;
-  gchar      *id;
-  GHashTable *ims;
-  guint16     next_icid;
-  XIMS        xims;
-  GtkWidget  *window;
-  GtkWidget  *entry;
+  GSource              *xevent_source; /* Xlib: preedit window, keymap */
+  GSource              *xcb_source;    /* XCB: the XIM transport */
+  xcb_connection_t     *xcb;
+  gchar                *id;
+  GHashTable           *ims;
+  guint16               next_icid;
+  XIMS                  xims;
+  NimfXimPreeditWindow *preedit_window;
+  GHashTable           *compound_texts; /* UTF-8 to COMPOUND_TEXT */
 };
 
 struct _NimfXimClass
@@ -0,0 +1,390 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 2; tab-width: 2 -*- */
+/*
+ * nimf-top.c
+ * This file is part of Nimf.
+ *
+ * Copyright (C) 2017 Hodong Kim <cogniti@gmail.com>
+ *
+ * Nimf is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Nimf is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program;  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+#include "nimf-private.h"
+#include "nimf-metrics.h"
+#include <gio/gunixsocketaddress.h>
+#include <glib/gi18n.h>
+#include <string.h>
+#include <unistd.h>
+#include <libaudit.h>
+
+static GSocketConnection *
+nimf_top_connect (GError **error)
+{
+  GSocketClient     *socket_client;
+  GSocketAddress    *address;
+  GSocketConnection *connection;
+  gchar             *addr;
+  uid_t              uid;
+
+  uid = audit_getloginuid ();
+  if (uid == (uid_t) -1)
+    uid = getuid ();
+
+  addr = g_strdup_printf (NIMF_BASE_ADDRESS"%d", uid);
+  address = g_unix_socket_address_new_with_type (addr, -1,
+                                                 G_UNIX_SOCKET_ADDRESS_ABSTRACT);
+  g_free (addr);
+
+  socket_client = g_socket_client_new ();
+  connection = g_socket_client_connect (socket_client,
+                                        G_SOCKET_CONNECTABLE (address),
+                                        NULL, error);
+  g_object_unref (address);
+  g_object_unref (socket_client);
+
+  return connection;
+}
+
+static GKeyFile *
+nimf_top_get_stats (GSocket *socket)
+{
+  NimfMessage *message;
+  GKeyFile    *stats;
+  GError      *error = NULL;
+
+  nimf_send_message (socket, 0, NIMF_MESSAGE_GET_STATS, NULL, 0, NULL);
+  message = nimf_recv_message (socket);
+
+  if (message == NULL)
+    return NULL;
+
+  if (message->header->type != NIMF_MESSAGE_GET_STATS_REPLY ||
+      message->header->data_len == 0)
+  {
+    nimf_message_unref (message);
+    return NULL;
+  }
+
+  stats = g_key_file_new ();
+
+  if (!g_key_file_load_from_data (stats, message->data,
+                                  strnlen (message->data, message->header->data_len),
+                                  G_KEY_FILE_NONE, &error))
+  {
+    g_printerr ("%s\n", error->message);
+    g_clear_error (&error);
+    g_key_file_unref (stats);
+    stats = NULL;
+  }
+
+  nimf_message_unref (message);
+
+  return stats;
+}
+
+static gint64
+get_int (GKeyFile *stats, const gchar *group, const gchar *key)
+{
+  if (stats == NULL)
+    return 0;
+
+  return g_key_file_get_int64 (stats, group, key, NULL);
+}
+
+static gdouble
+get_rate (GKeyFile    *stats,
+          GKeyFile    *prev_stats,
+          const gchar *group,
+          const gchar *key,
+          gdouble      interval)
+{
+  if (prev_stats == NULL || !g_key_file_has_group (prev_stats, group))
+    return 0.0;
+
+  return (get_int (stats, group, key) - get_int (prev_stats, group, key)) /
+         interval;
+}
+
+/* upper bound in microseconds of the bucket the percentile falls in */
+static gint64
+get_percentile (GKeyFile    *stats,
+                const gchar *group,
+                const gchar *prefix,
+                gdouble      percentile)
+{
+  gchar   *key;
+  gint    *buckets;
+  gsize    n_buckets = 0;
+  gint64   count;
+  gint64   sum = 0;
+  gint64   retval = 0;
+  gsize    i;
+
+  key = g_strdup_printf ("%s-count", prefix);
+  count = get_int (stats, group, key);
+  g_free (key);
+
+  if (count == 0)
+    return 0;
+
+  key = g_strdup_printf ("%s-buckets", prefix);
+  buckets = g_key_file_get_integer_list (stats, group, key, &n_buckets, NULL);
+  g_free (key);
+
+  if (buckets == NULL)
+    return 0;
+
+  for (i = 0; i < n_buckets; i++)
+  {
+    sum += buckets[i];
+
+    if (sum >= count * percentile)
+    {
+      retval = (gint64) 1 << i;
+      break;
+    }
+  }
+
+  g_free (buckets);
+
+  return retval;
+}
+
+static gint64
+get_average (GKeyFile *stats, const gchar *group, const gchar *prefix)
+{
+  gchar  *key;
+  gint64  count;
+  gint64  total;
+
+  key = g_strdup_printf ("%s-count", prefix);
+  count = get_int (stats, group, key);
+  g_free (key);
+
+  if (count == 0)
+    return 0;
+
+  key = g_strdup_printf ("%s-total", prefix);
+  total = get_int (stats, group, key);
+  g_free (key);
+
+  return total / count;
+}
+
+static gchar *
+get_command (gint pid)
+{
+  gchar *path;
+  gchar *command = NULL;
+
+  if (pid <= 0)
+    return g_strdup ("?");
+
+  path = g_strdup_printf ("/proc/%d/comm", pid);
+
+  if (g_file_get_contents (path, &command, NULL, NULL))
+    g_strchomp (command);
+  else
+    command = g_strdup ("?");
+
+  g_free (path);
+
+  return command;
+}
+
+static void
+nimf_top_print (GKeyFile *stats, GKeyFile *prev_stats, gdouble interval)
+{
+  gchar **groups;
+  gint64  uptime = get_int (stats, "server", "uptime") / G_USEC_PER_SEC;
+  gint    i;
+
+  g_print ("nimf-daemon: up %"G_GINT64_FORMAT":%02"G_GINT64_FORMAT":%02"G_GINT64_FORMAT
+           ", RSS %"G_GINT64_FORMAT" kB, %"G_GINT64_FORMAT" connections, "
+           "%"G_GINT64_FORMAT" slow replies\n",
+           uptime / 3600, uptime / 60 % 60, uptime % 60,
+           get_int (stats, "server", "rss"),
+           get_int (stats, "server", "connections"),
+           get_int (stats, "server", "slow-replies"));
+  g_print ("round trip: avg %"G_GINT64_FORMAT" us, p99 < %"G_GINT64_FORMAT" us, "
+           "max %"G_GINT64_FORMAT" us; round trips per key:",
+           get_average    (stats, "server", "round-trip"),
+           get_percentile (stats, "server", "round-trip", 0.99),
+           get_int (stats, "server", "round-trip-max"));
+
+  gint  *per_key;
+  gsize  n_per_key = 0;
+  gsize  j;
+
+  per_key = g_key_file_get_integer_list (stats, "server", "round-trips-per-key",
+                                         &n_per_key, NULL);
+  for (j = 0; j < n_per_key; j++)
+    g_print (" %d%s:%d", (gint) j,
+             j == NIMF_METRICS_MAX_ROUND_TRIPS ? "+" : "", per_key[j]);
+  g_print ("\n");
+  g_free (per_key);
+
+  groups = g_key_file_get_groups (stats, NULL);
+
+  g_print ("\n%-24s %8s %8s %8s %8s %10s %8s %8s %10s %8s\n",
+           "ENGINE", "RSS(kB)", "SESSIONS", "SESS(kB)", "SESS(us)", "KEYS",
+           "KEYS/s", "AVG(us)", "P99(us)<", "MAX(us)");
+
+  for (i = 0; groups[i]; i++)
+  {
+    if (!g_str_has_prefix (groups[i], "engine "))
+      continue;
+
+    g_print ("%-24s %8"G_GINT64_FORMAT" %8"G_GINT64_FORMAT" %8"G_GINT64_FORMAT
+             " %8"G_GINT64_FORMAT" %10"G_GINT64_FORMAT" %8.1f %8"G_GINT64_FORMAT
+             " %10"G_GINT64_FORMAT" %8"G_GINT64_FORMAT"\n",
+             groups[i] + strlen ("engine "),
+             get_int (stats, groups[i], "rss"),
+             get_int (stats, groups[i], "sessions"),
+             get_int (stats, groups[i], "session-rss"),
+             get_int (stats, groups[i], "session-time"),
+             get_int (stats, groups[i], "filter-event-count"),
+             get_rate (stats, prev_stats, groups[i], "filter-event-count", interval),
+             get_average (stats, groups[i], "filter-event"),
+             get_percentile (stats, groups[i], "filter-event", 0.99),
+             get_int (stats, groups[i], "filter-event-max"));
+  }
+
+  g_print ("\n%-6s %7s %-16s %8s %10s %8s %10s %8s %8s %6s\n",
+           "CLIENT", "PID", "COMMAND", "CONTEXTS", "MSGS", "MSGS/s", "KEYS",
+           "AVG(us)", "RTRIPS", "SLOW");
+
+  for (i = 0; groups[i]; i++)
+  {
+    if (!g_str_has_prefix (groups[i], "connection "))
+      continue;
+
+    gint64 n_keys  = get_int (stats, groups[i], "filter-events");
+    gint64 pid     = get_int (stats, groups[i], "pid");
+    gchar *command = get_command (pid);
+
+    g_print ("%-6s %7"G_GINT64_FORMAT" %-16s %8"G_GINT64_FORMAT" %10"G_GINT64_FORMAT
+             " %8.1f %10"G_GINT64_FORMAT" %8"G_GINT64_FORMAT" %8"G_GINT64_FORMAT
+             " %6"G_GINT64_FORMAT"\n",
+             groups[i] + strlen ("connection "),
+             pid, command,
+             get_int (stats, groups[i], "contexts"),
+             get_int (stats, groups[i], "messages"),
+             get_rate (stats, prev_stats, groups[i], "messages", interval),
+             n_keys,
+             n_keys ? get_int (stats, groups[i], "filter-event-time") / n_keys : 0,
+             get_int (stats, groups[i], "round-trips"),
+             get_int (stats, groups[i], "slow-replies"));
+    g_free (command);
+  }
+
+  g_print ("\n%-36s %10s %8s %10s %8s\n",
+           "MESSAGE", "COUNT", "AVG(us)", "P99(us)<", "MAX(us)");
+
+  for (i = 0; groups[i]; i++)
+  {
+    if (!g_str_has_prefix (groups[i], "message "))
+      continue;
+
+    g_print ("%-36s %10"G_GINT64_FORMAT" %8"G_GINT64_FORMAT" %10"G_GINT64_FORMAT
+             " %8"G_GINT64_FORMAT"\n",
+             groups[i] + strlen ("message "),
+             get_int (stats, groups[i], "service-time-count"),
+             get_average (stats, groups[i], "service-time"),
+             get_percentile (stats, groups[i], "service-time", 0.99),
+             get_int (stats, groups[i], "service-time-max"));
+  }
+
+  g_strfreev (groups);
+}
+
+int
+main (int argc, char **argv)
+{
+  GSocketConnection *connection;
+  GSocket           *socket;
+  GKeyFile          *stats;
+  GKeyFile          *prev_stats = NULL;
+  GError            *error      = NULL;
+  gdouble            interval   = 2.0;
+  gboolean           is_once    = FALSE;
+  gboolean           retval     = FALSE;
+
+  GOptionContext *context;
+  GOptionEntry    entries[] = {
+    {"interval", 'd', 0, G_OPTION_ARG_DOUBLE, &interval, N_("Seconds between updates"), N_("SECONDS")},
+    {"once", 0, 0, G_OPTION_ARG_NONE, &is_once, N_("Print once and exit"), NULL},
+    {NULL}
+  };
+
+  context = g_option_context_new ("- Show Nimf daemon statistics");
+  g_option_context_add_main_entries (context, entries, GETTEXT_PACKAGE);
+  g_option_context_parse (context, &argc, &argv, &error);
+  g_option_context_free (context);
+
+  if (error != NULL)
+  {
+    g_warning ("%s", error->message);
+    g_error_free (error);
+    return EXIT_FAILURE;
+  }
+
+  if (interval < 0.1)
+    interval = 0.1;
+
+  connection = nimf_top_connect (&error);
+
+  if (connection == NULL)
+  {
+    g_printerr ("Can't connect to nimf-daemon: %s\n", error->message);
+    g_error_free (error);
+    return EXIT_FAILURE;
+  }
+
+  socket = g_socket_connection_get_socket (connection);
+
+  while (TRUE)
+  {
+    stats = nimf_top_get_stats (socket);
+
+    if (stats == NULL)
+    {
+      g_printerr ("Can't get statistics from nimf-daemon\n");
+      break;
+    }
+
+    if (!is_once)
+      g_print ("\033[H\033[2J");
+
+    nimf_top_print (stats, prev_stats, interval);
+
+    if (prev_stats)
+      g_key_file_unref (prev_stats);
+
+    prev_stats = stats;
+    retval = TRUE;
+
+    if (is_once)
+      break;
+
+    g_usleep (interval * G_USEC_PER_SEC);
+  }
+
+  if (prev_stats)
+    g_key_file_unref (prev_stats);
+
+  g_object_unref (connection);
+
+  return retval ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,771 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 2; tab-width: 2 -*- */
+/*
+ * nimf-trace-replay.c
+ * This file is part of Nimf.
+ *
+ * Copyright (C) 2017 Hodong Kim <cogniti@gmail.com>
+ *
+ * Nimf is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Nimf is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program;  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+#include "nimf.h"
+#include "nimf-trace.h"
+#include <glib/gi18n.h>
+#include <string.h>
+
+/*
+ * Feeds a trace written by "nimf-daemon --trace=FILE" back into the running
+ * daemon, or into engines loaded in this process (--in-process), and
+ * compares the preedit and commit output with the recorded one.
+ */
+
+typedef struct
+{
+  GPtrArray  *records;
+  gboolean   *consumed;
+  guint       position;
+  GHashTable *contexts;
+  GPtrArray  *outputs;
+  NimfServer *server;
+  gboolean    in_process;
+  gboolean    max_speed;
+  gboolean    verbose;
+  /* statistics */
+  guint       n_inputs;
+  guint       n_events;
+  guint       n_mismatches;
+  gint64      replay_event_time;
+  gint64      replay_event_max;
+  gint64      trace_event_time;
+  gint64      trace_event_max;
+} NimfReplay;
+
+static NimfReplay replay;
+
+/* a recorded input context; icids are only unique within their source */
+typedef struct
+{
+  guint32  source;
+  guint16  icid;
+  gpointer object; /* NimfReplayIM, or NimfIM in daemon mode */
+} NimfReplayContext;
+
+static guint
+nimf_replay_context_hash (gconstpointer key)
+{
+  const NimfReplayContext *context = key;
+
+  return context->source * 65599 + context->icid;
+}
+
+static gboolean
+nimf_replay_context_equal (gconstpointer a,
+                           gconstpointer b)
+{
+  const NimfReplayContext *context_a = a;
+  const NimfReplayContext *context_b = b;
+
+  return context_a->source == context_b->source &&
+         context_a->icid   == context_b->icid;
+}
+
+static void
+nimf_replay_context_free (NimfReplayContext *context)
+{
+  g_object_unref (context->object);
+  g_slice_free (NimfReplayContext, context);
+}
+
+static void
+nimf_replay_collect (guint32              source,
+                     guint16              icid,
+                     NimfTraceRecordType  type,
+                     gconstpointer        data1,
+                     gsize                data1_len,
+                     const gchar         *str)
+{
+  NimfTraceRecord *record;
+  gsize            str_len = str ? strlen (str) + 1 : 0;
+
+  record = g_slice_new0 (NimfTraceRecord);
+  record->header.type     = type;
+  record->header.icid     = icid;
+  record->header.source   = source;
+  record->header.data_len = data1_len + str_len;
+  record->data = g_malloc0 (record->header.data_len + 1);
+
+  if (data1_len > 0)
+    memcpy (record->data, data1, data1_len);
+
+  if (str_len > 0)
+    memcpy (record->data + data1_len, str, str_len);
+
+  g_ptr_array_add (replay.outputs, record);
+}
+
+static void
+nimf_replay_collect_preedit_changed (guint32      source,
+                                     guint16      icid,
+                                     const gchar *preedit_string,
+                                     gint         cursor_pos)
+{
+  gint32 data = cursor_pos;
+
+  nimf_replay_collect (source, icid, NIMF_TRACE_RECORD_PREEDIT_CHANGED,
+                       &data, sizeof (gint32),
+                       preedit_string ? preedit_string : "");
+}
+
+static void
+nimf_replay_collect_delete_surrounding (guint32 source,
+                                        guint16 icid,
+                                        gint    offset,
+                                        gint    n_chars)
+{
+  gint32 data[2] = { offset, n_chars };
+
+  nimf_replay_collect (source, icid, NIMF_TRACE_RECORD_DELETE_SURROUNDING,
+                       data, sizeof (data), NULL);
+}
+
+static void nimf_replay_set_surrounding (guint32      source,
+                                         guint16      icid,
+                                         const gchar *data);
+
+/*
+ * A client answers retrieve-surrounding by calling set_surrounding while the
+ * daemon is still inside filter_event, so the answer is recorded before the
+ * FILTER_EVENT_RESULT record.  Apply it right away, and skip it later.
+ */
+static gboolean
+nimf_replay_retrieve_surrounding (guint32 source, guint16 icid)
+{
+  guint i;
+
+  for (i = replay.position + 1; i < replay.records->len; i++)
+  {
+    NimfTraceRecord *record = g_ptr_array_index (replay.records, i);
+
+    if (record->header.type == NIMF_TRACE_RECORD_FILTER_EVENT_RESULT ||
+        record->header.type == NIMF_TRACE_RECORD_FILTER_EVENT)
+      break;
+
+    if (record->header.source == source && record->header.icid == icid &&
+        !replay.consumed[i] &&
+        record->header.type == NIMF_TRACE_RECORD_SET_SURROUNDING)
+    {
+      replay.consumed[i] = TRUE;
+      nimf_replay_set_surrounding (source, icid, record->data);
+
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+/*
+ * NimfReplayIM collects the output of in-process engines.
+ */
+#define NIMF_TYPE_REPLAY_IM  (nimf_replay_im_get_type ())
+#define NIMF_REPLAY_IM(obj)  (G_TYPE_CHECK_INSTANCE_CAST ((obj), NIMF_TYPE_REPLAY_IM, NimfReplayIM))
+
+typedef struct _NimfReplayIM      NimfReplayIM;
+typedef struct _NimfReplayIMClass NimfReplayIMClass;
+
+struct _NimfReplayIM
+{
+  NimfServiceIM parent_instance;
+  guint32       source;
+};
+
+struct _NimfReplayIMClass
+{
+  NimfServiceIMClass parent_class;
+};
+
+GType nimf_replay_im_get_type (void) G_GNUC_CONST;
+
+G_DEFINE_TYPE (NimfReplayIM, nimf_replay_im, NIMF_TYPE_SERVICE_IM);
+
+static void
+nimf_replay_im_emit_commit (NimfServiceIM *im,
+                            const gchar   *text)
+{
+  nimf_replay_collect (NIMF_REPLAY_IM (im)->source, im->icid,
+                       NIMF_TRACE_RECORD_COMMIT, NULL, 0, text);
+}
+
+static void
+nimf_replay_im_emit_preedit_start (NimfServiceIM *im)
+{
+  im->preedit_state = NIMF_PREEDIT_STATE_START;
+  nimf_replay_collect (NIMF_REPLAY_IM (im)->source, im->icid,
+                       NIMF_TRACE_RECORD_PREEDIT_START, NULL, 0, NULL);
+}
+
+static void
+nimf_replay_im_emit_preedit_changed (NimfServiceIM    *im,
+                                     const gchar      *preedit_string,
+                                     NimfPreeditAttr **attrs,
+                                     gint              cursor_pos)
+{
+  nimf_replay_collect_preedit_changed (NIMF_REPLAY_IM (im)->source, im->icid,
+                                       preedit_string, cursor_pos);
+}
+
+static void
+nimf_replay_im_emit_preedit_end (NimfServiceIM *im)
+{
+  im->preedit_state = NIMF_PREEDIT_STATE_END;
+  nimf_replay_collect (NIMF_REPLAY_IM (im)->source, im->icid,
+                       NIMF_TRACE_RECORD_PREEDIT_END, NULL, 0, NULL);
+}
+
+static gboolean
+nimf_replay_im_emit_retrieve_surrounding (NimfServiceIM *im)
+{
+  return nimf_replay_retrieve_surrounding (NIMF_REPLAY_IM (im)->source,
+                                           im->icid);
+}
+
+static gboolean
+nimf_replay_im_emit_delete_surrounding (NimfServiceIM *im,
+                                        gint           offset,
+                                        gint           n_chars)
+{
+  nimf_replay_collect_delete_surrounding (NIMF_REPLAY_IM (im)->source,
+                                          im->icid, offset, n_chars);
+
+  return TRUE;
+}
+
+static void
+nimf_replay_im_init (NimfReplayIM *im)
+{
+}
+
+static void
+nimf_replay_im_class_init (NimfReplayIMClass *class)
+{
+  NimfServiceIMClass *service_im_class = NIMF_SERVICE_IM_CLASS (class);
+
+  service_im_class->emit_commit               = nimf_replay_im_emit_commit;
+  service_im_class->emit_preedit_start        = nimf_replay_im_emit_preedit_start;
+  service_im_class->emit_preedit_changed      = nimf_replay_im_emit_preedit_changed;
+  service_im_class->emit_preedit_end          = nimf_replay_im_emit_preedit_end;
+  service_im_class->emit_retrieve_surrounding = nimf_replay_im_emit_retrieve_surrounding;
+  service_im_class->emit_delete_surrounding   = nimf_replay_im_emit_delete_surrounding;
+}
+
+/*
+ * Daemon mode uses a NimfIM per recorded input context.
+ */
+static void
+on_commit (NimfIM *im, const gchar *text, NimfReplayContext *context)
+{
+  nimf_replay_collect (context->source, context->icid,
+                       NIMF_TRACE_RECORD_COMMIT, NULL, 0, text);
+}
+
+static void
+on_preedit_start (NimfIM *im, NimfReplayContext *context)
+{
+  nimf_replay_collect (context->source, context->icid,
+                       NIMF_TRACE_RECORD_PREEDIT_START, NULL, 0, NULL);
+}
+
+static void
+on_preedit_changed (NimfIM *im, NimfReplayContext *context)
+{
+  nimf_replay_collect_preedit_changed (context->source, context->icid,
+                                       im->preedit_string, im->cursor_pos);
+}
+
+static void
+on_preedit_end (NimfIM *im, NimfReplayContext *context)
+{
+  nimf_replay_collect (context->source, context->icid,
+                       NIMF_TRACE_RECORD_PREEDIT_END, NULL, 0, NULL);
+}
+
+static gboolean
+on_retrieve_surrounding (NimfIM *im, NimfReplayContext *context)
+{
+  return nimf_replay_retrieve_surrounding (context->source, context->icid);
+}
+
+static gboolean
+on_delete_surrounding (NimfIM            *im,
+                       gint               offset,
+                       gint               n_chars,
+                       NimfReplayContext *context)
+{
+  nimf_replay_collect_delete_surrounding (context->source, context->icid,
+                                          offset, n_chars);
+  return TRUE;
+}
+
+static gpointer
+nimf_replay_get_context (guint32 source, guint16 icid)
+{
+  NimfReplayContext  key = { source, icid, NULL };
+  NimfReplayContext *context;
+
+  context = g_hash_table_lookup (replay.contexts, &key);
+
+  if (context)
+    return context->object;
+
+  context = g_slice_new (NimfReplayContext);
+  context->source = source;
+  context->icid   = icid;
+
+  if (replay.in_process)
+  {
+    context->object = g_object_new (NIMF_TYPE_REPLAY_IM,
+                                    "server", replay.server, NULL);
+    NIMF_SERVICE_IM (context->object)->icid = icid;
+    NIMF_REPLAY_IM  (context->object)->source = source;
+  }
+  else
+  {
+    context->object = nimf_im_new ();
+    g_signal_connect (context->object, "commit",
+                      G_CALLBACK (on_commit), context);
+    g_signal_connect (context->object, "preedit-start",
+                      G_CALLBACK (on_preedit_start), context);
+    g_signal_connect (context->object, "preedit-changed",
+                      G_CALLBACK (on_preedit_changed), context);
+    g_signal_connect (context->object, "preedit-end",
+                      G_CALLBACK (on_preedit_end), context);
+    g_signal_connect (context->object, "retrieve-surrounding",
+                      G_CALLBACK (on_retrieve_surrounding), context);
+    g_signal_connect (context->object, "delete-surrounding",
+                      G_CALLBACK (on_delete_surrounding), context);
+  }
+
+  g_hash_table_add (replay.contexts, context);
+
+  return context->object;
+}
+
+static void
+nimf_replay_set_surrounding (guint32      source,
+                             guint16      icid,
+                             const gchar *data)
+{
+  gpointer     context = nimf_replay_get_context (source, icid);
+  gint         cursor_index = *(gint32 *) data;
+  const gchar *text = data + sizeof (gint32);
+
+  if (replay.in_process)
+    nimf_service_im_set_surrounding (context, text, strlen (text),
+                                     cursor_index);
+  else
+    nimf_im_set_surrounding (context, text, strlen (text), cursor_index);
+}
+
+static gboolean
+nimf_replay_filter_event (const NimfTraceRecord *record)
+{
+  gpointer   context = nimf_replay_get_context (record->header.source,
+                                                record->header.icid);
+  NimfEvent *event;
+  gboolean   retval;
+
+  event = nimf_trace_record_get_event (record);
+
+  if (event == NULL)
+    return FALSE;
+
+  if (replay.in_process)
+    retval = nimf_service_im_filter_event (context, event);
+  else
+    retval = nimf_im_filter_event (context, event);
+
+  nimf_event_free (event);
+
+  return retval;
+}
+
+static void
+nimf_replay_input (const NimfTraceRecord *record)
+{
+  guint32  source = record->header.source;
+  guint16  icid   = record->header.icid;
+  gpointer context;
+
+  if (record->header.type == NIMF_TRACE_RECORD_DESTROY)
+  {
+    NimfReplayContext key = { source, icid, NULL };
+
+    g_hash_table_remove (replay.contexts, &key);
+    return;
+  }
+
+  context = nimf_replay_get_context (source, icid);
+
+  switch (record->header.type)
+  {
+    case NIMF_TRACE_RECORD_FOCUS_IN:
+      if (replay.in_process)
+      {
+        NimfServiceIM *im = context;
+
+        /* start with the engine the recorded context was using */
+        if (record->header.data_len > 0 &&
+            g_strcmp0 (nimf_engine_get_id (im->engine), record->data) != 0)
+          nimf_service_im_set_engine_by_id (im, record->data);
+
+        nimf_service_im_focus_in (im);
+      }
+      else
+      {
+        nimf_im_focus_in (context);
+      }
+      break;
+    case NIMF_TRACE_RECORD_FOCUS_OUT:
+      if (replay.in_process)
+        nimf_service_im_focus_out (context);
+      else
+        nimf_im_focus_out (context);
+      break;
+    case NIMF_TRACE_RECORD_RESET:
+      if (replay.in_process)
+        nimf_service_im_reset (context);
+      else
+        nimf_im_reset (context);
+      break;
+    case NIMF_TRACE_RECORD_SET_SURROUNDING:
+      nimf_replay_set_surrounding (source, icid, record->data);
+      break;
+    case NIMF_TRACE_RECORD_SET_CURSOR_LOCATION:
+      if (replay.in_process)
+        nimf_service_im_set_cursor_location (context,
+                                             (NimfRectangle *) record->data);
+      else
+        nimf_im_set_cursor_location (context, (NimfRectangle *) record->data);
+      break;
+    case NIMF_TRACE_RECORD_SET_USE_PREEDIT:
+      if (replay.in_process)
+        nimf_service_im_set_use_preedit (context, *(gint32 *) record->data);
+      else
+        nimf_im_set_use_preedit (context, *(gint32 *) record->data);
+      break;
+    case NIMF_TRACE_RECORD_SET_ENGINE:
+      /* Clients can't choose an engine, only the in-process mode can. */
+      if (replay.in_process)
+        nimf_service_im_set_engine_by_id (context, record->data);
+      break;
+    default:
+      g_warning (G_STRLOC ": %s: Unexpected record: %s", G_STRFUNC,
+                 nimf_trace_record_type_get_name (record->header.type));
+      break;
+  }
+}
+
+static gboolean
+nimf_replay_is_compared (const NimfTraceRecord *record)
+{
+  switch (record->header.type)
+  {
+    case NIMF_TRACE_RECORD_PREEDIT_CHANGED:
+    case NIMF_TRACE_RECORD_COMMIT:
+    case NIMF_TRACE_RECORD_DELETE_SURROUNDING:
+      return TRUE;
+    default:
+      return FALSE;
+  }
+}
+
+static gchar *
+nimf_replay_describe (const NimfTraceRecord *record)
+{
+  const gchar *name = nimf_trace_record_type_get_name (record->header.type);
+
+  switch (record->header.type)
+  {
+    case NIMF_TRACE_RECORD_PREEDIT_CHANGED:
+      return g_strdup_printf ("%s \"%s\" cursor %d", name,
+                              record->data + sizeof (gint32),
+                              *(gint32 *) record->data);
+    case NIMF_TRACE_RECORD_COMMIT:
+      return g_strdup_printf ("%s \"%s\"", name, record->data);
+    case NIMF_TRACE_RECORD_DELETE_SURROUNDING:
+      return g_strdup_printf ("%s %d %d", name,
+                              ((gint32 *) record->data)[0],
+                              ((gint32 *) record->data)[1]);
+    default:
+      return g_strdup (name);
+  }
+}
+
+static void
+nimf_replay_mismatch (guint                  index,
+                      const NimfTraceRecord *expected,
+                      const NimfTraceRecord *actual)
+{
+  gchar *expected_str = expected ? nimf_replay_describe (expected) : g_strdup ("nothing");
+  gchar *actual_str   = actual   ? nimf_replay_describe (actual)   : g_strdup ("nothing");
+
+  const NimfTraceRecord *record = expected ? expected : actual;
+
+  g_print ("record %u, source %u, icid %d: expected %s, got %s\n", index,
+           record->header.source, record->header.icid,
+           expected_str, actual_str);
+
+  replay.n_mismatches++;
+
+  g_free (expected_str);
+  g_free (actual_str);
+}
+
+/* Compares the recorded output following record index with the collected one
+ * and returns the index of the next record to replay. */
+static guint
+nimf_replay_compare (guint index)
+{
+  const NimfTraceRecord *input = g_ptr_array_index (replay.records, index);
+  gboolean in_event = input->header.type == NIMF_TRACE_RECORD_FILTER_EVENT;
+  guint    n_actual = 0;
+  guint    i;
+
+  for (i = index + 1; i < replay.records->len; i++)
+  {
+    NimfTraceRecord *record = g_ptr_array_index (replay.records, i);
+
+    if (replay.consumed[i])
+      continue;
+
+    if (!nimf_trace_record_is_output (record))
+      break;
+
+    if (!nimf_replay_is_compared (record))
+      continue;
+
+    NimfTraceRecord *actual = NULL;
+
+    while (n_actual < replay.outputs->len)
+    {
+      actual = g_ptr_array_index (replay.outputs, n_actual++);
+
+      if (nimf_replay_is_compared (actual))
+        break;
+
+      actual = NULL;
+    }
+
+    if (actual == NULL ||
+        actual->header.type     != record->header.type ||
+        actual->header.source   != record->header.source ||
+        actual->header.icid     != record->header.icid ||
+        actual->header.data_len != record->header.data_len ||
+        memcmp (actual->data, record->data, record->header.data_len) != 0)
+      nimf_replay_mismatch (i, record, actual);
+  }
+
+  for (; n_actual < replay.outputs->len; n_actual++)
+  {
+    NimfTraceRecord *actual = g_ptr_array_index (replay.outputs, n_actual);
+
+    if (nimf_replay_is_compared (actual))
+      nimf_replay_mismatch (index, NULL, actual);
+  }
+
+  g_ptr_array_set_size (replay.outputs, 0);
+
+  if (in_event && i < replay.records->len)
+  {
+    NimfTraceRecord *record = g_ptr_array_index (replay.records, i);
+
+    if (record->header.type == NIMF_TRACE_RECORD_FILTER_EVENT_RESULT)
+    {
+      gint64 latency = record->header.timestamp - input->header.timestamp;
+
+      replay.trace_event_time += latency;
+      replay.trace_event_max = MAX (replay.trace_event_max, latency);
+
+      return i + 1;
+    }
+  }
+
+  return i;
+}
+
+static void
+nimf_replay_run ()
+{
+  gint64 first_timestamp = -1;
+  gint64 start_time      = g_get_monotonic_time ();
+  guint  i = 0;
+
+  while (i < replay.records->len)
+  {
+    NimfTraceRecord *record = g_ptr_array_index (replay.records, i);
+
+    if (replay.consumed[i] || nimf_trace_record_is_output (record) ||
+        record->header.type == NIMF_TRACE_RECORD_FILTER_EVENT_RESULT)
+    {
+      i++;
+      continue;
+    }
+
+    if (first_timestamp < 0)
+      first_timestamp = record->header.timestamp;
+
+    if (!replay.max_speed)
+    {
+      gint64 delay = (record->header.timestamp - first_timestamp) -
+                     (g_get_monotonic_time () - start_time);
+      if (delay > 0)
+        g_usleep (delay);
+    }
+
+    if (replay.verbose)
+      g_print ("record %u, source %u, icid %d: %s\n", i,
+               record->header.source, record->header.icid,
+               nimf_trace_record_type_get_name (record->header.type));
+
+    replay.position = i;
+    replay.n_inputs++;
+
+    if (record->header.type == NIMF_TRACE_RECORD_FILTER_EVENT)
+    {
+      gint64   begin   = g_get_monotonic_time ();
+      gboolean retval  = nimf_replay_filter_event (record);
+      gint64   latency = g_get_monotonic_time () - begin;
+      guint    next;
+
+      replay.n_events++;
+      replay.replay_event_time += latency;
+      replay.replay_event_max = MAX (replay.replay_event_max, latency);
+
+      next = nimf_replay_compare (i);
+
+      if (next > 0)
+      {
+        NimfTraceRecord *result = g_ptr_array_index (replay.records, next - 1);
+
+        if (result->header.type == NIMF_TRACE_RECORD_FILTER_EVENT_RESULT &&
+            *(gint32 *) result->data != retval)
+        {
+          g_print ("record %u, source %u, icid %d: "
+                   "expected filter-event %d, got %d\n",
+                   next - 1, record->header.source, record->header.icid,
+                   *(gint32 *) result->data, retval);
+          replay.n_mismatches++;
+        }
+      }
+
+      i = next;
+    }
+    else
+    {
+      nimf_replay_input (record);
+      i = nimf_replay_compare (i);
+    }
+  }
+
+  g_print ("replayed %u inputs (%u key events) in %.3f s\n", replay.n_inputs,
+           replay.n_events,
+           (g_get_monotonic_time () - start_time) / (gdouble) G_USEC_PER_SEC);
+
+  if (replay.n_events > 0)
+  {
+    g_print ("filter-event latency, recorded: avg %"G_GINT64_FORMAT" us, "
+             "max %"G_GINT64_FORMAT" us\n",
+             replay.trace_event_time / replay.n_events, replay.trace_event_max);
+    g_print ("filter-event latency, replayed: avg %"G_GINT64_FORMAT" us, "
+             "max %"G_GINT64_FORMAT" us\n",
+             replay.replay_event_time / replay.n_events, replay.replay_event_max);
+  }
+
+  g_print ("%u mismatches\n", replay.n_mismatches);
+}
+
+int
+main (int argc, char **argv)
+{
+  GError  *error = NULL;
+  gchar  **filenames = NULL;
+  gboolean is_debug = FALSE;
+
+  GOptionContext *context;
+  GOptionEntry    entries[] = {
+    {"in-process", 0, 0, G_OPTION_ARG_NONE, &replay.in_process, N_("Replay into engines loaded in this process instead of the daemon"), NULL},
+    {"max-speed", 0, 0, G_OPTION_ARG_NONE, &replay.max_speed, N_("Replay as fast as possible instead of at the recorded speed"), NULL},
+    {"verbose", 0, 0, G_OPTION_ARG_NONE, &replay.verbose, N_("Print each replayed record"), NULL},
+    {"debug", 0, 0, G_OPTION_ARG_NONE, &is_debug, N_("Log debugging message"), NULL},
+    {G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &filenames, NULL, N_("TRACE")},
+    {NULL}
+  };
+
+  context = g_option_context_new ("- Replay a Nimf keystroke trace");
+  g_option_context_add_main_entries (context, entries, GETTEXT_PACKAGE);
+  g_option_context_parse (context, &argc, &argv, &error);
+  g_option_context_free (context);
+
+  if (error != NULL)
+  {
+    g_warning ("%s", error->message);
+    g_error_free (error);
+    return EXIT_FAILURE;
+  }
+
+  if (filenames == NULL || filenames[0] == NULL)
+  {
+    g_printerr ("Usage: %s [OPTION...] TRACE\n", g_get_prgname ());
+    return EXIT_FAILURE;
+  }
+
+  if (is_debug)
+    g_setenv ("G_MESSAGES_DEBUG", "nimf", TRUE);
+
+  replay.records = nimf_trace_load (filenames[0], &error);
+  g_strfreev (filenames);
+
+  if (replay.records == NULL)
+  {
+    g_printerr ("%s\n", error->message);
+    g_error_free (error);
+    return EXIT_FAILURE;
+  }
+
+  replay.consumed = g_new0 (gboolean, replay.records->len);
+  replay.outputs  = g_ptr_array_new_with_free_func ((GDestroyNotify) nimf_trace_record_free);
+  replay.contexts = g_hash_table_new_full (nimf_replay_context_hash,
+                                           nimf_replay_context_equal,
+                                           (GDestroyNotify) nimf_replay_context_free,
+                                           NULL);
+
+  if (replay.in_process)
+    /* engines only; no listener, services are not started */
+    replay.server = g_object_new (NIMF_TYPE_SERVER,
+                                  "address", "nimf-trace-replay", NULL);
+
+  nimf_replay_run ();
+
+  g_hash_table_unref (replay.contexts);
+
+  if (replay.server)
+    g_object_unref (replay.server);
+
+  g_ptr_array_unref (replay.outputs);
+  g_ptr_array_unref (replay.records);
+  g_free (replay.consumed);
+
+  return replay.n_mismatches > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}